@@ -35,6 +35,8 @@ public:
 
     void onDanmakuInfo(int roomid, const bilibili::LiveDanmakuinfo& info) override;
 
+    void onEmoticonAtlas(const std::shared_ptr<LiveEmoticonAtlas>& atlas) override;
+
     std::vector<std::string> getQualityDescriptionList();
     int getCurrentQualityIndex();
 
@@ -59,6 +59,9 @@ public:
     // 设置清晰度
     void setVideoQuality();
 
+    // 离线下载当前视频
+    void downloadVideo();
+
     // 切换评论模式
     void setCommentMode();
 
@@ -78,6 +81,9 @@ public:
     // 切换到下一集
     virtual void onIndexChangeToNext() = 0;
 
+    // 预加载下一集
+    virtual void requestNextPreload() {}
+
     // 上报播放进度
     virtual void reportCurrentProgress(size_t progress, size_t duration) = 0;
 
@@ -152,6 +158,7 @@ public:
     int getProgress() override;
     void onIndexChange(size_t index) override;
     void onIndexChangeToNext() override;
+    void requestNextPreload() override;
     void reportCurrentProgress(size_t progress, size_t duration) override;
     void requestCastUrl() override;
 
@@ -202,6 +209,8 @@ public:
 
     void onIndexChangeToNext() override;
 
+    void requestNextPreload() override;
+
     void reportCurrentProgress(size_t progress, size_t duration) override;
 
     void onCastPlayUrl(const bilibili::VideoUrlResult& result) override;
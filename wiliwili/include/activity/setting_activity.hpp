@@ -38,6 +38,8 @@ private:
     BRLS_BIND(brls::RadioCell, btnNetworkChecker, "tools/network_checker");
     BRLS_BIND(brls::RadioCell, btnReleaseChecker, "tools/release_checker");
     BRLS_BIND(brls::RadioCell, btnExportBan, "tools/export_banlist");
+    BRLS_BIND(brls::RadioCell, btnMediaCache, "tools/media_cache");
+    BRLS_BIND(brls::RadioCell, btnDownloads, "tools/downloads");
     BRLS_BIND(brls::RadioCell, btnQuit, "tools/quit");
     BRLS_BIND(brls::RadioCell, btnOpenConfig, "tools/config_dir");
     BRLS_BIND(brls::RadioCell, btnVibrationTest, "tools/vibration_test");
@@ -58,6 +60,8 @@ private:
     BRLS_BIND(brls::BooleanCell, btnHWDEC, "setting/video/hwdec");
     BRLS_BIND(brls::BooleanCell, btnAutoPlay, "setting/video/auto_play");
     BRLS_BIND(BiliSelectorCell, selectorInmemory, "setting/video/inmemory");
+    BRLS_BIND(BiliSelectorCell, selectorDiskCache, "setting/video/disk_cache");
+    BRLS_BIND(BiliSelectorCell, selectorDownloadBandwidth, "setting/video/download_bandwidth");
     BRLS_BIND(BiliSelectorCell, selectorFormat, "setting/video/format");
     BRLS_BIND(BiliSelectorCell, selectorCodec, "setting/video/codec");
     BRLS_BIND(BiliSelectorCell, selectorQuality, "setting/audio/quality");
@@ -65,6 +69,7 @@ private:
     BRLS_BIND(TextBox, labelOpensource, "setting/label/opensource");
     BRLS_BIND(brls::BooleanCell, cellShowBar, "cell/showBottomBar");
     BRLS_BIND(brls::BooleanCell, cellShowFPS, "cell/showFPS");
+    BRLS_BIND(brls::BooleanCell, cellIdleFPS, "cell/idleFPS");
     BRLS_BIND(brls::BooleanCell, cellTvSearch, "cell/tvSearch");
     BRLS_BIND(brls::BooleanCell, cellTvOSD, "cell/tvOSD");
     BRLS_BIND(brls::BooleanCell, cellFullscreen, "cell/fullscreen");
@@ -48,6 +48,7 @@ class VideoRelation;            // 某个视频点赞收藏情况
 class VideoEpisodeRelation;     // 番剧的某一集的点赞收藏情况
 class VideoUrlResult;           // 视频播放地址
 class VideoHighlightProgress;   // 视频高能进度条
+class VideoShotResult;          // 视频进度条预览图
 class VideoDetailPage;
 typedef std::vector<VideoDetailPage> VideoDetailPageListResult;  // 视频分P列表 （视频详情API可以直接获取分P列表）
 class VideoPageResult;                                           // 视频分P详情 （主要用来获取cc字幕）
@@ -486,6 +487,11 @@ public:
                                        const std::function<void(VideoHighlightProgress)>& callback = nullptr,
                                        const ErrorCallback& error                                  = nullptr);
 
+    /// 视频页 获取进度条预览图
+    static void get_video_shot(const std::string& bvid, uint64_t cid,
+                               const std::function<void(VideoShotResult)>& callback = nullptr,
+                               const ErrorCallback& error                           = nullptr);
+
     /// 视频页 上报历史记录
     static void report_history(const std::string& mid, const std::string& access_key, uint64_t aid,
                                uint64_t cid, int type = 3, unsigned int progress = 0, unsigned int duration = 0,
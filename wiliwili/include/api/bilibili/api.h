@@ -4,10 +4,25 @@
 
 #pragma once
 
+#ifdef LOCAL_TEST_SERVER
+#include "utils/local_server.hpp"
+#endif
+
 namespace bilibili {
 
 namespace Api {
 
+#ifdef LOCAL_TEST_SERVER
+// 所有请求都发送到本地测试服务器，见 utils/local_server.hpp
+const std::string _apiBase     = LOCAL_TEST_SERVER_URL "api.bilibili.com";
+const std::string _appBase     = LOCAL_TEST_SERVER_URL "app.bilibili.com";
+const std::string _vcBase      = LOCAL_TEST_SERVER_URL "api.vc.bilibili.com";
+const std::string _bvcBase     = LOCAL_TEST_SERVER_URL "bvc.bilivideo.com";
+const std::string _liveBase    = LOCAL_TEST_SERVER_URL "api.live.bilibili.com";
+const std::string _passBase    = LOCAL_TEST_SERVER_URL "passport.bilibili.com";
+const std::string _bangumiBase = LOCAL_TEST_SERVER_URL "bangumi.bilibili.com";
+const std::string _grpcBase    = LOCAL_TEST_SERVER_URL "grpc.biliapi.net";
+#else
 const std::string _apiBase     = "https://api.bilibili.com";
 const std::string _appBase     = "https://app.bilibili.com";
 const std::string _vcBase      = "https://api.vc.bilibili.com";
@@ -16,6 +31,7 @@ const std::string _liveBase    = "https://api.live.bilibili.com";
 const std::string _passBase    = "https://passport.bilibili.com";
 const std::string _bangumiBase = "https://bangumi.bilibili.com";
 const std::string _grpcBase    = "https://grpc.biliapi.net";
+#endif
 
 /// ===
 /// 视频API
@@ -92,6 +108,8 @@ const std::string VideoEpisodeRelation = _apiBase + "/pgc/season/episode/web/inf
 const std::string VideoDanmaku = _apiBase + "/x/v1/dm/list.so";
 /// 获取高能进度条
 const std::string VideoHighlight = _bvcBase + "/pbp/data";
+/// 获取进度条预览图
+const std::string VideoShot = _apiBase + "/x/player/videoshot";
 /// 获取直播弹幕token
 const std::string LiveDanmakuInfo = _liveBase + "/xlive/web-room/v1/index/getDanmuInfo";
 /// 直播API
@@ -665,6 +665,25 @@ inline void from_json(const nlohmann::json& nlohmann_json_j, VideoHighlightProgr
     }
 }
 
+/// 进度条预览图
+/// 每张图片由 img_x_len * img_y_len 个 img_x_size * img_y_size 的小图组成，index 为每张小图对应的时间 (s)
+class VideoShotResult {
+public:
+    int img_x_len  = 0;
+    int img_y_len  = 0;
+    int img_x_size = 0;
+    int img_y_size = 0;
+    std::vector<std::string> image;
+    std::vector<unsigned int> index;
+};
+inline void from_json(const nlohmann::json& nlohmann_json_j, VideoShotResult& nlohmann_json_t) {
+    NLOHMANN_JSON_EXPAND(NLOHMANN_JSON_PASTE(NLOHMANN_JSON_FROM, img_x_len, img_y_len, img_x_size, img_y_size));
+    if (nlohmann_json_j.contains("image") && nlohmann_json_j.at("image").is_array())
+        nlohmann_json_j.at("image").get_to(nlohmann_json_t.image);
+    if (nlohmann_json_j.contains("index") && nlohmann_json_j.at("index").is_array())
+        nlohmann_json_j.at("index").get_to(nlohmann_json_t.index);
+}
+
 class VideoOnlineTotal {
 public:
     std::string total;
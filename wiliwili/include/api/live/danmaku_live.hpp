@@ -5,10 +5,16 @@
 #pragma once
 
 #include <cstddef>
+#include <cstdint>
 #include <string>
 #include <atomic>
 #include <thread>
 #include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <queue>
+#include <memory>
+#include <unordered_map>
 
 #include <borealis/core/singleton.hpp>
 #include <mongoose.h>
@@ -19,37 +25,178 @@
 
 using json = nlohmann::json;
 
-typedef void (*on_message_func_t)(const std::string &);
+typedef std::function<void(const std::string &)> on_message_func_t;
+
+/**
+ * 弹幕连接状态变化的回调，在事件循环线程中调用
+ * @param connected 是否已连接 (已发送进房请求)
+ * @param gap 重新连接时，弹幕中断的时长 (ms)
+ */
+typedef std::function<void(bool connected, uint64_t gap)> on_status_func_t;
+
+class LiveDanmakuRoom;
+
+/// 对弹幕服务器的测速连接
+class LiveDanmakuProbe {
+public:
+    LiveDanmakuRoom *room = nullptr;
+    mg_connection *nc     = nullptr;
+    size_t index          = 0;
+    uint64_t latency      = UINT64_MAX;
+    bool done             = false;
+};
+
+/// 单个直播间的弹幕连接状态，只在 LiveDanmakuManager 的事件循环线程中访问
+class LiveDanmakuRoom {
+public:
+    size_t id;
+    int room_id;
+    uint64_t uid;
+    bilibili::LiveDanmakuinfo info;
+
+    mg_connection *nc   = nullptr;
+    mg_timer *heartbeat = nullptr;
+    bool ws_open        = false;
+
+    // 按延迟从低到高排序的服务器序号，host_index 为当前使用的服务器在其中的位置
+    std::vector<size_t> host_order;
+    size_t host_index = 0;
+
+    // 测速状态
+    std::vector<LiveDanmakuProbe> probes;
+    bool probing            = false;
+    uint64_t probe_deadline = 0;
+
+    // 连续连接失败的次数，用于切换服务器与计算指数退避的时间
+    size_t retry = 0;
+    // 下一次重连的时间 (mg_millis)，为 0 时表示不需要重连
+    uint64_t reconnect_at = 0;
+    // 最后一次收到服务器数据的时间 (mg_millis)
+    uint64_t last_recv = 0;
+    // 弹幕开始中断的时间 (mg_millis)，为 0 时表示没有中断
+    uint64_t gap_start = 0;
+
+    const bilibili::LiveDanmakuHostinfo &current_host() const;
+
+    void send_join_request();
+    void send_heartbeat();
+};
+
+class LiveDanmakuSink {
+public:
+    on_message_func_t on_message;
+    on_status_func_t on_status;
+};
+
+/**
+ * 直播弹幕连接管理
+ * 所有直播间共用一个 mongoose 事件循环线程和一个消息处理线程，
+ * 同时打开多个直播间时线程数量保持不变
+ */
+class LiveDanmakuManager : public brls::Singleton<LiveDanmakuManager> {
+public:
+    LiveDanmakuManager() = default;
+    ~LiveDanmakuManager();
+
+    /**
+     * 添加一个直播间
+     * @param func 收到消息后的回调，在消息处理线程中调用
+     * @return 连接 id，用于移除直播间
+     */
+    size_t add_room(int room_id, uint64_t uid, const bilibili::LiveDanmakuinfo &info, on_message_func_t func,
+                    on_status_func_t status = nullptr);
+
+    /// 移除直播间，之后不会再收到该直播间的消息；所有直播间都移除后停止事件循环
+    void remove_room(size_t id);
+
+    void set_wait_time(size_t time);
+
+    /// 当前打开的直播间数量
+    size_t room_count();
+
+    /// 重连的最大退避时间 (ms)
+    static inline uint64_t MAX_RECONNECT_DELAY = 30000;
+
+    /// 心跳间隔 (ms)
+    static inline uint64_t HEARTBEAT_INTERVAL = 30000;
+
+    /// 超过此时间没有收到服务器的任何数据时，认为连接已经失效 (ms)
+    static inline uint64_t HEARTBEAT_TIMEOUT = 70000;
+
+    /// 服务器测速的最长等待时间 (ms)
+    static inline uint64_t PROBE_TIMEOUT = 1500;
+
+private:
+    std::atomic<size_t> wait_time{100};
+    size_t next_id = 1;
+
+    std::mutex state_mutex;
+    std::thread mongoose_thread;
+    std::thread task_thread;
+    std::atomic_bool running{false};
+    mg_mgr *mgr = nullptr;
+    // 任意一个存活连接的 id，用于唤醒事件循环
+    std::atomic<unsigned long> wakeup_id{0};
+
+    // 只在事件循环线程中访问
+    std::unordered_map<size_t, std::shared_ptr<LiveDanmakuRoom>> rooms;
+
+    // 需要在事件循环线程中执行的操作
+    std::mutex command_mutex;
+    std::vector<std::function<void()>> commands;
+
+    // 各直播间的消息回调
+    std::mutex sink_mutex;
+    std::unordered_map<size_t, LiveDanmakuSink> sinks;
+
+    // 待处理的消息 <连接 id, 消息>
+    std::mutex msg_q_mutex;
+    std::condition_variable cv;
+    std::queue<std::pair<size_t, std::string>> msg_q;
+
+    void start();
+    void stop();
+    void run_command(std::function<void()> func);
+    void probe_hosts(LiveDanmakuRoom *room);
+    void finish_probe(LiveDanmakuRoom *room);
+    void open_room(LiveDanmakuRoom *room);
+    void close_room(LiveDanmakuRoom *room);
+    void on_room_closed(LiveDanmakuRoom *room);
+    void check_rooms();
+    void notify_status(LiveDanmakuRoom *room, bool connected, uint64_t gap);
+    void add_msg(size_t id, std::string &&msg);
+
+    static void event_handler(struct mg_connection *nc, int ev, void *ev_data);
+    static void probe_handler(struct mg_connection *nc, int ev, void *ev_data);
+    static void heartbeat_timer(void *param);
+};
+
+/// 直播弹幕连接，实际的连接由 LiveDanmakuManager 统一管理
 class LiveDanmaku {
 public:
     int room_id;
     int uid;
     void connect(int room_id, uint64_t uid, const bilibili::LiveDanmakuinfo &info);
     void disconnect();
-    void send_join_request(int room_id, uint64_t uid);
 
-    void send_heartbeat();
     void send_text_message(const std::string &message);
 
     void setonMessage(on_message_func_t func);
     on_message_func_t onMessage = nullptr;
 
+    void setonStatus(on_status_func_t func);
+    on_status_func_t onStatus = nullptr;
+
     void set_wait_time(size_t time);
-    size_t wait_time = 100;
 
     LiveDanmaku();
     ~LiveDanmaku();
 
     bool is_connected();
     std::atomic_bool connected{false};
-    bool is_evOK();
-    std::atomic_bool ms_ev_ok{false};
 
     bilibili::LiveDanmakuinfo info;
 
-    std::thread mongoose_thread;
-    std::thread task_thread;
-    std::mutex mongoose_mutex;
-    mg_mgr *mgr;
-    mg_connection *nc;
-};
\ No newline at end of file
+private:
+    size_t conn_id = 0;
+};
@@ -5,10 +5,35 @@
 #pragma once
 
 #include <unordered_map>
+#include <functional>
+#include <memory>
 #include <vector>
 #include <string>
 #include <cstdint>
 
-using lmp = std::unordered_map<std::string, std::vector<uint8_t>>;
+/// 表情在图集中的位置
+class LiveEmoticonRect {
+public:
+    int x = 0, y = 0, w = 0, h = 0;
+};
 
-lmp dl_emoticon(int room_id);
\ No newline at end of file
+/// 解码后的直播间表情图集 (RGBA)，纹理需要在主线程中创建
+class LiveEmoticonAtlas {
+public:
+    int width  = 0;
+    int height = 0;
+    std::vector<uint8_t> pixels;
+    std::unordered_map<std::string, LiveEmoticonRect> items;
+};
+
+typedef std::function<void(std::shared_ptr<LiveEmoticonAtlas>)> on_emoticon_func_t;
+
+/// 图集的最大宽高
+constexpr int EMOTICON_ATLAS_SIZE = 2048;
+
+/**
+ * 异步下载直播间的表情，并在网络线程中解码为一张图集
+ * 图片并发下载，并缓存在磁盘中供所有直播间共用
+ * @param callback 完成后的回调，在网络线程中调用；请求失败时参数为 nullptr
+ */
+void dl_emoticon(int room_id, const on_emoticon_func_t &callback);
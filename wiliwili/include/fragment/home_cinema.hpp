@@ -18,6 +18,8 @@ public:
 
     void onCreate() override;
 
+    bool isReleasable() override;
+
     void onCinemaList(const bilibili::PGCResultWrapper &result) override;
 
     ~HomeCinema();
@@ -26,8 +26,17 @@ public:
 
     void onCreate() override;
 
+    bool isReleasable() override;
+
+    std::shared_ptr<AttachedViewState> onSaveState() override;
+
+    void onRestoreState(const std::shared_ptr<AttachedViewState> &state) override;
+
     void onError(const std::string &error) override;
 
 private:
     BRLS_BIND(RecyclingGrid, recyclingGrid, "home/recommends/recyclingGrid");
+
+    // 从释放前保存的状态恢复时，不再请求第一页
+    bool restored = false;
 };
\ No newline at end of file
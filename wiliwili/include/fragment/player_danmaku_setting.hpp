@@ -38,6 +38,7 @@ private:
     BRLS_BIND(brls::BooleanCell, cellBottom, "player/danmaku/filter/bottom");
     BRLS_BIND(brls::BooleanCell, cellColor, "player/danmaku/filter/color");
     BRLS_BIND(brls::BooleanCell, cellAdvanced, "player/danmaku/filter/advanced");
+    BRLS_BIND(brls::BooleanCell, cellMerge, "player/danmaku/filter/merge");
 
     BRLS_BIND(BiliSelectorCell, cellArea, "player/danmaku/style/area");
     BRLS_BIND(BiliSelectorCell, cellAlpha, "player/danmaku/style/alpha");
@@ -48,6 +49,8 @@ private:
 
     BRLS_BIND(BiliSelectorCell, cellRenderPerf, "player/danmaku/performance/render");
 
+    BRLS_BIND(brls::BooleanCell, cellLiveRecord, "player/danmaku/live/record");
+
     BRLS_BIND(ButtonClose, closebtn, "button/close");
     BRLS_BIND(brls::ScrollingFrame, settings, "danmaku/settings");
     BRLS_BIND(brls::Box, cancel, "player/cancel");
@@ -19,6 +19,18 @@ public:
 
     void requestRecommendVideoList(int index = 1, int num = 30, int fresh = 0, FeedType type = FeedType::V1);
 
-private:
+    /**
+     * 启动时提前请求第一页推荐，与主界面的构建同时进行，只支持 V1 推荐
+     * 之后首页第一次加载同样数量的推荐时直接使用（或等待）这次请求的结果，需要在主线程调用
+     */
+    static void prefetch(FeedType type = FeedType::V1, int num = 30);
+
+    /// 启动时显示的不是推荐页时丢弃预取的结果
+    static void cancelPrefetch();
+
+    /// 预取的结果返回后多久没有被使用就丢弃 (ms)
+    static inline int PREFETCH_EXPIRE = 10000;
+
+protected:
     int requestPage;
 };
@@ -7,6 +7,7 @@
 #include "bilibili/result/home_live_result.h"
 #include "bilibili/result/live_danmaku_result.h"
 #include "presenter/presenter.h"
+#include "live/dl_emoticon.hpp"
 
 class LiveDataRequest : public Presenter {
 public:
@@ -19,6 +20,8 @@ public:
 
     virtual void onDanmakuInfo(int roomid, const bilibili::LiveDanmakuinfo& info) {}
 
+    virtual void onEmoticonAtlas(const std::shared_ptr<LiveEmoticonAtlas>& atlas) {}
+
     void requestData(int roomid);
 
     void reportHistory(int roomid);
@@ -27,6 +30,9 @@ public:
 
     void requestLiveDanmakuToken(int roomid);
 
+    /// 获取直播间的表情
+    void requestLiveEmoticon(int roomid);
+
     std::string getQualityDescription(int qn);
 
     static inline int defaultQuality = 0;
@@ -5,6 +5,8 @@
 #pragma once
 
 #include <borealis/core/event.hpp>
+#include <chrono>
+#include <memory>
 
 #include "presenter.h"
 #include "bilibili.h"
@@ -12,6 +14,8 @@
 #include "bilibili/result/home_pgc_season_result.h"
 #include "presenter/comment_related.hpp"
 
+class VideoPreloadData;
+
 // 指明一个id的类型
 enum class PGC_ID_TYPE {
     SEASON_ID,  // 剧ID
@@ -100,6 +104,24 @@ public:
     /// 获取视频分P详情
     void requestVideoPageDetail(const std::string& bvid, uint64_t cid, bool requestHistoryInfo = true);
 
+    /**
+     * 预加载下一个视频的播放地址、弹幕与分P详情，切换到该视频时直接使用
+     * @param season 是否为番剧
+     */
+    void requestPreload(const std::string& bvid, uint64_t cid, bool season);
+
+    /// 距离视频结束多少秒时预加载下一个视频，为 0 时不预加载
+    inline static int PRELOAD_TIME = 30;
+
+    /// 播放地址的过期时间，优先使用链接中的 deadline 参数，提前 URL_EXPIRE_MARGIN 秒视为过期
+    static std::chrono::system_clock::time_point getUrlDeadline(const bilibili::VideoUrlResult& result);
+
+    /// 链接中没有 deadline 参数时，播放地址的有效期 (s)
+    inline static int URL_EXPIRE = 6600;
+
+    /// 播放地址到期前多少秒视为过期 (s)
+    inline static int URL_EXPIRE_MARGIN = 600;
+
     /// 上报播放进度
     void reportHistory(uint64_t aid, uint64_t cid, unsigned int progress = 0, unsigned int duration = 0, int type = 3);
     inline static bool REPORT_HISTORY = true;
@@ -133,6 +155,25 @@ public:
     static inline int defaultQuality = 116;
 
 protected:
+    /// 处理视频信息：分P、合集、推荐等，并请求播放地址
+    void onVideoDetailAll(const bilibili::VideoDetailAllResult& result);
+
+    /// 处理分P详情：字幕链接/防遮挡数据/历史播放记录
+    void onVideoPageDetail(const bilibili::VideoPageResult& result, bool requestVideoHistory);
+
+    /// 使用预加载的数据播放视频，没有可用的预加载数据时返回 false
+    bool usePreload(const std::string& bvid, uint64_t cid, bool season, bool requestHistoryInfo);
+
+    /// 使用离线下载的文件播放视频，视频未下载时返回 false
+    bool useDownload(const std::string& bvid, uint64_t cid, bool requestHistoryInfo);
+
+    void requestPreloadUrl(const std::shared_ptr<VideoPreloadData>& data);
+    void requestPreloadDanmaku(const std::shared_ptr<VideoPreloadData>& data);
+    void requestPreloadPageDetail(const std::shared_ptr<VideoPreloadData>& data);
+
+    // 预加载的下一个视频
+    std::shared_ptr<VideoPreloadData> preloadData;
+
     bilibili::VideoDetailResult videoDetailResult;       //  视频数据
     bilibili::VideoDetailPage videoDetailPage;           // 视频分P数据
     bilibili::VideoDetailListResult videDetailRelated;   // 推荐视频
@@ -0,0 +1,112 @@
+#pragma once
+
+#include <chrono>
+#include <deque>
+#include <string>
+#include <vector>
+#include <borealis/core/singleton.hpp>
+
+#include "bilibili/result/video_detail_result.h"
+#include "utils/event_helper.hpp"
+
+/// 可供自适应切换的一路 dash 视频流
+class AbrRepresentation {
+public:
+    int id                 = 0;
+    int codecid            = 0;
+    unsigned int bandwidth = 0;  // bps
+    // 当前使用的链接，以及按 CDN 节点表现排序的所有链接
+    std::string url;
+    std::vector<std::string> urls;
+    size_t host = 0;
+    std::string description;
+    // 是否已经添加到播放器中，对应的轨道 id 由 mpv 分配，切换时从 track-list 中查找
+    bool loaded = false;
+    // 是否作为外挂轨道添加，加载视频时播放的视频流不是外挂轨道
+    bool external = false;
+};
+
+/**
+ * 自适应清晰度
+ * 根据测得的下载速度、缓存时长与卡顿次数，在不高于用户所选清晰度的视频流之间切换；
+ * 切换时通过 mpv 的外挂视频轨道实现，不需要重新加载整个视频；
+ * 播放中途下载速度过低时，同样以外挂轨道的方式切换到其他 CDN 节点
+ */
+class AbrHelper : public brls::Singleton<AbrHelper> {
+public:
+    AbrHelper();
+
+    ~AbrHelper();
+
+    /**
+     * 设置当前播放的视频，生成可供切换的视频流列表
+     * @param result 视频播放地址
+     * @param playing 当前正在播放的视频流
+     */
+    void setRepresentations(const bilibili::VideoUrlResult& result, const bilibili::DashMedia& playing);
+
+    void reset();
+
+    /// 是否开启自适应清晰度
+    static inline bool ENABLE = false;
+
+    /// 只使用测得带宽的一部分，为码率波动留出余量
+    static inline double SAFETY_FACTOR = 0.7;
+
+    /// 缓存低于此时长 (s) 且带宽不足时降低清晰度
+    static inline double LOW_BUFFER = 5;
+
+    /// 缓存高于此时长 (s) 时才会尝试提高清晰度
+    static inline double HIGH_BUFFER = 15;
+
+    /// 两次提高清晰度之间的最短间隔 (s)
+    static inline int SWITCH_INTERVAL = 10;
+
+    /// 统计卡顿次数的时间窗口 (s)，窗口内发生过卡顿时不会提高清晰度
+    static inline int STALL_WINDOW = 60;
+
+    /// 缓存不足且下载速度低于视频码率的这一比例时，视为当前 CDN 节点异常
+    static inline double COLLAPSE_RATIO = 0.5;
+
+    /// 节点异常持续此时长 (s) 后切换节点，发生卡顿时立即切换
+    static inline int FAILOVER_DELAY = 5;
+
+    /// 两次切换节点之间的最短间隔 (s)
+    static inline int FAILOVER_INTERVAL = 30;
+
+private:
+    void onCacheSpeed(int64_t speed, double buffer);
+
+    void onStall();
+
+    /// 根据当前状态选择合适的视频流
+    void decide(bool stalled);
+
+    void switchTo(size_t index, const std::string& reason);
+
+    /// 当前节点的下载速度是否已经无法维持播放
+    bool isCollapsed(bool stalled);
+
+    /// 将当前视频流切换到下一个 CDN 节点
+    void failover();
+
+    /// 带宽允许的最高视频流
+    size_t getSustainableIndex() const;
+
+    /// 在播放器的 track-list 中查找视频流对应的视频轨道 id，找不到时返回 0
+    static int findTrack(const AbrRepresentation& rep);
+
+    /// 以外挂轨道的方式添加视频流并切换过去
+    static void addTrack(AbrRepresentation& rep);
+
+    std::vector<AbrRepresentation> ladder;  // 按码率从低到高排列
+    size_t current = 0;
+    // 加载视频时播放的视频流，播放器切换到备用链接后会重新从这一路开始
+    size_t initial    = 0;
+    double throughput = 0;  // bps
+    std::deque<std::chrono::steady_clock::time_point> stalls;
+    size_t totalStalls = 0;
+    std::chrono::steady_clock::time_point lastSwitch, lastDecision, lastFailover, collapseSince;
+    bool collapsing = false;
+    MPVEvent::Subscription event_id;
+};
@@ -0,0 +1,42 @@
+#pragma once
+
+#ifdef LOCAL_TEST_SERVER
+
+#include <chrono>
+#include <string>
+#include <borealis/core/singleton.hpp>
+
+#include "utils/event_helper.hpp"
+
+/**
+ * 播放器加载速度测试
+ * 打开指定视频，记录从打开页面到获取播放地址、首帧画面与弹幕加载完成所用的时间，输出结果后退出程序；
+ * 配合本地测试服务器使用，可以在相同的网络条件下比较不同版本的加载速度
+ */
+class BenchmarkHelper : public brls::Singleton<BenchmarkHelper> {
+public:
+    ~BenchmarkHelper();
+
+    void start(const std::string& bvid);
+
+    /// 超时时间 (ms)，超时后直接输出已有的结果
+    static inline int TIMEOUT = 60000;
+
+private:
+    void check();
+
+    void report(bool timeout);
+
+    /// 从开始测试到现在的时间 (ms)
+    int64_t elapsed() const;
+
+    std::string bvid;
+    std::chrono::steady_clock::time_point startTime;
+    // 各阶段的耗时 (ms)，-1 表示还未完成
+    int64_t urlTime = -1, frameTime = -1, danmakuTime = -1;
+    bool finished = false;
+    MPVEvent::Subscription mpvEventID;
+    CustomEvent::Subscription customEventID;
+};
+
+#endif
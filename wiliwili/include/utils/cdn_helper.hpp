@@ -0,0 +1,95 @@
+#pragma once
+
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <borealis/core/singleton.hpp>
+
+/// 一个 CDN 节点的历史表现
+class CdnHostStat {
+public:
+    double speed    = 0;  // 平均下载速度 (byte/s)
+    double latency  = 0;  // 平均首字节时间 (ms)
+    size_t success  = 0;  // 播放中成功测得下载速度的次数
+    size_t failure  = 0;
+    size_t probes   = 0;  // 后台测速成功的次数，不计入 success
+    int64_t updated = 0;  // 最后一次更新的 unix 时间戳 (s)
+};
+
+/**
+ * 视频 CDN 选择
+ * 播放地址中的 base_url 和 backup_url 通常位于不同的 CDN 节点上，
+ * 播放时立即使用主链接（历史记录足够时使用表现最好的节点），同时在后台向各节点请求几 KB 数据测量首字节时间；
+ * 各节点的首字节时间、播放中的下载速度与失败次数会保存在配置目录中，供之后选择节点，数据足够时不再重复测速
+ */
+class CdnHelper : public brls::Singleton<CdnHelper> {
+public:
+    CdnHelper();
+
+    /**
+     * 在后台测量各节点的首字节时间，结果只记录到历史中，不影响正在进行的播放
+     * 所有节点都有足够新的历史记录时不测速
+     * @param urls 同一视频流的所有链接
+     */
+    void probe(const std::vector<std::string>& urls);
+
+    /// 根据历史表现对链接排序，不进行测速
+    std::vector<std::string> sort(const std::vector<std::string>& urls);
+
+    /// 所有节点都有足够新的历史记录时按历史表现排序，否则保持原有的顺序（主链接在前）
+    std::vector<std::string> order(const std::vector<std::string>& urls);
+
+    /// 记录一次下载速度 (byte/s)
+    void reportSpeed(const std::string& url, double speed);
+
+    /// 记录一次测速的首字节时间 (ms)
+    void reportLatency(const std::string& url, double latency);
+
+    /// 记录一次失败（请求出错或播放中途速度过低）
+    void reportFailure(const std::string& url);
+
+    /// 将各节点的表现保存到配置目录
+    void save();
+
+    /// 有新的记录时在后台线程中保存
+    void saveAsync();
+
+    static std::string getHost(const std::string& url);
+
+    /// 测速时请求的数据量 (byte)，只用来测量首字节时间
+    static inline int64_t PROBE_SIZE = 4 * 1024;
+
+    /// 测速的超时时间 (ms)
+    static inline int PROBE_TIMEOUT = 1500;
+
+    /// 所有节点都至少有这么多次播放中的成功记录，且都在 STAT_FRESH 内更新过时，直接使用历史记录排序
+    static inline size_t PROBE_SKIP_SAMPLES = 3;
+
+    /// 历史记录在此时间 (s) 内视为有效，无需重新测速
+    static inline int64_t STAT_FRESH = 24 * 3600;
+
+    /// 超过此时间 (s) 的历史记录在加载时丢弃
+    static inline int64_t STAT_EXPIRE = 7 * 24 * 3600;
+
+    /// 没有历史记录的节点使用的默认速度 (byte/s)
+    static inline double DEFAULT_SPEED = 1024 * 1024;
+
+private:
+    void load();
+
+    /// 节点得分，失败次数越多、首字节时间越长得分越低
+    double getScore(const std::string& host);
+
+    /// 所有节点都有足够新的历史记录
+    bool isKnown(const std::vector<std::string>& urls);
+
+    std::string getPath();
+
+    std::mutex mutex;
+    // 避免多个线程同时写入文件
+    std::mutex saveMutex;
+    std::unordered_map<std::string, CdnHostStat> stats;
+    bool dirty = false;
+};
@@ -46,6 +46,8 @@ enum class SettingItem {
     PLAYER_SKIP_OPENING_CREDITS,
     PLAYER_LOW_QUALITY,
     PLAYER_INMEMORY_CACHE,
+    PLAYER_DISK_CACHE,
+    DOWNLOAD_BANDWIDTH,
     PLAYER_HWDEC,
     PLAYER_HWDEC_CUSTOM,
     PLAYER_EXIT_FULLSCREEN_ON_END,
@@ -58,6 +60,7 @@ enum class SettingItem {
     PLAYER_HUE,
     PLAYER_GAMMA,
     PLAYER_OSD_TV_MODE,
+    PLAYER_ADAPTIVE_QUALITY,
     VIDEO_QUALITY,
     TEXTURE_CACHE_NUM,
     OPENCC_ON,
@@ -75,6 +78,8 @@ enum class SettingItem {
     DANMAKU_FILTER_COLOR,
     DANMAKU_FILTER_ADVANCED,
     DANMAKU_SMART_MASK,
+    DANMAKU_FILTER_MERGE,
+    DANMAKU_LIVE_RECORD,
     DANMAKU_STYLE_AREA,
     DANMAKU_STYLE_ALPHA,
     DANMAKU_STYLE_FONTSIZE,
@@ -0,0 +1,171 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+#include <borealis/core/singleton.hpp>
+
+namespace bilibili {
+class VideoUrlResult;
+class VideoPageResult;
+class VideoDetailAllResult;
+};  // namespace bilibili
+
+enum class DownloadState {
+    WAITING,      // 排队中
+    DOWNLOADING,  // 下载中
+    PAUSED,       // 已暂停
+    DONE,         // 已完成
+    FAILED,       // 下载失败
+};
+
+/// 一个需要分块下载的视频流
+class DownloadFile {
+public:
+    std::string name;               // 保存在任务目录中的文件名
+    std::vector<std::string> urls;  // 主链接与备用链接，有效期有限，不保存到磁盘
+    int64_t size = -1;              // 文件总大小，-1 表示未知
+    std::vector<bool> chunks;
+    std::set<size_t> fetching;  // 正在下载的分块
+    size_t failure = 0;         // 连续失败的次数，同时用来轮换链接
+};
+
+/// 一个分P或番剧分集的下载任务，所有文件保存在 download/<bvid>_<cid>/ 下
+class DownloadTask {
+public:
+    std::string bvid;
+    uint64_t cid  = 0;
+    uint64_t epid = 0;  // 番剧分集 id，为 0 时表示用户投稿视频
+    std::string title;
+    int quality         = 0;  // 期望的清晰度
+    int videoId         = 0;  // 实际下载的清晰度，重新获取链接时用来匹配同一个视频流
+    int codecId         = 0;
+    int audioId         = 0;
+    int64_t created     = 0;
+    DownloadState state = DownloadState::WAITING;
+    std::string error;
+    std::vector<DownloadFile> files;
+
+    // 播放链接是否可用，每次启动或链接过期后都需要重新获取
+    bool prepared  = false;
+    bool preparing = false;
+    // 本次启动后因下载失败而重新获取链接的次数
+    size_t refreshCount = 0;
+    // 暂停或删除任务时置为 true，正在进行的请求会尽快结束
+    std::shared_ptr<std::atomic<bool>> cancel = std::make_shared<std::atomic<bool>>(false);
+
+    std::string getKey() const;
+
+    /// 已知的总大小 (byte)
+    int64_t getSize() const;
+
+    /// 已下载的大小 (byte)
+    int64_t getDownloadedSize() const;
+
+    bool isBusy() const;
+};
+
+/**
+ * 离线下载
+ * 下载视频流、音频流、弹幕、防遮挡数据与字幕到配置目录，断网时也可以播放；
+ * 视频流按 CHUNK_SIZE 分块并发下载，每个分块完成后记录进度，中断后从未完成的分块继续；
+ * 最多同时进行 MAX_TASKS 个任务，所有任务共享 WORKERS 个下载线程与 BANDWIDTH 限速
+ */
+class DownloadManager : public brls::Singleton<DownloadManager> {
+public:
+    ~DownloadManager();
+
+    /// 读取下载记录，存在未完成的任务时继续下载
+    void start();
+
+    void stop();
+
+    /**
+     * 添加下载任务
+     * @param epid 番剧分集 id，用户投稿视频为 0
+     * @param quality 期望的清晰度，会选择不高于此清晰度的视频流
+     * @return 任务已存在时返回 false
+     */
+    bool add(const std::string& bvid, uint64_t cid, uint64_t epid, const std::string& title, int quality);
+
+    void pause(const std::string& key);
+
+    void resume(const std::string& key);
+
+    /// 删除任务与已下载的文件
+    void remove(const std::string& key);
+
+    /// 所有任务的快照，按添加顺序排列
+    std::vector<DownloadTask> getTasks();
+
+    /// 获取已下载完成的视频的播放地址，链接为本地文件
+    bool getPlayUrl(uint64_t cid, bilibili::VideoUrlResult& result);
+
+    /// 获取已下载完成的视频的分P详情，字幕与防遮挡链接为本地文件
+    bool getPageDetail(uint64_t cid, bilibili::VideoPageResult& result);
+
+    /// 获取已下载完成的视频的 xml 弹幕
+    bool getDanmaku(uint64_t cid, std::string& xml);
+
+    /// 获取已下载的用户投稿视频的详情，用于断网时打开视频
+    bool getVideoDetail(const std::string& bvid, bilibili::VideoDetailAllResult& result);
+
+    /// 同时下载的任务数
+    static inline size_t MAX_TASKS = 2;
+
+    /// 下载线程数，即同时下载的分块数
+    static inline size_t WORKERS = 4;
+
+    /// 分块大小 (byte)
+    static inline int64_t CHUNK_SIZE = 4 * 1024 * 1024;
+
+    /// 所有任务的总下载速度上限 (KB/s)，为 0 时不限速
+    static inline std::atomic<int> BANDWIDTH{0};
+
+    /// 每个链接允许连续失败的次数，超过后任务标记为失败
+    static inline size_t MAX_RETRY = 3;
+
+private:
+    void load();
+
+    /// 保存任务信息与下载进度，需要持有 mutex
+    void save(const DownloadTask& task);
+
+    void worker();
+
+    /// 选择下一个要执行的工作，需要持有 mutex
+    bool pick(std::shared_ptr<DownloadTask>& task, bool& prepare, size_t& file, size_t& chunk);
+
+    /// 获取播放链接、弹幕、字幕等数据，第一次下载时创建文件
+    void prepare(const std::shared_ptr<DownloadTask>& task);
+
+    void fetch(const std::shared_ptr<DownloadTask>& task, size_t file, size_t chunk);
+
+    /// 所有分块都下载完成时标记任务完成，需要持有 mutex
+    void checkFinished(DownloadTask& task);
+
+    /// 限速，下载的数据超出 BANDWIDTH 时阻塞当前线程
+    void limit(size_t size);
+
+    std::shared_ptr<DownloadTask> find(uint64_t cid, bool finished);
+
+    std::string getPath(const std::string& key, const std::string& name = "");
+
+    std::string dir;
+    bool loaded  = false;
+    bool running = false;
+    std::mutex mutex;
+    std::condition_variable condition;
+    std::vector<std::shared_ptr<DownloadTask>> tasks;
+    std::vector<std::thread> workers;
+
+    std::mutex limitMutex;
+    double limitTokens      = 0;
+    int64_t limitLastRefill = 0;
+};
@@ -31,6 +31,12 @@ typedef enum MpvEventEnum {
      */
     CACHE_SPEED_CHANGE,
 
+    /**
+     * 播放中途因缓存不足而暂停时触发此事件（不包括跳转进度导致的缓冲）
+     * 自适应清晰度会订阅此事件，用于降低清晰度
+     */
+    CACHE_STALL,
+
     /**
      * 视频播放速度调整时触发此事件
      * 弹幕组件和播放器组件的相关功能会订阅此事件
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <vector>
+#include <borealis/core/singleton.hpp>
+#include <borealis/core/time.hpp>
+
+/**
+ * 帧调度
+ * borealis 在 deactivated_time（默认 IDLE_TIME，设为 0 时关闭）内没有输入、也没有组件调用 setActiveEvent 时，
+ * 会把帧率降到闲置帧率 (deactivated_fps)；组件内容真正发生变化时（图片加载完成、弹幕滚动、列表数据与文字更新等）
+ * 调用 markDirty，之后的 ACTIVE_TIME 内保持正常帧率；
+ * 加载图标等低优先级的动画通过 advance 限制刷新率，不会阻止进入闲置状态；
+ * 此类需要工作在主线程
+ */
+class FrameScheduler : public brls::Singleton<FrameScheduler> {
+public:
+    /// 内容发生了变化，需要以正常帧率重绘
+    void markDirty();
+
+    /**
+     * 低优先级动画应该前进的帧数
+     * 重绘的间隔不会小于 1 / LOW_PRIORITY_FPS，前进的帧数按经过的时间计算，所以动画的速度不受影响
+     * @param last 上一次前进的时间 (us)，返回值大于 0 时更新
+     * @param interval 动画的帧间隔 (us)
+     */
+    size_t advance(brls::Time& last, brls::Time interval);
+
+    /**
+     * 设置进入闲置状态的时间 (ms) 与闲置状态的帧率
+     * @param time 为 0 时不会进入闲置状态
+     */
+    void setDeactivation(int time, int fps);
+
+    /// 是否开启了闲置状态
+    bool isDeactivationEnabled() const;
+
+    /// 在主循环中每帧调用一次，统计帧数、决定是否保持正常帧率，并在空闲的帧中执行 addIdleTask 添加的任务
+    void onFrame();
+
+    /**
+     * 添加一个在空闲的帧中执行的任务，任务返回 false 时移除
+     * 上一帧的间隔没有明显超过 TARGET_FPS 对应的间隔，或处于闲置状态（低帧率）时认为是空闲的帧
+     */
+    void addIdleTask(const std::function<bool()>& task);
+
+    /// 上一帧是否空闲
+    bool isIdleFrame() const;
+
+    /// 上一秒相对 TARGET_FPS 跳过的帧数
+    size_t getSkippedFrames() const;
+
+    /// 上一秒实际绘制的帧数
+    size_t getRenderedFrames() const;
+
+    /// 没有输入与变化时，进入闲置状态前等待的时间 (ms)，deactivated_time 的默认值
+    static inline int IDLE_TIME = 3000;
+
+    /// 调用 markDirty 之后保持正常帧率的时间 (ms)
+    static inline brls::Time ACTIVE_TIME = 500;
+
+    /// 低优先级动画的最高帧率
+    static inline size_t LOW_PRIORITY_FPS = 15;
+
+    /// 正常帧率，用来计算跳过的帧数与判断空闲的帧
+    static inline size_t TARGET_FPS = 60;
+
+    /// 闲置状态的帧率，未开启闲置状态时为 0
+    static inline size_t DEACTIVATED_FPS = 0;
+
+private:
+    brls::Time lastDirty  = 0;
+    brls::Time lastSecond = 0;
+    brls::Time lastFrame  = 0;
+    brls::Time frameTime  = 0;
+    size_t frames         = 0;
+    size_t renderedFrames = 0;
+    size_t skippedFrames  = 0;
+    bool deactivation     = false;
+    std::vector<std::function<bool()>> idleTasks;
+};
@@ -0,0 +1,105 @@
+#pragma once
+
+#ifdef LOCAL_TEST_SERVER
+
+#include <atomic>
+#include <cstdio>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <borealis/core/singleton.hpp>
+
+// 开启 LOCAL_TEST_SERVER 后，所有 api 请求都会发送到本地测试服务器
+// 请求地址为 http://127.0.0.1:9527/<原始域名>/<原始路径>
+#define LOCAL_TEST_SERVER_HOST "127.0.0.1:9527"
+#define LOCAL_TEST_SERVER_URL "http://" LOCAL_TEST_SERVER_HOST "/"
+
+struct mg_connection;
+struct mg_mgr;
+
+/// 客户端的一次请求
+class LocalRequest {
+public:
+    std::string method;
+    std::string host;
+    std::string path;
+    std::string query;
+    std::string body;
+    std::string range;
+};
+
+/// 正在发送的响应
+class LocalTransfer {
+public:
+    LocalRequest request;
+    // 正在录制，录制结束后才开始响应
+    bool recording = false;
+    // 响应头，以及内存中的响应内容（api 请求）
+    std::string header;
+    std::string data;
+    size_t offset = 0;
+    // 文件中的响应内容（媒体文件）
+    FILE* file         = nullptr;
+    uint64_t remaining = 0;
+    // 开始发送的时间 (ms)，用于模拟网络延迟
+    uint64_t ready = 0;
+    // 限速时当前可以发送的字节数
+    double budget     = 0;
+    uint64_t lastPump = 0;
+};
+
+/**
+ * 本地测试服务器
+ * 从磁盘中读取录制好的 api 响应与媒体文件，支持 Range 请求，可以模拟网络延迟与带宽，
+ * 用于在没有网络的情况下稳定地测试播放器的加载速度；
+ * 录制模式下，不存在的文件会先从原始地址下载并保存
+ *
+ * 文件保存在 <root>/<域名>/<路径>，除媒体与图片文件外，请求参数不同时响应也不同，
+ * 所以会在文件名后附加去除时间戳与签名后的请求参数的 md5
+ */
+class LocalServer : public brls::Singleton<LocalServer> {
+public:
+    ~LocalServer();
+
+    /// 以 root 为数据目录启动服务器
+    bool start(const std::string& root);
+
+    void stop();
+
+    /// 网络延迟 (ms)
+    static inline int LATENCY = 0;
+
+    /// 带宽 (byte/s)，为 0 时不限速
+    static inline int64_t BANDWIDTH = 0;
+
+    /// 录制模式
+    static inline bool RECORD = false;
+
+    /// 发送缓冲区的大小上限，限速时保证数据不会一次性全部写入 socket
+    static inline size_t SEND_BUFFER = 64 * 1024;
+
+private:
+    static void eventHandler(struct mg_connection* c, int ev, void* ev_data);
+
+    /// 准备响应，数据文件不存在时进入录制
+    void respond(struct mg_connection* c, LocalTransfer& transfer);
+
+    /// 从原始地址下载数据文件，结束后通过 mg_wakeup 通知服务器线程
+    void record(struct mg_connection* c, const LocalRequest& request);
+
+    /// 发送数据，返回 true 时表示响应已经发送完毕
+    bool pump(struct mg_connection* c, LocalTransfer& transfer);
+
+    void reply(struct mg_connection* c, int code, const std::string& message);
+
+    std::string getFixturePath(const LocalRequest& request) const;
+
+    std::string root;
+    struct mg_mgr* mgr = nullptr;
+    std::atomic<bool> running{false};
+    std::thread thread;
+    // key 为 mg_connection::id
+    std::unordered_map<unsigned long, LocalTransfer> transfers;
+};
+
+#endif
@@ -0,0 +1,130 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include <borealis/core/singleton.hpp>
+
+struct mg_connection;
+struct mg_mgr;
+
+/// 一个视频流的缓存，数据按 CHUNK_SIZE 分块写入 <key>.data，分块信息保存在 <key>.json
+class MediaCacheEntry {
+public:
+    int64_t size = -1;  // 文件总大小，-1 表示未知
+    std::string type;   // Content-Type
+    std::vector<bool> chunks;
+    size_t cached  = 0;  // 已缓存的分块数
+    int64_t access = 0;  // 最后访问的 unix 时间戳 (s)
+    // 正在读取的连接数，大于 0 时不会被清理
+    int users = 0;
+    // 正在下载的分块
+    std::set<size_t> fetching;
+};
+
+/// 播放器的一次请求
+class MediaCacheTransfer {
+public:
+    std::string key;
+    std::string url;
+    int64_t start = 0, end = -1, pos = 0;
+    bool partial    = false;
+    bool headerSent = false;
+    bool fetching   = false;
+    FILE* file      = nullptr;
+    std::shared_ptr<std::atomic<bool>> cancel;
+};
+
+/**
+ * 视频磁盘缓存
+ * 在本地启动一个代理服务器，播放器通过代理请求 CDN 上的视频流，
+ * 下载的数据按 <bvid>_<cid>_<清晰度> 保存在磁盘上，重复观看或向前跳转时直接从磁盘读取；
+ * 缓存总大小超过 MAX_SIZE 时，删除最久没有观看的视频
+ */
+class MediaCache : public brls::Singleton<MediaCache> {
+public:
+    ~MediaCache();
+
+    /**
+     * 获取经过缓存代理的播放链接，未开启缓存时返回原链接
+     * @param key 缓存的名称，同一视频流的主链接与备用链接使用相同的 key
+     * @param url CDN 链接
+     */
+    std::string getUrl(const std::string& key, const std::string& url);
+
+    /// 删除所有未在使用的缓存
+    void clear();
+
+    /// 已缓存的数据量 (byte)
+    int64_t getCachedSize();
+
+    /// 命中率：播放器读取的数据中不需要重新下载的比例
+    double getHitRate() const;
+
+    void stop();
+
+    /// 缓存总大小上限 (MB)，为 0 时不使用缓存
+    static inline int MAX_SIZE = 0;
+
+    /// 分块大小 (byte)
+    static inline int64_t CHUNK_SIZE = 1024 * 1024;
+
+    /// 一次请求最多下载的分块数，避免跳转后继续下载用不到的数据
+    static inline size_t FETCH_CHUNKS = 16;
+
+    /// 发送缓冲区的大小上限
+    static inline size_t SEND_BUFFER = 256 * 1024;
+
+private:
+    bool start();
+
+    void saveEntry(const std::string& key, const MediaCacheEntry& entry);
+
+    void removeEntry(const std::string& key);
+
+    /// 第一次使用时读取缓存目录中的记录
+    void load();
+
+    /// 清理缓存直到总大小低于上限，需要持有 mutex
+    void evict();
+
+    static void eventHandler(struct mg_connection* c, int ev, void* ev_data);
+
+    /// 发送已缓存的数据，遇到未缓存的分块时开始下载，返回 true 时表示请求已经完成
+    bool pump(struct mg_connection* c, MediaCacheTransfer& transfer);
+
+    /// 下载 index 开始的连续多个分块，需要持有 mutex
+    void fetch(struct mg_connection* c, MediaCacheTransfer& transfer, MediaCacheEntry& entry, size_t index);
+
+    void finish(MediaCacheTransfer& transfer);
+
+    /// 在下载线程中通知代理线程，代理已经停止时忽略
+    void wakeup(unsigned long id, const char* message);
+
+    std::string getPath(const std::string& key, const std::string& ext);
+
+    std::string dir;
+    bool loaded        = false;
+    int port           = 0;
+    struct mg_mgr* mgr = nullptr;
+    std::atomic<bool> running{false};
+    std::thread thread;
+    // 保护 mgr，保证 stop 释放 mgr 时没有下载线程正在调用 mg_wakeup
+    std::mutex wakeupMutex;
+    std::mutex mutex;
+    // 正在进行的下载数量，需要持有 mutex；stop 等待所有下载结束后再返回
+    size_t fetchCount = 0;
+    std::condition_variable fetchDone;
+    std::unordered_map<std::string, MediaCacheEntry> entries;
+    // key 为 mg_connection::id，只在代理线程中访问
+    std::unordered_map<unsigned long, MediaCacheTransfer> transfers;
+    // 播放器读取的数据量与从网络下载的数据量
+    std::atomic<uint64_t> servedBytes{0}, downloadedBytes{0};
+};
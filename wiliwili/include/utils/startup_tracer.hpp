@@ -0,0 +1,72 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include <borealis/core/singleton.hpp>
+
+/**
+ * 启动耗时统计
+ * 记录启动过程中各阶段的起止时间，第一帧绘制完成时输出冷启动耗时；
+ * 开启 ENABLE 后，稍等片刻（让后台的首页请求等阶段结束）把结果以 Chrome trace 格式写入配置目录，
+ * 可以直接拖入 chrome://tracing 或 Perfetto 中查看。可以在任意线程中记录
+ */
+class StartupTracer : public brls::Singleton<StartupTracer> {
+public:
+    /// 在作用域结束时记录一个阶段
+    class Scope {
+    public:
+        explicit Scope(std::string name);
+
+        ~Scope();
+
+    private:
+        std::string name;
+        int64_t start;
+    };
+
+    /// 需要在 main 的开头调用一次 instance()，以此作为启动时间并把当前线程记为主线程
+    StartupTracer();
+
+    /// 从启动到现在的时间 (us)
+    int64_t now() const;
+
+    /// 记录一个阶段，时间由 now() 获取
+    void add(const std::string& name, int64_t start, int64_t end);
+
+    /**
+     * 在主循环中每帧调用
+     * @return 第一次调用时返回 true，此时冷启动耗时已经确定
+     */
+    bool markFirstFrame();
+
+    /// 冷启动到第一帧绘制完成的时间 (ms)，还未完成时返回 -1
+    int64_t getColdStartTime() const;
+
+    /// 写入 trace 文件（启动参数 -p）
+    static inline bool ENABLE = false;
+
+    /// 第一帧之后等待多久写入 trace 文件 (ms)
+    static inline int TRACE_DELAY = 5000;
+
+private:
+    class Event {
+    public:
+        std::string name;
+        int64_t start = 0, duration = 0;
+        size_t thread = 0;
+    };
+
+    void save();
+
+    std::chrono::steady_clock::time_point startTime = std::chrono::steady_clock::now();
+    std::mutex eventsMutex;
+    std::vector<Event> events;
+    // 把线程 id 映射为从 1 开始的序号，主线程为 1
+    std::unordered_map<std::thread::id, size_t> threads;
+    int64_t coldStartTime = -1;
+};
@@ -0,0 +1,92 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <borealis/core/event.hpp>
+#include <borealis/core/singleton.hpp>
+
+/// 一个图标在图集中的位置 (px)
+class SVGAtlasEntry {
+public:
+    int x = 0, y = 0, width = 0, height = 0;
+};
+
+/// 图集的像素数据，在后台线程中生成或从磁盘读取
+class SVGAtlasData {
+public:
+    int width = 0, height = 0;
+    std::vector<uint8_t> pixels;  // RGBA
+    std::unordered_map<std::string, SVGAtlasEntry> entries;
+};
+
+/**
+ * SVG 图标图集
+ * 记录应用内用到的 SVG 资源及其尺寸，按当前的 windowScale 把它们栅格化到同一张纹理中，
+ * 结果按缩放比例与资源内容的哈希缓存在磁盘上，之后启动时直接读取，不再逐个解析与渲染；
+ * 窗口缩放后在后台重新生成，完成前继续使用旧的图集；
+ * 第一次出现的图标由 SVGImage 自行渲染，并在下一次生成图集时加入。此类需要工作在主线程
+ */
+class SVGAtlas : public brls::Singleton<SVGAtlas> {
+public:
+    /// 在窗口创建后调用，读取图标清单，加载磁盘缓存或在后台生成图集
+    void start();
+
+    /**
+     * 查询图标，不在图集中时记录下来
+     * @param name 资源路径，如 svg/ico-home.svg
+     * @param width 逻辑尺寸
+     * @return 图集纹理，图标不在图集中时返回 0
+     */
+    int get(const std::string& name, float width, float height, SVGAtlasEntry& entry);
+
+    int getWidth() const;
+
+    int getHeight() const;
+
+    /// 图集被替换时触发，之前获取的纹理与位置都已失效
+    brls::VoidEvent* getUpdateEvent();
+
+    /// 图集的最大边长 (px)，放不下的图标仍由 SVGImage 自行渲染
+    static inline int MAX_SIZE = 2048;
+
+private:
+    class Icon {
+    public:
+        std::string name;
+        int width = 0, height = 0;
+    };
+
+    static std::string getKey(const std::string& name, int width, int height);
+
+    /**
+     * 读取图标的 SVG 资源并计算磁盘缓存的路径，除启动时读取缓存外都在后台线程中调用
+     * @return 缓存文件路径，没有可用的图标时返回空字符串
+     */
+    static std::string readSources(const std::vector<Icon>& icons, float value, const std::string& dir,
+                                   std::vector<std::pair<std::string, std::string>>& sources,
+                                   std::vector<std::pair<int, int>>& sizes);
+
+    void saveManifest();
+
+    /// 生成 windowScale 下的图集，loadCache 为 true 时先尝试同步读取磁盘缓存
+    void build(bool loadCache);
+
+    void apply(float value, const SVGAtlasData& data);
+
+    bool started = false;
+    std::string dir;
+    std::vector<Icon> icons;
+    std::set<std::string> iconKeys;
+    bool manifestDirty = false;
+
+    int texture = 0;
+    float scale = 0;
+    SVGAtlasData atlas;  // 只保留位置信息，像素数据上传后释放
+    // 发起新的生成任务时递增，用来丢弃过时的结果
+    size_t buildToken = 0;
+    brls::VoidEvent updateEvent;
+};
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <borealis/core/singleton.hpp>
+
+namespace brls {
+class View;
+};
+
+namespace tinyxml2 {
+class XMLDocument;
+class XMLElement;
+};  // namespace tinyxml2
+
+/**
+ * XML 模板缓存
+ * 列表项等需要大量创建的组件每次创建时都会重新读取并解析 XML 文件，
+ * 这里按路径缓存解析后的文档，之后的创建直接从缓存的节点树构建组件；
+ * 缓存的文档在程序退出前不会释放，此类需要工作在主线程
+ */
+class TemplateHelper : public brls::Singleton<TemplateHelper> {
+public:
+    ~TemplateHelper();
+
+    /// 使用缓存的 XML 模板填充 view，用来代替 view->inflateFromXMLRes(res)
+    static void inflate(brls::View* view, const std::string& res);
+
+    /// 获取 XML 模板的根节点，读取或解析失败时返回 nullptr
+    tinyxml2::XMLElement* get(const std::string& res);
+
+private:
+    std::unordered_map<std::string, std::unique_ptr<tinyxml2::XMLDocument>> documents;
+};
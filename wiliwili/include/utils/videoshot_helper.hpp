@@ -0,0 +1,69 @@
+#pragma once
+
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+#include <borealis/core/singleton.hpp>
+
+/// 一个视频的进度条预览图
+class VideoShotData {
+public:
+    uint64_t cid = 0;
+    bool ready   = false;  // 索引已获取
+    bool evicted = false;  // 已被移出缓存，之后加载完成的图片直接丢弃
+    int xLen = 0, yLen = 0;
+    // 每张小图的尺寸 (px)，接口没有返回时为 0
+    int xSize = 0, ySize = 0;
+    std::vector<std::string> images;
+    std::vector<unsigned int> index;  // 每张小图对应的时间 (s)，升序
+    // 每张大图的纹理，0: 未加载，-1: 加载中或加载失败
+    std::vector<int> textures;
+    std::vector<std::pair<int, int>> sizes;  // 每张大图解码后的尺寸
+};
+
+/// 预览图在纹理中的位置
+class VideoShotFrame {
+public:
+    int texture = 0;
+    float x = 0, y = 0, width = 0, height = 0;
+    float imageWidth = 0, imageHeight = 0;
+};
+
+/**
+ * 进度条预览图
+ * B站将视频截图拼接为多张大图，每张大图包含 xLen * yLen 张小图；
+ * 第一次拖动进度条时请求索引，需要显示某张大图时才下载并在后台线程解码，
+ * 按 cid 缓存最近 MAX_VIDEOS 个视频的纹理
+ */
+class VideoShotHelper : public brls::Singleton<VideoShotHelper> {
+public:
+    /// 设置正在播放的视频，只记录 id
+    void setVideo(const std::string& bvid, uint64_t cid);
+
+    /**
+     * 获取 time (s) 处的预览图，此函数需要工作在主线程
+     * @return 数据未就绪时开始请求，并返回 false
+     */
+    bool getFrame(float time, VideoShotFrame& frame);
+
+    /// 释放所有纹理，此函数需要工作在主线程
+    void clear();
+
+    /// 缓存的视频数量
+    static inline size_t MAX_VIDEOS = 2;
+
+private:
+    void requestIndex(const std::shared_ptr<VideoShotData>& data);
+
+    void requestImage(const std::shared_ptr<VideoShotData>& data, size_t sheet);
+
+    void release(VideoShotData& data);
+
+    std::string bvid;
+    uint64_t cid = 0;
+    // 最近使用的视频在前
+    std::list<std::shared_ptr<VideoShotData>> cache;
+};
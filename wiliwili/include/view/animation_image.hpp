@@ -10,6 +10,7 @@
 #pragma once
 
 #include <borealis/core/box.hpp>
+#include <borealis/core/time.hpp>
 
 class AnimationImage : public brls::Box {
 public:
@@ -33,10 +34,10 @@ public:
 protected:
     size_t frame             = 1;
     size_t current_frame     = 0;
-    size_t last_refresh_time = 0;
-    size_t last_x            = 0;
-    size_t texture           = 0;
-    size_t frame_time        = 41666;  // 1/24 s
+    brls::Time last_refresh_time = 0;
+    size_t last_x                = 0;
+    size_t texture               = 0;
+    size_t frame_time            = 41666;  // 1/24 s
     NVGpaint paint;
 
     void refreshImage();
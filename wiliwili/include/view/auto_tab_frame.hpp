@@ -20,6 +20,8 @@
 #pragma once
 
 #include <functional>
+#include <list>
+#include <memory>
 #include <borealis/core/box.hpp>
 #include <borealis/core/bind.hpp>
 #include <borealis/core/application.hpp>
@@ -37,6 +39,7 @@ enum class AutoTabBarStyle { ACCENT, PLAIN, INLINE, NONE };
 
 class AutoSidebarItemGroup;
 class AttachedView;
+class AttachedViewState;
 class SVGImage;
 class ButtonRefresh;
 
@@ -73,6 +76,9 @@ public:
 
     void setAttachedViewCreator(TabViewCreator creator);
 
+    /// 释放标签页的内容，保存的状态会在下次创建时恢复
+    void releaseAttachedView();
+
     ~AutoSidebarItem() override;
 
     brls::GenericEvent* getActiveEvent();
@@ -107,7 +113,10 @@ private:
     bool active                        = false;
     View* attachedView                 = nullptr;
     TabViewCreator attachedViewCreator = nullptr;
+    std::shared_ptr<AttachedViewState> savedState;
     std::string iconDefault, iconActivate;
+
+    void deleteAttachedView();
 };
 
 class AutoSidebarItemGroup {
@@ -122,6 +131,12 @@ private:
     std::vector<AutoSidebarItem*> items;
 };
 
+/// 标签页被释放时保存的状态，重新创建标签页后用来恢复
+class AttachedViewState {
+public:
+    virtual ~AttachedViewState() = default;
+};
+
 class AttachedView : public brls::Box {
 public:
     AttachedView();
@@ -137,13 +152,27 @@ public:
 
     virtual void onHide();
 
+    /// 不可见时是否可以被释放，存在未完成的请求时应返回 false
+    virtual bool isReleasable();
+
+    /// 被释放前调用，返回的状态会在重新创建后交给 onRestoreState
+    virtual std::shared_ptr<AttachedViewState> onSaveState();
+
+    /// 重新创建后、onCreate 之前调用
+    virtual void onRestoreState(const std::shared_ptr<AttachedViewState>& state);
+
     View* getDefaultFocus() override { return brls::Box::getDefaultFocus(); }
 
     void registerTabAction(std::string hintText, enum brls::ControllerButton button, brls::ActionListener action,
                            bool hidden = false, bool allowRepeating = false, enum brls::Sound sound = brls::SOUND_NONE);
 
+    /// 移除通过 registerTabAction 注册在标签上的按键
+    void unregisterTabActions();
+
 private:
     AutoSidebarItem* tab = nullptr;
+    // 注册在标签上的按键，销毁时需要一并移除
+    std::vector<brls::ActionIdentifier> tabActions;
 };
 
 class AutoTabFrame : public brls::Box {
@@ -185,6 +214,12 @@ public:
 
     void setDemandMode(bool value);
 
+    /// 最多保留的标签页数量，超出时释放最久没有使用的标签页，为 0 时不释放
+    void setMaxAliveTabs(size_t value);
+
+    /// 切换标签页后，在空闲时预先创建下一个标签页
+    void setPreloadNextTab(bool value);
+
     void addItem(AutoSidebarItem* tab, TabViewCreator creator, brls::GenericEvent::Callback focusCallback);
 
     AutoSidebarItem* getItem(int position);
@@ -227,6 +262,9 @@ public:
 
     void setTabChangedAction(const std::function<void(size_t)>& event);
 
+    /// 切换标签页后等待多久 (ms) 预先创建下一个标签页
+    static inline long PRELOAD_DELAY = 1500;
+
 private:
     BRLS_BIND(Box, sidebar, "auto_tab_frame/auto_sidebar");
 
@@ -247,6 +285,19 @@ private:
 
     std::function<void(size_t)> tabChangedAction = nullptr;
 
+    size_t maxAliveTabs = 0;
+    bool preloadNextTab = false;
+    // 最近使用的标签在前
+    std::list<AutoSidebarItem*> recentTabs;
+    // 切换或移除标签时递增，用来取消之前提交的预加载与释放
+    std::shared_ptr<size_t> tabToken = std::make_shared<size_t>(0);
+
+    /// 记录标签的使用顺序，之后释放多余的标签页并预加载下一个标签页
+    void onTabUsed(AutoSidebarItem* item);
+
+    /// 释放 maxAliveTabs 之外可以被释放的标签页
+    void releaseTabs();
+
     NVGcolor skeletonBackground           = brls::Application::getTheme()["color/grey_3"];
     NVGcolor tabItemBackgroundColor       = nvgRGBA(0, 0, 0, 0);
     NVGcolor tabItemActiveBackgroundColor = nvgRGBA(0, 0, 0, 0);
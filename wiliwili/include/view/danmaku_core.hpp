@@ -6,6 +6,7 @@
 
 #include <mutex>
 #include <optional>
+#include <string>
 
 #include <nanovg.h>
 #include <borealis/core/singleton.hpp>
@@ -66,6 +67,7 @@ enum class DanmakuImageType {
     DANMAKU_IMAGE_NONE = 0,  // 无图片
     DANMAKU_IMAGE_OHH,
     DANMAKU_IMAGE_HIGHLIGHT,
+    DANMAKU_IMAGE_LIVE_EMOTICON,  // 回放的直播表情弹幕，msg 为表情名称
 };
 
 class AdvancedAnimation {
@@ -105,10 +107,10 @@ public:
     float length         = 0;
     int line             = 0;  // 弹幕在屏幕上的行数
     float speed          = 0;
-    int64_t startTime    = 0;
     NVGcolor color       = nvgRGBA(255, 255, 255, 160);
     NVGcolor borderColor = nvgRGBA(0, 0, 0, 160);
     int level;  // 弹幕等级 1-10
+    int count = 1;  // 合并后的重复弹幕数量
     std::optional<AdvancedAnimation> advancedAnimation;
     DanmakuImageType image{};  // 弹幕图片类型
     // 暂时用不到的信息，先不使用
@@ -140,12 +142,6 @@ public:
      */
     void refresh();
 
-    /**
-     * 设置当前视频倍速，弹幕会根据倍速变动
-     * @param speed
-     */
-    void setSpeed(double speed);
-
     /**
      * 将当前弹幕配置写入配置文件
      */
@@ -168,6 +164,12 @@ public:
      */
     void loadDanmakuData(const std::vector<DanmakuItem> &data);
 
+    /**
+     * 追加弹幕数据，不重置正在显示的弹幕
+     * @param data 弹幕列表，需要晚于已加载的全部弹幕
+     */
+    void appendDanmakuData(std::vector<DanmakuItem> data);
+
     /**
      * 实时添加一条弹幕
      * @param item 单条弹幕
@@ -180,6 +182,24 @@ public:
      */
     std::vector<DanmakuItem> getDanmakuData();
 
+    /**
+     * 合并重复弹幕
+     * 在同一时间窗口内，文本归一化后相同的同类弹幕会被合并为一条，显示为 "内容 ×N" 并适当放大字号
+     * @param data 已按时间排序的弹幕列表
+     */
+    static void mergeDanmakuData(std::vector<DanmakuItem> &data);
+
+    /**
+     * 弹幕文本归一化：去除空白、英文转小写、合并连续重复的字符
+     * "哈哈哈哈 " 与 "哈哈哈" 会得到相同的结果
+     */
+    static std::string normalizeDanmakuText(const std::string &text);
+
+    /**
+     * 根据重复次数计算合并后弹幕的字号缩放比例
+     */
+    static float getMergedFontScale(int count);
+
     /**
      * 加载遮罩数据
      * @param data 遮罩数据
@@ -195,6 +215,10 @@ public:
     static inline bool DANMAKU_FILTER_SHOW_COLOR    = true;
     static inline bool DANMAKU_FILTER_SHOW_ADVANCED = false;
     static inline bool DANMAKU_SMART_MASK           = true;
+    static inline bool DANMAKU_FILTER_MERGE         = true;
+
+    /// 合并重复弹幕的时间窗口 (秒)
+    static inline float DANMAKU_MERGE_WINDOW = 10.0f;
 
     /// [25, 50, 75, 100]
     static inline int DANMAKU_STYLE_AREA = 100;
@@ -255,9 +279,6 @@ private:
     // 弹幕显示的最大行数
     size_t lineNum;
 
-    // 当前视频播放速度
-    double videoSpeed;
-
     // 行高
     float lineHeight;
 
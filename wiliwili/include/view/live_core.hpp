@@ -5,12 +5,18 @@
 #pragma once
 
 #include "api/live/extract_messages.hpp"
+#include "api/live/dl_emoticon.hpp"
+#include "view/live_record.hpp"
 
+#include <atomic>
 #include <chrono>
 #include <cstddef>
 #include <deque>
 #include <map>
+#include <memory>
 #include <mutex>
+#include <string>
+#include <unordered_map>
 
 #include <nanovg.h>
 #include <borealis/core/singleton.hpp>
@@ -31,6 +37,9 @@ public:
     size_t line  = 0;
     float length = 0;
     float speed  = 0;
+    float scale  = 1.0f;
+    // 合并的重复弹幕数量，弹幕的拷贝之间共享同一个计数
+    std::shared_ptr<std::atomic<int>> count;
 };
 
 class LiveDanmakuCore : public brls::Singleton<LiveDanmakuCore> {
@@ -38,6 +47,15 @@ public:
     //0-60
     static inline int DANMAKU_FILTER_LEVEL_LIVE = 0;
 
+    /// 录制直播弹幕，暂停或回看时按播放进度重新显示录制的弹幕
+    static inline bool DANMAKU_RECORD = false;
+
+    /// 播放进度落后直播超过此时间时，切换为回放录制的弹幕 (ms)
+    static inline int64_t REPLAY_THRESHOLD = 3000;
+
+    /// 每次加载到 DanmakuCore 中的录制弹幕时长 (ms)
+    static inline int64_t REPLAY_WINDOW = 60000;
+
     std::vector<std::pair<time_p, time_p>> scroll_lines;
     std::vector<int> center_lines;
 
@@ -48,9 +66,65 @@ public:
 
     std::map<int, std::deque<LiveDanmakuItem>> now;
 
+    // 重复弹幕合并窗口 <归一化文本, <首次出现的时间, 弹幕计数>>
+    // 弹幕被丢弃或显示结束后计数随之释放，之后出现的相同弹幕会重新开始计数
+    std::unordered_map<std::string, std::pair<time_p, std::weak_ptr<std::atomic<int>>>> merge_window;
+
+    // 直播间表情图集，只在主线程中访问
+    std::shared_ptr<LiveEmoticonAtlas> emoticon_atlas;
+    int emoticon_texture = 0;
+
+    LiveDanmakuRecorder recorder;
+    // 开始播放直播时，录制时间与播放进度的差值 (ms)
+    int64_t live_offset    = 0;
+    bool live_offset_valid = false;
+    // 已加载到 DanmakuCore 中的录制时间范围，只在主线程中访问
+    int64_t replay_start = 0;
+    int64_t replay_end   = 0;
+    // 正在后台读取录制的弹幕
+    bool replay_loading = false;
+    // 停止回放时递增，用来丢弃过时的读取结果
+    size_t replay_token = 0;
+    // 是否正在回放录制的弹幕，此时收到的直播弹幕只录制不显示
+    std::atomic<bool> replaying{false};
+
     void reset();
+
+    /// 开始录制直播弹幕
+    void startRecord(int room_id);
+
+    /// 停止录制，export_path 不为空时将录制的弹幕导出为 xml 文件
+    void stopRecord(const std::string &export_path = "");
+
+    /// 在直播流开始播放时调用，记录播放进度与直播画面的对应关系
+    void syncLiveEdge();
+
+    /// 根据播放进度与直播画面的差距，在直播弹幕与回放录制弹幕之间切换
+    void updateReplay();
+
+    /**
+     * 在后台读取录制时间在 [start, end) 范围内的弹幕，完成后在主线程加载到 DanmakuCore
+     * @param append 为 true 时追加在已加载的弹幕之后，不影响正在屏幕上显示的弹幕；否则替换全部弹幕
+     */
+    void loadReplay(int64_t start, int64_t end, bool append);
+
+    /// 设置表情图集，纹理在下一次绘制时创建。需要在主线程中调用
+    void setEmoticonAtlas(const std::shared_ptr<LiveEmoticonAtlas> &atlas);
+
+    /// 获取表情在图集中的位置，不是表情弹幕或图集中没有对应表情时返回 nullptr
+    const LiveEmoticonRect *getEmoticon(const LiveDanmakuItem &i) const;
+    const LiveEmoticonRect *getEmoticon(const std::string &name) const;
+
+    /// 图集在第一次绘制时上传为纹理
+    void uploadEmoticonAtlas(NVGcontext *vg);
+
+    /// 绘制图集中的表情，宽度按 height 等比缩放。纹理未创建时返回 false
+    bool drawEmoticon(NVGcontext *vg, const LiveEmoticonRect &emoticon, float x, float y, float height, float alpha);
     void add(const std::vector<LiveDanmakuItem> &dan_l);
     void draw(NVGcontext *vg, float x, float y, float width, float height, float alpha);
 
+    /// 尝试将弹幕合并到窗口内已有的相同弹幕上，需要在持有 next_mutex 时调用
+    bool merge_danmaku(const LiveDanmakuItem &i, time_p now);
+
     bool init_danmaku(NVGcontext *vg, LiveDanmakuItem &i, float width, int LINES, float SECOND, time_p now, int time);
 };
\ No newline at end of file
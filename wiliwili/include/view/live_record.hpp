@@ -0,0 +1,100 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "api/live/extract_messages.hpp"
+
+/// 录制的直播弹幕，文件中每条记录由此结构体和 length 字节的弹幕内容组成
+class LiveDanmakuRecordHeader {
+public:
+    // 收到弹幕的时间，从开始录制时算起 (ms)
+    uint32_t time;
+    uint32_t color;
+    uint16_t length;
+    uint8_t type;
+    uint8_t size;
+    uint8_t level;
+    uint8_t flags;  // LIVE_RECORD_FLAG_*
+    uint8_t reserved[2];
+};
+
+/// 表情弹幕，length 字节的内容为表情名称
+constexpr uint8_t LIVE_RECORD_FLAG_EMOTICON = 1;
+
+static_assert(sizeof(LiveDanmakuRecordHeader) == 16, "LiveDanmakuRecordHeader should be 16 bytes");
+
+typedef std::function<void(const LiveDanmakuRecordHeader &header, const std::string &text)> on_record_func_t;
+
+/// 录制文件的一个分段，只追加写入
+class LiveDanmakuRecordSegment {
+public:
+    std::string path;
+    FILE *file     = nullptr;
+    uint64_t size  = 0;
+    uint32_t start = 0;
+    uint32_t end   = 0;
+    size_t count   = 0;
+    // 稀疏的时间索引 <时间, 文件偏移>，用于快速定位到某一时间点
+    std::vector<std::pair<uint32_t, uint64_t>> index;
+
+    void close(bool remove);
+};
+
+/**
+ * 直播弹幕录制
+ * 弹幕按收到的时间顺序追加写入磁盘，内存中只保留稀疏的时间索引；
+ * 录制文件由两个分段轮换组成，当前分段写满后删除较早的分段，磁盘占用不会超过 SEGMENT_SIZE 的两倍
+ */
+class LiveDanmakuRecorder {
+public:
+    ~LiveDanmakuRecorder();
+
+    bool open(int room_id);
+
+    /// 关闭录制并删除录制文件
+    void close();
+
+    /**
+     * 关闭录制，并在后台线程中将录制的全部弹幕导出为 B 站的 xml 弹幕格式，完成后删除录制文件
+     * 录制文件会先重命名，导出过程中可以立即开始新的录制
+     */
+    void closeAndExport(const std::string &path);
+
+    bool isOpen();
+
+    /// 当前录制的时间 (ms)
+    uint32_t now() const;
+
+    void append(const danmaku_t *dan, uint32_t time);
+
+    /// 按时间顺序读取 [start, end) 范围内的弹幕
+    void read(uint32_t start, uint32_t end, const on_record_func_t &func);
+
+    /// 单个分段的大小 (byte)
+    static inline uint64_t SEGMENT_SIZE = 4 * 1024 * 1024;
+
+    /// 时间索引的间隔 (ms)
+    static inline uint32_t INDEX_INTERVAL = 1000;
+
+private:
+    std::mutex mutex;
+    LiveDanmakuRecordSegment segments[2];
+    size_t current = 0;
+    int room_id    = 0;
+    std::chrono::steady_clock::time_point start_time;
+    // 开始录制时的 unix 时间戳 (s)
+    int64_t start_timestamp = 0;
+
+    bool openSegment(size_t index);
+    void readSegment(LiveDanmakuRecordSegment &segment, uint32_t start, uint32_t end, const on_record_func_t &func);
+
+    /// 按顺序读取已经关闭的录制文件，导出为 xml
+    static bool exportXML(const std::vector<std::string> &files, const std::string &path, int room_id,
+                          int64_t start_timestamp);
+};
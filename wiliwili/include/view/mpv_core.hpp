@@ -4,6 +4,7 @@
 
 #pragma once
 
+#include <atomic>
 #include <unordered_map>
 #include <vector>
 #include <string>
@@ -147,6 +148,20 @@ public:
 
     double getPlaybackTime() const;
 
+    /**
+     * 获取平滑的播放进度 (秒)，弹幕、字幕、进度条等界面元素统一使用此时间
+     * playback_time 只在视频帧更新时变化，直接用于绘制会出现卡顿；
+     * 此时间在两次 playback_time 更新之间根据现实时间与播放速度插值，与 mpv 的进度有偏差时平滑修正，
+     * 只在 mpv 跳转 (seek) 时直接跳变；暂停或缓冲时停在当前的播放位置，不会归零。可以在任意线程中无锁读取
+     */
+    double getMediaTime() const;
+
+    /// 平滑播放进度与 mpv 进度的偏差超过此值时直接跳转 (秒)
+    inline static double MEDIA_CLOCK_JUMP = 0.5;
+
+    /// 平滑修正偏差所用的时间 (秒)
+    inline static double MEDIA_CLOCK_CORRECTION = 0.5;
+
     std::string getCacheSpeed() const;
 
     int64_t getVolume() const;
@@ -318,6 +333,7 @@ public:
     // core states
     int64_t duration       = 0;  // second
     int64_t cache_speed    = 0;  // Bps
+    double cache_duration  = 0;  // 已缓存的时长 (s)
     int64_t volume         = 100;
     double video_speed     = 0;
     bool video_paused      = false;
@@ -342,6 +358,12 @@ public:
     double video_hue        = 0;
     double video_gamma      = 0;
 
+#ifdef MPV_SW_RENDER
+    // 软件绘制的统计信息：mpv 绘制的帧数与实际上传到纹理的帧数
+    size_t sw_frames_rendered = 0;
+    size_t sw_frames_uploaded = 0;
+#endif
+
     // 低画质解码，剔除解码过程中的部分步骤，可以用来节省cpu
     inline static bool LOW_QUALITY = false;
 
@@ -390,22 +412,49 @@ public:
     inline static double VIDEO_GAMMA      = 0;
 
 private:
+    // 平滑播放进度的锚点: 现实时间为 wall (us) 时播放进度为 media (s)，之后按 rate 倍速增长
+    struct MediaClockAnchor {
+        double media;
+        int64_t wall;
+        double rate;
+    };
+    // 写入时交替使用两个锚点，读取时不需要加锁
+    MediaClockAnchor media_clock[2]{};
+    std::atomic<int> media_clock_index{0};
+    bool media_clock_valid = false;
+
+    void setMediaClock(double media, double rate);
+
+    /// 根据 mpv 的播放进度更新平滑播放进度
+    void updateMediaClock(double time);
+
+    /// 播放状态或倍速变化后，以当前的平滑进度为起点重新计时
+    void restartMediaClock();
+
     mpv_handle *mpv                 = nullptr;
     mpv_render_context *mpv_context = nullptr;
     brls::Rect rect                 = {0, 0, 1920, 1080};
 #ifdef MPV_SW_RENDER
     const int PIXCEL_SIZE          = 4;
     int nvg_image                  = 0;
+    int nvg_image_size[2]          = {0, 0};
     const char *sw_format          = "rgba";
     int sw_size[2]                 = {1920, 1080};
     size_t pitch                   = PIXCEL_SIZE * sw_size[0];
     void *pixels                   = nullptr;
+    // 缓冲区可容纳的像素数量，视频区域缩小时复用已有的内存
+    size_t sw_capacity             = 0;
+    // 缓冲区中有尚未上传到纹理的新画面
+    bool sw_dirty                  = false;
     bool redraw                    = false;
     mpv_render_param mpv_params[5] = {
         {MPV_RENDER_PARAM_SW_SIZE, &sw_size[0]}, {MPV_RENDER_PARAM_SW_FORMAT, (void *)sw_format},
-        {MPV_RENDER_PARAM_SW_STRIDE, &pitch},    {MPV_RENDER_PARAM_SW_POINTER, pixels},
+        {MPV_RENDER_PARAM_SW_STRIDE, &pitch},    {MPV_RENDER_PARAM_SW_POINTER, nullptr},
         {MPV_RENDER_PARAM_INVALID, nullptr},
     };
+
+    /// 将视频绘制到缓冲区，在下一次绘制界面时上传为纹理
+    void renderSoftware();
 #elif defined(BOREALIS_USE_DEKO3D)
     DkFence doneFence;
     DkFence readyFence;
@@ -9,7 +9,11 @@
 
 #pragma once
 
+#include <deque>
 #include <map>
+#include <memory>
+#include <set>
+#include <vector>
 #include <borealis/core/application.hpp>
 #include <borealis/core/bind.hpp>
 #include <borealis/views/scrolling_frame.hpp>
@@ -20,6 +24,7 @@ class Image;
 }  // namespace brls
 class RecyclingGrid;
 class ButtonRefresh;
+class SkeletonCell;
 
 class RecyclingGridItem : public brls::Box {
 public:
@@ -55,6 +60,18 @@ private:
     size_t index;
 };
 
+/// 在后台线程中预先计算的列表项布局，具体内容由数据源定义
+class RecyclingGridLayout {
+public:
+    virtual ~RecyclingGridLayout() = default;
+
+    /// 列表项的高度，-1 表示未知
+    float height = -1;
+};
+
+/// 在后台线程中执行的布局任务，参数为列表项可用的宽度
+typedef std::function<std::shared_ptr<RecyclingGridLayout>(float width)> RecyclingGridLayoutTask;
+
 class RecyclingGridDataSource {
 public:
     virtual ~RecyclingGridDataSource() = default;
@@ -80,6 +97,16 @@ public:
         return -1;
     }
 
+    /*
+     * 瀑布流模式下，返回在后台线程中计算 index 项布局的任务，此函数工作在主线程
+     * 计算结果在 cellForRow 中通过 recycler->takeCellLayout(index) 取出
+     * Return nullptr to measure the cell on the main thread when it is added.
+     */
+    virtual RecyclingGridLayoutTask layoutForRow(RecyclingGrid* recycler,
+                                                 size_t index) {
+        return nullptr;
+    }
+
     /*
      * Tells the data source a row is selected.
      */
@@ -89,6 +116,45 @@ public:
 };
 
 class RecyclingGridContentBox;
+class RecyclingGridWarmer;
+
+/**
+ * 瀑布流模式下列表项高度的前缀和（树状数组）
+ * 高度未知 (-1) 的项单独计数，查询时按传入的默认高度计算，因此默认高度变化时不需要重建
+ * 后台布局得到的高度标记为估计值，参与偏移量的计算，但在列表项添加到屏幕上时仍需重新测量
+ */
+class CellHeightIndex {
+public:
+    void clear();
+
+    void push_back(float height);
+
+    /// 修改一项的高度，O(log n)
+    void set(size_t index, float height, bool estimate = false);
+
+    bool isEstimated(size_t index) const { return estimated[index]; }
+
+    float operator[](size_t index) const { return heights[index]; }
+
+    size_t size() const { return heights.size(); }
+
+    /// [0, index) 范围内所有项的高度之和，每一项额外加上 space，O(log n)
+    double getOffset(size_t index, float unknownHeight, float space) const;
+
+    /// [0, index) 范围内高度未知或为估计值的项数
+    size_t getUnknownCount(size_t index) const;
+
+    /// 二分查找 offset 所在的项，即满足 getOffset(i) <= offset 的最大 i，O(log n)
+    size_t findIndex(double offset, float unknownHeight, float space) const;
+
+private:
+    std::vector<float> heights;
+    std::vector<bool> estimated;
+    // 下标从 1 开始
+    std::vector<double> knownTree;
+    std::vector<size_t> unknownTree;
+    std::vector<size_t> estimatedTree;
+};
 
 class RecyclingGrid : public brls::ScrollingFrame {
 public:
@@ -136,6 +202,12 @@ public:
     //    计算从start元素的顶点到index（不包含index）元素顶点的距离
     float getHeightByCellIndex(size_t index, size_t start = 0);
 
+    /// 计算距列表顶部 height 处所在行的首项索引
+    size_t getCellIndexByHeight(float height);
+
+    /// 取出 index 项在后台线程中计算好的布局，每项只能取出一次，没有时返回 nullptr
+    std::shared_ptr<RecyclingGridLayout> takeCellLayout(size_t index);
+
     View* getNextCellFocus(brls::FocusDirection direction, View* currentView);
 
     void forceRequestNextPage();
@@ -190,6 +262,21 @@ public:
     /// 瀑布流模式，每一项高度不固定（仅在spanCount为1时可用）
     bool isFlowMode = false;
 
+    /// 瀑布流模式下，在后台线程中提前布局屏幕下方的项数
+    int preLayoutLine = 8;
+
+    /// 浏览到已加载行数的这个比例时预加载下一页，滑动较快时会根据请求耗时更早加载；大于等于 1 时只在到达底部时加载
+    float nextPageRatio = 0.7f;
+
+    /// 下一页请求的超时时间 (ms)，超时后允许再次请求
+    static inline brls::Time PAGE_TIMEOUT = 10000;
+
+    /// 启动后在空闲的帧中为每种列表项预先创建的行数，为 0 时不预先创建
+    static inline size_t WARM_ROWS = 2;
+
+    /// 每帧预先创建列表项的时间预算 (ms)
+    static inline float WARM_BUDGET = 4;
+
 private:
     RecyclingGridDataSource* dataSource = nullptr;
     bool layouted                       = false;
@@ -213,15 +300,36 @@ private:
     std::function<void()> nextPageCallback = nullptr;
     std::function<void()> refreshAction    = nullptr;
 
+    // 下一页请求发出的时间，0 表示没有正在进行的请求
+    brls::Time pageRequestTime = 0;
+    // 下一页请求的平均耗时 (ms)
+    float pageLatency = 500;
+    // 预加载超时（通常是没有更多数据）后暂停预加载，直到数据再次变化
+    bool preFetchPageEnabled = true;
+    // 向下滑动的平均速度 (行/秒)
+    float scrollSpeed         = 0;
+    float lastScrollY         = 0;
+    brls::Time lastScrollTime = 0;
+
     RecyclingGridContentBox* contentBox = nullptr;
+    SkeletonCell* footerSkeleton        = nullptr;
     brls::Image* hintImage;
     brls::Label* hintLabel;
     ButtonRefresh* refreshButton;
     brls::Rect renderedFrame;
-    std::vector<float> cellHeightCache;
+    // 屏幕上的列表项，按索引排序，首项的索引为 visibleMin，末项的索引为 visibleMax
+    std::deque<RecyclingGridItem*> visibleCells;
+    CellHeightIndex cellHeightCache;
     std::map<std::string, std::vector<RecyclingGridItem*>*> queueMap;
     std::map<std::string, std::function<RecyclingGridItem*(void)>>
         allocationMap;
+    // 每种列表项已经创建的数量，包括预先创建的
+    std::map<std::string, size_t> cellCount;
+    // 后台布局完成、还未添加到屏幕上的列表项
+    std::map<size_t, std::shared_ptr<RecyclingGridLayout>> cellLayoutCache;
+    std::set<size_t> cellLayoutRequested;
+    // 重新加载数据或销毁列表时递增，用来丢弃之前的布局结果
+    std::shared_ptr<size_t> layoutToken = std::make_shared<size_t>(0);
 
     //检查宽度是否有变化
     bool checkWidth();
@@ -239,6 +347,33 @@ private:
      * @param downSide 是向下添加还是向上添加，当向上添加时 将 renderedFrame 的 y 减去当前列表项的高度。（y 的值只在向上添加或移除时候改变）
      */
     void addCellAt(size_t index, bool downSide);
+
+    /// 将屏幕上所有的列表项移除并放入重复利用的列表中
+    void recycleAllCells();
+
+    /// 回收所有列表项，从 index 所在的行重新开始添加，用于跳转到距离当前位置很远的地方
+    void resetCellsAt(size_t index);
+
+    /// 为屏幕下方 preLayoutLine 项提交后台布局任务
+    void requestCellLayout();
+
+    /// 根据数据总数设置 contentBox 的高度
+    void updateContentHeight();
+
+    /// 判断是否需要（预）加载下一页
+    void checkNextPage(const brls::Rect& visibleFrame);
+
+    /// 加载下一页时在列表底部绘制一行骨架屏，由 RecyclingGridContentBox 调用
+    void drawFooterSkeleton(NVGcontext* vg, float x, float y, brls::Style style, brls::FrameContext* ctx);
+
+    /// 创建一个新的列表项
+    RecyclingGridItem* allocateCell(const std::string& identifier);
+
+    /// 预先创建一个列表项放入缓存列表，数量已经足够时返回 false
+    bool warmUpCell(const std::string& identifier);
+
+    friend class RecyclingGridContentBox;
+    friend class RecyclingGridWarmer;
 };
 
 class RecyclingGridContentBox : public brls::Box {
@@ -247,6 +382,9 @@ public:
     brls::View* getNextFocus(brls::FocusDirection direction,
                              brls::View* currentView) override;
 
+    void draw(NVGcontext* vg, float x, float y, float width, float height,
+              brls::Style style, brls::FrameContext* ctx) override;
+
 private:
     RecyclingGrid* recycler;
 };
@@ -5,6 +5,8 @@
 #pragma once
 
 #include <nanovg.h>
+#include <memory>
+#include <vector>
 #include <borealis/core/singleton.hpp>
 #include <borealis/core/application.hpp>
 
@@ -12,6 +14,36 @@
 #include "utils/event_helper.hpp"
 #include "presenter/presenter.h"
 
+/// 字幕排版后在屏幕上显示的一行
+class SubtitleRow {
+public:
+    std::string text;
+    float width = 0;
+};
+
+/// 一条字幕的排版结果
+class SubtitleLayout {
+public:
+    std::vector<SubtitleRow> rows;
+    // 最宽一行的宽度
+    float width = 0;
+    bool ready  = false;
+};
+
+/// 按开始时间排序的字幕，用于快速查找当前需要显示的字幕
+class SubtitleIndex {
+public:
+    std::vector<SubtitleLine> cues;
+    // endTime[i] 为前 i+1 条字幕中最晚的结束时间，用于跳转后查找仍在显示的字幕
+    std::vector<float> endTime;
+    std::vector<SubtitleLayout> layouts;
+    bool genByAI = false;
+    // 排版时使用的最大宽度，显示区域大小改变后需要重新排版
+    float layoutWidth = 0;
+    // 下一条需要排版的字幕
+    size_t layoutCursor = 0;
+};
+
 class SubtitleCore : public brls::Singleton<SubtitleCore>, public Presenter {
 public:
     SubtitleCore();
@@ -67,14 +99,37 @@ public:
      */
     [[nodiscard]] std::string getCurrentSubtitleId() const;
 
+    /// 每帧最多预先排版的字幕数量
+    static inline size_t SUBTITLE_LAYOUT_BATCH = 16;
+
+    /// 播放进度向前推进超过此数量的字幕时，改用二分查找定位
+    static inline size_t SUBTITLE_SEEK_STEPS = 8;
+
 private:
     void onLoadSubtitle(const bilibili::VideoPageSubtitle& page);
 
+    /// 根据播放进度更新正在显示的字幕
+    void updateActiveCues(double time);
+
+    /// 二分查找定位到指定时间，并重新计算正在显示的字幕
+    void seekCue(double time);
+
+    /// 排版一条字幕，按最大宽度自动换行
+    void layoutCue(NVGcontext* vg, size_t i);
+
     bilibili::VideoPageResult videoPageData;
     int subtitleFont = brls::Application::getDefaultFont();
     bilibili::VideoPageSubtitle currentSubtitle;
     NVGcolor fontColor       = nvgRGB(255, 255, 255);
     NVGcolor backgroundColor = nvgRGBA(0, 0, 0, 127);
-    size_t subtitleIndex     = 0;
     MPVEvent::Subscription event_id;
+
+    std::shared_ptr<SubtitleIndex> subtitleIndex;
+    // 每次切换字幕时递增，用于丢弃过期的异步结果
+    size_t subtitleGeneration = 0;
+    // 开始时间早于 cueTime 的字幕数量
+    size_t cueCursor = 0;
+    double cueTime   = 0;
+    // 正在显示的字幕，按开始时间排序
+    std::vector<size_t> activeCues;
 };
\ No newline at end of file
@@ -6,6 +6,8 @@
 #include <borealis/views/image.hpp>
 #include <lunasvg.h>
 
+#include "utils/svg_atlas.hpp"
+
 class SVGImage : public brls::Image {
 public:
     SVGImage();
@@ -37,8 +39,16 @@ public:
 
 private:
     std::unique_ptr<lunasvg::Document> document = nullptr;
-    brls::VoidEvent::Subscription subscription;
+    brls::VoidEvent::Subscription subscription, atlasSubscription;
+    // 资源文件的相对路径，非资源文件为空
+    std::string resName;
+    // 使用图集时的纹理与位置，为 0 时使用自己渲染的纹理
+    int atlasTexture = 0;
+    SVGAtlasEntry atlasEntry;
     std::string filePath;
     float angle = 0;
     float _width = 0.0f, _height = 0.0f;
+
+    /// 从图集中查找资源，找到时返回 true
+    bool useAtlas(const std::string& name);
 };
\ No newline at end of file
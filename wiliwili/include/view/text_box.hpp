@@ -4,6 +4,11 @@
 
 #pragma once
 
+#include <list>
+#include <map>
+#include <mutex>
+#include <unordered_map>
+#include <borealis/core/singleton.hpp>
 #include <borealis/views/label.hpp>
 #include "utils/image_helper.hpp"
 #include "utils/number_helper.hpp"
@@ -51,9 +56,13 @@ public:
 
     ~RichTextImage();
 
+    /// 开始加载图片，重复调用时不会再次加载
+    void load();
+
     std::string url;
     brls::Image* image;
     float width, height;
+    bool loaded = false;
 };
 
 /// 富文本 换行组件
@@ -64,6 +73,140 @@ public:
 
 typedef std::vector<std::shared_ptr<RichTextComponent>> RichTextData;
 
+/// 富文本排版参数，对应 TextBox 的字体设置
+class RichTextStyle {
+public:
+    int font          = 0;
+    float fontSize    = 0;
+    float lineHeight  = 0;
+    size_t maxRows    = SIZE_T_MAX;
+    bool showMoreText = false;
+
+    bool operator==(const RichTextStyle& o) const {
+        return font == o.font && fontSize == o.fontSize && lineHeight == o.lineHeight && maxRows == o.maxRows &&
+               showMoreText == o.showMoreText;
+    }
+};
+
+/// 排版结果中的一项：某一行中的一段文字或一张图片
+class RichTextLayoutItem {
+public:
+    RichTextType type = RichTextType::Text;
+    size_t source     = 0;  // 对应组件在 RichTextData 中的位置
+    size_t start      = 0;  // 文字在 RichTextSpan::text 中的范围
+    size_t length     = 0;
+    float x = 0, y = 0;
+};
+
+/**
+ * 富文本排版结果
+ * 只记录各组件的位置，不持有富文本组件，可以在后台线程中生成
+ */
+class RichTextLayout {
+public:
+    RichTextStyle style;
+    float width  = 0;
+    float height = 0;
+    std::vector<RichTextLayoutItem> items;
+    // 每一行第一项在 items 中的位置
+    std::vector<size_t> lines;
+
+    /// 排版结果能否直接用于指定宽度与样式的 TextBox
+    [[nodiscard]] bool match(float width, const RichTextStyle& style) const;
+
+    /// 获取第 line 行的 Y 值
+    [[nodiscard]] float getLineY(size_t line) const;
+
+    /**
+     * 使用 FontMetrics 中缓存的字符宽度排版，不依赖 NanoVG，可以工作在任意线程
+     * 遇到未测量过的字符时会等待主线程测量，所以不能在主线程中调用
+     * @return 等待超时时返回 nullptr
+     */
+    static std::shared_ptr<RichTextLayout> create(const RichTextData& data, const RichTextStyle& style, float width);
+};
+
+/**
+ * 字体测量缓存
+ * 按字体与字号记录行高与每个字符的宽度，后台线程排版时使用
+ * 字符宽度单独测量，不考虑字距调整 (kerning)
+ */
+class FontMetrics : public brls::Singleton<FontMetrics> {
+public:
+    /**
+     * 确保 text 中的字符都已测量，缺少的字符交给主线程测量并等待结果
+     * @return 等待超时时返回 false
+     */
+    bool load(int font, float fontSize, const std::string& text);
+
+    float getLineHeight(int font, float fontSize);
+
+    float getAdvance(int font, float fontSize, uint32_t codepoint);
+
+    /// 等待主线程测量的最长时间 (ms)
+    static inline int TIMEOUT = 1000;
+
+private:
+    /// 测量字符宽度，此函数需要工作在主线程
+    void measure(int font, float fontSize, const std::vector<uint32_t>& codepoints);
+
+    class Entry {
+    public:
+        float lineHeight = -1;
+        std::unordered_map<uint32_t, float> advances;
+    };
+
+    std::mutex mutex;
+    std::map<std::pair<int, float>, Entry> fonts;
+};
+
+/**
+ * 富文本排版结果的 LRU 缓存，此类需要工作在主线程
+ * 以内容的哈希、宽度与排版参数为键，列表项被回收后再次显示或窗口尺寸变回原样时不需要重新排版
+ * 每条缓存同时保存参与排版的内容（文字、图片地址与尺寸），取出时逐字节比较，避免哈希碰撞时用错排版结果
+ */
+class RichTextLayoutCache : public brls::Singleton<RichTextLayoutCache> {
+public:
+    std::shared_ptr<RichTextLayout> get(const RichTextData& data, size_t hash, float width, const RichTextStyle& style);
+
+    void put(const RichTextData& data, size_t hash, const std::shared_ptr<RichTextLayout>& layout);
+
+    void clear();
+
+    /// 计算富文本中影响排版的内容的哈希，不包括文字颜色
+    static size_t hash(const RichTextData& data);
+
+    /// 最多缓存的排版结果数量
+    static inline size_t MAX_SIZE = 256;
+
+private:
+    class Key {
+    public:
+        size_t hash = 0;
+        float width = 0;
+        RichTextStyle style;
+
+        bool operator==(const Key& o) const { return hash == o.hash && width == o.width && style == o.style; }
+    };
+
+    class KeyHash {
+    public:
+        size_t operator()(const Key& key) const;
+    };
+
+    class Entry {
+    public:
+        // 参与排版的内容，见 serialize
+        std::string content;
+        std::shared_ptr<RichTextLayout> layout;
+    };
+
+    static std::string serialize(const RichTextData& data);
+
+    // 最近使用的在前
+    std::list<std::pair<Key, Entry>> cache;
+    std::unordered_map<Key, std::list<std::pair<Key, Entry>>::iterator, KeyHash> index;
+};
+
 /**
  * 富文本
  * 支持不同颜色文字与图片绘制
@@ -93,8 +236,20 @@ public:
      */
     void setRichText(const RichTextData& value);
 
+    /**
+     * 设置富文本内容与在后台线程中计算好的排版结果
+     * 内容需要事先经过 prepareRichText 处理，排版结果与组件的宽度和样式不一致时会重新排版
+     */
+    void setRichText(const RichTextData& value, const std::shared_ptr<RichTextLayout>& layout);
+
     RichTextData& getRichText();
 
+    /// 当前的排版参数
+    [[nodiscard]] RichTextStyle getRichTextStyle() const;
+
+    /// 对富文本内容做显示前的处理（如繁简转换），setRichText 会自动调用
+    static void prepareRichText(const RichTextData& value);
+
     void setText(const std::string& text) override;
 
     void onLayout() override;
@@ -107,7 +262,7 @@ public:
     void setParsedDone(bool value) { this->parsedDone = value; }
 
     /**
-     * 按行重新分割富文本数据
+     * 按行重新分割富文本数据，相同内容、宽度与排版参数的结果会从 RichTextLayoutCache 中取出
      * @param width 设定分割的宽度
      * @return 总高度
      */
@@ -133,8 +288,10 @@ protected:
     bool showMoreText = false;
     // 富文本数据
     RichTextData richContent;
-    // 按行分割的富文本数据。开发者设置富文本数据后，会按行重新分割。
-    std::vector<RichTextData> lineContent;
+    // 富文本内容的哈希，用于查找排版缓存
+    size_t richHash = 0;
+    // 按行分割的排版结果。开发者设置富文本数据后，会按行重新分割。
+    std::shared_ptr<RichTextLayout> richLayout;
 
     bool parsedDone = false;
 };
\ No newline at end of file
@@ -10,11 +10,11 @@
 #pragma once
 
 #include "view/recycling_grid.hpp"
+#include "view/text_box.hpp"
 #include "view/user_info.hpp"
 #include "bilibili/result/video_detail_result.h"
 
 class SVGImage;
-class TextBox;
 
 /// GridHintView
 
@@ -47,6 +47,13 @@ public:
     SVGImage* svgImage;
 };
 
+/// 在后台线程中计算的评论布局
+class VideoCommentLayout : public RecyclingGridLayout {
+public:
+    RichTextData content;
+    std::shared_ptr<RichTextLayout> layout;
+};
+
 class VideoComment : public RecyclingGridItem {
 public:
     VideoComment();
@@ -57,7 +64,20 @@ public:
 
     void setMaxRows(size_t value);
 
-    void setData(bilibili::VideoCommentResult data);
+    /**
+     * 设置评论内容
+     * @param layout 由 layoutTask 在后台线程中计算的布局，为空时在主线程中排版
+     */
+    void setData(bilibili::VideoCommentResult data, const std::shared_ptr<RecyclingGridLayout>& layout = nullptr);
+
+    /// 将评论内容解析为富文本，此函数需要工作在主线程
+    static RichTextData parseContent(const bilibili::VideoCommentResult& data);
+
+    /**
+     * 生成在后台线程中计算评论布局的任务，用于 RecyclingGridDataSource::layoutForRow
+     * 还没有创建过评论组件时返回 nullptr
+     */
+    static RecyclingGridLayoutTask layoutTask(const bilibili::VideoCommentResult& data);
 
     void setReplyNum(size_t num);
 
@@ -85,4 +105,10 @@ protected:
     BRLS_BIND(SVGImage, svgLike, "comment/svg/like");
     BRLS_BIND(SVGImage, svgDislike, "comment/svg/dislike");
     bilibili::VideoCommentResult comment_data;
+
+    // 评论内容的默认排版参数与评论内容之外占用的宽度、高度，在第一次创建评论组件时记录
+    static inline RichTextStyle contentStyle;
+    static inline float contentPaddingX  = 0;
+    static inline float contentPaddingY  = 0;
+    static inline bool contentStyleReady = false;
 };
\ No newline at end of file
@@ -41,6 +41,7 @@ public:
     BRLS_BIND(brls::Label, labelVideoBitrate, "profile/video/bitrate");
     BRLS_BIND(brls::Label, labelVideoDrop, "profile/video/drop");
     BRLS_BIND(brls::Label, labelVideoSync, "profile/video/avsync");
+    BRLS_BIND(brls::Label, labelVideoUIFrames, "profile/video/ui_frames");
 
     BRLS_BIND(brls::Label, labelAudioChannel, "profile/audio/channel");
     BRLS_BIND(brls::Label, labelAudioCodec, "profile/audio/codec");
@@ -37,6 +37,9 @@ public:
 
     [[nodiscard]] float getProgress() const { return progress; }
 
+    // Whether the pointer is being dragged or moved with buttons
+    [[nodiscard]] bool isProgressChanging() const { return pointerSelected || pointerDragging; }
+
     // Progress is manually dragged
     brls::Event<float>* getProgressEvent() { return &progressEvent; }
 
@@ -67,6 +70,7 @@ private:
 
     float progress             = 1;
     bool pointerSelected       = false;
+    bool pointerDragging       = false;
     // while pointer is selected ignore progress setting
     bool ignoreProgressSetting = false;
     // while pointer is selected, the last progress value set by setProgress()
@@ -375,6 +375,9 @@ private:
     /// 绘制高能进度条
     void drawHighlightProgress(NVGcontext* vg, float x, float y, float width, float alpha);
 
+    /// 拖动进度条时，在进度条上方绘制预览图
+    void drawVideoShot(NVGcontext* vg, float alpha);
+
     void _setTvControlMode(bool state);
 
     float getRealDuration();
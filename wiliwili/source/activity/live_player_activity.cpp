@@ -13,6 +13,7 @@
 
 #include "utils/shader_helper.hpp"
 #include "utils/config_helper.hpp"
+#include "utils/string_helper.hpp"
 
 #include "live/extract_messages.hpp"
 #include "live/ws_utils.hpp"
@@ -58,6 +59,19 @@ static void onDanmakuReceived(const std::string& msg) {
     process_danmaku(danmaku_list);
 }
 
+static void onDanmakuStatus(bool connected, uint64_t gap) {
+    // 弹幕连接中断或恢复时在播放器上提示
+    std::string hint;
+    if (!connected) {
+        hint = "wiliwili/player/danmaku_disconnected"_i18n;
+    } else if (gap > 0) {
+        hint = wiliwili::format("wiliwili/player/danmaku_reconnected"_i18n, fmt::format("{:.1f}", gap / 1000.0));
+    } else {
+        return;
+    }
+    brls::sync([hint]() { APP_E->fire(VideoView::HINT, (void*)hint.c_str()); });
+}
+
 static void showDialog(const std::string& msg, const std::string& pic, bool forceQuit) {
     brls::Dialog* dialog;
     if (pic.empty()) {
@@ -130,6 +144,9 @@ void LiveActivity::setCommonData() {
                 default:
                     this->video->setOnlineCount({mpvErrorString(MPVCore::instance().mpv_error_code)});
             }
+        } else if (e == MPV_LOADED) {
+            // 直播流重新加载后，画面回到最新的位置
+            LiveDanmakuCore::instance().syncLiveEdge();
         } else if (e == END_OF_FILE) {
             // flv 直播遇到网络错误不会报错，而是输出 END_OF_FILE
             // 直播间关闭时也可能进入这里
@@ -225,6 +242,10 @@ void LiveActivity::onContentAvailable() {
 
     // 连接直播弹幕
     this->requestLiveDanmakuToken(this->liveData.roomid);
+    if (LiveDanmakuCore::DANMAKU_RECORD) LiveDanmakuCore::instance().startRecord(this->liveData.roomid);
+
+    // 下载直播间表情，用于显示表情弹幕
+    this->requestLiveEmoticon(this->liveData.roomid);
 
     // 获取直播间是否为大航海专属直播
     this->requestPayLiveInfo(liveData.roomid);
@@ -296,9 +317,14 @@ void LiveActivity::onLiveData(const bilibili::LiveRoomPlayInfo& result) {
 
 void LiveActivity::onDanmakuInfo(int roomid, const bilibili::LiveDanmakuinfo& info) {
     danmaku.setonMessage(onDanmakuReceived);
+    danmaku.setonStatus(onDanmakuStatus);
     danmaku.connect(roomid, std::stoll(ProgramConfig::instance().getUserID()), info);
 }
 
+void LiveActivity::onEmoticonAtlas(const std::shared_ptr<LiveEmoticonAtlas>& atlas) {
+    LiveDanmakuCore::instance().setEmoticonAtlas(atlas);
+}
+
 void LiveActivity::onError(const std::string& error) {
     brls::Logger::error("ERROR request live data: {}", error);
     this->video->showOSD(false);
@@ -364,6 +390,12 @@ LiveActivity::~LiveActivity() {
     MPV_E->unsubscribe(tl_event_id);
     // 在取消监控之后再停止播放器，避免在播放器停止时触发事件 (尤其是：END_OF_FILE)
     this->video->stop();
+    if (LiveDanmakuCore::instance().recorder.isOpen()) {
+        // 退出直播间时将录制的弹幕导出为 xml 文件
+        auto dir = ProgramConfig::instance().getConfigDir() + "/live_danmaku";
+        LiveDanmakuCore::instance().stopRecord(
+            fmt::format("{}/{}_{}.xml", dir, liveData.roomid, wiliwili::getUnixTime()));
+    }
     LiveDanmakuCore::instance().reset();
     brls::cancelDelay(toggleDelayIter);
     brls::cancelDelay(errorDelayIter);
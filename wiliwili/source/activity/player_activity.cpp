@@ -538,6 +538,13 @@ void PlayerActivity::onIndexChange(size_t index) {
     this->requestVideoUrl(videoDetailResult.bvid, videoDetailPage.cid);
 }
 
+void PlayerActivity::requestNextPreload() {
+    // 合集中的下一个视频需要先获取视频信息，这里只预加载下一分P
+    if (videoDetailPage.page < videoDetailResult.pages.size()) {
+        this->requestPreload(videoDetailResult.bvid, videoDetailResult.pages[videoDetailPage.page].cid, false);
+    }
+}
+
 void PlayerActivity::onIndexChangeToNext() {
     // videoDetailPage.page 是从1开始计数的单调递增序号，所以这里是尝试加载下一分P
     if (videoDetailPage.page < videoDetailResult.pages.size()) {
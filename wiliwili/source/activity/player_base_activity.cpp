@@ -15,6 +15,11 @@
 #include "utils/config_helper.hpp"
 #include "utils/dialog_helper.hpp"
 #include "utils/number_helper.hpp"
+#include "utils/abr_helper.hpp"
+#include "utils/cdn_helper.hpp"
+#include "utils/media_cache.hpp"
+#include "utils/download_manager.hpp"
+#include "utils/videoshot_helper.hpp"
 #include "presenter/comment_related.hpp"
 #include "view/qr_image.hpp"
 #include "view/video_view.hpp"
@@ -49,10 +54,15 @@ public:
         //从缓存列表中取出 或者 新生成一个表单项
         VideoComment* item = (VideoComment*)recycler->dequeueReusableCell("Cell");
 
-        item->setData(this->dataList[index - 2]);
+        item->setData(this->dataList[index - 2], recycler->takeCellLayout(index));
         return item;
     }
 
+    RecyclingGridLayoutTask layoutForRow(RecyclingGrid* recycler, size_t index) override {
+        if (index < 2) return nullptr;
+        return VideoComment::layoutTask(this->dataList[index - 2]);
+    }
+
     size_t getItemCount() override { return dataList.size() + 2; }
 
     void onItemSelected(RecyclingGrid* recycler, size_t index) override {
@@ -252,6 +262,13 @@ void BasePlayerActivity::setCommonData() {
                              return true;
                          });
 
+    // 离线下载当前视频
+    this->videoTitleBox->registerAction("wiliwili/player/download"_i18n, brls::ControllerButton::BUTTON_Y,
+                                        [this](brls::View* view) -> bool {
+                                            this->downloadVideo();
+                                            return true;
+                                        });
+
 
     this->btnQR->getParent()->addGestureRecognizer(new brls::TapGestureRecognizer(this->btnQR->getParent()));
 
@@ -304,6 +321,18 @@ void BasePlayerActivity::setCommonData() {
 
                     //todo: 如果有选择的字幕加载对应的字幕
                 }
+                // 临近结束时预加载下一个视频
+                if (PRELOAD_TIME > 0 &&
+                    (PLAYER_STRATEGY == PlayerStrategy::NEXT || PLAYER_STRATEGY == PlayerStrategy::RCMD)) {
+                    int64_t end = MPVCore::instance().duration;
+                    if (PLAYER_SKIP_OPENING_CREDITS) {
+                        int clipEnd       = videoUrlResult.clipEnd;
+                        auto seasonCustom = ProgramConfig::instance().getSeasonCustom(seasonInfo.season_id);
+                        if (seasonCustom.custom_clip) clipEnd = end - seasonCustom.clip_end;
+                        if (clipEnd > 0 && clipEnd < end) end = clipEnd;
+                    }
+                    if (end > 0 && end - MPVCore::instance().video_progress <= PRELOAD_TIME) this->requestNextPreload();
+                }
                 break;
             }
             case MpvEventEnum::END_OF_FILE:
@@ -464,6 +493,26 @@ void BasePlayerActivity::setVideoQuality() {
     });
 }
 
+void BasePlayerActivity::downloadVideo() {
+    // 下载当前清晰度，未获取到播放地址时使用默认清晰度
+    int quality = videoUrlResult.accept_quality.empty() ? defaultQuality : videoUrlResult.quality;
+    bool added;
+    if (dynamic_cast<PlayerSeasonActivity*>(this)) {
+        if (episodeResult.bvid.empty() || episodeResult.cid == 0) return;
+        std::string title = seasonInfo.season_title;
+        if (!episodeResult.title.empty()) title += " " + episodeResult.title;
+        added = DownloadManager::instance().add(episodeResult.bvid, episodeResult.cid, episodeResult.id, title,
+                                                quality);
+    } else {
+        if (videoDetailResult.bvid.empty() || videoDetailPage.cid == 0) return;
+        std::string title = videoDetailResult.title;
+        if (videoDetailResult.pages.size() > 1) title += " " + videoDetailPage.part;
+        added = DownloadManager::instance().add(videoDetailResult.bvid, videoDetailPage.cid, 0, title, quality);
+    }
+    brls::Application::notify(added ? "wiliwili/player/download_added"_i18n
+                                    : "wiliwili/player/download_exists"_i18n);
+}
+
 void BasePlayerActivity::setCommentMode() {
     this->recyclingGrid->estimatedRowHeight = 100;
     this->recyclingGrid->showSkeleton();
@@ -474,8 +523,7 @@ void BasePlayerActivity::setCommentMode() {
 void BasePlayerActivity::onVideoPlayUrl(const bilibili::VideoUrlResult& result) {
     brls::Logger::debug("onVideoPlayUrl quality: {}", result.quality);
 
-    // 有效期 110 分钟
-    videoDeadline = std::chrono::system_clock::now() + std::chrono::seconds(6600);
+    videoDeadline = VideoDetail::getUrlDeadline(result);
 
     // 获取预设的跳转位置
     int start    = this->getProgress();
@@ -566,6 +614,15 @@ void BasePlayerActivity::onVideoPlayUrl(const bilibili::VideoUrlResult& result)
             }
         }
 
+        // 磁盘缓存的名称: <bvid>_<cid>_<清晰度>_<编码>，音频为 <bvid>_<cid>_audio<码率>
+        std::string cacheKey;
+        if (dynamic_cast<PlayerSeasonActivity*>(this)) {
+            cacheKey = fmt::format("{}_{}", episodeResult.bvid, episodeResult.cid);
+        } else {
+            cacheKey = fmt::format("{}_{}", videoDetailResult.bvid, videoDetailPage.cid);
+        }
+        std::string videoKey = fmt::format("{}_{}_{}", cacheKey, v.id, v.codecid), audioKey;
+
         // 将主音频和备份音频链接合并，当作不同的音轨传给播放器，可以实现在播放失败时自动切换
         std::vector<std::string> audios;
         if (!result.dash.audio.empty()) {
@@ -580,19 +637,36 @@ void BasePlayerActivity::onVideoPlayUrl(const bilibili::VideoUrlResult& result)
             // 生成音频列表
             audios.emplace_back(a.base_url);
             audios.insert(audios.end(), a.backup_url.begin(), a.backup_url.end());
+            audioKey = fmt::format("{}_audio{}", cacheKey, a.id);
             brls::Logger::debug("Dash quality: {}; video: {}; audio: {}", videoUrlResult.quality, v.codecid, a.id);
         }
 
-        // 给播放器设置链接
-        this->video->setUrl(v.base_url, start, end, audios);
+        // 立即使用主链接播放（各节点都有足够的历史记录时使用表现最好的节点），同时在后台测速供之后选择节点
+        std::vector<std::string> urls{v.base_url};
+        urls.insert(urls.end(), v.backup_url.begin(), v.backup_url.end());
+        auto sorted = CdnHelper::instance().order(urls);
+        CdnHelper::instance().probe(urls);
+        audios = CdnHelper::instance().sort(audios);
+        for (auto& i : audios) i = MediaCache::instance().getUrl(audioKey, i);
+
+        // 给播放器设置链接，开启磁盘缓存时经过本地的缓存代理
+        auto& cache = MediaCache::instance();
+        this->video->setUrl(cache.getUrl(videoKey, sorted[0]), start, end, audios);
 
         // 设置备份视频链接
-        for (const auto& backup_url : v.backup_url) {
-            this->video->setBackupUrl(backup_url, start, end, audios);
+        for (size_t i = 1; i < sorted.size(); i++) {
+            this->video->setBackupUrl(cache.getUrl(videoKey, sorted[i]), start, end, audios);
         }
+
+        // 自适应清晰度在不高于当前清晰度的视频流中切换
+        auto media       = v;
+        media.base_url   = sorted[0];
+        media.backup_url = std::vector<std::string>(sorted.begin() + 1, sorted.end());
+        AbrHelper::instance().setRepresentations(result, media);
     } else {
         // flv
         brls::Logger::debug("Video type: flv");
+        AbrHelper::instance().reset();
         if (result.durl.empty()) {
             brls::Logger::error("No media");
         } else if (result.durl.size() == 1) {
@@ -738,4 +812,6 @@ BasePlayerActivity::~BasePlayerActivity() {
     APP_E->unsubscribe(customEventSubscribeID);
     // 停止视频播放
     this->video->stop();
+    // 释放进度条预览图
+    VideoShotHelper::instance().clear();
 }
\ No newline at end of file
@@ -91,6 +91,12 @@ void PlayerSeasonActivity::onIndexChangeToNext() {
     this->onIndexChange(episodeResult.index + 1);
 }
 
+void PlayerSeasonActivity::requestNextPreload() {
+    size_t index = episodeResult.index + 1;
+    if (index >= episodeList.size() || episodeList[index].id == 0) return;
+    this->requestPreload(episodeList[index].bvid, episodeList[index].cid, true);
+}
+
 void PlayerSeasonActivity::onContentAvailable() {
     this->setCommonData();
 
@@ -21,6 +21,10 @@
 #include "utils/vibration_helper.hpp"
 #include "utils/dialog_helper.hpp"
 #include "utils/activity_helper.hpp"
+#include "utils/media_cache.hpp"
+#include "utils/download_manager.hpp"
+#include "utils/frame_scheduler.hpp"
+#include "utils/string_helper.hpp"
 #include "view/text_box.hpp"
 #include "view/selector_cell.hpp"
 #include "view/mpv_core.hpp"
@@ -260,6 +264,88 @@ void SettingActivity::onContentAvailable() {
         return true;
     });
 
+    auto updateMediaCache = [this]() {
+        auto& cache = MediaCache::instance();
+        btnMediaCache->title->setText(wiliwili::format("wiliwili/setting/tools/others/media_cache"_i18n,
+                                                       cache.getCachedSize() / 1024 / 1024,
+                                                       (int)(cache.getHitRate() * 100)));
+    };
+    updateMediaCache();
+    btnMediaCache->registerClickAction([updateMediaCache](...) -> bool {
+        MediaCache::instance().clear();
+        updateMediaCache();
+        brls::Application::notify("wiliwili/setting/tools/others/media_cache_cleared"_i18n);
+        return true;
+    });
+
+    auto updateDownloads = [this]() {
+        auto tasks  = DownloadManager::instance().getTasks();
+        size_t done = std::count_if(tasks.begin(), tasks.end(),
+                                    [](const DownloadTask& i) { return i.state == DownloadState::DONE; });
+        btnDownloads->title->setText(
+            wiliwili::format("wiliwili/setting/tools/others/downloads"_i18n, done, tasks.size()));
+    };
+    updateDownloads();
+    btnDownloads->registerClickAction([updateDownloads](...) -> bool {
+        auto tasks = DownloadManager::instance().getTasks();
+        if (tasks.empty()) {
+            brls::Application::notify("wiliwili/download/empty"_i18n);
+            return true;
+        }
+        std::vector<std::string> items;
+        for (auto& i : tasks) {
+            std::string state;
+            switch (i.state) {
+                case DownloadState::WAITING:
+                    state = "wiliwili/download/state/waiting"_i18n;
+                    break;
+                case DownloadState::DOWNLOADING: {
+                    int64_t size = i.getSize();
+                    state        = wiliwili::format("wiliwili/download/state/downloading"_i18n,
+                                                    size > 0 ? i.getDownloadedSize() * 100 / size : 0);
+                    break;
+                }
+                case DownloadState::PAUSED:
+                    state = "wiliwili/download/state/paused"_i18n;
+                    break;
+                case DownloadState::DONE:
+                    state = "wiliwili/download/state/done"_i18n;
+                    break;
+                case DownloadState::FAILED:
+                    state = "wiliwili/download/state/failed"_i18n;
+                    break;
+            }
+            items.emplace_back(fmt::format("{} ({})", i.title, state));
+        }
+        BaseDropdown::text("wiliwili/player/download"_i18n, items, [tasks, updateDownloads](int data) {
+            auto& task      = tasks[data];
+            std::string key = task.getKey();
+            auto dialog     = new brls::Dialog(task.title);
+            dialog->addButton("hints/cancel"_i18n, []() {});
+            dialog->addButton("wiliwili/download/delete"_i18n, [key, updateDownloads]() {
+                DownloadManager::instance().remove(key);
+                updateDownloads();
+            });
+            if (task.state == DownloadState::DONE) {
+                // 打开视频时会优先使用下载的文件
+                dialog->addButton("wiliwili/download/play"_i18n, [task]() {
+                    if (task.epid != 0) {
+                        Intent::openSeasonByEpId(task.epid);
+                    } else {
+                        Intent::openBV(task.bvid, task.cid);
+                    }
+                });
+            } else if (task.state == DownloadState::WAITING || task.state == DownloadState::DOWNLOADING) {
+                dialog->addButton("wiliwili/download/pause"_i18n, [key]() { DownloadManager::instance().pause(key); });
+            } else {
+                dialog->addButton("wiliwili/download/resume"_i18n,
+                                  [key]() { DownloadManager::instance().resume(key); });
+            }
+            dialog->open();
+        });
+        return true;
+    });
+
     labelAboutVersion->setText(version
 #if defined(BOREALIS_USE_DEKO3D)
                                + " (deko3d)"
@@ -325,10 +411,21 @@ void SettingActivity::onContentAvailable() {
                       (size_t)conf.getIntOptionIndex(SettingItem::LIMITED_FPS), [fpsOption](int data) {
                           int fps = fpsOption.rawOptionList[data];
                           brls::Application::setLimitedFPS(fps);
+                          FrameScheduler::TARGET_FPS = fps > 0 ? fps : 60;
                           ProgramConfig::instance().setSettingItem(SettingItem::LIMITED_FPS, fps);
                           return true;
                       });
 
+    /// Idle FPS
+    cellIdleFPS->init("wiliwili/setting/app/others/idle_fps"_i18n, FrameScheduler::instance().isDeactivationEnabled(),
+                      [](bool value) {
+                          auto& conf = ProgramConfig::instance();
+                          int time   = value ? FrameScheduler::IDLE_TIME : 0;
+                          conf.setSettingItem(SettingItem::DEACTIVATED_TIME, time);
+                          FrameScheduler::instance().setDeactivation(
+                              time, conf.getSettingItem(SettingItem::DEACTIVATED_FPS, 5));
+                      });
+
     /// TV Search Mode
     cellTvSearch->init("wiliwili/setting/app/others/tv_search"_i18n, conf.getBoolOption(SettingItem::SEARCH_TV_MODE),
                        [](bool value) {
@@ -609,6 +706,26 @@ void SettingActivity::onContentAvailable() {
                                MPVCore::instance().restart();
                            });
 
+    auto diskCacheOption = conf.getOptionData(SettingItem::PLAYER_DISK_CACHE);
+    selectorDiskCache->init("wiliwili/setting/app/playback/disk_cache"_i18n,
+                            {"0MB (" + "hints/off"_i18n + ")", "512MB", "1GB", "2GB", "4GB"},
+                            conf.getIntOptionIndex(SettingItem::PLAYER_DISK_CACHE), [diskCacheOption](int data) {
+                                ProgramConfig::instance().setSettingItem(SettingItem::PLAYER_DISK_CACHE,
+                                                                         diskCacheOption.rawOptionList[data]);
+                                // 新的上限从下一次下载时开始生效
+                                MediaCache::MAX_SIZE = diskCacheOption.rawOptionList[data];
+                            });
+
+    auto bandwidthOption = conf.getOptionData(SettingItem::DOWNLOAD_BANDWIDTH);
+    selectorDownloadBandwidth->init(
+        "wiliwili/setting/app/playback/download_bandwidth"_i18n,
+        {"wiliwili/download/unlimited"_i18n, "1MB/s", "2MB/s", "5MB/s", "10MB/s"},
+        conf.getIntOptionIndex(SettingItem::DOWNLOAD_BANDWIDTH), [bandwidthOption](int data) {
+            ProgramConfig::instance().setSettingItem(SettingItem::DOWNLOAD_BANDWIDTH,
+                                                     bandwidthOption.rawOptionList[data]);
+            DownloadManager::BANDWIDTH = bandwidthOption.rawOptionList[data];
+        });
+
     /// TLS verify
     btnTls->init("wiliwili/setting/app/network/tls"_i18n, conf.getBoolOption(SettingItem::TLS_VERIFY), [](bool data) {
         auto& conf = ProgramConfig::instance();
@@ -10,10 +10,10 @@
 #include "live/ws_utils.hpp"
 #include "utils/config_helper.hpp"
 
+#include <algorithm>
 #include <cstddef>
+#include <cstdlib>
 #include <ctime>
-#include <queue>
-#include <condition_variable>
 #include <string>
 
 namespace bilibili {
@@ -24,159 +24,384 @@ void BilibiliClient::get_live_danmaku_info(int roomid, const std::function<void(
 }
 }  // namespace bilibili
 
-static void mongoose_event_handler(struct mg_connection *nc, int ev, void *ev_data);
+/// LiveDanmakuRoom
 
-static void heartbeat_timer(void *param) {
-    auto liveDanmaku = static_cast<LiveDanmaku *>(param);
-    if (liveDanmaku->is_connected() and liveDanmaku->is_evOK()) {
-        liveDanmaku->send_heartbeat();
-    }
+const bilibili::LiveDanmakuHostinfo &LiveDanmakuRoom::current_host() const {
+    if (host_order.empty()) return info.host_list[info.host_list.size() - 1];
+    return info.host_list[host_order[host_index % host_order.size()]];
 }
 
-static std::queue<std::string> msg_q;
-static std::condition_variable cv;
-static std::mutex msg_q_mutex;
+void LiveDanmakuRoom::send_join_request() {
+    if (this->nc == nullptr) return;
+    json join_request            = {{"uid", uid},
+                                    {"roomid", room_id},
+                                    {"protover", 2},
+                                    {"buvid", ProgramConfig::instance().getBuvid3()},
+                                    {"platform", "web"},
+                                    {"type", 2},
+                                    {"key", this->info.token}};
+    std::string join_request_str = join_request.dump();
+    brls::Logger::info("(LiveDanmaku) join_request:{}", join_request_str);
+    std::vector<uint8_t> packet = encode_packet(0, 7, join_request_str);
+    mg_ws_send(this->nc, packet.data(), packet.size(), WEBSOCKET_OP_BINARY);
+}
 
-static void add_msg(std::string &&a) {
-    std::lock_guard<std::mutex> lock(msg_q_mutex);
-    msg_q.emplace(std::move(a));
-    cv.notify_one();
+void LiveDanmakuRoom::send_heartbeat() {
+    if (this->nc == nullptr) return;
+    brls::Logger::debug("(LiveDanmaku) send_heartbeat: {}", room_id);
+    std::vector<uint8_t> packet = encode_packet(0, 2, "");
+    mg_ws_send(this->nc, packet.data(), packet.size(), WEBSOCKET_OP_BINARY);
 }
 
-LiveDanmaku::LiveDanmaku() {}
+/// LiveDanmakuManager
 
-LiveDanmaku::~LiveDanmaku() {
-    disconnect();
-    std::lock_guard<std::mutex> lock(msg_q_mutex);
-    while (!msg_q.empty()) msg_q.pop();
-}
+LiveDanmakuManager::~LiveDanmakuManager() { stop(); }
 
-void LiveDanmaku::connect(int room_id, uint64_t uid, const bilibili::LiveDanmakuinfo &info) {
-    if (connected.load(std::memory_order_acquire)) {
-        return;
+size_t LiveDanmakuManager::add_room(int room_id, uint64_t uid, const bilibili::LiveDanmakuinfo &info,
+                                    on_message_func_t func, on_status_func_t status) {
+    if (info.host_list.empty()) {
+        brls::Logger::error("(LiveDanmaku) host list is empty: {}", room_id);
+        return 0;
     }
-    connected.store(true, std::memory_order_release);
 
-    // Create and configure Mongoose connection
-    this->mgr = new mg_mgr;
+    auto room     = std::make_shared<LiveDanmakuRoom>();
+    room->room_id = room_id;
+    room->uid     = uid;
+    room->info    = info;
 
-    // get_live_s(room_id);
-    mg_log_set(MG_LL_NONE);
+    {
+        std::lock_guard<std::mutex> lock(sink_mutex);
+        room->id = next_id++;
+        sinks.emplace(room->id, LiveDanmakuSink{std::move(func), std::move(status)});
+    }
 
-    this->info = info;
-    mg_mgr_init(this->mgr);
-    mg_wakeup_init(this->mgr);
+    start();
+    run_command([this, room]() {
+        rooms.emplace(room->id, room);
+        probe_hosts(room.get());
+    });
 
-    std::string host = "ws://" + this->info.host_list[this->info.host_list.size() - 1].host + ":" +
-                       std::to_string(this->info.host_list[this->info.host_list.size() - 1].ws_port) + "/sub";
-    this->nc = mg_ws_connect(this->mgr, host.c_str(), mongoose_event_handler, this, nullptr);
+    brls::Logger::info("(LiveDanmaku) add room: {}/{}", room_id, room->id);
+    return room->id;
+}
 
-    if (this->nc == nullptr) {
-        brls::Logger::error("(LiveDanmaku) nc is null");
-        this->disconnect();
-        mg_mgr_free(this->mgr);
-        delete this->mgr;
+void LiveDanmakuManager::remove_room(size_t id) {
+    bool empty;
+    {
+        std::lock_guard<std::mutex> lock(sink_mutex);
+        sinks.erase(id);
+        empty = sinks.empty();
+    }
+
+    if (empty) {
+        // 没有需要监听的直播间了，直接停止事件循环
+        stop();
         return;
     }
 
-    this->room_id = room_id;
-    this->uid     = uid;
+    run_command([this, id]() {
+        auto it = rooms.find(id);
+        if (it == rooms.end()) return;
+        close_room(it->second.get());
+        rooms.erase(it);
+    });
+    brls::Logger::info("(LiveDanmaku) remove room: {}", id);
+}
+
+void LiveDanmakuManager::set_wait_time(size_t time) { wait_time = time; }
+
+size_t LiveDanmakuManager::room_count() {
+    std::lock_guard<std::mutex> lock(sink_mutex);
+    return sinks.size();
+}
+
+void LiveDanmakuManager::start() {
+    std::lock_guard<std::mutex> lock(state_mutex);
+    if (running.load(std::memory_order_acquire)) return;
+    running.store(true, std::memory_order_release);
+
+    mg_log_set(MG_LL_NONE);
+    this->mgr = new mg_mgr;
+    mg_mgr_init(this->mgr);
+    mg_wakeup_init(this->mgr);
 
-    // Start Mongoose event loop and heartbeat thread
+    // Mongoose event loop
     this->mongoose_thread = std::thread([this]() {
-        while (this->is_connected()) {
-            this->mongoose_mutex.lock();
-            if (this->nc == nullptr) {
-                break;
+        while (running.load(std::memory_order_acquire)) {
+            std::vector<std::function<void()>> list;
+            {
+                std::lock_guard<std::mutex> lock(command_mutex);
+                list.swap(commands);
             }
-            this->mongoose_mutex.unlock();
-            mg_mgr_poll(this->mgr, this->wait_time);
+            for (auto &func : list) func();
+
+            check_rooms();
+            mg_mgr_poll(this->mgr, (int)wait_time.load());
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(command_mutex);
+            commands.clear();
         }
+        for (auto &room : rooms) close_room(room.second.get());
+        rooms.clear();
         mg_mgr_free(this->mgr);
         delete this->mgr;
+        this->mgr = nullptr;
+        wakeup_id = 0;
     });
 
+    // 所有直播间的消息都在这个线程中分发
     this->task_thread = std::thread([this]() {
         while (true) {
             std::unique_lock<std::mutex> lock(msg_q_mutex);
-            cv.wait(lock, [this] { return !msg_q.empty() or !this->is_connected(); });
-            if (!this->is_connected()) break;
+            cv.wait(lock, [this] { return !msg_q.empty() || !running.load(std::memory_order_acquire); });
+            if (!running.load(std::memory_order_acquire)) break;
             auto msg = std::move(msg_q.front());
             msg_q.pop();
             lock.unlock();
 
-            this->onMessage(msg);
+            on_message_func_t func;
+            {
+                std::lock_guard<std::mutex> sink_lock(sink_mutex);
+                auto it = sinks.find(msg.first);
+                if (it != sinks.end()) func = it->second.on_message;
+            }
+            if (func) func(msg.second);
         }
     });
 
-    brls::Logger::info("(LiveDanmaku) connect step finish");
+    brls::Logger::info("(LiveDanmaku) event loop started");
 }
 
-void LiveDanmaku::disconnect() {
-    if (!connected.load(std::memory_order_acquire)) {
+void LiveDanmakuManager::stop() {
+    std::lock_guard<std::mutex> lock(state_mutex);
+    if (!running.load(std::memory_order_acquire)) return;
+
+    // Wakeup the mainloop, 在修改 running 之前唤醒，保证 mgr 此时还未被释放
+    auto id = wakeup_id.load();
+    if (mgr && id) mg_wakeup(this->mgr, id, nullptr, 0);
+
+    running.store(false, std::memory_order_release);
+
+    // Stop Mongoose event loop thread
+    if (mongoose_thread.joinable()) mongoose_thread.join();
+
+    cv.notify_all();
+    if (task_thread.joinable()) task_thread.join();
+
+    std::lock_guard<std::mutex> msg_lock(msg_q_mutex);
+    while (!msg_q.empty()) msg_q.pop();
+
+    brls::Logger::info("(LiveDanmaku) event loop stopped");
+}
+
+void LiveDanmakuManager::run_command(std::function<void()> func) {
+    {
+        std::lock_guard<std::mutex> lock(command_mutex);
+        commands.emplace_back(std::move(func));
+    }
+
+    // 唤醒事件循环立即执行，不必等到 mg_mgr_poll 超时；持有 state_mutex 保证 mgr 此时不会被释放
+    std::lock_guard<std::mutex> lock(state_mutex);
+    auto id = wakeup_id.load();
+    if (running.load(std::memory_order_acquire) && mgr && id) mg_wakeup(this->mgr, id, nullptr, 0);
+}
+
+void LiveDanmakuManager::probe_hosts(LiveDanmakuRoom *room) {
+    auto &hosts = room->info.host_list;
+    room->host_order.clear();
+    room->host_index = 0;
+
+    // 只有一个服务器时不需要测速
+    if (hosts.size() <= 1) {
+        room->host_order.emplace_back(0);
+        open_room(room);
         return;
     }
 
-    // Stop Mongoose event loop thread
-    connected.store(false, std::memory_order_release);
+    // 并发建立 TCP 连接，以连接建立的耗时作为服务器的延迟
+    room->probing        = true;
+    room->probe_deadline = mg_millis() + PROBE_TIMEOUT;
+    room->probes         = std::vector<LiveDanmakuProbe>(hosts.size());
+    for (size_t i = 0; i < hosts.size(); i++) {
+        auto &probe     = room->probes[i];
+        probe.room      = room;
+        probe.index     = i;
+        probe.latency   = mg_millis();
+        std::string url = "tcp://" + hosts[i].host + ":" + std::to_string(hosts[i].ws_port);
+        probe.nc        = mg_connect(this->mgr, url.c_str(), probe_handler, &probe);
+        if (probe.nc == nullptr) {
+            probe.done    = true;
+            probe.latency = UINT64_MAX;
+        } else {
+            wakeup_id = probe.nc->id;
+        }
+    }
+}
 
-    // Wakeup the mainloop
-    if (mgr && nc) mg_wakeup(this->mgr, this->nc->id, nullptr, 0);
+void LiveDanmakuManager::finish_probe(LiveDanmakuRoom *room) {
+    if (!room->probing) return;
+    room->probing = false;
 
-    // Stop Mongoose event loop thread
-    if (mongoose_thread.joinable()) {
-        mongoose_thread.join();
+    for (auto &probe : room->probes) {
+        if (probe.nc) {
+            probe.nc->fn_data    = nullptr;
+            probe.nc->is_closing = 1;
+            probe.nc             = nullptr;
+        }
+        if (!probe.done) probe.latency = UINT64_MAX;
     }
 
-    cv.notify_one();
+    // 按延迟排序，未能连接的服务器放在最后
+    room->host_order.resize(room->probes.size());
+    for (size_t i = 0; i < room->host_order.size(); i++) room->host_order[i] = i;
+    std::stable_sort(room->host_order.begin(), room->host_order.end(), [room](size_t a, size_t b) {
+        return room->probes[a].latency < room->probes[b].latency;
+    });
+    for (auto &i : room->host_order) {
+        auto &probe = room->probes[i];
+        brls::Logger::info("(LiveDanmaku) host {}: {}", room->info.host_list[i].host,
+                           probe.latency == UINT64_MAX ? "timeout" : std::to_string(probe.latency) + "ms");
+    }
+    room->probes.clear();
+    room->host_index = 0;
+    open_room(room);
+}
+
+void LiveDanmakuManager::open_room(LiveDanmakuRoom *room) {
+    auto &host      = room->current_host();
+    std::string url = "ws://" + host.host + ":" + std::to_string(host.ws_port) + "/sub";
+    brls::Logger::info("(LiveDanmaku) connect room {}: {}", room->room_id, url);
 
-    if (task_thread.joinable()) {
-        task_thread.join();
+    room->ws_open = false;
+    room->nc      = mg_ws_connect(this->mgr, url.c_str(), event_handler, room, nullptr);
+    if (room->nc == nullptr) {
+        brls::Logger::error("(LiveDanmaku) nc is null");
+        on_room_closed(room);
+        return;
     }
-    brls::Logger::info("(LiveDanmaku) close step finish");
+    wakeup_id = room->nc->id;
 }
 
-void LiveDanmaku::set_wait_time(size_t time) { wait_time = time; }
+void LiveDanmakuManager::close_room(LiveDanmakuRoom *room) {
+    for (auto &probe : room->probes) {
+        if (!probe.nc) continue;
+        probe.nc->fn_data    = nullptr;
+        probe.nc->is_closing = 1;
+        probe.nc             = nullptr;
+    }
+    room->probes.clear();
+    room->probing = false;
 
-bool LiveDanmaku::is_connected() { return connected.load(std::memory_order_acquire); }
+    if (room->heartbeat) {
+        mg_timer_free(&mgr->timers, room->heartbeat);
+        free(room->heartbeat);
+        room->heartbeat = nullptr;
+    }
+    if (room->nc) {
+        // 断开与 room 的关联，之后此连接上的事件都会被忽略
+        room->nc->fn_data    = nullptr;
+        room->nc->is_closing = 1;
+        room->nc             = nullptr;
+    }
+    room->ws_open      = false;
+    room->reconnect_at = 0;
+}
 
-bool LiveDanmaku::is_evOK() { return ms_ev_ok.load(std::memory_order_acquire); }
+void LiveDanmakuManager::on_room_closed(LiveDanmakuRoom *room) {
+    if (room->heartbeat) {
+        mg_timer_free(&mgr->timers, room->heartbeat);
+        free(room->heartbeat);
+        room->heartbeat = nullptr;
+    }
+    if (room->ws_open) {
+        // 弹幕从这里开始中断
+        room->gap_start = mg_millis();
+        notify_status(room, false, 0);
+    }
+    room->nc      = nullptr;
+    room->ws_open = false;
+
+    // 依次切换到下一个服务器，所有服务器都尝试过一遍后再按指数退避等待
+    size_t hosts     = std::max<size_t>(room->host_order.size(), 1);
+    room->host_index = (room->host_index + 1) % hosts;
+    uint64_t delay   = 0;
+    if (room->retry >= hosts) {
+        // 1s, 2s, 4s ... 最长 MAX_RECONNECT_DELAY
+        delay = std::min<uint64_t>(1000ULL << std::min<size_t>(room->retry - hosts, 16), MAX_RECONNECT_DELAY);
+    }
+    room->retry++;
+    room->reconnect_at = mg_millis() + delay;
+    brls::Logger::warning("(LiveDanmaku) room {} reconnect to {} in {}ms", room->room_id, room->current_host().host,
+                          delay);
+}
 
-void LiveDanmaku::send_join_request(const int room_id, const uint64_t uid) {
-    json join_request            = {{"uid", uid},
-                                    {"roomid", room_id},
-                                    {"protover", 2},
-                                    {"buvid", ProgramConfig::instance().getBuvid3()},
-                                    {"platform", "web"},
-                                    {"type", 2},
-                                    {"key", this->info.token}};
-    std::string join_request_str = join_request.dump();
-    brls::Logger::info("(LiveDanmaku) join_request:{}", join_request_str);
-    std::vector<uint8_t> packet = encode_packet(0, 7, join_request_str);
-    std::string packet_str(packet.begin(), packet.end());
-    mongoose_mutex.lock();
-    if (this->nc == nullptr) return;
-    mg_ws_send(this->nc, packet_str.data(), packet_str.size(), WEBSOCKET_OP_BINARY);
-    mongoose_mutex.unlock();
+void LiveDanmakuManager::check_rooms() {
+    uint64_t now = mg_millis();
+    for (auto &item : rooms) {
+        auto *room = item.second.get();
+
+        // 测速超时，直接使用已有的测速结果
+        if (room->probing && now >= room->probe_deadline) finish_probe(room);
+
+        // 长时间没有收到数据 (包括心跳回复)，主动断开连接以切换服务器
+        if (room->nc && room->ws_open && now - room->last_recv > HEARTBEAT_TIMEOUT) {
+            brls::Logger::warning("(LiveDanmaku) room {} heartbeat timeout", room->room_id);
+            room->nc->is_closing = 1;
+        }
+
+        if (room->reconnect_at == 0 || room->reconnect_at > now) continue;
+        room->reconnect_at = 0;
+        open_room(room);
+    }
 }
 
-void LiveDanmaku::send_heartbeat() {
-    brls::Logger::debug("(LiveDanmaku) send_heartbeat");
-    std::vector<uint8_t> packet = encode_packet(0, 2, "");
-    std::string packet_str(packet.begin(), packet.end());
-    mongoose_mutex.lock();
-    if (this->nc == nullptr) return;
-    mg_ws_send(this->nc, packet_str.data(), packet_str.size(), WEBSOCKET_OP_BINARY);
-    mongoose_mutex.unlock();
+void LiveDanmakuManager::notify_status(LiveDanmakuRoom *room, bool connected, uint64_t gap) {
+    on_status_func_t func;
+    {
+        std::lock_guard<std::mutex> lock(sink_mutex);
+        auto it = sinks.find(room->id);
+        if (it != sinks.end()) func = it->second.on_status;
+    }
+    // 在锁外调用，避免回调耗时阻塞消息分发，或在回调中再次访问 sinks 时死锁
+    if (func) func(connected, gap);
 }
 
-void LiveDanmaku::send_text_message(const std::string &message) {
-    //暂时不用
+void LiveDanmakuManager::add_msg(size_t id, std::string &&msg) {
+    std::lock_guard<std::mutex> lock(msg_q_mutex);
+    msg_q.emplace(id, std::move(msg));
+    cv.notify_one();
+}
+
+void LiveDanmakuManager::heartbeat_timer(void *param) { static_cast<LiveDanmakuRoom *>(param)->send_heartbeat(); }
+
+void LiveDanmakuManager::probe_handler(struct mg_connection *nc, int ev, void *ev_data) {
+    auto *probe = static_cast<LiveDanmakuProbe *>(nc->fn_data);
+    if (probe == nullptr) return;
+    if (ev == MG_EV_CONNECT) {
+        probe->latency = mg_millis() - probe->latency;
+    } else if (ev == MG_EV_ERROR || ev == MG_EV_CLOSE) {
+        probe->latency = UINT64_MAX;
+    } else {
+        return;
+    }
+    probe->done    = true;
+    probe->nc      = nullptr;
+    nc->fn_data    = nullptr;
+    nc->is_closing = 1;
+
+    // 所有服务器都已完成测速
+    auto *room = probe->room;
+    for (auto &i : room->probes)
+        if (!i.done) return;
+    LiveDanmakuManager::instance().finish_probe(room);
 }
 
-static void mongoose_event_handler(struct mg_connection *nc, int ev, void *ev_data) {
-    auto *liveDanmaku = static_cast<LiveDanmaku *>(nc->fn_data);
-    liveDanmaku->ms_ev_ok.store(true, std::memory_order_release);
+void LiveDanmakuManager::event_handler(struct mg_connection *nc, int ev, void *ev_data) {
+    auto *room = static_cast<LiveDanmakuRoom *>(nc->fn_data);
+    if (room == nullptr) return;
+    auto &manager = LiveDanmakuManager::instance();
     if (ev == MG_EV_OPEN) {
         MG_DEBUG(("%p %s", nc->fd, (char *)ev_data));
 #ifdef MONGOOSE_HEX_DUMPS
@@ -186,19 +411,71 @@ static void mongoose_event_handler(struct mg_connection *nc, int ev, void *ev_da
 #endif
     } else if (ev == MG_EV_ERROR) {
         MG_ERROR(("%p %s", nc->fd, (char *)ev_data));
-        liveDanmaku->ms_ev_ok.store(false, std::memory_order_release);
     } else if (ev == MG_EV_WS_OPEN) {
         MG_DEBUG(("%p %s", nc->fd, (char *)ev_data));
-        liveDanmaku->send_join_request(liveDanmaku->room_id, liveDanmaku->uid);
-        mg_timer_add(liveDanmaku->mgr, 30000, MG_TIMER_REPEAT, heartbeat_timer, nc->fn_data);
+        room->ws_open   = true;
+        room->last_recv = mg_millis();
+        room->send_join_request();
+        if (room->heartbeat == nullptr)
+            room->heartbeat =
+                mg_timer_add(manager.mgr, HEARTBEAT_INTERVAL, MG_TIMER_REPEAT, heartbeat_timer, (void *)room);
+
+        uint64_t gap    = room->gap_start ? room->last_recv - room->gap_start : 0;
+        room->gap_start = 0;
+        manager.notify_status(room, true, gap);
     } else if (ev == MG_EV_WS_MSG) {
         MG_DEBUG(("%p %s", nc->fd, (char *)ev_data));
+        // 收到数据后才认为当前服务器可用
+        room->retry              = 0;
+        room->last_recv          = mg_millis();
         struct mg_ws_message *wm = (struct mg_ws_message *)ev_data;
-        add_msg(std::string(wm->data.buf, wm->data.len));
+        manager.add_msg(room->id, std::string(wm->data.buf, wm->data.len));
     } else if (ev == MG_EV_CLOSE) {
         MG_DEBUG(("%p %s", nc->fd, (char *)ev_data));
-        liveDanmaku->ms_ev_ok.store(false, std::memory_order_release);
+        // 连接意外断开，切换服务器重连
+        manager.on_room_closed(room);
+    }
+}
+
+/// LiveDanmaku
+
+LiveDanmaku::LiveDanmaku() {}
+
+LiveDanmaku::~LiveDanmaku() { disconnect(); }
+
+void LiveDanmaku::connect(int room_id, uint64_t uid, const bilibili::LiveDanmakuinfo &info) {
+    if (connected.load(std::memory_order_acquire)) {
+        return;
+    }
+
+    this->info    = info;
+    this->room_id = room_id;
+    this->uid     = uid;
+    this->conn_id = LiveDanmakuManager::instance().add_room(room_id, uid, info, this->onMessage, this->onStatus);
+    connected.store(this->conn_id != 0, std::memory_order_release);
+
+    brls::Logger::info("(LiveDanmaku) connect step finish");
+}
+
+void LiveDanmaku::disconnect() {
+    if (!connected.load(std::memory_order_acquire)) {
+        return;
     }
+    connected.store(false, std::memory_order_release);
+
+    LiveDanmakuManager::instance().remove_room(this->conn_id);
+    this->conn_id = 0;
+    brls::Logger::info("(LiveDanmaku) close step finish");
 }
 
-void LiveDanmaku::setonMessage(on_message_func_t func) { onMessage = func; }
\ No newline at end of file
+void LiveDanmaku::set_wait_time(size_t time) { LiveDanmakuManager::instance().set_wait_time(time); }
+
+bool LiveDanmaku::is_connected() { return connected.load(std::memory_order_acquire); }
+
+void LiveDanmaku::send_text_message(const std::string &message) {
+    //暂时不用
+}
+
+void LiveDanmaku::setonMessage(on_message_func_t func) { onMessage = func; }
+
+void LiveDanmaku::setonStatus(on_status_func_t func) { onStatus = func; }
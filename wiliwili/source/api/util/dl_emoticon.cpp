@@ -3,80 +3,268 @@
 //
 
 #include <nlohmann/json.hpp>
-#include <curl/curl.h>
+#include <cpr/cpr.h>
+#include <cpr/filesystem.h>
+#include <borealis/core/logger.hpp>
+#include <stb_image.h>
 
+#ifdef USE_WEBP
+#include <webp/decode.h>
+#endif
+
+#include <algorithm>
+#include <atomic>
 #include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <mutex>
 #include <string>
+#include <thread>
 #include <vector>
 
 #include "live/dl_emoticon.hpp"
+#include "bilibili/util/http.hpp"
+#include "utils/config_helper.hpp"
+#include "utils/image_helper.hpp"
+
+const std::string EMOTICON_LIST_URL = "https://api.live.bilibili.com/xlive/web-ucenter/v2/emoticon/GetEmoticons";
+
+class EmoticonInfo {
+public:
+    std::string name;
+    std::string url;
+};
+
+class DecodedEmoticon {
+public:
+    int width  = 0;
+    int height = 0;
+    std::vector<uint8_t> pixels;
+};
+
+/// 一次表情下载任务，每张图片由一个网络线程单独处理
+class EmoticonTask {
+public:
+    std::vector<EmoticonInfo> list;
+    std::vector<std::vector<uint8_t>> data;
+    std::vector<DecodedEmoticon> images;
+    // 是否在下载后解码，解码后不再保留原始数据
+    bool decode = false;
+    std::atomic<size_t> remaining{0};
+    // 所有图片处理完成后调用
+    std::function<void(EmoticonTask &)> on_done;
+};
 
-static size_t write_callback(void *contents, size_t size, size_t nmemb, void *userp) {
-    ((std::vector<char> *)userp)
-        ->insert(((std::vector<char> *)userp)->end(), (char *)contents, (char *)contents + size * nmemb);
-    return size * nmemb;
+static std::string get_cache_dir() { return ProgramConfig::instance().getConfigDir() + "/emoticon"; }
+
+static std::string get_cache_path(const std::string &url) {
+    return get_cache_dir() + "/" + websocketpp::md5::md5_hash_hex(url);
+}
+
+static bool read_cache(const std::string &url, std::vector<uint8_t> &data) {
+    std::ifstream file(get_cache_path(url), std::ios::binary);
+    if (!file) return false;
+    data.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    return !data.empty();
 }
 
-static void download(const std::string &url, std::vector<uint8_t> &data) {
-    CURL *curl = curl_easy_init();
-    curl_easy_setopt(curl, CURLOPT_URL, url.c_str());
-    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, write_callback);
-    curl_easy_setopt(curl, CURLOPT_WRITEDATA, &data);
-    curl_easy_perform(curl);
+static void write_cache(const std::string &url, const std::string &data) {
+    static std::once_flag flag;
+    std::call_once(flag, []() {
+        std::error_code ec;
+        cpr::fs::create_directories(get_cache_dir(), ec);
+    });
+
+    // 先写入临时文件再重命名，避免多个直播间同时写入同一个缓存
+    auto path = get_cache_path(url);
+    auto tmp  = path + "." + std::to_string(std::hash<std::thread::id>{}(std::this_thread::get_id()));
+    std::ofstream file(tmp, std::ios::binary);
+    if (!file) return;
+    file.write(data.data(), (std::streamsize)data.size());
+    file.close();
 
-    curl_easy_cleanup(curl);
+    std::error_code ec;
+    cpr::fs::rename(tmp, path, ec);
+    if (ec) cpr::fs::remove(tmp, ec);
 }
 
-static void to_url(int room_id, std::vector<std::string> &names, std::vector<std::string> &urls) {
-    std::string u = "https://api.live.bilibili.com/xlive/web-ucenter/v2/emoticon/GetEmoticons?platform=pc&room_id=";
-    std::vector<uint8_t> data;
-    download(u + std::to_string(room_id), data);
+/// 优先从磁盘缓存中读取表情，没有缓存时下载
+static bool fetch_emoticon(const std::string &url, std::vector<uint8_t> &data) {
+    if (read_cache(url, data)) return true;
 
-    nlohmann::json _json = nlohmann::json::parse(std::string{data.begin(), data.end()});
+    cpr::Response r = cpr::Get(cpr::Url{url}, cpr::Timeout{bilibili::HTTP::TIMEOUT}, bilibili::HTTP::HEADERS,
+                               bilibili::HTTP::COOKIES, bilibili::HTTP::VERIFY, bilibili::HTTP::PROXIES);
+    if (r.error || r.status_code != 200 || r.text.empty()) {
+        brls::Logger::warning("dl_emoticon: failed to download {} ({})", url, r.status_code);
+        return false;
+    }
+    write_cache(url, r.text);
+    data.assign(r.text.begin(), r.text.end());
+    return true;
+}
 
-    auto it = _json["data"]["data"];
+static bool decode_emoticon(const std::vector<uint8_t> &data, DecodedEmoticon &image) {
+    if (data.empty()) return false;
+    uint8_t *pixels = nullptr;
+
+#ifdef USE_WEBP
+    bool isWebp = data.size() > 12 && memcmp(data.data(), "RIFF", 4) == 0 && memcmp(data.data() + 8, "WEBP", 4) == 0;
+    if (isWebp) {
+        pixels = WebPDecodeRGBA(data.data(), data.size(), &image.width, &image.height);
+    } else {
+#endif
+        int n;
+        pixels = stbi_load_from_memory(data.data(), (int)data.size(), &image.width, &image.height, &n, 4);
+#ifdef USE_WEBP
+    }
+#endif
 
-    if (it.is_array()) {
-        int n = it.size();
+    if (!pixels) {
+        image.width = image.height = 0;
+        return false;
+    }
+    image.pixels.assign(pixels, pixels + (size_t)image.width * image.height * 4);
 
-        for (int i = 0; i < n; ++i) {
-            if (!it.is_array()) break;
+#ifdef USE_WEBP
+    if (isWebp)
+        WebPFree(pixels);
+    else
+#endif
+        stbi_image_free(pixels);
+    return true;
+}
 
-            int e_n   = it[i].size();
-            auto e_it = it[i]["emoticons"];
+/// 请求缩小后的表情，减少下载与解码的时间
+static std::string get_emoticon_url(const std::string &url) {
+    if (url.find("hdslb.com") == std::string::npos || url.find('@') != std::string::npos) return url;
+    return url + ImageHelper::emoji_size2_ext;
+}
 
-            if (!e_it.is_array()) break;
+static cpr::Parameters get_list_parameters(int room_id) {
+    return cpr::Parameters{{"platform", "pc"}, {"room_id", std::to_string(room_id)}};
+}
 
-            for (int j = 0; j < e_n; ++j) {
-                auto em_name = e_it[i]["emoji"];
+static std::vector<EmoticonInfo> parse_emoticon_list(const std::string &text) {
+    std::vector<EmoticonInfo> list;
+    try {
+        nlohmann::json _json = nlohmann::json::parse(text);
 
-                if (!em_name.is_string()) break;
+        auto &packs = _json.at("data").at("data");
+        if (!packs.is_array()) return list;
 
-                auto em_url = e_it[j]["url"];
+        for (auto &pack : packs) {
+            auto e_it = pack.find("emoticons");
+            if (e_it == pack.end() || !e_it->is_array()) continue;
 
-                if (!em_url.is_string()) break;
+            for (auto &emoticon : *e_it) {
+                auto em_name = emoticon.find("emoji");
+                auto em_url  = emoticon.find("url");
+                if (em_name == emoticon.end() || !em_name->is_string()) continue;
+                if (em_url == emoticon.end() || !em_url->is_string()) continue;
 
-                names.emplace_back(em_name.get_ref<const std::string &>());
-                urls.emplace_back(em_url.get_ref<const std::string &>());
+                auto url = get_emoticon_url(em_url->get<std::string>());
+                list.emplace_back(EmoticonInfo{em_name->get<std::string>(), url});
             }
         }
+    } catch (const std::exception &e) {
+        brls::Logger::error("dl_emoticon: {}", e.what());
     }
+    return list;
 }
 
-lmp dl_emoticon(int room_id) {
-    lmp ret;
+static void run_task(const std::shared_ptr<EmoticonTask> &task) {
+    size_t n = task->list.size();
+    if (n == 0) {
+        task->on_done(*task);
+        return;
+    }
+
+    task->data.resize(n);
+    if (task->decode) task->images.resize(n);
+    task->remaining = n;
+
+    // 使用全局的网络线程池并发下载
+    for (size_t i = 0; i < n; ++i) {
+        cpr::async([task, i]() {
+            auto &data = task->data[i];
+            fetch_emoticon(task->list[i].url, data);
+            if (task->decode) {
+                decode_emoticon(data, task->images[i]);
+                data.clear();
+                data.shrink_to_fit();
+            }
+            if (task->remaining.fetch_sub(1) == 1) task->on_done(*task);
+        });
+    }
+}
 
-    std::vector<std::string> names;
-    std::vector<std::string> urls;
+/// 按高度从大到小逐行排列表情，生成一张图集
+static std::shared_ptr<LiveEmoticonAtlas> pack_atlas(EmoticonTask &task) {
+    auto atlas = std::make_shared<LiveEmoticonAtlas>();
+
+    std::vector<size_t> order;
+    for (size_t i = 0; i < task.images.size(); ++i) {
+        if (task.images[i].width > 0 && task.images[i].width <= EMOTICON_ATLAS_SIZE) order.emplace_back(i);
+    }
+    std::stable_sort(order.begin(), order.end(),
+                     [&task](size_t a, size_t b) { return task.images[a].height > task.images[b].height; });
 
-    to_url(room_id, names, urls);
+    // 表情之间保留 1px 的间隔，避免缩放时采样到相邻的表情
+    std::vector<std::pair<size_t, LiveEmoticonRect>> placed;
+    int x = 0, y = 0, row = 0;
+    for (auto i : order) {
+        auto &name  = task.list[i].name;
+        auto &image = task.images[i];
+        // 同名表情只放入第一张
+        if (atlas->items.count(name)) continue;
+        if (x + image.width > EMOTICON_ATLAS_SIZE) {
+            x = 0;
+            y += row;
+            row = 0;
+        }
+        if (y + image.height > EMOTICON_ATLAS_SIZE) {
+            brls::Logger::warning("dl_emoticon: atlas is full, {} emoticons left", order.size() - atlas->items.size());
+            break;
+        }
+        atlas->items[name] = LiveEmoticonRect{x, y, image.width, image.height};
+        placed.emplace_back(i, atlas->items[name]);
+        x += image.width + 1;
+        row           = std::max(row, image.height + 1);
+        atlas->width  = std::max(atlas->width, x);
+        atlas->height = std::max(atlas->height, y + row);
+    }
 
-    int n = names.size();
-    for (int i = 0; i < n; ++i) {
-        std::vector<uint8_t> data;
-        download(urls[i], data);
-        ret[names[i]] = std::move(data);
+    atlas->pixels.assign((size_t)atlas->width * atlas->height * 4, 0);
+    for (auto &[i, rect] : placed) {
+        auto &image = task.images[i];
+        for (int line = 0; line < rect.h; ++line) {
+            memcpy(atlas->pixels.data() + ((size_t)(rect.y + line) * atlas->width + rect.x) * 4,
+                   image.pixels.data() + (size_t)line * rect.w * 4, (size_t)rect.w * 4);
+        }
     }
 
-    return ret;
+    return atlas;
+}
+
+void dl_emoticon(int room_id, const on_emoticon_func_t &callback) {
+    cpr::GetCallback(
+        [callback, room_id](const cpr::Response &r) {
+            if (r.error || r.status_code != 200) {
+                brls::Logger::error("dl_emoticon: failed to get emoticon list of room {}", room_id);
+                if (callback) callback(nullptr);
+                return;
+            }
+
+            auto task     = std::make_shared<EmoticonTask>();
+            task->list    = parse_emoticon_list(r.text);
+            task->decode  = true;
+            task->on_done = [callback](EmoticonTask &t) {
+                auto atlas = pack_atlas(t);
+                brls::Logger::debug("dl_emoticon: {} emoticons, atlas {}x{}", atlas->items.size(), atlas->width,
+                                    atlas->height);
+                if (callback) callback(atlas);
+            };
+            run_task(task);
+        },
+        cpr::Url{EMOTICON_LIST_URL}, get_list_parameters(room_id), CPR_HTTP_BASE);
 }
@@ -288,6 +288,12 @@ void BilibiliClient::get_highlight_progress(uint64_t cid,
         cpr::Url{Api::VideoHighlight}, cpr::Parameters({{"cid", std::to_string(cid)}}), CPR_HTTP_BASE);
 }
 
+void BilibiliClient::get_video_shot(const std::string& bvid, uint64_t cid,
+                                    const std::function<void(VideoShotResult)>& callback, const ErrorCallback& error) {
+    HTTP::getResultAsync<VideoShotResult>(
+        Api::VideoShot, {{"bvid", bvid}, {"cid", std::to_string(cid)}, {"index", "1"}}, callback, error);
+}
+
 void BilibiliClient::get_subtitle(const std::string& link, const std::function<void(SubtitleData)>& callback,
                                   const ErrorCallback& error) {
     std::string url = link;
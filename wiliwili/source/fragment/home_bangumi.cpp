@@ -110,4 +110,6 @@ HomeBangumi::~HomeBangumi() { brls::Logger::debug("Fragment HomeBangumiActivity:
 
 brls::View* HomeBangumi::create() { return new HomeBangumi(); }
 
+bool HomeBangumi::isReleasable() { return !this->requesting; }
+
 void HomeBangumi::onError(const std::string& error) {}
\ No newline at end of file
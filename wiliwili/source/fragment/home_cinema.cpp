@@ -27,6 +27,8 @@ HomeCinema::~HomeCinema() { brls::Logger::debug("Fragment HomeCinemaActivity: de
 
 brls::View* HomeCinema::create() { return new HomeCinema(); }
 
+bool HomeCinema::isReleasable() { return !this->requesting; }
+
 void HomeCinema::onCreate() {
     this->registerTabAction("wiliwili/home/common/refresh"_i18n, brls::ControllerButton::BUTTON_X,
                             [this](brls::View* view) -> bool {
@@ -62,6 +62,8 @@ public:
 
     size_t getItemCount() override { return recommendList.size(); }
 
+    const bilibili::RecommendVideoListResult& getRecommendList() const { return recommendList; }
+
     void onItemSelected(RecyclingGrid* recycler, size_t index) override {
         if (recommendList[index].business_info.is_ad) {
             if (recommendList[index].business_info.is_ad_video) {
@@ -108,6 +110,14 @@ private:
     bilibili::RecommendVideoListResult recommendList;
 };
 
+/// 标签页被释放时保存的推荐列表与浏览位置
+class HomeRecommendsState : public AttachedViewState {
+public:
+    bilibili::RecommendVideoListResult recommendList;
+    int requestPage   = 1;
+    size_t focusIndex = 0;
+};
+
 /// HomeRecommends
 
 HomeRecommends::HomeRecommends() {
@@ -120,10 +130,11 @@ HomeRecommends::HomeRecommends() {
         this->recyclingGrid->showSkeleton();
         this->requestData(true);
     });
-    this->requestData();
 }
 
 void HomeRecommends::onCreate() {
+    if (!restored) this->requestData();
+
     this->registerTabAction("wiliwili/home/common/refresh"_i18n, brls::ControllerButton::BUTTON_X,
                             [this](brls::View* view) -> bool {
                                 this->recyclingGrid->refresh();
@@ -158,6 +169,7 @@ void HomeRecommends::onRecommendVideoList(const bilibili::RecommendVideoListResu
             }
         } else {
             brls::Logger::verbose("refresh home recommends: first page");
+            recyclingGrid->setDefaultCellFocus(0);
             recyclingGrid->setDataSource(new DataSourceRecommendVideoList(result.item));
         }
     });
@@ -167,6 +179,28 @@ brls::View* HomeRecommends::create() { return new HomeRecommends(); }
 
 HomeRecommends::~HomeRecommends() = default;
 
+bool HomeRecommends::isReleasable() { return !this->requesting; }
+
+std::shared_ptr<AttachedViewState> HomeRecommends::onSaveState() {
+    auto* datasource = dynamic_cast<DataSourceRecommendVideoList*>(recyclingGrid->getDataSource());
+    if (!datasource || datasource->getItemCount() == 0) return nullptr;
+    auto state           = std::make_shared<HomeRecommendsState>();
+    state->recommendList = datasource->getRecommendList();
+    state->requestPage   = this->requestPage;
+    auto* cell           = dynamic_cast<RecyclingGridItem*>(recyclingGrid->getDefaultFocus());
+    if (cell) state->focusIndex = cell->getIndex();
+    return state;
+}
+
+void HomeRecommends::onRestoreState(const std::shared_ptr<AttachedViewState>& value) {
+    auto state = std::dynamic_pointer_cast<HomeRecommendsState>(value);
+    if (!state) return;
+    this->restored    = true;
+    this->requestPage = state->requestPage;
+    recyclingGrid->setDefaultCellFocus(state->focusIndex);
+    recyclingGrid->setDataSource(new DataSourceRecommendVideoList(state->recommendList));
+}
+
 void HomeRecommends::onError(const std::string& error) {
     brls::sync([this, error]() { this->recyclingGrid->setError(error); });
 }
\ No newline at end of file
@@ -6,6 +6,7 @@
 
 #include "activity/search_activity_tv.hpp"
 #include "fragment/home_tab.hpp"
+#include "fragment/home_recommends.hpp"
 #include "view/custom_button.hpp"
 #include "utils/activity_helper.hpp"
 
@@ -13,6 +14,8 @@ using namespace brls::literals;
 
 HomeTab::HomeTab() {
     this->inflateFromXMLRes("xml/fragment/home_tab.xml");
+    // 默认标签页不是推荐时，启动阶段预取的推荐不会被用到
+    if (!dynamic_cast<HomeRecommends*>(this->tabFrame->getActiveTab())) Home::cancelPrefetch();
     brls::Logger::debug("Fragment HomeTab: create");
 }
 
@@ -7,12 +7,13 @@
 #include "utils/image_helper.hpp"
 #include "utils/activity_helper.hpp"
 #include "utils/string_helper.hpp"
+#include "utils/template_helper.hpp"
 
 using namespace brls::literals;
 
 class FeedCard : public RecyclingGridItem {
 public:
-    FeedCard() { this->inflateFromXMLRes("xml/views/feed_card.xml"); }
+    FeedCard() { TemplateHelper::inflate(this, "xml/views/feed_card.xml"); }
 
     void setItem(const bilibili::MsgFeedItem& item) {
         this->textBox->setText(item.source_content);
@@ -9,12 +9,13 @@
 #include "view/user_info.hpp"
 #include "utils/image_helper.hpp"
 #include "utils/number_helper.hpp"
+#include "utils/template_helper.hpp"
 
 using namespace brls::literals;
 
 class ChatUserCard : public RecyclingGridItem {
 public:
-    ChatUserCard() { this->inflateFromXMLRes("xml/views/inbox_user.xml"); }
+    ChatUserCard() { TemplateHelper::inflate(this, "xml/views/inbox_user.xml"); }
 
     void setCard(const bilibili::InboxChatResult& r) {
         std::string misc;
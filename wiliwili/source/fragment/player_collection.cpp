@@ -10,6 +10,7 @@
 #include "utils/config_helper.hpp"
 #include "view/recycling_grid.hpp"
 #include "view/check_box.hpp"
+#include "utils/template_helper.hpp"
 #include <pystring.h>
 
 using namespace brls::literals;
@@ -21,7 +22,7 @@ typedef struct CollectionListRequest {
 
 class CollectionListCell : public RecyclingGridItem {
 public:
-    CollectionListCell() { this->inflateFromXMLRes("xml/views/collection_list_cell.xml"); }
+    CollectionListCell() { TemplateHelper::inflate(this, "xml/views/collection_list_cell.xml"); }
 
     void setSelected(bool selected) { this->checkbox->setChecked(selected); }
 
@@ -7,6 +7,7 @@
 
 #include "fragment/player_danmaku_setting.hpp"
 #include "view/danmaku_core.hpp"
+#include "view/live_core.hpp"
 #include "view/button_close.hpp"
 #include "view/selector_cell.hpp"
 #include "utils/config_helper.hpp"
@@ -79,6 +80,13 @@ PlayerDanmakuSetting::PlayerDanmakuSetting() {
                                  DanmakuCore::instance().refresh();
                                  return true;
                              });
+    // 合并是在加载弹幕时预先处理的，修改后从下一次加载弹幕开始生效
+    this->cellMerge->init("wiliwili/player/danmaku/filter/merge"_i18n, DanmakuCore::DANMAKU_FILTER_MERGE,
+                          [](bool data) {
+                              DanmakuCore::DANMAKU_FILTER_MERGE = data;
+                              DanmakuCore::save();
+                              return true;
+                          });
 
     std::vector<std::string> levels;
     for (size_t i = 1; i <= 10; i++)
@@ -161,6 +169,14 @@ PlayerDanmakuSetting::PlayerDanmakuSetting() {
                                    DanmakuCore::DANMAKU_RENDER_QUALITY = perf.rawOptionList[data];
                                    DanmakuCore::save();
                                });
+
+    // 从下一次进入直播间开始生效
+    this->cellLiveRecord->init("wiliwili/player/danmaku/live/record"_i18n, LiveDanmakuCore::DANMAKU_RECORD,
+                               [](bool data) {
+                                   LiveDanmakuCore::DANMAKU_RECORD = data;
+                                   ProgramConfig::instance().setSettingItem(SettingItem::DANMAKU_LIVE_RECORD, data);
+                                   return true;
+                               });
 }
 
 PlayerDanmakuSetting::~PlayerDanmakuSetting() { brls::Logger::debug("Fragment PlayerDanmakuSetting: delete"); }
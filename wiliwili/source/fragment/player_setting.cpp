@@ -12,6 +12,7 @@
 #include "utils/shader_helper.hpp"
 #include "utils/number_helper.hpp"
 #include "utils/activity_helper.hpp"
+#include "utils/abr_helper.hpp"
 #include "activity/player_activity.hpp"
 #include "fragment/player_setting.hpp"
 #include "view/danmaku_core.hpp"
@@ -150,6 +151,14 @@ void PlayerSetting::setupCommonSetting() {
                       GA("player_setting", {{"skip", value ? "true" : "false"}});
                   });
 
+    /// Adaptive quality
+    btnAdaptiveQuality->init("wiliwili/player/setting/common/adaptive_quality"_i18n,
+                             conf.getBoolOption(SettingItem::PLAYER_ADAPTIVE_QUALITY), [](bool value) {
+                                 ProgramConfig::instance().setSettingItem(SettingItem::PLAYER_ADAPTIVE_QUALITY, value);
+                                 AbrHelper::ENABLE = value;
+                                 GA("player_setting", {{"adaptive_quality", value ? "true" : "false"}});
+                             });
+
     /// player strategy
     int strategyIndex = conf.getIntOption(SettingItem::PLAYER_STRATEGY);
     // 中文比较简洁可以显示出来，其他语言翻译过长，在这里就先不展示了
@@ -16,13 +16,26 @@
 
 #include "utils/config_helper.hpp"
 #include "utils/activity_helper.hpp"
+#include "utils/download_manager.hpp"
+#include "utils/media_cache.hpp"
 #include "view/mpv_core.hpp"
+#include "utils/local_server.hpp"
+#include "utils/benchmark_helper.hpp"
+#include "utils/frame_scheduler.hpp"
+#include "utils/startup_tracer.hpp"
+#include "presenter/home_recommends.hpp"
 
 #ifdef IOS
 #include <SDL2/SDL_main.h>
 #endif
 
 int main(int argc, char* argv[]) {
+    // 以此作为冷启动的起点
+    StartupTracer::instance();
+
+#ifdef LOCAL_TEST_SERVER
+    std::string serverRoot, benchmarkBvid;
+#endif
     for (int i = 1; i < argc; i++) {
         if (std::strcmp(argv[i], "-d") == 0) {
             brls::Logger::setLogLevel(brls::LogLevel::LOG_DEBUG);
@@ -33,32 +46,74 @@ int main(int argc, char* argv[]) {
         } else if (std::strcmp(argv[i], "-o") == 0) {
             const char* path = (i + 1 < argc) ? argv[++i] : "wiliwili.log";
             brls::Logger::setLogOutput(std::fopen(path, "w+"));
+        } else if (std::strcmp(argv[i], "-p") == 0) {
+            // 输出启动耗时 (startup_trace.json)
+            StartupTracer::ENABLE = true;
+        }
+#ifdef LOCAL_TEST_SERVER
+        else if (std::strcmp(argv[i], "-s") == 0 && i + 1 < argc) {
+            // 本地测试服务器的数据目录
+            serverRoot = argv[++i];
+        } else if (std::strcmp(argv[i], "-r") == 0) {
+            LocalServer::RECORD = true;
+        } else if (std::strcmp(argv[i], "-l") == 0 && i + 1 < argc) {
+            LocalServer::LATENCY = std::atoi(argv[++i]);
+        } else if (std::strcmp(argv[i], "-w") == 0 && i + 1 < argc) {
+            LocalServer::BANDWIDTH = std::atoll(argv[++i]) * 1024;
+        } else if (std::strcmp(argv[i], "-b") == 0 && i + 1 < argc) {
+            benchmarkBvid = argv[++i];
         }
+#endif
     }
 
+#ifdef LOCAL_TEST_SERVER
+    if (!serverRoot.empty() && !LocalServer::instance().start(serverRoot)) return EXIT_FAILURE;
+#endif
+
     // Load cookies and settings
-    ProgramConfig::instance().init();
+    {
+        StartupTracer::Scope scope("config");
+        ProgramConfig::instance().init();
+    }
 
     // Init the app and i18n
-    if (!brls::Application::init()) {
-        brls::Logger::error("Unable to init application");
-        return EXIT_FAILURE;
+    {
+        StartupTracer::Scope scope("application.init");
+        if (!brls::Application::init()) {
+            brls::Logger::error("Unable to init application");
+            return EXIT_FAILURE;
+        }
     }
 
     // Return directly to the desktop when closing the application (only for NX)
     brls::Application::getPlatform()->exitToHomeMode(true);
 
-    brls::Application::createWindow("wiliwili");
-    brls::Logger::info("createWindow done");
+    {
+        // 包括字体加载
+        StartupTracer::Scope scope("window");
+        brls::Application::createWindow("wiliwili");
+        brls::Logger::info("createWindow done");
+    }
 
     // Register custom view\theme\style
-    Register::initCustomView();
-    Register::initCustomTheme();
-    Register::initCustomStyle();
+    {
+        StartupTracer::Scope scope("register");
+        Register::initCustomView();
+        Register::initCustomTheme();
+        Register::initCustomStyle();
+    }
 
     brls::Application::getPlatform()->disableScreenDimming(false);
 
+#ifdef LOCAL_TEST_SERVER
+    if (!benchmarkBvid.empty()) {
+        BenchmarkHelper::instance().start(benchmarkBvid);
+    } else
+#endif
     if (brls::Application::getPlatform()->isApplicationMode()) {
+        // 首页推荐的请求与主界面的构建同时进行
+        Home::prefetch();
+        StartupTracer::Scope scope("main_activity");
         Intent::openMain();
         // Uncomment these lines to debug activities
         //        Intent::openBV("BV1Da411Y7U4");  // 弹幕防遮挡 (横屏)
@@ -96,13 +151,29 @@ int main(int argc, char* argv[]) {
                     {"window", fmt::format("{}x{}", brls::Application::windowWidth, brls::Application::windowHeight)}})
     APPVersion::instance().checkUpdate();
 
+    // 继续上次未完成的离线下载
+    DownloadManager::instance().start();
+
     // Run the app
     // brls::Application::setLimitedFPS(60);
     while (brls::Application::mainLoop()) {
+        FrameScheduler::instance().onFrame();
+        if (StartupTracer::instance().markFirstFrame()) {
+            GA("startup", {{"cold_start", std::to_string(StartupTracer::instance().getColdStartTime())}})
+        }
     }
 
     brls::Logger::info("mainLoop done");
 
+    DownloadManager::instance().stop();
+
+    // 在其他单例析构前关闭磁盘缓存代理，保存缓存记录
+    MediaCache::instance().stop();
+
+#ifdef LOCAL_TEST_SERVER
+    LocalServer::instance().stop();
+#endif
+
     // Cleanup curl and Check whether restart is required
     ProgramConfig::instance().exit(argv);
 
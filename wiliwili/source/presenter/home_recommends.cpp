@@ -3,9 +3,78 @@
 //
 
 #include <borealis/core/style.hpp>
+#include <borealis/core/thread.hpp>
 #include "presenter/home_recommends.hpp"
+#include "utils/startup_tracer.hpp"
 #include "bilibili.h"
 
+/// 启动时预取的第一页推荐，只在主线程中访问；结果只使用一次，超过 Home::PREFETCH_EXPIRE 没有使用时丢弃
+class HomePrefetch {
+public:
+    using Callback = std::function<void(bool, const bilibili::RecommendVideoListResultWrapper &, const std::string &)>;
+
+    /// 结果已经返回时立即回调，否则等待结果返回，没有对应的预取请求时返回 false
+    bool wait(int count, const Callback &cb) {
+        if ((!pending && !done) || count != num) return false;
+        callback = cb;
+        if (done) flush();
+        return true;
+    }
+
+    void finish(bool ok, const bilibili::RecommendVideoListResultWrapper &data, const std::string &msg) {
+        if (!pending) return;
+        pending = false;
+        done    = true;
+        success = ok;
+        result  = data;
+        error   = msg;
+        if (callback) {
+            flush();
+            return;
+        }
+        size_t current = token;
+        brls::delay(Home::PREFETCH_EXPIRE, [this, current]() {
+            if (current == token) cancel();
+        });
+    }
+
+    /// 丢弃还没有使用的预取结果，正在进行的请求返回后也不再保存
+    void cancel() {
+        if (callback) return;
+        token++;
+        pending = false;
+        done    = false;
+        result  = bilibili::RecommendVideoListResultWrapper();
+    }
+
+    bool pending = false, done = false;
+    int num      = 0;
+
+private:
+    // 结果只使用一次
+    void flush() {
+        Callback cb = callback;
+        callback    = nullptr;
+        done        = false;
+        token++;
+        cb(success, result, error);
+        result = bilibili::RecommendVideoListResultWrapper();
+    }
+
+    bool success = false;
+    bilibili::RecommendVideoListResultWrapper result;
+    std::string error;
+    Callback callback;
+    size_t token = 0;
+};
+
+static HomePrefetch homePrefetch;
+
+static int getRecommendRows() {
+    static int y_num = (int)brls::getStyle().getMetric("wiliwili/grid/span/4");
+    return y_num;
+}
+
 void Home::onRecommendVideoList(const bilibili::RecommendVideoListResultWrapper &result) {}
 void Home::onError(const std::string &error) {}
 
@@ -33,9 +102,21 @@ void Home::requestData(bool refresh, FeedType type) {
 
 void Home::requestRecommendVideoList(int index, int num, int fresh, FeedType type) {
     CHECK_AND_SET_REQUEST
-    static int y_num = (int)brls::getStyle().getMetric("wiliwili/grid/span/4");
+    // 首次加载时使用启动阶段预取的结果
+    if (index == 1 && fresh == 0 && type == FeedType::V1) {
+        auto callback = [this](bool success, const bilibili::RecommendVideoListResultWrapper &result,
+                               const std::string &error) {
+            if (success) {
+                this->onRecommendVideoList(result);
+            } else {
+                this->onError(error);
+            }
+            UNSET_REQUEST
+        };
+        if (homePrefetch.wait(num, callback)) return;
+    }
     BILI::get_recommend(
-        index, num, 0, type == FeedType::V1 ? "V1" : "CLIENT_SELECTED", 3, y_num,
+        index, num, 0, type == FeedType::V1 ? "V1" : "CLIENT_SELECTED", 3, getRecommendRows(),
         [this](const bilibili::RecommendVideoListResultWrapper &result) {
             this->onRecommendVideoList(result);
             UNSET_REQUEST
@@ -44,4 +125,24 @@ void Home::requestRecommendVideoList(int index, int num, int fresh, FeedType typ
             this->onError(error);
             UNSET_REQUEST
         });
-}
\ No newline at end of file
+}
+void Home::prefetch(FeedType type, int num) {
+    // 预取的结果只用于首页推荐第一次加载 V1 推荐
+    if (type != FeedType::V1) return;
+    if (homePrefetch.pending || homePrefetch.done) return;
+    homePrefetch.pending = true;
+    homePrefetch.num     = num;
+    int64_t start        = StartupTracer::instance().now();
+    BILI::get_recommend(
+        1, num, 0, "V1", 3, getRecommendRows(),
+        [start](const bilibili::RecommendVideoListResultWrapper &result) {
+            StartupTracer::instance().add("home.prefetch", start, StartupTracer::instance().now());
+            brls::sync([result]() { homePrefetch.finish(true, result, ""); });
+        },
+        [start](BILI_ERR) {
+            StartupTracer::instance().add("home.prefetch", start, StartupTracer::instance().now());
+            brls::sync([error]() { homePrefetch.finish(false, {}, error); });
+        });
+}
+
+void Home::cancelPrefetch() { homePrefetch.cancel(); }
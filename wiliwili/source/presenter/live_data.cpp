@@ -110,6 +110,20 @@ void LiveDataRequest::requestLiveDanmakuToken(int roomid) {
         });
 }
 
+void LiveDataRequest::requestLiveEmoticon(int roomid) {
+    ASYNC_RETAIN
+    dl_emoticon(roomid, [ASYNC_TOKEN](std::shared_ptr<LiveEmoticonAtlas> atlas) {
+        if (!atlas || atlas->items.empty()) {
+            ASYNC_RELEASE
+            return;
+        }
+        brls::sync([ASYNC_TOKEN, atlas]() {
+            ASYNC_RELEASE
+            this->onEmoticonAtlas(atlas);
+        });
+    });
+}
+
 std::string LiveDataRequest::getQualityDescription(int qn) {
     if (qualityDescriptionMap.count(qn) == 0) return "Unknown Quality " + std::to_string(qn);
     return qualityDescriptionMap[qn];
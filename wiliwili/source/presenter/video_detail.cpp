@@ -1,14 +1,19 @@
 //
 // Created by fang on 2022/8/9.
 //
+#include <algorithm>
+#include <chrono>
 #include <cstdlib>
+#include <optional>
 #include <tinyxml2.h>
 #include <pystring.h>
 #include <borealis/core/thread.hpp>
 
 #include "presenter/video_detail.hpp"
 #include "utils/config_helper.hpp"
+#include "utils/download_manager.hpp"
 #include "utils/number_helper.hpp"
+#include "utils/videoshot_helper.hpp"
 #include "view/danmaku_core.hpp"
 #include "view/subtitle_core.hpp"
 #include "view/video_view.hpp"
@@ -16,6 +21,20 @@
 #include "bilibili/result/mine_collection_result.h"
 #include "utils/dialog_helper.hpp"
 
+/// 预加载的下一个视频数据，所有字段只在主线程中修改
+class VideoPreloadData {
+public:
+    std::string bvid;
+    uint64_t cid = 0;
+    bool season  = false;
+    int quality  = 0;
+    // 播放地址的有效期
+    std::chrono::system_clock::time_point deadline;
+    std::optional<bilibili::VideoUrlResult> url;
+    std::optional<std::vector<DanmakuItem>> danmaku;
+    std::optional<bilibili::VideoPageResult> page;
+};
+
 /// 请求视频数据
 void VideoDetail::requestData(const bilibili::VideoDetailResult& video) { this->requestVideoInfo(video.bvid); }
 
@@ -180,78 +199,19 @@ void VideoDetail::requestVideoInfo(const std::string& bvid) {
         [ASYNC_TOKEN](const bilibili::VideoDetailAllResult& result) {
             brls::sync([ASYNC_TOKEN, result]() {
                 ASYNC_RELEASE
-                brls::Logger::debug("BILI::get_video_detail");
-                this->videoDetailResult = result.View;
-                this->userDetailResult  = result.Card;
-                this->videDetailRelated = result.Related;
-
-                if (!this->videoDetailResult.redirect_url.empty()) {
-                    // eg: https://www.bilibili.com/bangumi/play/ep568278
-                    std::vector<std::string> items;
-                    pystring::split(this->videoDetailResult.redirect_url, items, "/");
-                    std::string epid = items[items.size() - 1];
-                    if (pystring::startswith(epid, "ep")) {
-                        this->onRedirectToEp(pystring::slice(epid, 2));
-                        return;
-                    } else {
-                        brls::Logger::error("unknown redirect url: {}", videoDetailResult.redirect_url);
-                    }
-                }
-
-                // 如果请求前就设定了指定分P，那么尝试打开指定的分P，两种情况会预设cid
-                // 1. 从历史记录打开视频
-                // 2. 切换分P播放
-                if (videoDetailPage.cid != 0) {
-                    for (const auto& i : this->videoDetailResult.pages) {
-                        if (i.cid == videoDetailPage.cid) {
-                            brls::Logger::debug("获取视频分P列表: PV {}", i.cid);
-                            videoDetailPage = i;
-                            break;
-                        }
-                    }
-                } else {
-                    // 其他两种情况打开PV1
-                    // 1. 未指定PV
-                    // 2. 指定了错误的PV（比如Up主重新上传过视频，那么历史记录中保存的PV就是错误的）
-                    for (const auto& i : this->videoDetailResult.pages) {
-                        brls::Logger::debug("获取视频分P列表: PV1 {}", i.cid);
-                        videoDetailPage = i;
-                        break;
-                    }
-                }
-
-                if (videoDetailPage.cid == 0) {
-                    brls::Logger::error("未获取到视频列表");
-                    return;
-                }
-
-                // 请求视频播放地址
-                this->requestVideoUrl(this->videoDetailResult.bvid, this->videoDetailPage.cid);
-
-                // 展示视频相关信息
-                this->onUpInfo(this->userDetailResult);
-                this->onVideoInfo(this->videoDetailResult);
-
-                // 展示分P数据
-                this->onVideoPageListInfo(this->videoDetailResult.pages);
-
-                // 展示合集数据
-                if (!videoDetailResult.ugc_season.sections.empty()) this->onUGCSeasonInfo(videoDetailResult.ugc_season);
-
-                // 请求视频评论
-                this->requestVideoComment(std::to_string(this->videoDetailResult.aid), 0, 3);
-
-                // 请求用户投稿列表
-                this->requestUploadedVideos(videoDetailResult.owner.mid, 1);
-
-                // 展示相关推荐
-                this->onRelatedVideoList(videDetailRelated);
+                this->onVideoDetailAll(result);
             });
         },
-        [ASYNC_TOKEN](BILI_ERR) {
+        [ASYNC_TOKEN, bvid](BILI_ERR) {
             brls::Logger::error("ERROR:请求视频信息 {}", error);
-            brls::sync([ASYNC_TOKEN, error]() {
+            brls::sync([ASYNC_TOKEN, bvid, error]() {
                 ASYNC_RELEASE
+                // 断网时打开已下载的视频
+                bilibili::VideoDetailAllResult result;
+                if (DownloadManager::instance().getVideoDetail(bvid, result)) {
+                    this->onVideoDetailAll(result);
+                    return;
+                }
                 this->onError(error);
             });
         });
@@ -261,10 +221,83 @@ void VideoDetail::requestVideoInfo(const std::string& bvid) {
     GA("plain_video", {{"bvid", bvid}})
 }
 
+void VideoDetail::onVideoDetailAll(const bilibili::VideoDetailAllResult& result) {
+    brls::Logger::debug("BILI::get_video_detail");
+    this->videoDetailResult = result.View;
+    this->userDetailResult  = result.Card;
+    this->videDetailRelated = result.Related;
+
+    if (!this->videoDetailResult.redirect_url.empty()) {
+        // eg: https://www.bilibili.com/bangumi/play/ep568278
+        std::vector<std::string> items;
+        pystring::split(this->videoDetailResult.redirect_url, items, "/");
+        std::string epid = items[items.size() - 1];
+        if (pystring::startswith(epid, "ep")) {
+            this->onRedirectToEp(pystring::slice(epid, 2));
+            return;
+        } else {
+            brls::Logger::error("unknown redirect url: {}", videoDetailResult.redirect_url);
+        }
+    }
+
+    // 如果请求前就设定了指定分P，那么尝试打开指定的分P，两种情况会预设cid
+    // 1. 从历史记录打开视频
+    // 2. 切换分P播放
+    if (videoDetailPage.cid != 0) {
+        for (const auto& i : this->videoDetailResult.pages) {
+            if (i.cid == videoDetailPage.cid) {
+                brls::Logger::debug("获取视频分P列表: PV {}", i.cid);
+                videoDetailPage = i;
+                break;
+            }
+        }
+    } else {
+        // 其他两种情况打开PV1
+        // 1. 未指定PV
+        // 2. 指定了错误的PV（比如Up主重新上传过视频，那么历史记录中保存的PV就是错误的）
+        for (const auto& i : this->videoDetailResult.pages) {
+            brls::Logger::debug("获取视频分P列表: PV1 {}", i.cid);
+            videoDetailPage = i;
+            break;
+        }
+    }
+
+    if (videoDetailPage.cid == 0) {
+        brls::Logger::error("未获取到视频列表");
+        return;
+    }
+
+    // 请求视频播放地址
+    this->requestVideoUrl(this->videoDetailResult.bvid, this->videoDetailPage.cid);
+
+    // 展示视频相关信息
+    this->onUpInfo(this->userDetailResult);
+    this->onVideoInfo(this->videoDetailResult);
+
+    // 展示分P数据
+    this->onVideoPageListInfo(this->videoDetailResult.pages);
+
+    // 展示合集数据
+    if (!videoDetailResult.ugc_season.sections.empty()) this->onUGCSeasonInfo(videoDetailResult.ugc_season);
+
+    // 请求视频评论
+    this->requestVideoComment(std::to_string(this->videoDetailResult.aid), 0, 3);
+
+    // 请求用户投稿列表
+    this->requestUploadedVideos(videoDetailResult.owner.mid, 1);
+
+    // 展示相关推荐
+    this->onRelatedVideoList(videDetailRelated);
+}
+
 /// 获取视频地址
 void VideoDetail::requestVideoUrl(const std::string& bvid, uint64_t cid, bool requestHistoryInfo) {
     // 重置MPV
     MPVCore::instance().reset();
+    // 进度条预览图，第一次拖动进度条时才会请求
+    VideoShotHelper::instance().setVideo(bvid, cid);
+    if (useDownload(bvid, cid, requestHistoryInfo)) return;
+    if (usePreload(bvid, cid, false, requestHistoryInfo)) return;
     ASYNC_RETAIN
     brls::Logger::debug("请求视频播放地址: {}/{}/{}", bvid, cid, defaultQuality);
     if (cid == 0) return;
@@ -299,6 +332,10 @@ void VideoDetail::requestVideoUrl(const std::string& bvid, uint64_t cid, bool re
 void VideoDetail::requestSeasonVideoUrl(const std::string& bvid, uint64_t cid, bool requestHistoryInfo) {
     // 重置MPV
     MPVCore::instance().reset();
+    // 进度条预览图，第一次拖动进度条时才会请求
+    VideoShotHelper::instance().setVideo(bvid, cid);
+    if (useDownload(bvid, cid, requestHistoryInfo)) return;
+    if (usePreload(bvid, cid, true, requestHistoryInfo)) return;
 
     ASYNC_RETAIN
     brls::Logger::debug("请求番剧视频播放地址: {}", cid);
@@ -469,6 +506,39 @@ void VideoDetail::requestVideoRelationInfo(uint64_t epid) {
         });
 }
 
+/// 解析 xml 格式的弹幕
+static bool decodeDanmaku(const std::string& xml, std::vector<DanmakuItem>& items) {
+    brls::Logger::debug("DANMAKU: start decode");
+
+    // Load XML
+    tinyxml2::XMLDocument document = tinyxml2::XMLDocument();
+    tinyxml2::XMLError error       = document.Parse(xml.c_str());
+
+    if (error != tinyxml2::XMLError::XML_SUCCESS) {
+        brls::Logger::error("Error decode danmaku xml[1]: {}", std::to_string(error));
+        return false;
+    }
+    tinyxml2::XMLElement* element = document.RootElement();
+    if (!element) {
+        brls::Logger::error("Error decode danmaku xml[2]: no root element");
+        return false;
+    }
+
+    for (auto child = element->FirstChildElement(); child != nullptr; child = child->NextSiblingElement()) {
+        if (child->Name()[0] != 'd') continue;  // 简易判断是不是弹幕
+        const char* content = child->GetText();
+        if (!content) continue;
+        try {
+            items.emplace_back(content, child->Attribute("p"));
+        } catch (...) {
+            brls::Logger::error("DANMAKU: error decode: {}", child->GetText());
+        }
+    }
+
+    brls::Logger::debug("DANMAKU: decode done: {}", items.size());
+    return true;
+}
+
 /// 获取视频弹幕
 void VideoDetail::requestVideoDanmaku(uint64_t cid) {
     brls::Logger::debug("请求弹幕：cid: {}", cid);
@@ -477,37 +547,9 @@ void VideoDetail::requestVideoDanmaku(uint64_t cid) {
         cid,
         [ASYNC_TOKEN](const std::string& result) {
             ASYNC_RELEASE
-            brls::Logger::debug("DANMAKU: start decode");
-
-            // Load XML
-            tinyxml2::XMLDocument document = tinyxml2::XMLDocument();
-            tinyxml2::XMLError error       = document.Parse(result.c_str());
-
-            if (error != tinyxml2::XMLError::XML_SUCCESS) {
-                brls::Logger::error("Error decode danmaku xml[1]: {}", std::to_string(error));
-                return;
-            }
-            tinyxml2::XMLElement* element = document.RootElement();
-            if (!element) {
-                brls::Logger::error("Error decode danmaku xml[2]: no root element");
-                return;
-            }
-
             std::vector<DanmakuItem> items;
-            for (auto child = element->FirstChildElement(); child != nullptr; child = child->NextSiblingElement()) {
-                if (child->Name()[0] != 'd') continue;  // 简易判断是不是弹幕
-                const char* content = child->GetText();
-                if (!content) continue;
-                try {
-                    items.emplace_back(content, child->Attribute("p"));
-                } catch (...) {
-                    brls::Logger::error("DANMAKU: error decode: {}", child->GetText());
-                }
-            }
-
+            if (!decodeDanmaku(result, items)) return;
             brls::sync([items]() { DanmakuCore::instance().loadDanmakuData(items); });
-
-            brls::Logger::debug("DANMAKU: decode done: {}", items.size());
         },
         [ASYNC_TOKEN](BILI_ERR) {
             ASYNC_RELEASE
@@ -522,53 +564,214 @@ void VideoDetail::requestVideoPageDetail(const std::string& bvid, uint64_t cid,
     BILI::get_page_detail(
         bvid, cid,
         [ASYNC_TOKEN, requestVideoHistory](const bilibili::VideoPageResult& result) {
-#if defined(BOREALIS_USE_D3D11) || defined(BOREALIS_USE_OPENGL) && !defined(__PSV__)
-            if (!result.mask_url.empty()) {
-                brls::Logger::debug("获取防遮挡数据: {}", result.mask_url);
-                auto url = pystring::startswith(result.mask_url, "//") ? "https:" + result.mask_url : result.mask_url;
-                DanmakuCore::instance().loadMaskData(url);
-            }
-#endif
             brls::sync([ASYNC_TOKEN, result, requestVideoHistory]() {
                 ASYNC_RELEASE
-                SubtitleCore::instance().setSubtitleList(result);
-                // 存在UP主设置的字幕
-                if (!result.subtitles.empty() && pystring::count(result.subtitles[0].lan, "ai") <= 0) {
-                    SubtitleCore::instance().selectSubtitle(0);
-                }
+                this->onVideoPageDetail(result, requestVideoHistory);
+            });
+        },
+        [ASYNC_TOKEN](BILI_ERR) {
+            ASYNC_RELEASE
+            brls::Logger::error("{}", error);
+        });
+}
 
-                if (!requestVideoHistory) return;
-
-                brls::Logger::debug("历史播放进度：{}/{}", result.last_play_cid, result.last_play_time);
-                // 之前播放过此视频，或其他视频分集
-                if (videoDetailPage.cid && result.last_play_cid) {
-                    if (result.last_play_cid == videoDetailPage.cid) {
-                        if (result.last_play_time <= 0) return;
-                        // 之前播放过此视频
-                        APP_E->fire(VideoView::LAST_TIME, (void*)&(result.last_play_time));
-                    } else {
-                        // 之前播放过同一合集的其他视频
-                        for (auto& p : videoDetailResult.pages) {
-                            if (p.cid != result.last_play_cid) continue;
-                            std::string hint = fmt::format("上次看到第 {} 个: {}", p.page, p.part);
-                            if (result.last_play_time > 0) {
-                                hint += " " + wiliwili::sec2Time(result.last_play_time / 1000);
-                            } else {
-                                hint += " 已看完";
-                            }
-                            APP_E->fire(VideoView::HINT, (void*)hint.c_str());
-                            break;
-                        }
-                    }
+void VideoDetail::onVideoPageDetail(const bilibili::VideoPageResult& result, bool requestVideoHistory) {
+#if defined(BOREALIS_USE_D3D11) || defined(BOREALIS_USE_OPENGL) && !defined(__PSV__)
+    if (!result.mask_url.empty()) {
+        brls::Logger::debug("获取防遮挡数据: {}", result.mask_url);
+        auto url = pystring::startswith(result.mask_url, "//") ? "https:" + result.mask_url : result.mask_url;
+        DanmakuCore::instance().loadMaskData(url);
+    }
+#endif
+    SubtitleCore::instance().setSubtitleList(result);
+    // 存在UP主设置的字幕
+    if (!result.subtitles.empty() && pystring::count(result.subtitles[0].lan, "ai") <= 0) {
+        SubtitleCore::instance().selectSubtitle(0);
+    }
+
+    if (!requestVideoHistory) return;
+
+    brls::Logger::debug("历史播放进度：{}/{}", result.last_play_cid, result.last_play_time);
+    // 之前播放过此视频，或其他视频分集
+    if (videoDetailPage.cid && result.last_play_cid) {
+        if (result.last_play_cid == videoDetailPage.cid) {
+            if (result.last_play_time <= 0) return;
+            // 之前播放过此视频
+            APP_E->fire(VideoView::LAST_TIME, (void*)&(result.last_play_time));
+        } else {
+            // 之前播放过同一合集的其他视频
+            for (auto& p : videoDetailResult.pages) {
+                if (p.cid != result.last_play_cid) continue;
+                std::string hint = fmt::format("上次看到第 {} 个: {}", p.page, p.part);
+                if (result.last_play_time > 0) {
+                    hint += " " + wiliwili::sec2Time(result.last_play_time / 1000);
+                } else {
+                    hint += " 已看完";
                 }
+                APP_E->fire(VideoView::HINT, (void*)hint.c_str());
+                break;
+            }
+        }
+    }
+}
+
+std::chrono::system_clock::time_point VideoDetail::getUrlDeadline(const bilibili::VideoUrlResult& result) {
+    std::string url;
+    if (!result.dash.video.empty()) {
+        url = result.dash.video[0].base_url;
+    } else if (!result.durl.empty()) {
+        url = result.durl[0].url;
+    }
+
+    auto now      = std::chrono::system_clock::now();
+    auto fallback = now + std::chrono::seconds(URL_EXPIRE);
+    auto pos      = url.find("deadline=");
+    if (pos == std::string::npos) return fallback;
+    long long deadline = std::strtoll(url.c_str() + pos + 9, nullptr, 10);
+    auto expire        = std::chrono::system_clock::time_point(std::chrono::seconds(deadline));
+    auto time          = expire - std::chrono::seconds(URL_EXPIRE_MARGIN);
+    // 本地时间不准确时（比服务器时间快）使用默认的有效期；时间偏慢时同样不超过默认的有效期
+    if (time <= now) return fallback;
+    return std::min(time, fallback);
+}
+
+/// 预加载下一个视频
+void VideoDetail::requestPreload(const std::string& bvid, uint64_t cid, bool season) {
+    if (PRELOAD_TIME <= 0 || cid == 0) return;
+    if (preloadData && preloadData->cid == cid && preloadData->quality == defaultQuality) return;
+
+    auto data      = std::make_shared<VideoPreloadData>();
+    data->bvid     = bvid;
+    data->cid      = cid;
+    data->season   = season;
+    data->quality  = defaultQuality;
+    preloadData    = data;
+    brls::Logger::info("preload: {}/{}", bvid, cid);
+
+    this->requestPreloadUrl(data);
+    this->requestPreloadDanmaku(data);
+    this->requestPreloadPageDetail(data);
+}
+
+void VideoDetail::requestPreloadUrl(const std::shared_ptr<VideoPreloadData>& data) {
+    ASYNC_RETAIN
+    auto callback = [ASYNC_TOKEN, data](const bilibili::VideoUrlResult& result) {
+        brls::sync([ASYNC_TOKEN, data, result]() {
+            ASYNC_RELEASE
+            data->url      = result;
+            data->deadline = VideoDetail::getUrlDeadline(result);
+        });
+    };
+    auto errorCallback = [ASYNC_TOKEN](BILI_ERR) {
+        ASYNC_RELEASE
+        brls::Logger::error("preload url: {}", error);
+    };
+    if (data->season) {
+        BILI::get_season_url(data->cid, data->quality, callback, errorCallback);
+    } else {
+        BILI::get_video_url(data->bvid, data->cid, data->quality, callback, errorCallback);
+    }
+}
+
+void VideoDetail::requestPreloadDanmaku(const std::shared_ptr<VideoPreloadData>& data) {
+    ASYNC_RETAIN
+    BILI::get_danmaku(
+        data->cid,
+        [ASYNC_TOKEN, data](const std::string& result) {
+            std::vector<DanmakuItem> items;
+            decodeDanmaku(result, items);
+            brls::sync([ASYNC_TOKEN, data, items]() {
+                ASYNC_RELEASE
+                data->danmaku = items;
             });
         },
         [ASYNC_TOKEN](BILI_ERR) {
             ASYNC_RELEASE
-            brls::Logger::error("{}", error);
+            brls::Logger::error("preload danmaku: {}", error);
         });
 }
 
+void VideoDetail::requestPreloadPageDetail(const std::shared_ptr<VideoPreloadData>& data) {
+    ASYNC_RETAIN
+    BILI::get_page_detail(
+        data->bvid, data->cid,
+        [ASYNC_TOKEN, data](const bilibili::VideoPageResult& result) {
+            brls::sync([ASYNC_TOKEN, data, result]() {
+                ASYNC_RELEASE
+                data->page = result;
+            });
+        },
+        [ASYNC_TOKEN](BILI_ERR) {
+            ASYNC_RELEASE
+            brls::Logger::error("preload page detail: {}", error);
+        });
+}
+
+bool VideoDetail::usePreload(const std::string& bvid, uint64_t cid, bool season, bool requestHistoryInfo) {
+    auto data = preloadData;
+    if (!data || data->cid != cid || data->season != season) return false;
+    preloadData.reset();
+    // 播放地址还未获取到、清晰度已修改或链接已过期时重新请求
+    if (!data->url || data->quality != defaultQuality) return false;
+    if (std::chrono::system_clock::now() > data->deadline) return false;
+    brls::Logger::info("use preload: {}/{}", bvid, cid);
+
+    this->videoUrlResult = *data->url;
+    this->onVideoPlayUrl(*data->url);
+
+    // 请求当前视频在线人数
+    this->requestVideoOnline(bvid, cid);
+    // 弹幕
+    if (data->danmaku) {
+        DanmakuCore::instance().loadDanmakuData(*data->danmaku);
+    } else {
+        this->requestVideoDanmaku(cid);
+    }
+    // 分P详情 （字幕链接/历史播放记录）
+    if (data->page) {
+        this->onVideoPageDetail(*data->page, requestHistoryInfo);
+    } else {
+        this->requestVideoPageDetail(bvid, cid, requestHistoryInfo);
+    }
+    // 请求高能进度条
+    this->requestHighlightProgress(cid);
+    return true;
+}
+
+bool VideoDetail::useDownload(const std::string& bvid, uint64_t cid, bool requestHistoryInfo) {
+    auto& download = DownloadManager::instance();
+    bilibili::VideoUrlResult url;
+    if (!download.getPlayUrl(cid, url)) return false;
+    brls::Logger::info("use download: {}/{}", bvid, cid);
+
+    this->videoUrlResult = url;
+    this->onVideoPlayUrl(url);
+
+    // 弹幕，在后台读取并解析，没有下载弹幕时从网络请求
+    ASYNC_RETAIN
+    brls::Threading::async([ASYNC_TOKEN, cid]() {
+        std::string xml;
+        auto items = std::make_shared<std::vector<DanmakuItem>>();
+        bool local = DownloadManager::instance().getDanmaku(cid, xml) && decodeDanmaku(xml, *items);
+        brls::sync([ASYNC_TOKEN, cid, local, items]() {
+            ASYNC_RELEASE
+            if (local) {
+                DanmakuCore::instance().loadDanmakuData(*items);
+            } else {
+                this->requestVideoDanmaku(cid);
+            }
+        });
+    });
+    // 分P详情 （本地的字幕与防遮挡数据/下载时的历史播放记录）
+    bilibili::VideoPageResult page;
+    if (download.getPageDetail(cid, page)) {
+        this->onVideoPageDetail(page, requestHistoryInfo);
+    } else {
+        this->requestVideoPageDetail(bvid, cid, requestHistoryInfo);
+    }
+    return true;
+}
+
 /// 上报历史记录
 void VideoDetail::reportHistory(uint64_t aid, uint64_t cid, unsigned int progress, unsigned int duration, int type) {
     if (!REPORT_HISTORY) return;
@@ -0,0 +1,243 @@
+#include <borealis/core/logger.hpp>
+
+#include <algorithm>
+
+#include "bilibili.h"
+#include "utils/abr_helper.hpp"
+#include "utils/cdn_helper.hpp"
+#include "view/mpv_core.hpp"
+#include "view/video_view.hpp"
+
+using namespace std::chrono;
+
+AbrHelper::AbrHelper() {
+    event_id = MPV_E->subscribe([this](MpvEventEnum e) {
+        auto& mpv = MPVCore::instance();
+        switch (e) {
+            case MpvEventEnum::CACHE_SPEED_CHANGE:
+                this->onCacheSpeed(mpv.cache_speed, mpv.cache_duration);
+                break;
+            case MpvEventEnum::CACHE_STALL:
+                this->onStall();
+                break;
+            case MpvEventEnum::START_FILE:
+                // 加载了新的文件（切换清晰度或使用备用链接），之前添加的视频轨道已经失效
+                for (auto& i : ladder) i.loaded = i.external = false;
+                if (!ladder.empty()) ladder[initial].loaded = true;
+                current = initial;
+                break;
+            case MpvEventEnum::RESET:
+                this->reset();
+                break;
+            default:
+                break;
+        }
+    });
+}
+
+AbrHelper::~AbrHelper() { MPV_E->unsubscribe(event_id); }
+
+void AbrHelper::reset() {
+    if (totalStalls > 0) brls::Logger::info("ABR: {} stalls in total", totalStalls);
+    ladder.clear();
+    stalls.clear();
+    current      = 0;
+    initial      = 0;
+    throughput   = 0;
+    totalStalls  = 0;
+    collapsing   = false;
+    lastFailover = {};
+    CdnHelper::instance().saveAsync();
+}
+
+void AbrHelper::setRepresentations(const bilibili::VideoUrlResult& result, const bilibili::DashMedia& playing) {
+    this->reset();
+
+    // 每个清晰度只保留一路视频流，优先使用与当前视频相同的编码
+    for (auto& media : result.dash.video) {
+        if (media.id > playing.id) continue;
+        auto it = std::find_if(ladder.begin(), ladder.end(), [&media](auto& i) { return i.id == media.id; });
+        if (it == ladder.end()) {
+            it     = ladder.emplace(ladder.end());
+            it->id = media.id;
+            for (size_t i = 0; i < result.accept_quality.size() && i < result.accept_description.size(); i++) {
+                if (result.accept_quality[i] == media.id) it->description = result.accept_description[i];
+            }
+        } else if (it->codecid == playing.codecid || media.codecid != playing.codecid) {
+            continue;
+        }
+        // 当前清晰度直接使用正在播放的视频流
+        auto& source  = media.id == playing.id ? playing : media;
+        it->bandwidth = source.bandwidth;
+        it->codecid   = source.codecid;
+        it->urls      = {source.base_url};
+        it->urls.insert(it->urls.end(), source.backup_url.begin(), source.backup_url.end());
+        // 正在播放的视频流已经完成了节点测速，其他视频流按节点的历史表现排序
+        if (&source != &playing) it->urls = CdnHelper::instance().sort(it->urls);
+        it->host = 0;
+        it->url  = it->urls[0];
+    }
+    std::sort(ladder.begin(), ladder.end(), [](auto& a, auto& b) { return a.bandwidth < b.bandwidth; });
+
+    for (size_t i = 0; i < ladder.size(); i++) {
+        if (ladder[i].url == playing.base_url) {
+            this->current = this->initial = i;
+            ladder[i].loaded              = true;
+            break;
+        }
+    }
+    if (ladder.empty() || !ladder[initial].loaded) {
+        // 当前视频流不在列表中时不进行自适应切换
+        ladder.clear();
+        return;
+    }
+
+    lastSwitch = lastDecision = steady_clock::now();
+    brls::Logger::info("ABR: {} representations, start at {} ({}kbps)", ladder.size(), ladder[current].description,
+                       ladder[current].bandwidth / 1000);
+}
+
+void AbrHelper::onCacheSpeed(int64_t speed, double buffer) {
+    if (ladder.empty() || speed < 0) return;
+    // 缓存充足时下载速度为 0 表示暂停了下载，只有缓存不足时才说明网络出现了问题
+    if (speed == 0 && (throughput <= 0 || buffer >= LOW_BUFFER)) return;
+
+    // 缓存已满时播放器会降低下载速度，此时只使用高于当前估计值的测量结果
+    double sample = speed * 8.0;
+    if (buffer < HIGH_BUFFER || sample > throughput) {
+        throughput = throughput <= 0 ? sample : throughput * 0.7 + sample * 0.3;
+    }
+
+    auto now = steady_clock::now();
+    if (now - lastDecision < seconds(2)) return;
+    lastDecision = now;
+    // 记录当前节点的下载速度，下次播放时用于选择节点
+    if (buffer < HIGH_BUFFER && speed > 0) CdnHelper::instance().reportSpeed(ladder[current].url, (double)speed);
+    this->decide(false);
+}
+
+void AbrHelper::onStall() {
+    if (ladder.empty()) return;
+    auto now = steady_clock::now();
+    stalls.emplace_back(now);
+    totalStalls++;
+    while (!stalls.empty() && now - stalls.front() > seconds(STALL_WINDOW)) stalls.pop_front();
+    brls::Logger::info("ABR: stall #{}, {} in the last {}s, throughput {}kbps, quality {}", totalStalls, stalls.size(),
+                       STALL_WINDOW, (int64_t)throughput / 1000, ladder[current].description);
+    this->decide(true);
+}
+
+size_t AbrHelper::getSustainableIndex() const {
+    double usable = throughput * SAFETY_FACTOR;
+    size_t index  = 0;
+    for (size_t i = 0; i < ladder.size(); i++) {
+        if (ladder[i].bandwidth <= usable) index = i;
+    }
+    return index;
+}
+
+int AbrHelper::findTrack(const AbrRepresentation& rep) {
+    auto& mpv     = MPVCore::instance();
+    int64_t count = mpv.getInt("track-list/count");
+    for (int64_t i = 0; i < count; i++) {
+        std::string prefix = fmt::format("track-list/{}/", i);
+        if (mpv.getString(prefix + "type") != "video") continue;
+        bool external = mpv.getString(prefix + "external") == "yes";
+        if (external != rep.external) continue;
+        if (external && mpv.getString(prefix + "external-filename") != rep.url) continue;
+        return (int)mpv.getInt(prefix + "id");
+    }
+    return 0;
+}
+
+void AbrHelper::addTrack(AbrRepresentation& rep) {
+    rep.loaded   = true;
+    rep.external = true;
+    MPVCore::instance().command_async("video-add", rep.url, "select", rep.description);
+}
+
+bool AbrHelper::isCollapsed(bool stalled) {
+    auto now = steady_clock::now();
+    // 开启自适应清晰度时，只有下载速度连最低清晰度都无法维持才切换节点，否则优先降低清晰度
+    auto& limit = ladder[ENABLE ? 0 : current];
+    if (throughput <= 0 || MPVCore::instance().cache_duration >= LOW_BUFFER ||
+        throughput >= limit.bandwidth * COLLAPSE_RATIO) {
+        collapsing = false;
+        return false;
+    }
+    if (!collapsing) {
+        collapsing    = true;
+        collapseSince = now;
+    }
+    if (!stalled && now - collapseSince < seconds(FAILOVER_DELAY)) return false;
+    return lastFailover == steady_clock::time_point{} || now - lastFailover > seconds(FAILOVER_INTERVAL);
+}
+
+void AbrHelper::failover() {
+    auto& rep = ladder[current];
+    if (rep.urls.size() < 2) return;
+    CdnHelper::instance().reportFailure(rep.url);
+
+    auto from = CdnHelper::getHost(rep.url);
+    rep.host  = (rep.host + 1) % rep.urls.size();
+    rep.url   = rep.urls[rep.host];
+    brls::Logger::warning("ABR: failover {} -> {}, throughput {}kbps, buffer {:.1f}s", from,
+                          CdnHelper::getHost(rep.url), (int64_t)throughput / 1000, MPVCore::instance().cache_duration);
+    addTrack(rep);
+
+    // 重新测量新节点的下载速度
+    throughput   = 0;
+    collapsing   = false;
+    lastFailover = lastSwitch = steady_clock::now();
+}
+
+void AbrHelper::decide(bool stalled) {
+    if (ladder.empty() || MPVCore::instance().video_seeking) return;
+    if (this->isCollapsed(stalled)) {
+        this->failover();
+        return;
+    }
+    if (!ENABLE || ladder.size() < 2) return;
+
+    auto now      = steady_clock::now();
+    double buffer = MPVCore::instance().cache_duration;
+    while (!stalls.empty() && now - stalls.front() > seconds(STALL_WINDOW)) stalls.pop_front();
+
+    size_t sustainable = getSustainableIndex();
+    if (stalled) {
+        // 卡顿后至少降低一级清晰度
+        if (current == 0) return;
+        this->switchTo(std::min(sustainable, current - 1), "stall");
+    } else if (buffer < LOW_BUFFER && sustainable < current) {
+        this->switchTo(sustainable, "low buffer");
+    } else if (buffer > HIGH_BUFFER && stalls.empty() && now - lastSwitch > seconds(SWITCH_INTERVAL) &&
+               sustainable > current) {
+        // 每次只提高一级清晰度
+        this->switchTo(current + 1, "high buffer");
+    }
+}
+
+void AbrHelper::switchTo(size_t index, const std::string& reason) {
+    if (index == current || index >= ladder.size()) return;
+    auto& from = ladder[current];
+    auto& to   = ladder[index];
+    brls::Logger::info("ABR: {} -> {} ({}), throughput {}kbps, buffer {:.1f}s, stalls {}/{}s", from.description,
+                       to.description, reason, (int64_t)throughput / 1000, MPVCore::instance().cache_duration,
+                       stalls.size(), STALL_WINDOW);
+
+    // 视频流第一次使用（或之前添加失败）时作为外挂轨道添加，之后直接切换轨道
+    int track = to.loaded ? findTrack(to) : 0;
+    if (track > 0) {
+        MPVCore::instance().command_async("set", "vid", track);
+    } else {
+        // 使用当前表现最好的节点
+        to.urls = CdnHelper::instance().sort(to.urls);
+        to.host = 0;
+        to.url  = to.urls[0];
+        addTrack(to);
+    }
+    current    = index;
+    lastSwitch = steady_clock::now();
+
+    APP_E->fire(VideoView::SET_QUALITY, (void*)to.description.c_str());
+}
@@ -0,0 +1,64 @@
+#ifdef LOCAL_TEST_SERVER
+
+#include <borealis/core/application.hpp>
+#include <borealis/core/logger.hpp>
+#include <borealis/core/thread.hpp>
+
+#include "utils/activity_helper.hpp"
+#include "utils/benchmark_helper.hpp"
+
+using namespace std::chrono;
+
+BenchmarkHelper::~BenchmarkHelper() {
+    MPV_E->unsubscribe(mpvEventID);
+    APP_E->unsubscribe(customEventID);
+}
+
+void BenchmarkHelper::start(const std::string& id) {
+    this->bvid = id;
+
+    mpvEventID = MPV_E->subscribe([this](MpvEventEnum e) {
+        if (e == MpvEventEnum::START_FILE) {
+            // 获取到播放地址并开始加载
+            if (urlTime < 0) urlTime = elapsed();
+        } else if (e == MpvEventEnum::LOADING_END) {
+            // 显示第一帧画面
+            if (urlTime >= 0 && frameTime < 0) frameTime = elapsed();
+        } else {
+            return;
+        }
+        this->check();
+    });
+    customEventID = APP_E->subscribe([this](const std::string& event, void* data) {
+        if (event != "DANMAKU_LOADED" || danmakuTime >= 0) return;
+        danmakuTime = elapsed();
+        this->check();
+    });
+
+    brls::Logger::info("Benchmark: open {}", bvid);
+    startTime = steady_clock::now();
+    Intent::openBV(bvid);
+    brls::delay(TIMEOUT, [this]() { this->report(true); });
+}
+
+int64_t BenchmarkHelper::elapsed() const {
+    return duration_cast<milliseconds>(steady_clock::now() - startTime).count();
+}
+
+void BenchmarkHelper::check() {
+    if (urlTime >= 0 && frameTime >= 0 && danmakuTime >= 0) this->report(false);
+}
+
+void BenchmarkHelper::report(bool timeout) {
+    if (finished) return;
+    finished = true;
+
+    std::string result = fmt::format("Benchmark {}: url {}ms, first frame {}ms, danmaku {}ms{}", bvid, urlTime,
+                                     frameTime, danmakuTime, timeout ? " (timeout)" : "");
+    brls::Logger::info("{}", result);
+    printf("%s\n", result.c_str());
+    fflush(stdout);
+    brls::Application::quit();
+}
+
+#endif
@@ -0,0 +1,175 @@
+#include <borealis/core/logger.hpp>
+#include <borealis/core/thread.hpp>
+#include <cpr/cpr.h>
+#include <nlohmann/json.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <fstream>
+
+#include "bilibili/util/http.hpp"
+#include "utils/cdn_helper.hpp"
+#include "utils/config_helper.hpp"
+#include "utils/number_helper.hpp"
+
+void to_json(nlohmann::json& j, const CdnHostStat& stat) {
+    j = nlohmann::json{{"speed", stat.speed},
+                       {"latency", stat.latency},
+                       {"success", stat.success},
+                       {"failure", stat.failure},
+                       {"probes", stat.probes},
+                       {"updated", stat.updated}};
+}
+
+void from_json(const nlohmann::json& j, CdnHostStat& stat) {
+    j.at("speed").get_to(stat.speed);
+    j.at("success").get_to(stat.success);
+    j.at("failure").get_to(stat.failure);
+    j.at("updated").get_to(stat.updated);
+    // 旧版本的记录中没有首字节时间与测速次数
+    if (j.contains("latency")) j.at("latency").get_to(stat.latency);
+    if (j.contains("probes")) j.at("probes").get_to(stat.probes);
+}
+
+CdnHelper::CdnHelper() { this->load(); }
+
+std::string CdnHelper::getPath() { return ProgramConfig::instance().getConfigDir() + "/cdn_stats.json"; }
+
+std::string CdnHelper::getHost(const std::string& url) {
+    auto start = url.find("://");
+    start      = start == std::string::npos ? 0 : start + 3;
+    auto end   = url.find('/', start);
+    return url.substr(start, end == std::string::npos ? std::string::npos : end - start);
+}
+
+void CdnHelper::load() {
+    std::ifstream file(getPath());
+    if (!file) return;
+    try {
+        nlohmann::json content;
+        file >> content;
+        auto data   = content.get<std::unordered_map<std::string, CdnHostStat>>();
+        int64_t now = (int64_t)wiliwili::getUnixTime();
+        for (auto& i : data) {
+            if (now - i.second.updated < STAT_EXPIRE) stats.emplace(i);
+        }
+        brls::Logger::info("CdnHelper: load {} hosts", stats.size());
+    } catch (const std::exception& e) {
+        brls::Logger::error("CdnHelper::load: {}", e.what());
+    }
+}
+
+void CdnHelper::save() {
+    std::lock_guard<std::mutex> saveLock(saveMutex);
+    nlohmann::json content;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!dirty) return;
+        dirty   = false;
+        content = stats;
+    }
+    std::ofstream file(getPath());
+    if (!file) {
+        brls::Logger::error("CdnHelper: cannot save to {}", getPath());
+        return;
+    }
+    file << content.dump();
+}
+
+void CdnHelper::saveAsync() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!dirty) return;
+    }
+    brls::Threading::async([this]() { this->save(); });
+}
+
+double CdnHelper::getScore(const std::string& host) {
+    auto it = stats.find(host);
+    if (it == stats.end()) return DEFAULT_SPEED;
+    auto& stat  = it->second;
+    size_t ok   = stat.success + stat.probes;
+    double rate = (double)(ok + 1) / (double)(ok + stat.failure * 2 + 1);
+    double wait = 1.0 + stat.latency / 1000.0;
+    return (stat.speed > 0 ? stat.speed : DEFAULT_SPEED) * rate / wait;
+}
+
+bool CdnHelper::isKnown(const std::vector<std::string>& urls) {
+    int64_t now = (int64_t)wiliwili::getUnixTime();
+    std::lock_guard<std::mutex> lock(mutex);
+    for (auto& url : urls) {
+        auto it = stats.find(getHost(url));
+        if (it == stats.end() || it->second.success < PROBE_SKIP_SAMPLES || now - it->second.updated > STAT_FRESH)
+            return false;
+    }
+    return true;
+}
+
+std::vector<std::string> CdnHelper::sort(const std::vector<std::string>& urls) {
+    std::vector<std::pair<double, std::string>> scores;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (auto& url : urls) scores.emplace_back(getScore(getHost(url)), url);
+    }
+    std::stable_sort(scores.begin(), scores.end(), [](auto& a, auto& b) { return a.first > b.first; });
+    std::vector<std::string> res;
+    res.reserve(scores.size());
+    for (auto& i : scores) res.emplace_back(i.second);
+    return res;
+}
+
+void CdnHelper::reportSpeed(const std::string& url, double speed) {
+    if (speed <= 0) return;
+    std::lock_guard<std::mutex> lock(mutex);
+    auto& stat   = stats[getHost(url)];
+    stat.speed   = stat.speed <= 0 ? speed : stat.speed * 0.7 + speed * 0.3;
+    stat.updated = (int64_t)wiliwili::getUnixTime();
+    stat.success++;
+    dirty = true;
+}
+
+std::vector<std::string> CdnHelper::order(const std::vector<std::string>& urls) {
+    if (urls.size() < 2 || !isKnown(urls)) return urls;
+    return this->sort(urls);
+}
+
+void CdnHelper::reportLatency(const std::string& url, double latency) {
+    if (latency <= 0) return;
+    std::lock_guard<std::mutex> lock(mutex);
+    auto& stat   = stats[getHost(url)];
+    stat.latency = stat.latency <= 0 ? latency : stat.latency * 0.7 + latency * 0.3;
+    stat.updated = (int64_t)wiliwili::getUnixTime();
+    stat.probes++;
+    dirty = true;
+}
+
+void CdnHelper::reportFailure(const std::string& url) {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto& stat   = stats[getHost(url)];
+    stat.updated = (int64_t)wiliwili::getUnixTime();
+    stat.failure++;
+    dirty = true;
+}
+
+void CdnHelper::probe(const std::vector<std::string>& urls) {
+    if (urls.size() < 2 || isKnown(urls)) return;
+
+    auto pending = std::make_shared<std::atomic<size_t>>(urls.size());
+    for (auto& url : urls) {
+        cpr::GetCallback(
+            [this, pending, url](const cpr::Response& r) {
+                if (!r.error && (r.status_code == 206 || r.status_code == 200)) {
+                    // 数据量很小，请求耗时近似为首字节时间
+                    brls::Logger::debug("CdnHelper: {} {}ms", getHost(url), (int64_t)(r.elapsed * 1000));
+                    this->reportLatency(url, r.elapsed * 1000);
+                } else {
+                    brls::Logger::warning("CdnHelper: {} failed ({}) {}", getHost(url), r.status_code,
+                                          r.error.message);
+                    this->reportFailure(url);
+                }
+                if (--(*pending) == 0) this->save();
+            },
+            cpr::Url{url}, cpr::Range{0, PROBE_SIZE - 1}, cpr::Timeout{PROBE_TIMEOUT}, bilibili::HTTP::HEADERS,
+            bilibili::HTTP::PROXIES, bilibili::HTTP::VERIFY);
+    }
+}
@@ -18,6 +18,8 @@
 #include <borealis/views/edit_text_dialog.hpp>
 #include <cpr/filesystem.h>
 
+#include <future>
+
 #include "bilibili.h"
 #include "utils/number_helper.hpp"
 #include "utils/thread_helper.hpp"
@@ -27,10 +29,17 @@
 #include "utils/vibration_helper.hpp"
 #include "utils/ban_list.hpp"
 #include "utils/string_helper.hpp"
+#include "utils/abr_helper.hpp"
+#include "utils/media_cache.hpp"
+#include "utils/download_manager.hpp"
+#include "utils/frame_scheduler.hpp"
+#include "utils/svg_atlas.hpp"
+#include "utils/startup_tracer.hpp"
 #include "presenter/video_detail.hpp"
 #include "activity/player_activity.hpp"
 #include "activity/search_activity_tv.hpp"
 #include "view/danmaku_core.hpp"
+#include "view/live_core.hpp"
 #include "view/video_view.hpp"
 #include "view/mpv_core.hpp"
 #include "utils/dialog_helper.hpp"
@@ -131,6 +140,7 @@ std::unordered_map<SettingItem, ProgramOption> ProgramConfig::SETTING_MAP = {
     {SettingItem::PLAYER_HWDEC_CUSTOM, {"player_hwdec_custom", {}, {}, 0}},
     {SettingItem::PLAYER_EXIT_FULLSCREEN_ON_END, {"player_exit_fullscreen_on_end", {}, {}, 1}},
     {SettingItem::PLAYER_OSD_TV_MODE, {"player_osd_tv_mode", {}, {}, 0}},
+    {SettingItem::PLAYER_ADAPTIVE_QUALITY, {"player_adaptive_quality", {}, {}, 0}},
     {SettingItem::OPENCC_ON, {"opencc", {}, {}, 1}},
     {SettingItem::DANMAKU_ON, {"danmaku", {}, {}, 1}},
     {SettingItem::DANMAKU_FILTER_BOTTOM, {"danmaku_filter_bottom", {}, {}, 1}},
@@ -139,6 +149,8 @@ std::unordered_map<SettingItem, ProgramOption> ProgramConfig::SETTING_MAP = {
     {SettingItem::DANMAKU_FILTER_COLOR, {"danmaku_filter_color", {}, {}, 1}},
     {SettingItem::DANMAKU_FILTER_ADVANCED, {"danmaku_filter_advanced", {}, {}, 0}},
     {SettingItem::DANMAKU_SMART_MASK, {"danmaku_smart_mask", {}, {}, 1}},
+    {SettingItem::DANMAKU_FILTER_MERGE, {"danmaku_filter_merge", {}, {}, 1}},
+    {SettingItem::DANMAKU_LIVE_RECORD, {"danmaku_live_record", {}, {}, 0}},
     {SettingItem::SEARCH_TV_MODE, {"search_tv_mode", {}, {}, 1}},
     {SettingItem::HTTP_PROXY_STATUS, {"http_proxy_status", {}, {}, 0}},
     {SettingItem::TLS_VERIFY,
@@ -161,6 +173,10 @@ std::unordered_map<SettingItem, ProgramOption> ProgramConfig::SETTING_MAP = {
     {SettingItem::PLAYER_INMEMORY_CACHE,
      {"player_inmemory_cache", {"0MB", "10MB", "20MB", "50MB", "100MB"}, {0, 10, 20, 50, 100}, 1}},
 #endif
+    {SettingItem::PLAYER_DISK_CACHE,
+     {"player_disk_cache", {"0MB", "512MB", "1GB", "2GB", "4GB"}, {0, 512, 1024, 2048, 4096}, 0}},
+    {SettingItem::DOWNLOAD_BANDWIDTH,
+     {"download_bandwidth", {"0", "1MB/s", "2MB/s", "5MB/s", "10MB/s"}, {0, 1024, 2048, 5120, 10240}, 0}},
     {
         SettingItem::PLAYER_DEFAULT_SPEED,
         {"player_default_speed",
@@ -496,20 +512,6 @@ void ProgramConfig::load() {
     brls::DesktopPlatform::GAMEPAD_DB = getConfigDir() + "/gamecontrollerdb.txt";
 #endif
 
-    // 初始化自定义布局
-    std::string customThemeID = getSettingItem(SettingItem::APP_RESOURCES, std::string{""});
-    if (!customThemeID.empty()) {
-        for (auto& theme : customThemes) {
-            if (theme.id == customThemeID) {
-                brls::View::CUSTOM_RESOURCES_PATH = theme.path;
-                break;
-            }
-        }
-        if (brls::View::CUSTOM_RESOURCES_PATH.empty()) {
-            brls::Logger::warning("Custom theme not found: {}", customThemeID);
-        }
-    }
-
     // 初始化 UI 缩放
     std::string UIScale = getSettingItem(SettingItem::APP_UI_SCALE, std::string{""});
     if (UIScale == "544p") {
@@ -565,6 +567,8 @@ void ProgramConfig::load() {
     // 初始化弹幕相关内容
     DanmakuCore::DANMAKU_ON                   = getBoolOption(SettingItem::DANMAKU_ON);
     DanmakuCore::DANMAKU_SMART_MASK           = getBoolOption(SettingItem::DANMAKU_SMART_MASK);
+    DanmakuCore::DANMAKU_FILTER_MERGE         = getBoolOption(SettingItem::DANMAKU_FILTER_MERGE);
+    LiveDanmakuCore::DANMAKU_RECORD           = getBoolOption(SettingItem::DANMAKU_LIVE_RECORD);
     DanmakuCore::DANMAKU_FILTER_SHOW_TOP      = getBoolOption(SettingItem::DANMAKU_FILTER_TOP);
     DanmakuCore::DANMAKU_FILTER_SHOW_BOTTOM   = getBoolOption(SettingItem::DANMAKU_FILTER_BOTTOM);
     DanmakuCore::DANMAKU_FILTER_SHOW_SCROLL   = getBoolOption(SettingItem::DANMAKU_FILTER_SCROLL);
@@ -612,6 +616,9 @@ void ProgramConfig::load() {
     // 是否自动跳过片头片尾
     BasePlayerActivity::PLAYER_SKIP_OPENING_CREDITS = getBoolOption(SettingItem::PLAYER_SKIP_OPENING_CREDITS);
 
+    // 是否开启自适应清晰度
+    AbrHelper::ENABLE = getBoolOption(SettingItem::PLAYER_ADAPTIVE_QUALITY);
+
     // 初始化是否固定显示底部进度条
     VideoView::BOTTOM_BAR = getBoolOption(SettingItem::PLAYER_BOTTOM_BAR);
 
@@ -634,6 +641,12 @@ void ProgramConfig::load() {
     // 初始化内存缓存大小
     MPVCore::INMEMORY_CACHE = getIntOption(SettingItem::PLAYER_INMEMORY_CACHE);
 
+    // 初始化视频磁盘缓存大小
+    MediaCache::MAX_SIZE = getIntOption(SettingItem::PLAYER_DISK_CACHE);
+
+    // 初始化离线下载限速
+    DownloadManager::BANDWIDTH = getIntOption(SettingItem::DOWNLOAD_BANDWIDTH);
+
     // 初始化是否使用opencc自动转换简体
     brls::Label::OPENCC_ON = getBoolOption(SettingItem::OPENCC_ON);
 
@@ -669,18 +682,14 @@ void ProgramConfig::load() {
 #endif
 
     // 初始化FPS限制
-    brls::Application::setLimitedFPS(getSettingItem(SettingItem::LIMITED_FPS, 0));
-
-    // 初始化进入闲置状态需要的时间 (ms);
-    int deactivatedTime = getSettingItem(SettingItem::DEACTIVATED_TIME, 0);
-    if (deactivatedTime > 0) {
-        // Reduce FPS to a lower value after a period of inactivity
-        brls::Application::setAutomaticDeactivation(true);
-        brls::Application::setDeactivatedTime(deactivatedTime);
-    }
+    int limitedFPS = getSettingItem(SettingItem::LIMITED_FPS, 0);
+    brls::Application::setLimitedFPS(limitedFPS);
+    if (limitedFPS > 0) FrameScheduler::TARGET_FPS = limitedFPS;
 
-    // 初始化闲置状态 FPS
-    brls::Application::setDeactivatedFPS(getSettingItem(SettingItem::DEACTIVATED_FPS, 5));
+    // 初始化进入闲置状态需要的时间 (ms) 与闲置状态 FPS
+    // Reduce FPS to a lower value after a period of inactivity
+    FrameScheduler::instance().setDeactivation(getSettingItem(SettingItem::DEACTIVATED_TIME, FrameScheduler::IDLE_TIME),
+                                               getSettingItem(SettingItem::DEACTIVATED_FPS, 5));
 
     // 初始化一些在创建窗口之后才能初始化的内容
     brls::Application::getWindowCreationDoneEvent()->subscribe([this]() {
@@ -714,6 +723,9 @@ void ProgramConfig::load() {
             brls::Application::getPlatform()->setThemeVariant(brls::ThemeVariant::DARK);
         }
 
+        // 加载或生成 SVG 图标图集
+        SVGAtlas::instance().start();
+
         // 初始化纹理缓存数量
 #if defined(__PSV__) || defined(PS4)
         brls::TextureCache::instance().cache.setCapacity(1);
@@ -973,11 +985,32 @@ void ProgramConfig::init() {
     }
 #endif
 
-    // load custom theme
-    this->loadCustomThemes();
+    // 扫描自定义主题与读取配置文件互不依赖，在后台线程中扫描主题
+    auto themes = std::async(std::launch::async, [this]() {
+        StartupTracer::Scope scope("config.themes");
+        this->loadCustomThemes();
+    });
 
     // load config from disk
-    this->load();
+    {
+        StartupTracer::Scope scope("config.load");
+        this->load();
+    }
+
+    // 初始化自定义布局
+    themes.get();
+    std::string customThemeID = getSettingItem(SettingItem::APP_RESOURCES, std::string{""});
+    if (!customThemeID.empty()) {
+        for (auto& theme : customThemes) {
+            if (theme.id == customThemeID) {
+                brls::View::CUSTOM_RESOURCES_PATH = theme.path;
+                break;
+            }
+        }
+        if (brls::View::CUSTOM_RESOURCES_PATH.empty()) {
+            brls::Logger::warning("Custom theme not found: {}", customThemeID);
+        }
+    }
 
     // init custom font path
     brls::FontLoader::USER_FONT_PATH = getConfigDir() + "/font.ttf";
@@ -0,0 +1,787 @@
+#include <cpr/cpr.h>
+#include <cpr/filesystem.h>
+#include <nlohmann/json.hpp>
+#include <pystring.h>
+#include <borealis/core/application.hpp>
+#include <borealis/core/i18n.hpp>
+#include <borealis/core/logger.hpp>
+#include <borealis/core/thread.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+
+#include "bilibili.h"
+#include "bilibili/api.h"
+#include "bilibili/util/http.hpp"
+#include "bilibili/result/video_detail_result.h"
+#include "utils/cdn_helper.hpp"
+#include "utils/config_helper.hpp"
+#include "utils/download_manager.hpp"
+#include "utils/number_helper.hpp"
+#include "utils/string_helper.hpp"
+
+using namespace brls::literals;
+
+// 下载一个分块的超时时间 (ms)，限速较低时也足够下载完一个分块
+#define DOWNLOAD_CHUNK_TIMEOUT 300000
+// 连续 DOWNLOAD_STALL_TIME (s) 速度低于 DOWNLOAD_STALL_SPEED (byte/s) 时认为连接已经卡住，放弃这次请求
+#define DOWNLOAD_STALL_SPEED 1024
+#define DOWNLOAD_STALL_TIME 20
+
+static std::string getAbsoluteUrl(const std::string& url) {
+    return pystring::startswith(url, "//") ? "https:" + url : url;
+}
+
+/// 本地文件的链接，字幕与防遮挡数据使用 cpr 读取，需要转换为 file:// 链接
+static std::string getFileUrl(const std::string& path) {
+    return pystring::startswith(path, "/") ? "file://" + path : "file:///" + path;
+}
+
+static bool readFile(const std::string& path, std::string& content) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file) return false;
+    std::stringstream buffer;
+    buffer << file.rdbuf();
+    content = buffer.str();
+    return true;
+}
+
+static bool writeFile(const std::string& path, const std::string& content) {
+    std::ofstream file(path, std::ios::binary);
+    if (!file) return false;
+    file.write(content.data(), (std::streamsize)content.size());
+    return (bool)file;
+}
+
+template <typename T>
+static bool readJson(const std::string& path, T& result) {
+    std::string content;
+    if (!readFile(path, content)) return false;
+    try {
+        result = nlohmann::json::parse(content).get<T>();
+        return true;
+    } catch (const std::exception& e) {
+        brls::Logger::error("DownloadManager: cannot read {}: {}", path, e.what());
+        return false;
+    }
+}
+
+/// 同步请求接口，返回 data 或 result 字段
+static bool getJson(const std::string& url, const cpr::Parameters& parameters, nlohmann::json& data,
+                    std::string& error) {
+    auto r = bilibili::HTTP::get(url, parameters);
+    if (r.error) {
+        error = r.error.message;
+        return false;
+    }
+    if (r.status_code != 200) {
+        error = "Network error. [Status code: " + std::to_string(r.status_code) + " ]";
+        return false;
+    }
+    try {
+        auto res = nlohmann::json::parse(r.text);
+        int code = res.at("code").get<int>();
+        if (code != 0) {
+            error = res.contains("message") && res.at("message").is_string() ? res.at("message").get<std::string>()
+                                                                             : std::to_string(code);
+            return false;
+        }
+        if (res.contains("data") && res.at("data").is_object()) {
+            data = res.at("data");
+        } else if (res.contains("result") && res.at("result").is_object()) {
+            data = res.at("result");
+        } else {
+            error = "Cannot find data";
+            return false;
+        }
+        return true;
+    } catch (const std::exception& e) {
+        error = "Api error. \n" + std::string{e.what()};
+        return false;
+    }
+}
+
+/// 下载一个完整的小文件：弹幕、字幕、防遮挡数据
+static bool getFile(const std::string& url, std::string& content) {
+    auto r = cpr::Get(cpr::Url{getAbsoluteUrl(url)}, CPR_HTTP_BASE);
+    if (r.error || r.status_code != 200) {
+        brls::Logger::error("DownloadManager: cannot download {} ({}) {}", url, r.status_code, r.error.message);
+        return false;
+    }
+    content = std::move(r.text);
+    return true;
+}
+
+/// 请求文件的第一个字节，从 Content-Range 中获取文件大小，依次尝试所有链接
+static int64_t getContentLength(const std::vector<std::string>& urls) {
+    for (auto& url : urls) {
+        auto r = cpr::Get(cpr::Url{url}, cpr::Range{0, 0}, cpr::Timeout{bilibili::HTTP::TIMEOUT},
+                          bilibili::HTTP::HEADERS, bilibili::HTTP::PROXIES, bilibili::HTTP::VERIFY);
+        // Content-Range: bytes 0-0/12345678
+        auto range = r.header["Content-Range"];
+        auto slash = range.rfind('/');
+        if (!r.error && r.status_code == 206 && slash != std::string::npos) {
+            long long total = std::atoll(range.c_str() + slash + 1);
+            if (total > 0) return total;
+        }
+        brls::Logger::warning("DownloadManager: cannot get size from {} ({}) {}", CdnHelper::getHost(url),
+                              r.status_code, r.error.message);
+        CdnHelper::instance().reportFailure(url);
+    }
+    return -1;
+}
+
+/// DownloadTask
+
+std::string DownloadTask::getKey() const { return fmt::format("{}_{}", bvid, cid); }
+
+int64_t DownloadTask::getSize() const {
+    int64_t size = 0;
+    for (auto& i : files) {
+        if (i.size > 0) size += i.size;
+    }
+    return size;
+}
+
+int64_t DownloadTask::getDownloadedSize() const {
+    int64_t size = 0;
+    for (auto& file : files) {
+        for (size_t i = 0; i < file.chunks.size(); i++) {
+            if (!file.chunks[i]) continue;
+            size += std::min(DownloadManager::CHUNK_SIZE, file.size - (int64_t)i * DownloadManager::CHUNK_SIZE);
+        }
+    }
+    return size;
+}
+
+bool DownloadTask::isBusy() const {
+    if (preparing) return true;
+    return std::any_of(files.begin(), files.end(), [](const DownloadFile& i) { return !i.fetching.empty(); });
+}
+
+/// DownloadManager
+
+DownloadManager::~DownloadManager() { this->stop(); }
+
+std::string DownloadManager::getPath(const std::string& key, const std::string& name) {
+    if (name.empty()) return dir + "/" + key;
+    return dir + "/" + key + "/" + name;
+}
+
+void DownloadManager::load() {
+    if (loaded) return;
+    loaded    = true;
+    this->dir = ProgramConfig::instance().getConfigDir() + "/download";
+    std::error_code ec;
+    cpr::fs::create_directories(dir, ec);
+    for (auto& item : cpr::fs::directory_iterator(dir, ec)) {
+        if (!item.is_directory(ec)) continue;
+        std::string key = item.path().filename().string();
+        try {
+            std::ifstream file(getPath(key, "task.json"));
+            nlohmann::json content;
+            file >> content;
+            auto task = std::make_shared<DownloadTask>();
+            content.at("bvid").get_to(task->bvid);
+            content.at("cid").get_to(task->cid);
+            content.at("epid").get_to(task->epid);
+            content.at("title").get_to(task->title);
+            content.at("quality").get_to(task->quality);
+            content.at("video_id").get_to(task->videoId);
+            content.at("codec_id").get_to(task->codecId);
+            content.at("audio_id").get_to(task->audioId);
+            content.at("created").get_to(task->created);
+            task->state = (DownloadState)content.at("state").get<int>();
+            for (auto& i : content.at("files")) {
+                DownloadFile f;
+                i.at("name").get_to(f.name);
+                i.at("size").get_to(f.size);
+                auto chunks = i.at("chunks").get<std::string>();
+                for (char c : chunks) f.chunks.push_back(c == '1');
+                // 分块数与文件大小不符时重新下载
+                if (f.size >= 0 && f.chunks.size() != (size_t)((f.size + CHUNK_SIZE - 1) / CHUNK_SIZE)) {
+                    f.chunks.assign((f.size + CHUNK_SIZE - 1) / CHUNK_SIZE, false);
+                }
+                task->files.emplace_back(std::move(f));
+            }
+            // 上次退出时未完成的任务继续下载
+            if (task->state == DownloadState::DOWNLOADING || task->state == DownloadState::FAILED) {
+                task->state = DownloadState::WAITING;
+            }
+            if (key != task->getKey()) throw std::runtime_error("key mismatch");
+            tasks.emplace_back(task);
+        } catch (const std::exception& e) {
+            brls::Logger::warning("DownloadManager: skip {}: {}", key, e.what());
+        }
+    }
+    std::sort(tasks.begin(), tasks.end(), [](auto& a, auto& b) { return a->created < b->created; });
+    brls::Logger::info("DownloadManager: load {} tasks", tasks.size());
+}
+
+void DownloadManager::save(const DownloadTask& task) {
+    nlohmann::json files = nlohmann::json::array();
+    for (auto& f : task.files) {
+        std::string chunks;
+        chunks.reserve(f.chunks.size());
+        for (bool i : f.chunks) chunks.push_back(i ? '1' : '0');
+        files.push_back({{"name", f.name}, {"size", f.size}, {"chunks", chunks}});
+    }
+    nlohmann::json content;
+    content["bvid"]     = task.bvid;
+    content["cid"]      = task.cid;
+    content["epid"]     = task.epid;
+    content["title"]    = task.title;
+    content["quality"]  = task.quality;
+    content["video_id"] = task.videoId;
+    content["codec_id"] = task.codecId;
+    content["audio_id"] = task.audioId;
+    content["created"]  = task.created;
+    content["state"]    = (int)task.state;
+    content["error"]    = task.error;
+    content["files"]    = files;
+    std::ofstream file(getPath(task.getKey(), "task.json"));
+    if (file) file << content.dump();
+}
+
+void DownloadManager::start() {
+    std::lock_guard<std::mutex> lock(mutex);
+    this->load();
+    if (running) {
+        condition.notify_all();
+        return;
+    }
+    bool pending = std::any_of(tasks.begin(), tasks.end(), [](auto& i) {
+        return i->state == DownloadState::WAITING || i->state == DownloadState::DOWNLOADING;
+    });
+    if (!pending) return;
+    running = true;
+    for (size_t i = 0; i < WORKERS; i++) workers.emplace_back([this]() { this->worker(); });
+}
+
+void DownloadManager::stop() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!running) return;
+        running = false;
+        for (auto& i : tasks) *i->cancel = true;
+    }
+    condition.notify_all();
+    for (auto& i : workers) {
+        if (i.joinable()) i.join();
+    }
+    workers.clear();
+
+    std::lock_guard<std::mutex> lock(mutex);
+    for (auto& i : tasks) {
+        i->cancel = std::make_shared<std::atomic<bool>>(false);
+        this->save(*i);
+    }
+}
+
+bool DownloadManager::add(const std::string& bvid, uint64_t cid, uint64_t epid, const std::string& title,
+                          int quality) {
+    if (bvid.empty() || cid == 0) return false;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        this->load();
+        if (this->find(cid, false)) return false;
+        auto task     = std::make_shared<DownloadTask>();
+        task->bvid    = bvid;
+        task->cid     = cid;
+        task->epid    = epid;
+        task->title   = title;
+        task->quality = quality;
+        task->created = (int64_t)wiliwili::getUnixTime();
+        std::error_code ec;
+        cpr::fs::create_directories(getPath(task->getKey()), ec);
+        this->save(*task);
+        tasks.emplace_back(task);
+        brls::Logger::info("DownloadManager: add {} {}", task->getKey(), title);
+    }
+    this->start();
+    return true;
+}
+
+void DownloadManager::pause(const std::string& key) {
+    std::lock_guard<std::mutex> lock(mutex);
+    for (auto& task : tasks) {
+        if (task->getKey() != key) continue;
+        if (task->state != DownloadState::WAITING && task->state != DownloadState::DOWNLOADING) return;
+        task->state = DownloadState::PAUSED;
+        // 正在进行的请求使用旧的标记，会尽快结束
+        *task->cancel = true;
+        task->cancel  = std::make_shared<std::atomic<bool>>(false);
+        this->save(*task);
+        return;
+    }
+}
+
+void DownloadManager::resume(const std::string& key) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (auto& task : tasks) {
+            if (task->getKey() != key) continue;
+            if (task->state != DownloadState::PAUSED && task->state != DownloadState::FAILED) return;
+            task->state        = DownloadState::WAITING;
+            task->prepared     = false;
+            task->refreshCount = 0;
+            task->error.clear();
+            this->save(*task);
+            break;
+        }
+    }
+    this->start();
+}
+
+void DownloadManager::remove(const std::string& key) {
+    std::lock_guard<std::mutex> lock(mutex);
+    for (auto it = tasks.begin(); it != tasks.end(); it++) {
+        if ((*it)->getKey() != key) continue;
+        *(*it)->cancel = true;
+        tasks.erase(it);
+        std::error_code ec;
+        cpr::fs::remove_all(getPath(key), ec);
+        brls::Logger::info("DownloadManager: remove {}", key);
+        return;
+    }
+}
+
+std::vector<DownloadTask> DownloadManager::getTasks() {
+    std::lock_guard<std::mutex> lock(mutex);
+    this->load();
+    std::vector<DownloadTask> res;
+    res.reserve(tasks.size());
+    for (auto& i : tasks) res.emplace_back(*i);
+    return res;
+}
+
+std::shared_ptr<DownloadTask> DownloadManager::find(uint64_t cid, bool finished) {
+    for (auto& i : tasks) {
+        if (i->cid != cid) continue;
+        if (finished && i->state != DownloadState::DONE) continue;
+        return i;
+    }
+    return nullptr;
+}
+
+bool DownloadManager::getPlayUrl(uint64_t cid, bilibili::VideoUrlResult& result) {
+    std::string key;
+    std::vector<std::string> media;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        this->load();
+        auto task = this->find(cid, true);
+        if (!task) return false;
+        key = task->getKey();
+        for (auto& i : task->files) media.emplace_back(getPath(key, i.name));
+    }
+    // 视频文件被手动删除时重新在线播放
+    std::error_code ec;
+    for (auto& i : media) {
+        if (!cpr::fs::exists(i, ec)) return false;
+    }
+    if (!readJson(getPath(key, "playurl.json"), result)) return false;
+    return !result.dash.video.empty();
+}
+
+bool DownloadManager::getPageDetail(uint64_t cid, bilibili::VideoPageResult& result) {
+    std::string path;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        this->load();
+        auto task = this->find(cid, true);
+        if (!task) return false;
+        path = getPath(task->getKey(), "page.json");
+    }
+    return readJson(path, result);
+}
+
+bool DownloadManager::getDanmaku(uint64_t cid, std::string& xml) {
+    std::string path;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        this->load();
+        auto task = this->find(cid, true);
+        if (!task) return false;
+        path = getPath(task->getKey(), "danmaku.xml");
+    }
+    return readFile(path, xml);
+}
+
+bool DownloadManager::getVideoDetail(const std::string& bvid, bilibili::VideoDetailAllResult& result) {
+    std::string path;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        this->load();
+        for (auto& i : tasks) {
+            if (i->bvid != bvid || i->epid != 0 || i->state != DownloadState::DONE) continue;
+            path = getPath(i->getKey(), "detail.json");
+            break;
+        }
+    }
+    if (path.empty()) return false;
+    return readJson(path, result);
+}
+
+void DownloadManager::worker() {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (running) {
+        std::shared_ptr<DownloadTask> task;
+        bool prepare = false;
+        size_t file = 0, chunk = 0;
+        if (!this->pick(task, prepare, file, chunk)) {
+            condition.wait(lock);
+            continue;
+        }
+        lock.unlock();
+        if (prepare) {
+            this->prepare(task);
+        } else {
+            this->fetch(task, file, chunk);
+        }
+        lock.lock();
+    }
+}
+
+bool DownloadManager::pick(std::shared_ptr<DownloadTask>& task, bool& prepare, size_t& file, size_t& chunk) {
+    size_t active = 0;
+    for (auto& t : tasks) {
+        if (t->state != DownloadState::WAITING && t->state != DownloadState::DOWNLOADING) continue;
+        // 超出同时下载的任务数时排队等待
+        if (active++ >= MAX_TASKS) break;
+        if (!t->prepared) {
+            // 等待正在进行的请求结束后再重新获取链接
+            if (t->isBusy()) continue;
+            t->preparing = true;
+            t->state     = DownloadState::DOWNLOADING;
+            task         = t;
+            prepare      = true;
+            return true;
+        }
+        for (size_t i = 0; i < t->files.size(); i++) {
+            auto& f = t->files[i];
+            for (size_t j = 0; j < f.chunks.size(); j++) {
+                if (f.chunks[j] || f.fetching.count(j)) continue;
+                f.fetching.insert(j);
+                t->state = DownloadState::DOWNLOADING;
+                task     = t;
+                prepare  = false;
+                file     = i;
+                chunk    = j;
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+void DownloadManager::prepare(const std::shared_ptr<DownloadTask>& task) {
+    DownloadTask info;
+    std::shared_ptr<std::atomic<bool>> cancel;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        info   = *task;
+        cancel = task->cancel;
+    }
+    std::string key = info.getKey();
+
+    auto fail = [this, &task, &key](const std::string& error) {
+        brls::Logger::error("DownloadManager: {} failed: {}", key, error);
+        std::lock_guard<std::mutex> lock(mutex);
+        task->preparing = false;
+        if (task->state == DownloadState::DOWNLOADING || task->state == DownloadState::WAITING) {
+            task->state = DownloadState::FAILED;
+            task->error = error;
+        }
+        this->save(*task);
+        condition.notify_all();
+    };
+
+    // 获取播放地址
+    std::string error;
+    nlohmann::json data;
+    cpr::Parameters parameters{{"cid", std::to_string(info.cid)},
+                               {"qn", std::to_string(info.quality)},
+                               {"fourk", "1"},
+                               {"fnval", BILI::FNVAL},
+                               {"fnver", "0"}};
+    if (info.epid == 0) parameters.Add(cpr::Parameter{"bvid", info.bvid});
+    if (!getJson(info.epid == 0 ? bilibili::Api::PlayInformation : bilibili::Api::SeasonUrl, parameters, data,
+                 error)) {
+        fail(error);
+        return;
+    }
+    bilibili::VideoUrlResult url;
+    try {
+        url = data.get<bilibili::VideoUrlResult>();
+    } catch (const std::exception& e) {
+        fail(e.what());
+        return;
+    }
+    if (url.dash.video.empty()) {
+        fail("Only DASH videos can be downloaded");
+        return;
+    }
+
+    // 选择视频流：继续下载时使用之前的视频流，否则选择不高于期望清晰度的视频流，并匹配设定的视频编码
+    auto& videos = url.dash.video;
+    int video    = -1;
+    for (size_t i = 0; i < videos.size() && info.videoId != 0; i++) {
+        if (videos[i].id == info.videoId && videos[i].codecid == info.codecId) {
+            video = (int)i;
+            break;
+        }
+    }
+    if (video < 0) {
+        int quality = videos.back().id;
+        for (auto& i : videos) {
+            if (i.id <= info.quality) {
+                quality = i.id;
+                break;
+            }
+        }
+        for (size_t i = 0; i < videos.size(); i++) {
+            if (videos[i].id != quality) continue;
+            if (video < 0) video = (int)i;
+            if (videos[i].codecid == BILI::VIDEO_CODEC) {
+                video = (int)i;
+                break;
+            }
+        }
+    }
+
+    // 选择音频流
+    auto& audios = url.dash.audio;
+    int audio    = audios.empty() ? -1 : 0;
+    for (size_t i = 0; i < audios.size(); i++) {
+        if (audios[i].id == (info.audioId != 0 ? info.audioId : BILI::AUDIO_QUALITY)) {
+            audio = (int)i;
+            break;
+        }
+    }
+
+    std::vector<DownloadFile> files(audio < 0 ? 1 : 2);
+    files[0].name = "video.m4s";
+    files[0].urls = {videos[video].base_url};
+    files[0].urls.insert(files[0].urls.end(), videos[video].backup_url.begin(), videos[video].backup_url.end());
+    if (audio >= 0) {
+        files[1].name = "audio.m4s";
+        files[1].urls = {audios[audio].base_url};
+        files[1].urls.insert(files[1].urls.end(), audios[audio].backup_url.begin(), audios[audio].backup_url.end());
+    }
+    for (auto& f : files) {
+        f.urls = CdnHelper::instance().sort(f.urls);
+        f.size = getContentLength(f.urls);
+        if (*cancel) break;
+        if (f.size <= 0) {
+            fail("Cannot get the size of " + f.name);
+            return;
+        }
+    }
+
+    // 播放地址中只保留下载的视频流与音频流，链接替换为本地文件
+    auto local  = data;
+    auto& dash  = local.at("dash");
+    auto stream = dash.at("video").at((size_t)video);
+    std::string description;
+    for (size_t i = 0; i < url.accept_quality.size() && i < url.accept_description.size(); i++) {
+        if (url.accept_quality[i] == videos[video].id) description = url.accept_description[i];
+    }
+    stream["base_url"]   = getPath(key, files[0].name);
+    stream["backup_url"] = nlohmann::json::array();
+    dash["video"]        = nlohmann::json::array({stream});
+    dash["audio"]        = nlohmann::json::array();
+    if (audio >= 0) {
+        stream               = data.at("dash").at("audio").at((size_t)audio);
+        stream["base_url"]   = getPath(key, files[1].name);
+        stream["backup_url"] = nlohmann::json::array();
+        dash["audio"].push_back(stream);
+    }
+    dash.erase("dolby");
+    dash.erase("flac");
+    local.erase("durl");
+    local["quality"]            = videos[video].id;
+    local["accept_quality"]     = nlohmann::json::array({videos[video].id});
+    local["accept_description"] = nlohmann::json::array({description});
+    if (*cancel) {
+        std::lock_guard<std::mutex> lock(mutex);
+        task->preparing = false;
+        condition.notify_all();
+        return;
+    }
+    writeFile(getPath(key, "playurl.json"), local.dump());
+
+    // 弹幕、分P详情、字幕与防遮挡数据只下载一次，失败时在下次获取链接时重试
+    std::error_code ec;
+    std::string content;
+    if (!cpr::fs::exists(getPath(key, "danmaku.xml"), ec)) {
+        auto r = bilibili::HTTP::get(bilibili::Api::VideoDanmaku, {{"oid", std::to_string(info.cid)}});
+        if (!r.error && r.status_code == 200) writeFile(getPath(key, "danmaku.xml"), r.text);
+    }
+    nlohmann::json page;
+    if (!cpr::fs::exists(getPath(key, "page.json"), ec) &&
+        getJson(bilibili::Api::PageDetail, {{"bvid", info.bvid}, {"cid", std::to_string(info.cid)}}, page, error)) {
+        try {
+            bool success = true;
+            if (page.contains("dm_mask") && page.at("dm_mask").is_object() &&
+                page.at("dm_mask").contains("mask_url")) {
+                auto& mask = page.at("dm_mask").at("mask_url");
+                if (mask.is_string() && !mask.get<std::string>().empty()) {
+                    std::string path = getPath(key, "mask.webmask");
+                    if (!getFile(mask.get<std::string>(), content) || !writeFile(path, content)) success = false;
+                    mask = getFileUrl(path);
+                }
+            }
+            if (page.contains("subtitle") && page.at("subtitle").is_object() &&
+                page.at("subtitle").contains("subtitles") && page.at("subtitle").at("subtitles").is_array()) {
+                auto& subtitles = page.at("subtitle").at("subtitles");
+                for (size_t i = 0; i < subtitles.size(); i++) {
+                    std::string path = getPath(key, fmt::format("subtitle_{}.json", i));
+                    auto& link       = subtitles[i].at("subtitle_url");
+                    if (!getFile(link.get<std::string>(), content) || !writeFile(path, content)) success = false;
+                    link = getFileUrl(path);
+                }
+            }
+            if (success) writeFile(getPath(key, "page.json"), page.dump());
+        } catch (const std::exception& e) {
+            brls::Logger::error("DownloadManager: {} page detail: {}", key, e.what());
+        }
+    }
+    // 用户投稿视频保存视频详情，断网时也可以打开
+    nlohmann::json detail;
+    if (info.epid == 0 && !cpr::fs::exists(getPath(key, "detail.json"), ec) &&
+        getJson(bilibili::Api::DetailAll, {{"bvid", info.bvid}}, detail, error)) {
+        writeFile(getPath(key, "detail.json"), detail.dump());
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    task->preparing = false;
+    if (*cancel) {
+        condition.notify_all();
+        return;
+    }
+    // 文件大小不变时保留已下载的分块
+    for (auto& f : files) {
+        std::string path = getPath(key, f.name);
+        for (auto& old : task->files) {
+            if (old.name == f.name && old.size == f.size && cpr::fs::exists(path, ec)) f.chunks = old.chunks;
+        }
+        if (f.chunks.empty()) {
+            std::ofstream create(path, std::ios::binary);
+            f.chunks.assign((f.size + CHUNK_SIZE - 1) / CHUNK_SIZE, false);
+        }
+    }
+    task->files    = files;
+    task->videoId  = videos[video].id;
+    task->codecId  = videos[video].codecid;
+    task->audioId  = audio < 0 ? 0 : audios[audio].id;
+    task->prepared = true;
+    this->save(*task);
+    this->checkFinished(*task);
+    condition.notify_all();
+    brls::Logger::info("DownloadManager: {} ready, {}MB", key, task->getSize() / 1024 / 1024);
+}
+
+void DownloadManager::fetch(const std::shared_ptr<DownloadTask>& task, size_t index, size_t chunk) {
+    std::string path, url;
+    int64_t from, to;
+    std::shared_ptr<std::atomic<bool>> cancel;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto& file = task->files[index];
+        path       = getPath(task->getKey(), file.name);
+        url        = file.urls[file.failure % file.urls.size()];
+        from       = (int64_t)chunk * CHUNK_SIZE;
+        to         = std::min(from + CHUNK_SIZE, file.size) - 1;
+        cancel     = task->cancel;
+    }
+
+    // 服务器忽略 Range 返回完整文件或返回错误信息时，不能写入文件
+    int status = 0;
+    std::string data;
+    data.reserve(to - from + 1);
+    auto r = cpr::Get(
+        cpr::Url{url}, cpr::Range{from, to}, cpr::Timeout{DOWNLOAD_CHUNK_TIMEOUT}, bilibili::HTTP::HEADERS,
+        bilibili::HTTP::PROXIES, bilibili::HTTP::VERIFY, cpr::HeaderCallback{[&](auto header, intptr_t) -> bool {
+            if (header.size() > 9 && header.substr(0, 5) == "HTTP/") {
+                status = std::atoi(std::string(header.substr(header.find(' ') + 1, 3)).c_str());
+            }
+            return true;
+        }},
+        cpr::WriteCallback{[&](auto buffer, intptr_t) -> bool {
+            if (*cancel || status != 206 || data.size() + buffer.size() > (size_t)(to - from + 1)) return false;
+            this->limit(buffer.size());
+            data.append(buffer.data(), buffer.size());
+            return true;
+        }},
+        // 没有收到数据时也会定期调用，暂停或退出时可以立即中断卡住的连接
+        cpr::ProgressCallback([cancel](...) -> bool { return !*cancel; }),
+        cpr::LowSpeed{DOWNLOAD_STALL_SPEED, DOWNLOAD_STALL_TIME});
+
+    bool success = !*cancel && !r.error && status == 206 && data.size() == (size_t)(to - from + 1);
+    if (success) {
+        std::fstream file(path, std::ios::in | std::ios::out | std::ios::binary);
+        success = file && file.seekp(from) && file.write(data.data(), (std::streamsize)data.size()) && file.flush();
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    auto& file = task->files[index];
+    file.fetching.erase(chunk);
+    if (success) {
+        file.chunks[chunk] = true;
+        this->save(*task);
+        this->checkFinished(*task);
+    } else if (!*cancel) {
+        file.failure++;
+        brls::Logger::warning("DownloadManager: {}/{} chunk {} failed ({}) {}", task->getKey(), file.name, chunk,
+                              status, r.error.message);
+        CdnHelper::instance().reportFailure(url);
+        // 所有链接都多次失败后重新获取链接，多次重新获取后仍然失败时停止下载
+        if (task->prepared && file.failure >= MAX_RETRY * file.urls.size()) {
+            task->prepared = false;
+            if (++task->refreshCount > MAX_RETRY) {
+                task->state = DownloadState::FAILED;
+                task->error = r.error ? r.error.message
+                                      : "Network error. [Status code: " + std::to_string(status) + " ]";
+                this->save(*task);
+                brls::Logger::error("DownloadManager: {} failed: {}", task->getKey(), task->error);
+            }
+        }
+    }
+    condition.notify_all();
+}
+
+void DownloadManager::checkFinished(DownloadTask& task) {
+    if (task.state == DownloadState::DONE || task.files.empty()) return;
+    for (auto& f : task.files) {
+        if (!f.fetching.empty() || f.size < 0) return;
+        if (std::find(f.chunks.begin(), f.chunks.end(), false) != f.chunks.end()) return;
+    }
+    task.state = DownloadState::DONE;
+    this->save(task);
+    brls::Logger::info("DownloadManager: {} done", task.getKey());
+    std::string title = task.title;
+    brls::sync([title]() { brls::Application::notify(wiliwili::format("wiliwili/download/done"_i18n, title)); });
+}
+
+void DownloadManager::limit(size_t size) {
+    int bandwidth = BANDWIDTH.load();
+    if (bandwidth <= 0) return;
+    double rate = bandwidth * 1024.0;
+    int64_t wait;
+    {
+        std::lock_guard<std::mutex> lock(limitMutex);
+        int64_t now = std::chrono::duration_cast<std::chrono::milliseconds>(
+                          std::chrono::steady_clock::now().time_since_epoch())
+                          .count();
+        // 空闲时最多积累 1s 的数据量，超出的部分记为欠额，由之后的请求依次等待
+        limitTokens     = std::min(rate, limitTokens + (double)(now - limitLastRefill) * rate / 1000.0);
+        limitLastRefill = now;
+        limitTokens -= (double)size;
+        wait = limitTokens < 0 ? (int64_t)(-limitTokens * 1000.0 / rate) : 0;
+    }
+    if (wait > 0) std::this_thread::sleep_for(std::chrono::milliseconds(wait));
+}
@@ -0,0 +1,72 @@
+#include <borealis/core/application.hpp>
+#include <borealis/core/logger.hpp>
+
+#include <algorithm>
+
+#include "utils/frame_scheduler.hpp"
+
+void FrameScheduler::markDirty() { this->lastDirty = brls::getCPUTimeUsec(); }
+
+size_t FrameScheduler::advance(brls::Time& last, brls::Time interval) {
+    if (interval <= 0) interval = 1;
+    brls::Time redraw = interval;
+    if (LOW_PRIORITY_FPS > 0) redraw = std::max(redraw, (brls::Time)(1000000 / LOW_PRIORITY_FPS));
+    brls::Time now = brls::getCPUTimeUsec();
+    if (now - last < redraw) return 0;
+    auto steps = (size_t)((now - last) / interval);
+    // 保留不足一帧的时间；很久没有绘制时（比如被其他页面遮挡）从当前时间重新开始
+    last = now - last > interval * 100 ? now : last + (brls::Time)steps * interval;
+    return steps;
+}
+
+void FrameScheduler::setDeactivation(int time, int fps) {
+    deactivation = time > 0;
+    brls::Application::setDeactivatedFPS(fps);
+    brls::Application::setAutomaticDeactivation(deactivation);
+    if (deactivation) brls::Application::setDeactivatedTime(time);
+    DEACTIVATED_FPS = deactivation && fps > 0 ? fps : 0;
+}
+
+bool FrameScheduler::isDeactivationEnabled() const { return deactivation; }
+
+void FrameScheduler::onFrame() {
+    brls::Time now = brls::getCPUTimeUsec();
+    if (now - lastDirty < ACTIVE_TIME * 1000) brls::Application::setActiveEvent(true);
+
+    frameTime = lastFrame == 0 ? 0 : now - lastFrame;
+    lastFrame = now;
+    if (!idleTasks.empty() && isIdleFrame()) {
+        // 任务执行过程中可能会添加新的任务
+        std::vector<std::function<bool()>> tasks;
+        tasks.swap(idleTasks);
+        for (auto& task : tasks) {
+            if (task()) idleTasks.emplace_back(std::move(task));
+        }
+    }
+
+    frames++;
+    if (lastSecond == 0) lastSecond = now;
+    if (now - lastSecond < 1000000) return;
+
+    // 按实际经过的时间换算，避免闲置时一帧跨越多秒导致统计偏小
+    double seconds = (double)(now - lastSecond) / 1000000.0;
+    renderedFrames = (size_t)((double)frames / seconds);
+    skippedFrames  = renderedFrames < TARGET_FPS ? TARGET_FPS - renderedFrames : 0;
+    frames         = 0;
+    lastSecond     = now;
+    brls::Logger::verbose("FrameScheduler: {} frames rendered, {} skipped", renderedFrames, skippedFrames);
+}
+
+void FrameScheduler::addIdleTask(const std::function<bool()>& task) { idleTasks.emplace_back(task); }
+
+bool FrameScheduler::isIdleFrame() const {
+    if (frameTime == 0) return true;
+    // 闲置状态下帧间隔本来就长，不代表上一帧繁忙
+    if (DEACTIVATED_FPS > 0 && frameTime >= 900000 / (brls::Time)DEACTIVATED_FPS) return true;
+    size_t fps = TARGET_FPS > 0 ? TARGET_FPS : 60;
+    return frameTime < 1500000 / (brls::Time)fps;
+}
+
+size_t FrameScheduler::getSkippedFrames() const { return skippedFrames; }
+
+size_t FrameScheduler::getRenderedFrames() const { return renderedFrames; }
@@ -9,6 +9,7 @@
 #include <stb_image.h>
 
 #include "utils/image_helper.hpp"
+#include "utils/frame_scheduler.hpp"
 #include "api/bilibili/util/http.hpp"
 
 #ifdef USE_WEBP
@@ -132,6 +133,7 @@ void ImageHelper::requestImage() {
         if (tex > 0) {
             brls::Logger::verbose("cache hit 2: {}", this->imageUrl);
             this->imageView->innerSetImage(tex);
+            FrameScheduler::instance().markDirty();
         } else {
             NVGcontext* vg = brls::Application::getNVGContext();
             if (imageData) {
@@ -145,6 +147,7 @@ void ImageHelper::requestImage() {
                 if (!this->isCancel) {
                     brls::Logger::verbose("load image: {}", this->imageUrl);
                     this->imageView->innerSetImage(tex);
+                    FrameScheduler::instance().markDirty();
                 }
             }
         }
@@ -0,0 +1,327 @@
+#ifdef LOCAL_TEST_SERVER
+
+#include <mongoose.h>
+#include <cpr/cpr.h>
+#include <cpr/filesystem.h>
+#include <pystring.h>
+#include <borealis/core/logger.hpp>
+
+#include <algorithm>
+#include <fstream>
+#include <regex>
+#include <set>
+#include <sstream>
+
+#include "bilibili/util/http.hpp"
+#include "utils/local_server.hpp"
+
+// 这些文件的请求参数只用于鉴权，只根据路径保存
+static const std::set<std::string> STATIC_EXTENSIONS = {".m4s",  ".mp4", ".flv", ".jpg",     ".jpeg",
+                                                        ".png",  ".webp", ".gif", ".webmask", ".svga"};
+
+// 不影响响应内容的请求参数
+static const std::set<std::string> IGNORED_PARAMETERS = {"ts", "wts", "w_rid", "sign"};
+
+static std::string toString(const struct mg_str& str) { return std::string{str.buf, str.len}; }
+
+static bool isStatic(const std::string& path) {
+    std::string ext = pystring::lower(pystring::os::path::splitext(path).second);
+    return STATIC_EXTENSIONS.count(ext) > 0;
+}
+
+static std::string getContentType(const std::string& path, const std::string& data) {
+    std::string ext = pystring::lower(pystring::os::path::splitext(path).second);
+    if (ext == ".m4s" || ext == ".mp4") return "video/mp4";
+    if (ext == ".flv") return "video/x-flv";
+    if (ext == ".jpg" || ext == ".jpeg") return "image/jpeg";
+    if (ext == ".png") return "image/png";
+    if (ext == ".webp") return "image/webp";
+    if (ext == ".gif") return "image/gif";
+    if (!data.empty() && (data[0] == '{' || data[0] == '[')) return "application/json";
+    return "application/octet-stream";
+}
+
+/// 将 json 中的链接替换为本地服务器的地址，使后续的媒体与图片请求也发送到本地
+static std::string rewriteUrls(const std::string& data) {
+    static const std::regex URL_REGEX(R"("(https?:)?//([A-Za-z0-9.\-]+)/)");
+    return std::regex_replace(data, URL_REGEX, "\"" LOCAL_TEST_SERVER_URL "$2/");
+}
+
+/// 解析 Range 请求头，返回 false 时表示范围无效
+static bool parseRange(const std::string& range, uint64_t size, uint64_t& start, uint64_t& end) {
+    start = 0;
+    end   = size == 0 ? 0 : size - 1;
+    if (!pystring::startswith(range, "bytes=")) return true;
+    auto spec = pystring::split(range.substr(6), ",")[0];
+    auto dash = spec.find('-');
+    if (dash == std::string::npos) return false;
+    std::string first = pystring::strip(spec.substr(0, dash)), last = pystring::strip(spec.substr(dash + 1));
+    try {
+        if (first.empty()) {
+            // bytes=-N 表示最后 N 个字节
+            uint64_t suffix = std::stoull(last);
+            start           = size > suffix ? size - suffix : 0;
+        } else {
+            start = std::stoull(first);
+            if (!last.empty()) end = std::min(end, (uint64_t)std::stoull(last));
+        }
+    } catch (const std::exception& e) {
+        return false;
+    }
+    return start < size && start <= end;
+}
+
+LocalServer::~LocalServer() { this->stop(); }
+
+bool LocalServer::start(const std::string& dir) {
+    if (running) return true;
+    this->root = dir;
+    this->mgr  = new mg_mgr;
+    mg_log_set(MG_LL_NONE);
+    mg_mgr_init(this->mgr);
+    mg_wakeup_init(this->mgr);
+    if (!mg_http_listen(this->mgr, "http://" LOCAL_TEST_SERVER_HOST, eventHandler, this)) {
+        brls::Logger::error("LocalServer: cannot listen on {}", LOCAL_TEST_SERVER_HOST);
+        mg_mgr_free(this->mgr);
+        delete this->mgr;
+        this->mgr = nullptr;
+        return false;
+    }
+
+    running      = true;
+    this->thread = std::thread([this]() {
+        while (running) mg_mgr_poll(this->mgr, 10);
+    });
+    brls::Logger::info("LocalServer: serving {} at {} (latency {}ms, bandwidth {}KB/s, record {})", root,
+                       LOCAL_TEST_SERVER_HOST, LATENCY, BANDWIDTH / 1024, RECORD);
+    return true;
+}
+
+void LocalServer::stop() {
+    if (!running) return;
+    running = false;
+    if (thread.joinable()) thread.join();
+    for (auto& i : transfers) {
+        if (i.second.file) fclose(i.second.file);
+    }
+    transfers.clear();
+    mg_mgr_free(this->mgr);
+    delete this->mgr;
+    this->mgr = nullptr;
+}
+
+std::string LocalServer::getFixturePath(const LocalRequest& request) const {
+    std::string path = root + "/" + request.host + request.path;
+    if (pystring::endswith(path, "/")) path += "index";
+    if (isStatic(request.path)) return path;
+
+    std::vector<std::string> parameters;
+    for (auto& i : pystring::split(request.query, "&")) {
+        if (i.empty() || IGNORED_PARAMETERS.count(i.substr(0, i.find('='))) > 0) continue;
+        parameters.emplace_back(i);
+    }
+    std::sort(parameters.begin(), parameters.end());
+    std::string key = pystring::join("&", parameters) + "\n" + request.body;
+    return path + "." + websocketpp::md5::md5_hash_hex(key);
+}
+
+void LocalServer::eventHandler(struct mg_connection* c, int ev, void* ev_data) {
+    auto* self = (LocalServer*)c->fn_data;
+    if (ev == MG_EV_HTTP_MSG) {
+        auto* hm = (struct mg_http_message*)ev_data;
+        LocalRequest request;
+        request.method = toString(hm->method);
+        request.query  = toString(hm->query);
+        request.body   = toString(hm->body);
+        auto* range    = mg_http_get_header(hm, "Range");
+        if (range) request.range = toString(*range);
+
+        // /<域名>/<路径>
+        std::string uri = toString(hm->uri);
+        auto pos        = uri.find('/', 1);
+        request.host    = uri.substr(1, pos == std::string::npos ? std::string::npos : pos - 1);
+        request.path    = pos == std::string::npos ? "/" : uri.substr(pos);
+        if (request.host.empty() || uri.find("..") != std::string::npos) {
+            self->reply(c, 403, "Forbidden");
+            return;
+        }
+
+        auto& transfer   = self->transfers[c->id];
+        transfer         = LocalTransfer{};
+        transfer.request = std::move(request);
+        transfer.ready   = mg_millis() + LATENCY;
+        self->respond(c, transfer);
+    } else if (ev == MG_EV_WAKEUP) {
+        // 录制结束
+        auto it = self->transfers.find(c->id);
+        if (it == self->transfers.end()) return;
+        it->second.recording = false;
+        if (toString(*(struct mg_str*)ev_data) == "1") {
+            self->respond(c, it->second);
+        } else {
+            self->transfers.erase(it);
+            self->reply(c, 502, "Bad Gateway");
+        }
+    } else if (ev == MG_EV_POLL || ev == MG_EV_WRITE) {
+        auto it = self->transfers.find(c->id);
+        if (it == self->transfers.end() || it->second.recording) return;
+        if (self->pump(c, it->second)) {
+            if (it->second.file) fclose(it->second.file);
+            self->transfers.erase(it);
+        }
+    } else if (ev == MG_EV_CLOSE) {
+        auto it = self->transfers.find(c->id);
+        if (it == self->transfers.end()) return;
+        if (it->second.file) fclose(it->second.file);
+        self->transfers.erase(it);
+    }
+}
+
+void LocalServer::respond(struct mg_connection* c, LocalTransfer& transfer) {
+    auto& request    = transfer.request;
+    std::string path = getFixturePath(request);
+    std::error_code ec;
+    if (!cpr::fs::exists(path, ec)) {
+        if (!RECORD) {
+            brls::Logger::warning("LocalServer: missing {}{}?{}", request.host, request.path, request.query);
+            transfers.erase(c->id);
+            reply(c, 404, "Not Found");
+            return;
+        }
+        transfer.recording = true;
+        record(c, request);
+        return;
+    }
+
+    uint64_t size = cpr::fs::file_size(path, ec);
+    uint64_t start, end;
+    if (!parseRange(request.range, size, start, end)) {
+        mg_printf(c, "HTTP/1.1 416 Range Not Satisfiable\r\nContent-Range: bytes */%llu\r\nContent-Length: 0\r\n\r\n",
+                  (unsigned long long)size);
+        transfers.erase(c->id);
+        return;
+    }
+    uint64_t length = size == 0 ? 0 : end - start + 1;
+
+    std::string type;
+    if (isStatic(request.path)) {
+        // 媒体文件直接从磁盘中分段读取
+        transfer.file = fopen(path.c_str(), "rb");
+        if (!transfer.file || fseek(transfer.file, (long)start, SEEK_SET) != 0) {
+            transfers.erase(c->id);
+            reply(c, 500, "Internal Server Error");
+            return;
+        }
+        transfer.remaining = length;
+        type               = getContentType(request.path, "");
+    } else {
+        std::ifstream file(path, std::ios::binary);
+        std::stringstream buffer;
+        buffer << file.rdbuf();
+        transfer.data = buffer.str();
+        type          = getContentType(request.path, transfer.data);
+        if (type == "application/json") transfer.data = rewriteUrls(transfer.data);
+        // 替换链接后长度会发生变化，api 请求总是返回完整的内容
+        start = 0;
+        size = length = transfer.data.size();
+        end           = length == 0 ? 0 : length - 1;
+    }
+
+    bool partial    = !request.range.empty() && transfer.file;
+    transfer.header = fmt::format(
+        "HTTP/1.1 {}\r\nContent-Type: {}\r\nContent-Length: {}\r\nAccept-Ranges: bytes\r\n"
+        "Access-Control-Allow-Origin: *\r\n",
+        partial ? "206 Partial Content" : "200 OK", type, length);
+    if (partial) transfer.header += fmt::format("Content-Range: bytes {}-{}/{}\r\n", start, end, size);
+    transfer.header += "\r\n";
+    if (request.method == "HEAD") {
+        transfer.data.clear();
+        transfer.remaining = 0;
+    }
+}
+
+void LocalServer::record(struct mg_connection* c, const LocalRequest& request) {
+    std::string url  = "https://" + request.host + request.path;
+    std::string path = getFixturePath(request);
+    if (!request.query.empty()) url += "?" + request.query;
+    unsigned long id = c->id;
+    brls::Logger::info("LocalServer: recording {}", url);
+
+    cpr::async([this, id, url, path, request]() {
+        cpr::Response r;
+        if (request.method == "POST") {
+            r = cpr::Post(cpr::Url{url}, cpr::Body{request.body}, CPR_HTTP_BASE);
+        } else {
+            r = cpr::Get(cpr::Url{url}, CPR_HTTP_BASE);
+        }
+
+        bool success = !r.error && r.status_code == 200;
+        if (success) {
+            // 先写入临时文件，避免中断录制后留下不完整的文件
+            std::error_code ec;
+            cpr::fs::create_directories(cpr::fs::path(path).parent_path(), ec);
+            std::string temp = path + ".tmp";
+            std::ofstream file(temp, std::ios::binary);
+            file.write(r.text.data(), (std::streamsize)r.text.size());
+            file.close();
+            cpr::fs::rename(temp, path, ec);
+            success = file.good() && !ec;
+        }
+        if (!success) {
+            brls::Logger::error("LocalServer: failed to record {} ({}) {}", url, r.status_code, r.error.message);
+        }
+        if (running) mg_wakeup(this->mgr, id, success ? "1" : "0", 1);
+    });
+}
+
+bool LocalServer::pump(struct mg_connection* c, LocalTransfer& transfer) {
+    uint64_t now = mg_millis();
+    if (now < transfer.ready || (transfer.header.empty() && transfer.lastPump == 0)) return false;
+
+    if (!transfer.header.empty()) {
+        mg_send(c, transfer.header.data(), transfer.header.size());
+        transfer.header.clear();
+        transfer.lastPump = now;
+    }
+
+    if (BANDWIDTH > 0) {
+        // 令牌桶，最多积累一秒的数据量
+        transfer.budget += (double)(now - transfer.lastPump) * BANDWIDTH / 1000.0;
+        transfer.budget = std::min(transfer.budget, (double)BANDWIDTH);
+    }
+    transfer.lastPump = now;
+
+    char buffer[16 * 1024];
+    while (c->send.len < SEND_BUFFER) {
+        size_t size = SEND_BUFFER - c->send.len;
+        if (BANDWIDTH > 0) {
+            if (transfer.budget < 1) break;
+            size = std::min(size, (size_t)transfer.budget);
+        }
+        if (transfer.offset < transfer.data.size()) {
+            size = std::min(size, transfer.data.size() - transfer.offset);
+            mg_send(c, transfer.data.data() + transfer.offset, size);
+            transfer.offset += size;
+        } else if (transfer.file && transfer.remaining > 0) {
+            size = std::min({size, sizeof(buffer), (size_t)transfer.remaining});
+            size = fread(buffer, 1, size, transfer.file);
+            if (size == 0) {
+                // 文件被截断，无法继续发送
+                c->is_draining = 1;
+                return true;
+            }
+            mg_send(c, buffer, size);
+            transfer.remaining -= size;
+        } else {
+            break;
+        }
+        if (BANDWIDTH > 0) transfer.budget -= (double)size;
+    }
+    return transfer.offset >= transfer.data.size() && transfer.remaining == 0;
+}
+
+void LocalServer::reply(struct mg_connection* c, int code, const std::string& message) {
+    mg_http_reply(c, code, "Content-Type: text/plain\r\n", "%s\n", message.c_str());
+}
+
+#endif
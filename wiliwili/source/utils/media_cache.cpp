@@ -0,0 +1,468 @@
+// 32 位平台上同样使用 64 位的文件偏移
+#ifndef _FILE_OFFSET_BITS
+#define _FILE_OFFSET_BITS 64
+#endif
+
+#include <mongoose.h>
+#include <cpr/cpr.h>
+#include <cpr/filesystem.h>
+#include <nlohmann/json.hpp>
+#include <pystring.h>
+#include <borealis/core/logger.hpp>
+
+#include <algorithm>
+#include <fstream>
+
+#include "bilibili/util/http.hpp"
+#include "utils/config_helper.hpp"
+#include "utils/media_cache.hpp"
+#include "utils/number_helper.hpp"
+#include "utils/string_helper.hpp"
+
+// 代理服务器使用的端口，被占用时依次尝试后面的端口
+#define MEDIA_CACHE_PORT 9600
+#define MEDIA_CACHE_PORT_RETRY 10
+
+static int64_t now() { return (int64_t)wiliwili::getUnixTime(); }
+
+/// 定位到文件中的指定位置，支持超过 2GB 的偏移
+static int seekFile(FILE* file, int64_t offset) {
+#ifdef _WIN32
+    return _fseeki64(file, offset, SEEK_SET);
+#else
+    return fseeko(file, (off_t)offset, SEEK_SET);
+#endif
+}
+
+static std::string toString(const struct mg_str& str) { return std::string{str.buf, str.len}; }
+
+static bool isValidKey(const std::string& key) {
+    if (key.empty()) return false;
+    return std::all_of(key.begin(), key.end(), [](char c) { return isalnum((unsigned char)c) || c == '_'; });
+}
+
+MediaCache::~MediaCache() { this->stop(); }
+
+std::string MediaCache::getPath(const std::string& key, const std::string& ext) { return dir + "/" + key + ext; }
+
+bool MediaCache::start() {
+    if (running) return true;
+    this->load();
+
+    this->mgr = new mg_mgr;
+    mg_mgr_init(this->mgr);
+    mg_wakeup_init(this->mgr);
+    for (int i = 0; i < MEDIA_CACHE_PORT_RETRY && port == 0; i++) {
+        std::string address = fmt::format("http://127.0.0.1:{}", MEDIA_CACHE_PORT + i);
+        if (mg_http_listen(this->mgr, address.c_str(), eventHandler, this)) port = MEDIA_CACHE_PORT + i;
+    }
+    if (port == 0) {
+        brls::Logger::error("MediaCache: cannot start proxy");
+        mg_mgr_free(this->mgr);
+        delete this->mgr;
+        this->mgr = nullptr;
+        return false;
+    }
+
+    running      = true;
+    this->thread = std::thread([this]() {
+        while (running) mg_mgr_poll(this->mgr, 20);
+    });
+    brls::Logger::info("MediaCache: proxy on port {}, {} entries, {}MB cached", port, entries.size(),
+                       getCachedSize() / 1024 / 1024);
+    return true;
+}
+
+void MediaCache::stop() {
+    if (!running) return;
+    running = false;
+    if (thread.joinable()) thread.join();
+    // 取消所有下载
+    for (auto& i : transfers) this->finish(i.second);
+    transfers.clear();
+    {
+        std::lock_guard<std::mutex> lock(wakeupMutex);
+        mg_mgr_free(this->mgr);
+        delete this->mgr;
+        this->mgr = nullptr;
+    }
+    this->port = 0;
+
+    std::unique_lock<std::mutex> lock(mutex);
+    fetchDone.wait(lock, [this]() { return fetchCount == 0; });
+    for (auto& i : entries) saveEntry(i.first, i.second);
+}
+
+void MediaCache::wakeup(unsigned long id, const char* message) {
+    std::lock_guard<std::mutex> lock(wakeupMutex);
+    if (running && this->mgr) mg_wakeup(this->mgr, id, message, 1);
+}
+
+void MediaCache::load() {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (loaded) return;
+    loaded    = true;
+    this->dir = ProgramConfig::instance().getConfigDir() + "/media_cache";
+    std::error_code ec;
+    cpr::fs::create_directories(dir, ec);
+    for (auto& file : cpr::fs::directory_iterator(dir, ec)) {
+        auto path = file.path();
+        if (path.extension() != ".json") continue;
+        std::string key = path.stem().string();
+        try {
+            std::ifstream readFile(path.string());
+            nlohmann::json content;
+            readFile >> content;
+            MediaCacheEntry entry;
+            entry.size   = content.at("size").get<int64_t>();
+            entry.type   = content.at("type").get<std::string>();
+            entry.access = content.at("access").get<int64_t>();
+            auto chunks  = content.at("chunks").get<std::string>();
+            for (char c : chunks) entry.chunks.push_back(c == '1');
+            entry.cached = std::count(entry.chunks.begin(), entry.chunks.end(), true);
+            // 数据文件丢失或被截断时丢弃整个缓存
+            if (!cpr::fs::exists(getPath(key, ".data"), ec) || entry.size < 0) throw std::runtime_error("no data");
+            entries.emplace(key, std::move(entry));
+        } catch (const std::exception& e) {
+            brls::Logger::warning("MediaCache: drop {}: {}", key, e.what());
+            removeEntry(key);
+        }
+    }
+}
+
+void MediaCache::saveEntry(const std::string& key, const MediaCacheEntry& entry) {
+    std::string chunks;
+    chunks.reserve(entry.chunks.size());
+    for (bool i : entry.chunks) chunks.push_back(i ? '1' : '0');
+    nlohmann::json content = {
+        {"size", entry.size}, {"type", entry.type}, {"access", entry.access}, {"chunks", chunks}};
+    std::ofstream file(getPath(key, ".json"));
+    if (file) file << content.dump();
+}
+
+void MediaCache::removeEntry(const std::string& key) {
+    std::error_code ec;
+    cpr::fs::remove(getPath(key, ".json"), ec);
+    cpr::fs::remove(getPath(key, ".data"), ec);
+}
+
+void MediaCache::evict() {
+    int64_t limit = (int64_t)MAX_SIZE * 1024 * 1024;
+    int64_t total = 0;
+    for (auto& i : entries) total += (int64_t)i.second.cached * CHUNK_SIZE;
+
+    while (total > limit) {
+        auto oldest = entries.end();
+        for (auto it = entries.begin(); it != entries.end(); it++) {
+            if (it->second.users > 0 || !it->second.fetching.empty()) continue;
+            if (oldest == entries.end() || it->second.access < oldest->second.access) oldest = it;
+        }
+        if (oldest == entries.end()) break;
+        brls::Logger::info("MediaCache: evict {} ({}MB)", oldest->first,
+                           oldest->second.cached * CHUNK_SIZE / 1024 / 1024);
+        total -= (int64_t)oldest->second.cached * CHUNK_SIZE;
+        removeEntry(oldest->first);
+        entries.erase(oldest);
+    }
+}
+
+void MediaCache::clear() {
+    this->load();
+    std::lock_guard<std::mutex> lock(mutex);
+    for (auto it = entries.begin(); it != entries.end();) {
+        if (it->second.users > 0 || !it->second.fetching.empty()) {
+            it++;
+            continue;
+        }
+        removeEntry(it->first);
+        it = entries.erase(it);
+    }
+    servedBytes     = 0;
+    downloadedBytes = 0;
+}
+
+int64_t MediaCache::getCachedSize() {
+    this->load();
+    std::lock_guard<std::mutex> lock(mutex);
+    int64_t total = 0;
+    for (auto& i : entries) total += (int64_t)i.second.cached * CHUNK_SIZE;
+    return total;
+}
+
+double MediaCache::getHitRate() const {
+    uint64_t served = servedBytes, downloaded = downloadedBytes;
+    if (served == 0) return 0;
+    return 1.0 - std::min(1.0, (double)downloaded / (double)served);
+}
+
+std::string MediaCache::getUrl(const std::string& key, const std::string& url) {
+    if (MAX_SIZE <= 0 || !isValidKey(key) || !pystring::startswith(url, "http")) return url;
+    if (!running && !this->start()) return url;
+    return fmt::format("http://127.0.0.1:{}/{}?url={}", port, key, wiliwili::urlEncode(url));
+}
+
+void MediaCache::eventHandler(struct mg_connection* c, int ev, void* ev_data) {
+    auto* self = (MediaCache*)c->fn_data;
+    if (ev == MG_EV_HTTP_MSG) {
+        auto* hm = (struct mg_http_message*)ev_data;
+        MediaCacheTransfer transfer;
+        transfer.key = toString(hm->uri).substr(1);
+        char url[8192];
+        int len = mg_http_get_var(&hm->query, "url", url, sizeof(url));
+        if (!isValidKey(transfer.key) || len <= 0) {
+            mg_http_reply(c, 400, "", "Bad Request\n");
+            return;
+        }
+        transfer.url = std::string(url, len);
+
+        // 只支持单个范围
+        auto* range = mg_http_get_header(hm, "Range");
+        if (range) {
+            std::string value = toString(*range);
+            long long start = 0, end = -1;
+            if (sscanf(value.c_str(), "bytes=%lld-%lld", &start, &end) >= 1) {
+                transfer.start   = start;
+                transfer.end     = end;
+                transfer.partial = true;
+            }
+        }
+        transfer.pos = transfer.start;
+
+        {
+            std::lock_guard<std::mutex> lock(self->mutex);
+            auto& entry  = self->entries[transfer.key];
+            entry.access = now();
+            entry.users++;
+        }
+        auto& t = self->transfers[c->id];
+        self->finish(t);
+        t = std::move(transfer);
+        if (self->pump(c, t)) {
+            self->finish(t);
+            self->transfers.erase(c->id);
+        }
+    } else if (ev == MG_EV_POLL || ev == MG_EV_WRITE || ev == MG_EV_WAKEUP) {
+        auto it = self->transfers.find(c->id);
+        if (it == self->transfers.end() || it->second.key.empty()) return;
+        auto& t = it->second;
+        if (ev == MG_EV_WAKEUP) {
+            std::string message = toString(*(struct mg_str*)ev_data);
+            if (message != "c") t.fetching = false;
+            if (message == "e") {
+                // 下载失败，断开连接后播放器会尝试备用链接
+                if (!t.headerSent) mg_http_reply(c, 502, "", "Bad Gateway\n");
+                c->is_draining = 1;
+                self->finish(t);
+                self->transfers.erase(it);
+                return;
+            }
+        }
+        if (self->pump(c, t)) {
+            self->finish(t);
+            self->transfers.erase(it);
+        }
+    } else if (ev == MG_EV_CLOSE) {
+        auto it = self->transfers.find(c->id);
+        if (it == self->transfers.end()) return;
+        self->finish(it->second);
+        self->transfers.erase(it);
+    }
+}
+
+void MediaCache::finish(MediaCacheTransfer& transfer) {
+    if (transfer.key.empty()) return;
+    if (transfer.cancel) *transfer.cancel = true;
+    if (transfer.file) fclose(transfer.file);
+    transfer.file = nullptr;
+
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = entries.find(transfer.key);
+    if (it != entries.end()) {
+        it->second.users--;
+        saveEntry(it->first, it->second);
+    }
+    transfer.key.clear();
+}
+
+bool MediaCache::pump(struct mg_connection* c, MediaCacheTransfer& transfer) {
+    std::unique_lock<std::mutex> lock(mutex);
+    auto& entry = entries[transfer.key];
+
+    // 第一次请求这个视频流时，需要先下载一个分块才能知道文件大小
+    if (entry.size < 0) {
+        if (!transfer.fetching && entry.fetching.empty()) fetch(c, transfer, entry, transfer.start / CHUNK_SIZE);
+        return false;
+    }
+
+    if (!transfer.headerSent) {
+        if (transfer.end < 0 || transfer.end >= entry.size) transfer.end = entry.size - 1;
+        if (transfer.start >= entry.size || transfer.start > transfer.end) {
+            mg_printf(c,
+                      "HTTP/1.1 416 Range Not Satisfiable\r\nContent-Range: bytes */%lld\r\n"
+                      "Content-Length: 0\r\n\r\n",
+                      (long long)entry.size);
+            return true;
+        }
+        std::string header = fmt::format(
+            "HTTP/1.1 {}\r\nContent-Type: {}\r\nContent-Length: {}\r\nAccept-Ranges: bytes\r\n",
+            transfer.partial ? "206 Partial Content" : "200 OK",
+            entry.type.empty() ? "application/octet-stream" : entry.type, transfer.end - transfer.start + 1);
+        if (transfer.partial) {
+            header += fmt::format("Content-Range: bytes {}-{}/{}\r\n", transfer.start, transfer.end, entry.size);
+        }
+        header += "\r\n";
+        mg_send(c, header.data(), header.size());
+        transfer.headerSent = true;
+    }
+
+    char buffer[64 * 1024];
+    while (c->send.len < SEND_BUFFER && transfer.pos <= transfer.end) {
+        size_t index = transfer.pos / CHUNK_SIZE;
+        if (!entry.chunks[index]) {
+            // 其他连接正在下载这个分块时等待下载完成
+            if (!transfer.fetching && entry.fetching.count(index) == 0) fetch(c, transfer, entry, index);
+            return false;
+        }
+        int64_t chunkEnd = std::min(transfer.end + 1, (int64_t)(index + 1) * CHUNK_SIZE);
+        size_t size      = std::min((size_t)(chunkEnd - transfer.pos), sizeof(buffer));
+
+        if (!transfer.file) transfer.file = fopen(getPath(transfer.key, ".data").c_str(), "rb");
+        if (!transfer.file || seekFile(transfer.file, transfer.pos) != 0 ||
+            fread(buffer, 1, size, transfer.file) != size) {
+            // 缓存文件损坏，丢弃这个分块
+            brls::Logger::error("MediaCache: failed to read {} at {}", transfer.key, transfer.pos);
+            entry.chunks[index] = false;
+            entry.cached--;
+            c->is_draining = 1;
+            return true;
+        }
+        mg_send(c, buffer, size);
+        transfer.pos += (int64_t)size;
+        servedBytes += size;
+    }
+    return transfer.pos > transfer.end;
+}
+
+void MediaCache::fetch(struct mg_connection* c, MediaCacheTransfer& transfer, MediaCacheEntry& entry, size_t index) {
+    // 下载从 index 开始的连续未缓存分块，文件大小未知时只下载一个分块
+    size_t last = index;
+    if (entry.size >= 0) {
+        size_t endChunk = transfer.end / CHUNK_SIZE;
+        while (last + 1 <= endChunk && last + 1 - index < FETCH_CHUNKS && !entry.chunks[last + 1] &&
+               entry.fetching.count(last + 1) == 0) {
+            last++;
+        }
+    }
+    for (size_t i = index; i <= last; i++) entry.fetching.insert(i);
+
+    transfer.fetching = true;
+    transfer.cancel   = std::make_shared<std::atomic<bool>>(false);
+    fetchCount++;
+    int64_t from      = (int64_t)index * CHUNK_SIZE;
+    int64_t to        = (int64_t)(last + 1) * CHUNK_SIZE - 1;
+    if (entry.size >= 0) to = std::min(to, entry.size - 1);
+
+    unsigned long id = c->id;
+    cpr::async([this, id, index, last, from, to, key = transfer.key, url = transfer.url, cancel = transfer.cancel]() {
+        std::string path = getPath(key, ".data");
+        FILE* file       = fopen(path.c_str(), "r+b");
+        if (!file) file = fopen(path.c_str(), "w+b");
+
+        // 每下载完成一个分块就写入磁盘并通知代理线程
+        std::string data;
+        int64_t rangeEnd = to;
+        size_t next      = index;
+        bool success     = file != nullptr;
+        auto commit      = [&](bool final) {
+            // 最后一个分块可能不足 CHUNK_SIZE，只有完整下载到范围末尾时才写入
+            if (final && (int64_t)(next * CHUNK_SIZE + data.size()) != rangeEnd + 1) final = false;
+            while (success && (data.size() >= (size_t)CHUNK_SIZE || (final && !data.empty()))) {
+                size_t size = std::min(data.size(), (size_t)CHUNK_SIZE);
+                if (seekFile(file, (int64_t)next * CHUNK_SIZE) != 0 ||
+                    fwrite(data.data(), 1, size, file) != size || fflush(file) != 0) {
+                    success = false;
+                    break;
+                }
+                data.erase(0, size);
+                downloadedBytes += size;
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    auto& entry = entries[key];
+                    if (next < entry.chunks.size() && !entry.chunks[next]) {
+                        entry.chunks[next] = true;
+                        entry.cached++;
+                    }
+                    entry.fetching.erase(next);
+                }
+                next++;
+                if (!final) this->wakeup(id, "c");
+            }
+        };
+
+        cpr::Response r;
+        bool known;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            known = entries[key].size >= 0;
+        }
+        if (success && known) {
+            // 服务器忽略 Range 返回完整文件或返回错误信息时，不能写入缓存
+            int status = 0;
+            r          = cpr::Get(
+                cpr::Url{url}, cpr::Range{from, to}, bilibili::HTTP::HEADERS, bilibili::HTTP::PROXIES,
+                bilibili::HTTP::VERIFY, cpr::HeaderCallback{[&](auto header, intptr_t) -> bool {
+                    if (header.size() > 9 && header.substr(0, 5) == "HTTP/") {
+                        status = std::atoi(std::string(header.substr(header.find(' ') + 1, 3)).c_str());
+                    }
+                    return true;
+                }},
+                cpr::WriteCallback{[&](auto chunk, intptr_t) -> bool {
+                    if (*cancel || status != 206) return false;
+                    data.append(chunk.data(), chunk.size());
+                    commit(false);
+                    return success;
+                }},
+                cpr::ProgressCallback([cancel](...) -> bool { return !*cancel; }));
+        } else if (success) {
+            r = cpr::Get(cpr::Url{url}, cpr::Range{from, to}, bilibili::HTTP::HEADERS, bilibili::HTTP::PROXIES,
+                         bilibili::HTTP::VERIFY, cpr::ProgressCallback([cancel](...) -> bool { return !*cancel; }));
+            // Content-Range: bytes 0-1048575/12345678
+            long long total = -1;
+            auto range      = r.header["Content-Range"];
+            auto slash      = range.rfind('/');
+            if (r.status_code == 206 && slash != std::string::npos) total = std::atoll(range.c_str() + slash + 1);
+            if (total > 0) {
+                rangeEnd = std::min(to, (int64_t)total - 1);
+                std::lock_guard<std::mutex> lock(mutex);
+                auto& entry = entries[key];
+                if (entry.size < 0) {
+                    entry.size = total;
+                    entry.type = r.header["Content-Type"];
+                    entry.chunks.assign((total + CHUNK_SIZE - 1) / CHUNK_SIZE, false);
+                    entry.cached = 0;
+                }
+                data = std::move(r.text);
+            } else {
+                success = false;
+            }
+        }
+        // 服务器不支持 Range 请求时无法缓存，已经下载完整的分块仍然保留
+        if (r.error || r.status_code != 206) success = false;
+        if (success) commit(true);
+        if (file) fclose(file);
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            auto& entry = entries[key];
+            for (size_t i = index; i <= last; i++) entry.fetching.erase(i);
+            if (!success && !*cancel) {
+                brls::Logger::error("MediaCache: failed to fetch {} ({}) {}", key, r.status_code, r.error.message);
+            }
+            this->evict();
+        }
+        if (!*cancel) this->wakeup(id, success ? "d" : "e");
+
+        std::lock_guard<std::mutex> lock(mutex);
+        if (--fetchCount == 0) fetchDone.notify_all();
+    });
+}
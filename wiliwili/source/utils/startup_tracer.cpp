@@ -0,0 +1,72 @@
+#include <borealis/core/logger.hpp>
+#include <borealis/core/thread.hpp>
+#include <nlohmann/json.hpp>
+
+#include <fstream>
+
+#include "utils/startup_tracer.hpp"
+#include "utils/config_helper.hpp"
+
+/// StartupTracer::Scope
+
+StartupTracer::Scope::Scope(std::string name) : name(std::move(name)), start(StartupTracer::instance().now()) {}
+
+StartupTracer::Scope::~Scope() { StartupTracer::instance().add(name, start, StartupTracer::instance().now()); }
+
+/// StartupTracer
+
+StartupTracer::StartupTracer() { threads[std::this_thread::get_id()] = 1; }
+
+int64_t StartupTracer::now() const {
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - startTime)
+        .count();
+}
+
+void StartupTracer::add(const std::string& name, int64_t start, int64_t end) {
+    std::lock_guard<std::mutex> lock(eventsMutex);
+    auto it = threads.find(std::this_thread::get_id());
+    if (it == threads.end()) it = threads.emplace(std::this_thread::get_id(), threads.size() + 1).first;
+    Event event;
+    event.name     = name;
+    event.start    = start;
+    event.duration = end - start;
+    event.thread   = it->second;
+    events.emplace_back(event);
+    brls::Logger::debug("Startup: {} {}ms", name, event.duration / 1000);
+}
+
+bool StartupTracer::markFirstFrame() {
+    if (coldStartTime >= 0) return false;
+    int64_t end = now();
+    this->add("first_frame", 0, end);
+    coldStartTime = end / 1000;
+    brls::Logger::info("Startup: cold start to first frame {}ms", coldStartTime);
+    if (ENABLE) brls::delay(TRACE_DELAY, [this]() { this->save(); });
+    return true;
+}
+
+int64_t StartupTracer::getColdStartTime() const { return coldStartTime; }
+
+void StartupTracer::save() {
+    nlohmann::json trace = nlohmann::json::array();
+    {
+        std::lock_guard<std::mutex> lock(eventsMutex);
+        for (auto& i : events) {
+            trace.push_back({{"name", i.name},
+                             {"cat", "startup"},
+                             {"ph", "X"},
+                             {"ts", i.start},
+                             {"dur", i.duration},
+                             {"pid", 1},
+                             {"tid", i.thread}});
+        }
+    }
+    const std::string path = ProgramConfig::instance().getConfigDir() + "/startup_trace.json";
+    std::ofstream file(path);
+    if (!file) {
+        brls::Logger::error("Cannot write startup trace to: {}", path);
+        return;
+    }
+    file << nlohmann::json{{"traceEvents", trace}, {"displayTimeUnit", "ms"}}.dump();
+    brls::Logger::info("Write startup trace to: {}", path);
+}
@@ -0,0 +1,326 @@
+#include <borealis/core/application.hpp>
+#include <borealis/core/logger.hpp>
+#include <borealis/core/thread.hpp>
+#include <cpr/cpr.h>
+#include <cpr/filesystem.h>
+#include <lunasvg.h>
+#include <nlohmann/json.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+
+#include "utils/svg_atlas.hpp"
+#include "utils/config_helper.hpp"
+
+/// 生成图集的线程
+class SVGAtlasThreadPool : public cpr::ThreadPool, public brls::Singleton<SVGAtlasThreadPool> {
+public:
+    SVGAtlasThreadPool() : cpr::ThreadPool(1, 1, std::chrono::milliseconds(5000)) { this->Start(); }
+
+    ~SVGAtlasThreadPool() override { this->Stop(); }
+};
+
+static const char ATLAS_MAGIC[4]   = {'W', 'S', 'V', 'A'};
+static const uint32_t ATLAS_VERSION = 1;
+static const int ATLAS_PADDING      = 2;
+
+static std::string readSource(const std::string& name) {
+#ifdef USE_LIBROMFS
+    auto file = romfs::get(name);
+    return std::string((const char*)file.string().data(), file.size());
+#else
+    std::ifstream file(std::string(BRLS_RESOURCES) + name, std::ios::binary);
+    if (!file) return "";
+    std::stringstream ss;
+    ss << file.rdbuf();
+    return ss.str();
+#endif
+}
+
+/// FNV-1a，保证每次启动的结果一致
+static uint64_t hashData(uint64_t hash, const std::string& data) {
+    for (unsigned char c : data) {
+        hash ^= c;
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+template <typename T>
+static void writeValue(std::ofstream& file, T value) {
+    file.write((const char*)&value, sizeof(T));
+}
+
+template <typename T>
+static bool readValue(std::ifstream& file, T& value) {
+    return (bool)file.read((char*)&value, sizeof(T));
+}
+
+static bool loadAtlasFile(const std::string& path, SVGAtlasData& data) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file) return false;
+    char magic[4];
+    uint32_t version = 0, count = 0;
+    if (!file.read(magic, 4) || memcmp(magic, ATLAS_MAGIC, 4) != 0) return false;
+    if (!readValue(file, version) || version != ATLAS_VERSION) return false;
+    if (!readValue(file, data.width) || !readValue(file, data.height) || !readValue(file, count)) return false;
+    if (data.width <= 0 || data.height <= 0 || data.width > SVGAtlas::MAX_SIZE || data.height > SVGAtlas::MAX_SIZE)
+        return false;
+    for (uint32_t i = 0; i < count; i++) {
+        uint32_t length = 0;
+        if (!readValue(file, length) || length > 4096) return false;
+        std::string key(length, '\0');
+        SVGAtlasEntry entry;
+        if (!file.read(&key[0], length)) return false;
+        if (!readValue(file, entry.x) || !readValue(file, entry.y) || !readValue(file, entry.width) ||
+            !readValue(file, entry.height))
+            return false;
+        data.entries[key] = entry;
+    }
+    data.pixels.resize((size_t)data.width * data.height * 4);
+    return (bool)file.read((char*)data.pixels.data(), (std::streamsize)data.pixels.size());
+}
+
+static void saveAtlasFile(const std::string& path, const SVGAtlasData& data) {
+    std::ofstream file(path, std::ios::binary);
+    if (!file) return;
+    file.write(ATLAS_MAGIC, 4);
+    writeValue(file, ATLAS_VERSION);
+    writeValue(file, data.width);
+    writeValue(file, data.height);
+    writeValue(file, (uint32_t)data.entries.size());
+    for (auto& i : data.entries) {
+        writeValue(file, (uint32_t)i.first.size());
+        file.write(i.first.data(), (std::streamsize)i.first.size());
+        writeValue(file, i.second.x);
+        writeValue(file, i.second.y);
+        writeValue(file, i.second.width);
+        writeValue(file, i.second.height);
+    }
+    file.write((const char*)data.pixels.data(), (std::streamsize)data.pixels.size());
+}
+
+/**
+ * 按高度从大到小逐行摆放图标，再逐个渲染到图集中
+ * 放不下的图标会被跳过
+ */
+static void renderAtlas(const std::vector<std::pair<std::string, std::string>>& sources,
+                        const std::vector<std::pair<int, int>>& sizes, SVGAtlasData& data) {
+    std::vector<size_t> order(sources.size());
+    double area = 0;
+    int widest  = 0;
+    for (size_t i = 0; i < order.size(); i++) {
+        order[i] = i;
+        area += (double)(sizes[i].first + ATLAS_PADDING) * (sizes[i].second + ATLAS_PADDING);
+        widest = std::max(widest, sizes[i].first + ATLAS_PADDING);
+    }
+    std::sort(order.begin(), order.end(), [&sizes](size_t a, size_t b) { return sizes[a].second > sizes[b].second; });
+
+    data.width = std::min(SVGAtlas::MAX_SIZE, std::max(widest, (int)std::ceil(std::sqrt(area) * 1.1)));
+    int x = 0, y = 0, shelf = 0;
+    std::vector<std::pair<size_t, SVGAtlasEntry>> placed;
+    for (size_t i : order) {
+        int w = sizes[i].first, h = sizes[i].second;
+        if (w <= 0 || h <= 0 || w + ATLAS_PADDING > data.width) continue;
+        if (x + w + ATLAS_PADDING > data.width) {
+            x = 0;
+            y += shelf;
+            shelf = 0;
+        }
+        if (y + h + ATLAS_PADDING > SVGAtlas::MAX_SIZE) continue;
+        SVGAtlasEntry entry;
+        entry.x      = x;
+        entry.y      = y;
+        entry.width  = w;
+        entry.height = h;
+        placed.emplace_back(i, entry);
+        x += w + ATLAS_PADDING;
+        shelf = std::max(shelf, h + ATLAS_PADDING);
+    }
+    data.height = std::max(1, y + shelf);
+    data.pixels.assign((size_t)data.width * data.height * 4, 0);
+
+    for (auto& i : placed) {
+        auto& source  = sources[i.first];
+        auto& entry   = i.second;
+        auto document = lunasvg::Document::loadFromData(source.second.data(), source.second.size());
+        if (!document) {
+            brls::Logger::error("SVGAtlas: cannot load svg image: {}", source.first);
+            continue;
+        }
+        auto bitmap = document->renderToBitmap(entry.width, entry.height);
+        if (!bitmap.valid()) continue;
+        bitmap.convertToRGBA();
+        int rows = std::min(entry.height, (int)bitmap.height());
+        int cols = std::min(entry.width, (int)bitmap.width());
+        for (int row = 0; row < rows; row++) {
+            memcpy(&data.pixels[((size_t)(entry.y + row) * data.width + entry.x) * 4],
+                   bitmap.data() + (size_t)row * bitmap.stride(), (size_t)cols * 4);
+        }
+        data.entries[source.first] = entry;
+    }
+}
+
+/// SVGAtlas
+
+void SVGAtlas::start() {
+    if (started) return;
+    started   = true;
+    this->dir = ProgramConfig::instance().getConfigDir() + "/svg_atlas";
+    std::error_code ec;
+    cpr::fs::create_directories(dir, ec);
+
+    try {
+        std::ifstream file(dir + "/icons.json");
+        if (file) {
+            nlohmann::json content;
+            file >> content;
+            for (auto& i : content) {
+                Icon icon;
+                icon.name   = i.at("name").get<std::string>();
+                icon.width  = i.at("width").get<int>();
+                icon.height = i.at("height").get<int>();
+                if (iconKeys.insert(getKey(icon.name, icon.width, icon.height)).second) icons.emplace_back(icon);
+            }
+        }
+    } catch (const std::exception& e) {
+        brls::Logger::warning("SVGAtlas: cannot read icon list: {}", e.what());
+    }
+
+    brls::Application::getWindowSizeChangedEvent()->subscribe([this]() {
+        if (brls::Application::windowScale != this->scale) this->build(false);
+    });
+
+    if (!icons.empty()) this->build(true);
+}
+
+int SVGAtlas::get(const std::string& name, float width, float height, SVGAtlasEntry& entry) {
+    if (!started) return 0;
+    int w = (int)std::round(width), h = (int)std::round(height);
+    if (w <= 0 || h <= 0) return 0;
+    std::string key = getKey(name, w, h);
+    if (texture > 0) {
+        auto it = atlas.entries.find(key);
+        if (it != atlas.entries.end()) {
+            entry = it->second;
+            return texture;
+        }
+    }
+
+    // 记录新出现的图标，稍后保存清单并在后台重新生成图集
+    if (iconKeys.insert(key).second) {
+        Icon icon;
+        icon.name   = name;
+        icon.width  = w;
+        icon.height = h;
+        icons.emplace_back(icon);
+        if (!manifestDirty) {
+            manifestDirty = true;
+            brls::delay(3000, [this]() {
+                this->saveManifest();
+                this->build(false);
+            });
+        }
+    }
+    return 0;
+}
+
+int SVGAtlas::getWidth() const { return atlas.width; }
+
+int SVGAtlas::getHeight() const { return atlas.height; }
+
+brls::VoidEvent* SVGAtlas::getUpdateEvent() { return &updateEvent; }
+
+std::string SVGAtlas::getKey(const std::string& name, int width, int height) {
+    return name + "@" + std::to_string(width) + "x" + std::to_string(height);
+}
+
+void SVGAtlas::saveManifest() {
+    manifestDirty          = false;
+    nlohmann::json content = nlohmann::json::array();
+    for (auto& i : icons) content.push_back({{"name", i.name}, {"width", i.width}, {"height", i.height}});
+    std::ofstream file(dir + "/icons.json");
+    if (file) file << content.dump();
+}
+
+std::string SVGAtlas::readSources(const std::vector<Icon>& icons, float value, const std::string& dir,
+                                  std::vector<std::pair<std::string, std::string>>& sources,
+                                  std::vector<std::pair<int, int>>& sizes) {
+    uint64_t hash = 14695981039346656037ULL;
+    for (auto& i : icons) {
+        std::string key  = getKey(i.name, i.width, i.height);
+        std::string data = readSource(i.name);
+        if (data.empty()) continue;
+        hash = hashData(hashData(hash, key), data);
+        sources.emplace_back(key, std::move(data));
+        sizes.emplace_back((int)std::round(i.width * value), (int)std::round(i.height * value));
+    }
+    if (sources.empty()) return "";
+    return fmt::format("{}/{}_{:016x}.bin", dir, (int)std::round(value * 100), hash);
+}
+
+void SVGAtlas::build(bool loadCache) {
+    float value  = brls::Application::windowScale;
+    size_t token = ++buildToken;
+
+    // 启动时同步读取资源与磁盘缓存，第一帧就可以使用图集
+    if (loadCache) {
+        std::vector<std::pair<std::string, std::string>> sources;
+        std::vector<std::pair<int, int>> sizes;
+        std::string path = readSources(icons, value, dir, sources, sizes);
+        if (path.empty()) return;
+        SVGAtlasData data;
+        if (loadAtlasFile(path, data)) {
+            brls::Logger::info("SVGAtlas: load {} icons from {}", data.entries.size(), path);
+            this->apply(value, data);
+            return;
+        }
+    }
+
+    // 读取资源、计算哈希与渲染都在后台线程中进行
+    std::string folder = this->dir;
+    SVGAtlasThreadPool::instance().Submit([this, icons = this->icons, folder, value, token]() {
+        std::vector<std::pair<std::string, std::string>> sources;
+        std::vector<std::pair<int, int>> sizes;
+        std::string path = readSources(icons, value, folder, sources, sizes);
+        if (path.empty()) return;
+
+        auto data = std::make_shared<SVGAtlasData>();
+        if (!loadAtlasFile(path, *data)) {
+            *data = SVGAtlasData();
+            brls::Time start = brls::getCPUTimeUsec();
+            renderAtlas(sources, sizes, *data);
+            brls::Logger::info("SVGAtlas: render {} icons ({}x{}) in {}ms", data->entries.size(), data->width,
+                               data->height, (brls::getCPUTimeUsec() - start) / 1000);
+            // 清理其他缩放比例或旧版本资源生成的缓存
+            std::error_code ec;
+            for (auto& file : cpr::fs::directory_iterator(folder, ec)) {
+                if (file.path().extension() == ".bin") cpr::fs::remove(file.path(), ec);
+            }
+            saveAtlasFile(path, *data);
+        }
+        brls::sync([this, data, value, token]() {
+            if (token == this->buildToken) this->apply(value, *data);
+        });
+    });
+}
+
+void SVGAtlas::apply(float value, const SVGAtlasData& data) {
+    NVGcontext* vg = brls::Application::getNVGContext();
+    int tex        = nvgCreateImageRGBA(vg, data.width, data.height, 0, data.pixels.data());
+    if (tex <= 0) {
+        brls::Logger::error("SVGAtlas: cannot create texture {}x{}", data.width, data.height);
+        return;
+    }
+    int old             = this->texture;
+    this->texture       = tex;
+    this->scale         = value;
+    this->atlas.width   = data.width;
+    this->atlas.height  = data.height;
+    this->atlas.entries = data.entries;
+    this->updateEvent.fire();
+    if (old > 0) nvgDeleteImage(vg, old);
+}
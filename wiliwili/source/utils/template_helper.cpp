@@ -0,0 +1,49 @@
+#include <borealis/core/application.hpp>
+#include <borealis/core/logger.hpp>
+#include <tinyxml2.h>
+
+#include <fstream>
+#include <sstream>
+
+#include "utils/template_helper.hpp"
+
+TemplateHelper::~TemplateHelper() = default;
+
+void TemplateHelper::inflate(brls::View* view, const std::string& res) {
+    tinyxml2::XMLElement* element = TemplateHelper::instance().get(res);
+    // 解析失败时交给 borealis 处理，由其报告具体的错误
+    if (!element) {
+        view->inflateFromXMLRes(res);
+        return;
+    }
+    view->inflateFromXMLElement(element);
+}
+
+tinyxml2::XMLElement* TemplateHelper::get(const std::string& res) {
+    auto it = documents.find(res);
+    if (it != documents.end()) return it->second->RootElement();
+
+    std::string xml;
+#ifdef USE_LIBROMFS
+    auto file = romfs::get(res);
+    xml       = std::string((const char*)file.string().data(), file.size());
+#else
+    std::ifstream file(std::string(BRLS_RESOURCES) + res, std::ios::binary);
+    if (!file) {
+        brls::Logger::error("TemplateHelper: cannot open {}", res);
+        return nullptr;
+    }
+    std::stringstream ss;
+    ss << file.rdbuf();
+    xml = ss.str();
+#endif
+
+    auto document = std::make_unique<tinyxml2::XMLDocument>();
+    if (document->Parse(xml.c_str(), xml.size()) != tinyxml2::XML_SUCCESS || !document->RootElement()) {
+        brls::Logger::error("TemplateHelper: cannot parse {}", res);
+        return nullptr;
+    }
+    tinyxml2::XMLElement* element = document->RootElement();
+    documents[res]                = std::move(document);
+    return element;
+}
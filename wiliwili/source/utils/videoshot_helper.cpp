@@ -0,0 +1,138 @@
+#include <borealis/core/application.hpp>
+#include <borealis/core/logger.hpp>
+#include <borealis/core/thread.hpp>
+#include <cpr/cpr.h>
+#include <stb_image.h>
+
+#include <algorithm>
+
+#include "bilibili.h"
+#include "bilibili/util/http.hpp"
+#include "bilibili/result/video_detail_result.h"
+#include "utils/videoshot_helper.hpp"
+
+void VideoShotHelper::setVideo(const std::string& bvid, uint64_t cid) {
+    this->bvid = bvid;
+    this->cid  = cid;
+}
+
+bool VideoShotHelper::getFrame(float time, VideoShotFrame& frame) {
+    if (bvid.empty() || cid == 0) return false;
+
+    auto it = std::find_if(cache.begin(), cache.end(), [this](auto& i) { return i->cid == cid; });
+    if (it == cache.end()) {
+        // 第一次使用，请求索引
+        auto data = std::make_shared<VideoShotData>();
+        data->cid = cid;
+        cache.emplace_front(data);
+        while (cache.size() > MAX_VIDEOS) {
+            release(*cache.back());
+            cache.pop_back();
+        }
+        requestIndex(data);
+        return false;
+    }
+    if (it != cache.begin()) cache.splice(cache.begin(), cache, it);
+    auto& data = cache.front();
+    if (!data->ready) return false;
+
+    // 二分查找不晚于 time 的最后一张小图
+    auto target     = (unsigned int)std::max(time, 0.0f);
+    auto pos        = std::upper_bound(data->index.begin(), data->index.end(), target);
+    size_t tile     = pos == data->index.begin() ? 0 : pos - data->index.begin() - 1;
+    size_t perSheet = data->xLen * data->yLen;
+    tile            = std::min(tile, data->images.size() * perSheet - 1);
+    size_t sheet    = tile / perSheet;
+
+    int tex = data->textures[sheet];
+    if (tex == 0) requestImage(data, sheet);
+    if (tex <= 0) return false;
+
+    size_t i          = tile % perSheet;
+    frame.texture     = tex;
+    frame.imageWidth  = (float)data->sizes[sheet].first;
+    frame.imageHeight = (float)data->sizes[sheet].second;
+    frame.width       = frame.imageWidth / (float)data->xLen;
+    frame.height      = frame.imageHeight / (float)data->yLen;
+    // 优先使用接口返回的小图尺寸，最后一行不满或带有边距的大图不能直接均分
+    if (data->xSize > 0 && data->ySize > 0 && (float)data->xSize <= frame.imageWidth &&
+        (float)data->ySize <= frame.imageHeight) {
+        frame.width  = (float)data->xSize;
+        frame.height = (float)data->ySize;
+    }
+    frame.x = (float)(i % data->xLen) * frame.width;
+    frame.y = (float)(i / data->xLen) * frame.height;
+    return true;
+}
+
+void VideoShotHelper::clear() {
+    for (auto& i : cache) release(*i);
+    cache.clear();
+}
+
+void VideoShotHelper::requestIndex(const std::shared_ptr<VideoShotData>& data) {
+    brls::Logger::debug("请求进度条预览图：{}/{}", bvid, data->cid);
+    BILI::get_video_shot(
+        bvid, data->cid,
+        [data](const bilibili::VideoShotResult& result) {
+            brls::sync([data, result]() {
+                if (data->evicted) return;
+                if (result.img_x_len <= 0 || result.img_y_len <= 0 || result.image.empty() || result.index.empty()) {
+                    brls::Logger::warning("VideoShot: no preview for {}", data->cid);
+                    return;
+                }
+                data->xLen  = result.img_x_len;
+                data->yLen  = result.img_y_len;
+                data->xSize = result.img_x_size;
+                data->ySize = result.img_y_size;
+                data->index = result.index;
+                for (auto& url : result.image) {
+                    data->images.emplace_back(url.compare(0, 2, "//") == 0 ? "https:" + url : url);
+                }
+                data->textures.assign(data->images.size(), 0);
+                data->sizes.assign(data->images.size(), {0, 0});
+                data->ready = true;
+            });
+        },
+        [](BILI_ERR) { brls::Logger::error("VideoShot: {}", error); });
+}
+
+void VideoShotHelper::requestImage(const std::shared_ptr<VideoShotData>& data, size_t sheet) {
+    // 标记为加载中，失败后不再重试
+    data->textures[sheet] = -1;
+    std::string url       = data->images[sheet];
+    cpr::GetCallback(
+        [data, sheet, url](const cpr::Response& r) {
+            // 在请求线程中解码，主线程只负责创建纹理
+            uint8_t* imageData = nullptr;
+            int imageW = 0, imageH = 0, n;
+            if (r.status_code == 200 && !r.text.empty()) {
+                imageData =
+                    stbi_load_from_memory((unsigned char*)r.text.c_str(), (int)r.text.size(), &imageW, &imageH, &n, 4);
+            }
+            if (!imageData) {
+                brls::Logger::error("VideoShot: failed to load {} ({})", url, r.status_code);
+                return;
+            }
+            brls::sync([data, sheet, imageData, imageW, imageH]() {
+                if (!data->evicted) {
+                    int tex = nvgCreateImageRGBA(brls::Application::getNVGContext(), imageW, imageH, 0, imageData);
+                    if (tex > 0) {
+                        data->textures[sheet] = tex;
+                        data->sizes[sheet]    = {imageW, imageH};
+                    }
+                }
+                stbi_image_free(imageData);
+            });
+        },
+        cpr::Url{url}, bilibili::HTTP::HEADERS, bilibili::HTTP::PROXIES, bilibili::HTTP::VERIFY);
+}
+
+void VideoShotHelper::release(VideoShotData& data) {
+    data.evicted   = true;
+    NVGcontext* vg = brls::Application::getNVGContext();
+    for (auto& tex : data.textures) {
+        if (tex > 0) nvgDeleteImage(vg, tex);
+        tex = 0;
+    }
+}
@@ -6,6 +6,7 @@
 #include <borealis/core/cache_helper.hpp>
 
 #include "view/animation_image.hpp"
+#include "utils/frame_scheduler.hpp"
 
 AnimationImage::AnimationImage() {
     brls::Logger::debug("View AnimationImage: create");
@@ -60,13 +61,12 @@ AnimationImage::~AnimationImage() {
 brls::View* AnimationImage::create() { return new AnimationImage(); }
 void AnimationImage::draw(NVGcontext* vg, float x, float y, float width, float height, brls::Style style,
                           brls::FrameContext* ctx) {
-    brls::Application::setActiveEvent(true);
-    size_t time_now = brls::getCPUTimeUsec();
-    if (time_now - last_refresh_time > frame_time) {
-        last_refresh_time = time_now;
-        last_x            = width * current_frame;
-        current_frame++;
-        current_frame %= frame;
+    // 加载图标等动画是低优先级的，限制刷新率，也不阻止进入闲置状态
+    size_t steps = FrameScheduler::instance().advance(last_refresh_time, frame_time);
+    if (steps > 0) {
+        current_frame = (current_frame + steps - 1) % frame;
+        last_x        = width * current_frame;
+        current_frame = (current_frame + 1) % frame;
     }
 
     this->paint.xform[4] = x - last_x;
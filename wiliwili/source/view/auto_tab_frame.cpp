@@ -18,6 +18,7 @@
 */
 
 #include <borealis/views/rectangle.hpp>
+#include <borealis/core/thread.hpp>
 #include <utility>
 
 #include "view/auto_tab_frame.hpp"
@@ -84,6 +85,11 @@ AutoTabFrame::AutoTabFrame() {
     // default is true, only load pages on demand
     this->registerBoolXMLAttribute("demandMode", [this](bool value) { this->setDemandMode(value); });
 
+    // default is 0, keep all visited pages alive
+    this->registerFloatXMLAttribute("maxAliveTabs", [this](float value) { this->setMaxAliveTabs((size_t)value); });
+
+    this->registerBoolXMLAttribute("preloadNextTab", [this](bool value) { this->setPreloadNextTab(value); });
+
     this->registerBoolXMLAttribute("disableNavigationRight", [this](bool value) { disableNavigationRight = value; });
 
     this->registerBoolXMLAttribute("disableNavigationDown", [this](bool value) { disableNavigationDown = value; });
@@ -117,6 +123,10 @@ void AutoTabFrame::setTabChangedAction(const std::function<void(size_t)>& event)
 
 void AutoTabFrame::setDemandMode(bool value) { this->isDemandMode = value; }
 
+void AutoTabFrame::setMaxAliveTabs(size_t value) { this->maxAliveTabs = value; }
+
+void AutoTabFrame::setPreloadNextTab(bool value) { this->preloadNextTab = value; }
+
 void AutoTabFrame::setSideBarPosition(AutoTabBarPosition position) {
     this->tabBarPosition = position;
     switch (position) {
@@ -159,6 +169,7 @@ void AutoTabFrame::addTab(AutoSidebarItem* tab, TabViewCreator creator) {
         if (!view->isFocused()) return;
 
         // Add the new tab
+        brls::Time start = brls::getCPUTimeUsec();
         View* newContent = sidebarItem->getAttachedView();
         if (!newContent) {
             newContent = sidebarItem->createAttachedView();
@@ -167,6 +178,9 @@ void AutoTabFrame::addTab(AutoSidebarItem* tab, TabViewCreator creator) {
         if (newContent == this->getActiveTab()) return;
 
         this->setTabAttachedView(newContent);
+        this->onTabUsed(sidebarItem);
+        brls::Logger::debug("AutoTabFrame: switch to tab {} in {}ms", sidebarItem->getCurrentIndex(),
+                            (brls::getCPUTimeUsec() - start) / 1000);
 
         if (this->tabChangedAction) this->tabChangedAction(sidebarItem->getCurrentIndex());
     });
@@ -182,6 +196,7 @@ void AutoTabFrame::addTab(AutoSidebarItem* tab, TabViewCreator creator) {
         if (isDefaultTab) {
             this->group.setActive(item);
             this->setTabAttachedView(newContent);
+            this->onTabUsed(item);
         }
     }
 }
@@ -243,6 +258,8 @@ void AutoTabFrame::clearTab(const std::string& name, bool onlyFirst) {
                 this->setLastFocusedView(nullptr);
                 brls::Application::giveFocus(this);
             }
+            this->recentTabs.remove(item);
+            (*tabToken)++;
             this->sidebar->removeView(item, true);
             this->group.removeView(item);
 
@@ -312,6 +329,7 @@ void AutoTabFrame::handleXMLElement(tinyxml2::XMLElement* element) {
 
 AutoTabFrame::~AutoTabFrame() {
     brls::Logger::debug("delete AutoTabFrame");
+    (*tabToken)++;
     if (this->activeTab) {
         // 直接移除activeTab，销毁的工作交给其对应的 AutoSidebarItem 来处理
         this->getChildren().erase(this->getChildren().begin() + 1);
@@ -340,6 +358,50 @@ void AutoTabFrame::setTabAttachedView(brls::View* newContent) {
     if (v) v->onShow();
 }
 
+void AutoTabFrame::onTabUsed(AutoSidebarItem* item) {
+    this->recentTabs.remove(item);
+    this->recentTabs.push_front(item);
+    if (maxAliveTabs == 0 && !preloadNextTab) return;
+
+    auto token   = this->tabToken;
+    size_t value = ++(*token);
+    if (maxAliveTabs > 0) this->releaseTabs();
+    if (!preloadNextTab) return;
+    brls::delay(PRELOAD_DELAY, [this, token, value, item]() {
+        // 期间切换过标签页或者当前页面不在最上层时，不再预加载
+        if (*token != value || !this->isOnTop) return;
+        size_t index = item->getCurrentIndex() + 1;
+        if (index >= this->sidebar->getChildren().size()) return;
+        AutoSidebarItem* next = this->getItem((int)index);
+        if (!next || next->getAttachedView()) return;
+        brls::Logger::debug("AutoTabFrame: preload tab {}", index);
+        next->createAttachedView();
+        this->recentTabs.remove(next);
+        this->recentTabs.insert(std::next(this->recentTabs.begin()), next);
+        if (maxAliveTabs > 0) this->releaseTabs();
+    });
+}
+
+void AutoTabFrame::releaseTabs() {
+    auto token   = this->tabToken;
+    size_t value = *token;
+    size_t alive = 0;
+    for (auto item : this->recentTabs) {
+        View* content = item->getAttachedView();
+        if (!content) continue;
+        if (++alive <= maxAliveTabs || content == this->activeTab) continue;
+        auto* v = dynamic_cast<AttachedView*>(content);
+        if (!v || !v->isReleasable()) continue;
+        // 请求结束前提交的回调都排在这之前，等它们执行完再释放
+        brls::sync([this, token, value, item, content]() {
+            if (*token != value || item->getAttachedView() != content || content == this->activeTab) return;
+            if (!((AttachedView*)content)->isReleasable()) return;
+            brls::Logger::debug("AutoTabFrame: release tab {}", item->getCurrentIndex());
+            item->releaseAttachedView();
+        });
+    }
+}
+
 void AutoTabFrame::setDefaultTabIndex(size_t index) { this->sidebar->setDefaultFocusedIndex(index); }
 
 size_t AutoTabFrame::getDefaultTabIndex() { return this->sidebar->getDefaultFocusedIndex(); }
@@ -433,6 +495,8 @@ AutoSidebarItem* AutoTabFrame::getItem(int position) {
 
 void AutoTabFrame::clearItems() {
     this->setTabAttachedView(nullptr);
+    this->recentTabs.clear();
+    (*tabToken)++;
     this->sidebar->clearViews();
     this->group.clear();
     this->setLastFocusedView(nullptr);
@@ -883,8 +947,10 @@ brls::View* AutoSidebarItem::createAttachedView() {
         AttachedView* v    = dynamic_cast<AttachedView*>(this->attachedView);
         if (v) {
             v->setTabBar(this);
+            if (this->savedState) v->onRestoreState(this->savedState);
             v->onCreate();
         }
+        this->savedState = nullptr;
     }
     if (!this->attachedView) {
         brls::fatal("AutoSidebarItem create attached View error");
@@ -949,8 +1015,22 @@ size_t AutoSidebarItem::getCurrentIndex() { return *((size_t*)this->getParentUse
 
 void AutoSidebarItem::setAttachedViewCreator(TabViewCreator creator) { this->attachedViewCreator = creator; }
 
+void AutoSidebarItem::releaseAttachedView() {
+    auto* v = dynamic_cast<AttachedView*>(this->attachedView);
+    if (v) {
+        this->savedState = v->onSaveState();
+        // 标签上的按键不能再指向被释放的标签页
+        v->unregisterTabActions();
+    }
+    this->deleteAttachedView();
+}
+
 AutoSidebarItem::~AutoSidebarItem() {
     brls::Logger::debug("del AutoSidebarItem: {}", this->label->getFullText());
+    this->deleteAttachedView();
+}
+
+void AutoSidebarItem::deleteAttachedView() {
     if (this->attachedView) {
         this->attachedView->setParent(nullptr);
         if (!this->attachedView->isPtrLocked()) {
@@ -1039,10 +1119,24 @@ void AttachedView::onShow() {}
 
 void AttachedView::onHide() {}
 
+bool AttachedView::isReleasable() { return false; }
+
+std::shared_ptr<AttachedViewState> AttachedView::onSaveState() { return nullptr; }
+
+void AttachedView::onRestoreState(const std::shared_ptr<AttachedViewState>& state) {}
+
+void AttachedView::unregisterTabActions() {
+    if (this->tab) {
+        for (auto id : tabActions) this->tab->unregisterAction(id);
+    }
+    tabActions.clear();
+}
+
 void AttachedView::registerTabAction(std::string hintText, enum brls::ControllerButton button,
                                      brls::ActionListener action, bool hidden, bool allowRepeating, enum brls::Sound sound) {
     this->registerAction(hintText, button, action, hidden, allowRepeating, sound);
-    if (this->tab) this->tab->registerAction(hintText, button, action, hidden, allowRepeating, sound);
+    if (this->tab)
+        tabActions.emplace_back(this->tab->registerAction(hintText, button, action, hidden, allowRepeating, sound));
 }
 
 AttachedView::AttachedView() { this->setGrow(1); }
@@ -7,14 +7,20 @@
 #include <borealis/core/thread.hpp>
 
 #include <pystring.h>
+#include <cctype>
+#include <cmath>
 #include <cstdlib>
+#include <iterator>
 #include <utility>
+#include <unordered_map>
 #include <lunasvg.h>
 
 #include "view/danmaku_core.hpp"
+#include "view/live_core.hpp"
 #include "utils/config_helper.hpp"
 #include "utils/string_helper.hpp"
 #include "utils/number_helper.hpp"
+#include "utils/frame_scheduler.hpp"
 #include "bilibili.h"
 
 // include ntohl / ntohll
@@ -176,7 +182,13 @@ DanmakuItem::DanmakuItem(std::string content, const char *attributes) : msg(std:
 }
 
 void DanmakuItem::draw(NVGcontext *vg, float x, float y, float alpha, bool multiLine) const {
-    if (image != DanmakuImageType::DANMAKU_IMAGE_NONE) {
+    if (image == DanmakuImageType::DANMAKU_IMAGE_LIVE_EMOTICON) {
+        // 回放的直播表情与直播时一样绘制为行高大小的图片
+        auto &core    = LiveDanmakuCore::instance();
+        auto emoticon = core.getEmoticon(msg);
+        float height  = DanmakuCore::DANMAKU_STYLE_FONTSIZE * DanmakuCore::DANMAKU_STYLE_LINE_HEIGHT * 0.01f;
+        if (emoticon && core.drawEmoticon(vg, *emoticon, x, y, height, alpha)) return;
+    } else if (image != DanmakuImageType::DANMAKU_IMAGE_NONE) {
         // 绘制图片弹幕
         float width    = DanmakuCore::DANMAKU_STYLE_FONTSIZE * 3;
         float height   = DanmakuCore::DANMAKU_STYLE_FONTSIZE;
@@ -229,8 +241,6 @@ DanmakuCore::DanmakuCore() {
             this->refresh();
         } else if (e == MpvEventEnum::RESET) {
             this->reset();
-        } else if (e == MpvEventEnum::VIDEO_SPEED_CHANGE) {
-            this->setSpeed(MPVCore::instance().getSpeed());
         }
     });
 
@@ -278,7 +288,6 @@ void DanmakuCore::reset() {
     maskWidth        = 0;
     maskHeight       = 0;
     maskSliceIndex      = 0;
-    videoSpeed          = MPVCore::instance().getSpeed();
     lineHeight          = DANMAKU_STYLE_FONTSIZE * DANMAKU_STYLE_LINE_HEIGHT * 0.01f;
     maskData.clear();
     if (maskTex != 0) {
@@ -293,6 +302,11 @@ void DanmakuCore::loadDanmakuData(const std::vector<DanmakuItem> &data) {
     this->danmakuData = data;
     if (!data.empty()) danmakuLoaded = true;
     std::sort(danmakuData.begin(), danmakuData.end());
+    if (DANMAKU_FILTER_MERGE) {
+        size_t rawSize = danmakuData.size();
+        mergeDanmakuData(danmakuData);
+        brls::Logger::debug("DANMAKU: merge repeated: {} -> {}", rawSize, danmakuData.size());
+    }
     danmakuMutex.unlock();
 
     // 更新显示总行数等信息
@@ -302,6 +316,23 @@ void DanmakuCore::loadDanmakuData(const std::vector<DanmakuItem> &data) {
     APP_E->fire("DANMAKU_LOADED", nullptr);
 }
 
+void DanmakuCore::appendDanmakuData(std::vector<DanmakuItem> data) {
+    if (data.empty()) return;
+    std::sort(data.begin(), data.end());
+    if (DANMAKU_FILTER_MERGE) mergeDanmakuData(data);
+    // 与 refresh 中设置的透明度保持一致
+    for (auto &d : data) {
+        d.color.a       = DanmakuCore::DANMAKU_STYLE_ALPHA * 0.01;
+        d.borderColor.a = DanmakuCore::DANMAKU_STYLE_ALPHA * 0.005;
+    }
+
+    danmakuMutex.lock();
+    this->danmakuData.insert(this->danmakuData.end(), std::make_move_iterator(data.begin()),
+                             std::make_move_iterator(data.end()));
+    this->danmakuLoaded = true;
+    danmakuMutex.unlock();
+}
+
 void DanmakuCore::addSingleDanmaku(const DanmakuItem &item) {
     danmakuMutex.lock();
     this->danmakuData.emplace_back(item);
@@ -312,6 +343,84 @@ void DanmakuCore::addSingleDanmaku(const DanmakuItem &item) {
     APP_E->fire("DANMAKU_LOADED", nullptr);
 }
 
+std::string DanmakuCore::normalizeDanmakuText(const std::string &text) {
+    std::string res;
+    res.reserve(text.size());
+    size_t lastStart = std::string::npos, lastLength = 0;
+    for (size_t i = 0; i < text.size();) {
+        auto c = (unsigned char)text[i];
+        // utf-8 字符长度
+        size_t length = c < 0x80 ? 1 : (c >> 5) == 0x6 ? 2 : (c >> 4) == 0xe ? 3 : (c >> 3) == 0x1e ? 4 : 1;
+        if (i + length > text.size()) length = text.size() - i;
+
+        // 去除空白字符与全角空格
+        if (c == ' ' || c == '\t' || c == '\n' || c == '\r' || text.compare(i, length, "\xe3\x80\x80") == 0) {
+            i += length;
+            continue;
+        }
+
+        // 合并连续重复的字符
+        if (lastStart != std::string::npos && lastLength == length &&
+            res.compare(lastStart, length, text, i, length) == 0) {
+            i += length;
+            continue;
+        }
+
+        lastStart  = res.size();
+        lastLength = length;
+        if (length == 1)
+            res.push_back((char)std::tolower(c));
+        else
+            res.append(text, i, length);
+        i += length;
+    }
+    return res;
+}
+
+float DanmakuCore::getMergedFontScale(int count) {
+    if (count <= 1) return 1.0f;
+    return std::min(1.0f + std::log2((float)count) * 0.1f, 1.5f);
+}
+
+void DanmakuCore::mergeDanmakuData(std::vector<DanmakuItem> &data) {
+    // 归一化文本 -> 合并到的弹幕在结果中的序号
+    std::unordered_map<std::string, size_t> heads;
+    std::vector<DanmakuItem> res;
+    res.reserve(data.size());
+
+    for (auto &item : data) {
+        // 高级弹幕、图片弹幕与失效弹幕不参与合并
+        if (item.type < 0 || item.type == 7 || item.image != DanmakuImageType::DANMAKU_IMAGE_NONE) {
+            res.emplace_back(std::move(item));
+            continue;
+        }
+
+        // 滚动、底部、顶部弹幕分别合并
+        auto key = normalizeDanmakuText(item.msg);
+        key.push_back('\0');
+        key.push_back(item.type == 4 || item.type == 5 ? (char)item.type : '1');
+
+        auto it = heads.find(key);
+        if (it != heads.end() && item.time - res[it->second].time <= DANMAKU_MERGE_WINDOW) {
+            auto &head = res[it->second];
+            head.count++;
+            // 保证合并后的弹幕不会因为首条弹幕等级过低而被过滤掉
+            if (item.level > head.level) head.level = item.level;
+            continue;
+        }
+
+        heads[key] = res.size();
+        res.emplace_back(std::move(item));
+    }
+
+    for (auto &item : res) {
+        if (item.count <= 1) continue;
+        item.msg += fmt::format(" ×{}", item.count);
+        item.fontSize *= getMergedFontScale(item.count);
+    }
+    data = std::move(res);
+}
+
 void DanmakuCore::loadMaskData(const std::string &url) {
     maskData.clear();
     BILI::get_webmask(
@@ -344,9 +453,6 @@ void DanmakuCore::loadMaskData(const std::string &url) {
 void DanmakuCore::refresh() {
     danmakuMutex.lock();
 
-    // 获取视频播放速度
-    videoSpeed = MPVCore::instance().getSpeed();
-
     // 将当前屏幕第一条弹幕序号设为0
     danmakuIndex = 0;
 
@@ -388,24 +494,10 @@ void DanmakuCore::refresh() {
     danmakuMutex.unlock();
 }
 
-void DanmakuCore::setSpeed(double speed) {
-    double oldSpeed     = videoSpeed;
-    videoSpeed          = speed;
-    int64_t currentTime = brls::getCPUTimeUsec();
-    double factor       = oldSpeed / speed;
-    // 修改滚动弹幕的起始播放时间，满足修改后的时间在新速度下生成的位置不变。
-    for (size_t j = this->danmakuIndex; j < this->danmakuData.size(); j++) {
-        auto &i = this->danmakuData[j];
-        if (i.type == 4 || i.type == 5) continue;
-        if (!i.canShow) continue;
-        if (i.time > MPVCore::instance().playback_time) return;
-        i.startTime = currentTime - (currentTime - i.startTime) * factor;
-    }
-}
-
 void DanmakuCore::save() {
     ProgramConfig::instance().setSettingItem(SettingItem::DANMAKU_ON, DANMAKU_ON, false);
     ProgramConfig::instance().setSettingItem(SettingItem::DANMAKU_SMART_MASK, DANMAKU_SMART_MASK, false);
+    ProgramConfig::instance().setSettingItem(SettingItem::DANMAKU_FILTER_MERGE, DANMAKU_FILTER_MERGE, false);
     ProgramConfig::instance().setSettingItem(SettingItem::DANMAKU_FILTER_TOP, DANMAKU_FILTER_SHOW_TOP, false);
     ProgramConfig::instance().setSettingItem(SettingItem::DANMAKU_FILTER_BOTTOM, DANMAKU_FILTER_SHOW_BOTTOM, false);
     ProgramConfig::instance().setSettingItem(SettingItem::DANMAKU_FILTER_SCROLL, DANMAKU_FILTER_SHOW_SCROLL, false);
@@ -431,7 +523,7 @@ std::vector<DanmakuItem> DanmakuCore::getDanmakuData() {
 void DanmakuCore::drawMask(NVGcontext *vg, float x, float y, float width, float height) {
 #if defined(BOREALIS_USE_OPENGL) || defined(BOREALIS_USE_D3D11)
     if (!DANMAKU_SMART_MASK || !maskData.isLoaded()) return;
-    double playbackTime = MPVCore::instance().playback_time;
+    double playbackTime = MPVCore::instance().getMediaTime();
     /// 1. 先根据时间选择分片
     while (maskSliceIndex < maskData.sliceData.size() - 1) {
         auto &slice = maskData.sliceData[maskSliceIndex + 1];
@@ -549,8 +641,10 @@ void DanmakuCore::draw(NVGcontext *vg, float x, float y, float width, float heig
     if (!this->danmakuLoaded) return;
     if (danmakuData.empty()) return;
 
-    int64_t currentTime = brls::getCPUTimeUsec();
-    double playbackTime = MPVCore::instance().playback_time;
+    // 弹幕滚动时保持正常帧率
+    if (MPVCore::instance().isPlaying()) FrameScheduler::instance().markDirty();
+
+    double playbackTime = MPVCore::instance().getMediaTime();
     float SECOND        = 0.12f * DANMAKU_STYLE_SPEED;
     float CENTER_SECOND = 0.04f * DANMAKU_STYLE_SPEED;
 
@@ -619,18 +713,8 @@ void DanmakuCore::draw(NVGcontext *vg, float x, float y, float width, float heig
                 continue;
             }
             //滑动弹幕
-            float position = 0;
-            if (!MPVCore::instance().isPlaying()) {
-                // 暂停状态弹幕也要暂停
-                position    = i.speed * (playbackTime - i.time);
-                i.startTime = currentTime - (playbackTime - i.time) / videoSpeed * 1e6;
-            } else {
-                // position = i.speed * (playbackTime - i.time) 是最精确的弹幕位置
-                // 但是因为 playbackTime 是根据视频帧率设定的，直接使用此值会导致弹幕看起来卡顿
-                // 这里以弹幕绘制的起始时间点为准，通过与当前时间值的差值计算来得到更精确的弹幕位置
-                // 但是当 AV 不同步时，mpv会自动修正播放的进度，导致 playbackTime 和现实的时间脱离，不同弹幕间因此可能产生重叠
-                position = i.speed * (currentTime - i.startTime) * videoSpeed / 1e6;
-            }
+            // playbackTime 是经过插值的平滑播放进度，暂停、倍速与 AV 同步修正都已经包含在内
+            float position = i.speed * (playbackTime - i.time);
 
             // 根据位置判断是否显示弹幕
             if (position > width + i.length) {
@@ -741,7 +825,15 @@ void DanmakuCore::draw(NVGcontext *vg, float x, float y, float width, float heig
             }
 
             /// 处理即将要显示的弹幕
-            if (i.image != DanmakuImageType::DANMAKU_IMAGE_NONE) {
+            const LiveEmoticonRect *emoticon = nullptr;
+            if (i.image == DanmakuImageType::DANMAKU_IMAGE_LIVE_EMOTICON) {
+                emoticon = LiveDanmakuCore::instance().getEmoticon(i.msg);
+                // 图集中没有对应的表情时按文字显示
+                if (!emoticon) i.image = DanmakuImageType::DANMAKU_IMAGE_NONE;
+            }
+            if (emoticon) {
+                i.length = emoticon->w * DANMAKU_STYLE_FONTSIZE * DANMAKU_STYLE_LINE_HEIGHT * 0.01f / emoticon->h;
+            } else if (i.image != DanmakuImageType::DANMAKU_IMAGE_NONE) {
                 i.length = DANMAKU_STYLE_FONTSIZE * 3;
             } else {
                 nvgFontSize(vg, DANMAKU_STYLE_FONTSIZE * i.fontSize);
@@ -776,9 +868,6 @@ void DanmakuCore::draw(NVGcontext *vg, float x, float y, float width, float heig
                     // 一条弹幕展示结束的时间点，同一行的其他弹幕到达屏幕左侧的时间应该在这之后。
                     scrollLines[k].second = i.time + SECOND;
                     i.canShow             = true;
-                    i.startTime           = currentTime;
-                    // 如果当前时间点弹幕已经出现在屏幕上了，那么反向推算出弹幕开始的现实时间
-                    if (playbackTime - i.time > 0.2) i.startTime -= (playbackTime - i.time) / videoSpeed * 1e6;
                     break;
                 }
             }
@@ -18,13 +18,14 @@
 #include "fragment/player_single_comment.hpp"
 #include "utils/dialog_helper.hpp"
 #include "utils/activity_helper.hpp"
+#include "utils/template_helper.hpp"
 
 using namespace brls::literals;
 
 class DynamicCommentAction : public brls::Box {
 public:
     DynamicCommentAction() {
-        this->inflateFromXMLRes("xml/fragment/dynamic_card_action.xml");
+        TemplateHelper::inflate(this, "xml/fragment/dynamic_card_action.xml");
 
         this->article->setGrow();
 
@@ -479,7 +480,7 @@ void DynamicArticleDetail::toggleCommentMode() {
 }
 
 DynamicArticleView::DynamicArticleView() {
-    this->inflateFromXMLRes("xml/views/dynamic_card.xml");
+    TemplateHelper::inflate(this, "xml/views/dynamic_card.xml");
     if (brls::Application::ORIGINAL_WINDOW_HEIGHT == 544) {
         videoArea->setWidthPercentage(80);
         videoAreaForward->setWidthPercentage(80);
@@ -7,8 +7,9 @@
 
 #include "view/dynamic_video_card.hpp"
 #include "utils/image_helper.hpp"
+#include "utils/template_helper.hpp"
 
-DynamicVideoCardView::DynamicVideoCardView() { this->inflateFromXMLRes("xml/views/video_card_dynamic.xml"); }
+DynamicVideoCardView::DynamicVideoCardView() { TemplateHelper::inflate(this, "xml/views/video_card_dynamic.xml"); }
 
 void DynamicVideoCardView::setCard(const std::string& cover, const std::string& title, const std::string& count,
                                    const std::string& danmaku, const std::string& duration) {
@@ -7,6 +7,7 @@
 
 #include "view/grid_dropdown.hpp"
 #include "view/svg_image.hpp"
+#include "utils/template_helper.hpp"
 
 /// EmptyDropDown
 
@@ -55,7 +56,7 @@ bool EmptyDropdown::isTranslucent() { return true; }
 brls::Box* EmptyDropdown::getContentView() { return content; }
 
 /// GridRadioCell
-GridRadioCell::GridRadioCell() { this->inflateFromXMLRes("xml/views/grid_radio_cell.xml"); }
+GridRadioCell::GridRadioCell() { TemplateHelper::inflate(this, "xml/views/grid_radio_cell.xml"); }
 
 void GridRadioCell::setSelected(bool selected) {
     brls::Theme theme = brls::Application::getTheme();
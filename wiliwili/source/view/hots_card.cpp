@@ -4,8 +4,9 @@
 
 #include "view/hots_card.hpp"
 #include "utils/image_helper.hpp"
+#include "utils/template_helper.hpp"
 
-RecyclingGridItemHotsCard::RecyclingGridItemHotsCard() { this->inflateFromXMLRes("xml/views/hots_card.xml"); }
+RecyclingGridItemHotsCard::RecyclingGridItemHotsCard() { TemplateHelper::inflate(this, "xml/views/hots_card.xml"); }
 
 RecyclingGridItemHotsCard::~RecyclingGridItemHotsCard() = default;
 
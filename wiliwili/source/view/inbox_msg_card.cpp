@@ -1,10 +1,11 @@
 #include "view/inbox_msg_card.hpp"
 #include "view/text_box.hpp"
 #include "utils/string_helper.hpp"
+#include "utils/template_helper.hpp"
 
 using namespace brls::literals;
 
-InboxMsgCard::InboxMsgCard() { this->inflateFromXMLRes("xml/views/inbox_msg.xml"); }
+InboxMsgCard::InboxMsgCard() { TemplateHelper::inflate(this, "xml/views/inbox_msg.xml"); }
 
 void InboxMsgCard::setCard(const bilibili::InboxMessageResult& r, const IEMap& m, uint64_t talker) {
     RichTextData d;
@@ -4,13 +4,22 @@
 
 #include "view/live_core.hpp"
 #include "view/danmaku_core.hpp"
+#include "view/mpv_core.hpp"
 
+#include <algorithm>
 #include <chrono>
 #include <cstddef>
+#include <fmt/format.h>
+#include <borealis/core/application.hpp>
+#include <borealis/core/logger.hpp>
+#include <borealis/core/thread.hpp>
 
 #include "nanovg.h"
 
-LiveDanmakuItem::LiveDanmakuItem(danmaku_t *dan) { this->danmaku = dan; }
+LiveDanmakuItem::LiveDanmakuItem(danmaku_t *dan) {
+    this->danmaku = dan;
+    this->count   = std::make_shared<std::atomic<int>>(1);
+}
 
 LiveDanmakuItem::LiveDanmakuItem(const LiveDanmakuItem &item) {
     this->danmaku = danmaku_t_copy(item.danmaku);
@@ -18,6 +27,8 @@ LiveDanmakuItem::LiveDanmakuItem(const LiveDanmakuItem &item) {
     this->length  = item.length;
     this->speed   = item.speed;
     this->line    = item.line;
+    this->scale   = item.scale;
+    this->count   = item.count;
 }
 
 LiveDanmakuItem::LiveDanmakuItem(LiveDanmakuItem &&item) {
@@ -26,6 +37,8 @@ LiveDanmakuItem::LiveDanmakuItem(LiveDanmakuItem &&item) {
     this->length  = item.length;
     this->speed   = item.speed;
     this->line    = item.line;
+    this->scale   = item.scale;
+    this->count   = std::move(item.count);
     item.danmaku  = nullptr;
 }
 
@@ -37,11 +50,176 @@ void LiveDanmakuCore::reset() {
     while (!this->next.empty()) {
         this->next.pop_front();
     }
+    this->merge_window.clear();
     this->next_mutex.unlock();
+    this->setEmoticonAtlas(nullptr);
+    this->live_offset_valid = false;
+    this->replay_loading    = false;
+    this->replay_token++;
+    if (this->replaying) {
+        this->replaying = false;
+        DanmakuCore::instance().reset();
+    }
+}
+
+void LiveDanmakuCore::startRecord(int room_id) {
+    this->live_offset_valid = false;
+    this->recorder.open(room_id);
+}
+
+void LiveDanmakuCore::stopRecord(const std::string &export_path) {
+    if (!export_path.empty() && this->recorder.isOpen())
+        this->recorder.closeAndExport(export_path);
+    else
+        this->recorder.close();
+}
+
+void LiveDanmakuCore::syncLiveEdge() {
+    if (!this->recorder.isOpen()) return;
+    // 直播流刚开始播放时，画面与收到的弹幕同步
+    this->live_offset       = (int64_t)this->recorder.now() - (int64_t)(MPVCore::instance().getMediaTime() * 1000);
+    this->live_offset_valid = true;
+}
+
+void LiveDanmakuCore::updateReplay() {
+    if (!this->live_offset_valid || !this->recorder.isOpen()) return;
+
+    // 当前画面对应的录制时间
+    int64_t current = (int64_t)(MPVCore::instance().getMediaTime() * 1000) + this->live_offset;
+    int64_t now     = (int64_t)this->recorder.now();
+    int64_t lag     = now - current;
+
+    if (!this->replaying) {
+        // 暂停或回看导致画面落后于直播时，改为回放录制的弹幕
+        if (lag < REPLAY_THRESHOLD) return;
+        brls::Logger::debug("LiveDanmakuCore: start replay, lag: {}ms", lag);
+        this->replaying = true;
+        this->now.clear();
+        this->next_mutex.lock();
+        this->next.clear();
+        this->next_mutex.unlock();
+        // 向前多加载一段，保留正在屏幕上滚动的弹幕
+        this->loadReplay(std::max<int64_t>(0, current - 10000), current + REPLAY_WINDOW, false);
+        return;
+    }
+
+    if (lag < REPLAY_THRESHOLD / 2) {
+        // 重新追上直播后恢复显示直播弹幕
+        brls::Logger::debug("LiveDanmakuCore: stop replay");
+        this->replaying      = false;
+        this->replay_loading = false;
+        this->replay_token++;
+        DanmakuCore::instance().reset();
+        return;
+    }
+
+    // 等待上一次读取完成
+    if (this->replay_loading) return;
+
+    if (current < this->replay_start || current > this->replay_end) {
+        // 跳转到已加载范围之外，重新加载
+        this->loadReplay(std::max<int64_t>(0, current - 10000), current + REPLAY_WINDOW, false);
+    } else if (current + REPLAY_WINDOW / 2 > this->replay_end && now >= this->replay_end + 1000) {
+        // 提前读取之后录制的弹幕，追加到已加载的弹幕之后
+        this->loadReplay(this->replay_end, this->replay_end + REPLAY_WINDOW, true);
+    }
+}
+
+void LiveDanmakuCore::loadReplay(int64_t start, int64_t end, bool append) {
+    end = std::min<int64_t>(end, this->recorder.now());
+    if (end <= start) return;
+
+    this->replay_loading = true;
+    size_t token         = this->replay_token;
+    int64_t offset       = this->live_offset;
+    int level            = DANMAKU_FILTER_LEVEL_LIVE;
+    brls::Threading::async([this, start, end, append, token, offset, level]() {
+        auto items = std::make_shared<std::vector<DanmakuItem>>();
+        this->recorder.read(start, end, [offset, level, items](const LiveDanmakuRecordHeader &header,
+                                                               const std::string &text) {
+            if (header.level < level) return;
+            float time = (float)((int64_t)header.time - offset) / 1000.0f;
+            if (time < 0) return;
+            // 直播弹幕没有权重，使用最高的权重避免被点播的弹幕等级过滤掉
+            int type        = header.type == 4 || header.type == 5 ? header.type : 1;
+            int size        = header.size ? header.size : 25;
+            auto attributes = fmt::format("{},{},{},{},0,0,0,0,10", time, type, size, header.color);
+            items->emplace_back(text, attributes.c_str());
+            if (header.flags & LIVE_RECORD_FLAG_EMOTICON) {
+                // 表情名称不做简繁转换，绘制时从图集中查找
+                items->back().msg   = text;
+                items->back().image = DanmakuImageType::DANMAKU_IMAGE_LIVE_EMOTICON;
+            }
+        });
+
+        brls::sync([this, start, end, append, token, items]() {
+            if (token != this->replay_token) return;
+            this->replay_loading = false;
+            this->replay_end     = end;
+            if (append) {
+                DanmakuCore::instance().appendDanmakuData(std::move(*items));
+            } else {
+                this->replay_start = start;
+                DanmakuCore::instance().loadDanmakuData(*items);
+            }
+        });
+    });
+}
+
+void LiveDanmakuCore::setEmoticonAtlas(const std::shared_ptr<LiveEmoticonAtlas> &atlas) {
+    if (this->emoticon_texture) {
+        nvgDeleteImage(brls::Application::getNVGContext(), this->emoticon_texture);
+        this->emoticon_texture = 0;
+    }
+    this->emoticon_atlas = atlas;
+}
+
+const LiveEmoticonRect *LiveDanmakuCore::getEmoticon(const LiveDanmakuItem &i) const {
+    if (!i.danmaku->is_emoticon) return nullptr;
+    return this->getEmoticon(i.danmaku->dan);
+}
+
+const LiveEmoticonRect *LiveDanmakuCore::getEmoticon(const std::string &name) const {
+    if (!this->emoticon_atlas) return nullptr;
+    auto it = this->emoticon_atlas->items.find(name);
+    if (it == this->emoticon_atlas->items.end()) return nullptr;
+    return &it->second;
+}
+
+void LiveDanmakuCore::uploadEmoticonAtlas(NVGcontext *vg) {
+    if (!this->emoticon_atlas || this->emoticon_texture || this->emoticon_atlas->pixels.empty()) return;
+    this->emoticon_texture = nvgCreateImageRGBA(vg, this->emoticon_atlas->width, this->emoticon_atlas->height, 0,
+                                                this->emoticon_atlas->pixels.data());
+    // 纹理创建后不再需要保留像素数据
+    this->emoticon_atlas->pixels.clear();
+    this->emoticon_atlas->pixels.shrink_to_fit();
+}
+
+bool LiveDanmakuCore::drawEmoticon(NVGcontext *vg, const LiveEmoticonRect &emoticon, float x, float y, float height,
+                                   float alpha) {
+    if (!this->emoticon_texture) return false;
+    float s    = height / emoticon.h;
+    auto paint = nvgImagePattern(vg, x - emoticon.x * s, y - emoticon.y * s, this->emoticon_atlas->width * s,
+                                 this->emoticon_atlas->height * s, 0, this->emoticon_texture,
+                                 DanmakuCore::DANMAKU_STYLE_ALPHA * 0.01f * alpha);
+    // 避免图片填充影响之后绘制的文字
+    nvgSave(vg);
+    nvgBeginPath(vg);
+    nvgRect(vg, x, y, emoticon.w * s, height);
+    nvgFillPaint(vg, paint);
+    nvgFill(vg);
+    nvgRestore(vg);
+    return true;
 }
 
 void LiveDanmakuCore::add(const std::vector<LiveDanmakuItem> &dan_l) {
+    auto _now        = std::chrono::system_clock::now();
+    auto record_time = this->recorder.now();
     for (const auto &i : dan_l) {
+        if (!i.danmaku->dan) continue;
+        // 录制全部弹幕，回放时再进行过滤
+        this->recorder.append(i.danmaku, record_time);
+        if (this->replaying) continue;
         if (i.danmaku->dan_type == 4 && !DanmakuCore::DANMAKU_FILTER_SHOW_BOTTOM)
             continue;
         else if (i.danmaku->dan_type == 5 && !DanmakuCore::DANMAKU_FILTER_SHOW_TOP)
@@ -51,14 +229,56 @@ void LiveDanmakuCore::add(const std::vector<LiveDanmakuItem> &dan_l) {
         if (i.danmaku->user_level < DANMAKU_FILTER_LEVEL_LIVE) continue;
         if (i.danmaku->dan_color != 0xffffff && !DanmakuCore::DANMAKU_FILTER_SHOW_COLOR) continue;
         this->next_mutex.lock();
-        this->next.emplace_front(std::move(i));
+        if (!merge_danmaku(i, _now)) this->next.emplace_front(std::move(i));
         this->next_mutex.unlock();
     }
 }
 
+bool LiveDanmakuCore::merge_danmaku(const LiveDanmakuItem &i, time_p now) {
+    if (!DanmakuCore::DANMAKU_FILTER_MERGE || i.danmaku->is_emoticon) return false;
+
+    auto window = std::chrono::milliseconds(size_t(DanmakuCore::DANMAKU_MERGE_WINDOW * 1000.0f));
+
+    // 清理过期的记录
+    if (merge_window.size() > 256) {
+        for (auto it = merge_window.begin(); it != merge_window.end();) {
+            if (it->second.first + window < now || it->second.second.expired())
+                it = merge_window.erase(it);
+            else
+                ++it;
+        }
+    }
+
+    // 滚动、底部、顶部弹幕分别合并
+    auto key  = DanmakuCore::normalizeDanmakuText(i.danmaku->dan);
+    auto type = i.danmaku->dan_type;
+    key.push_back('\0');
+    key.push_back(type == 4 || type == 5 ? (char)type : '1');
+
+    auto it = merge_window.find(key);
+    if (it != merge_window.end() && it->second.first + window >= now) {
+        auto count = it->second.second.lock();
+        if (count) {
+            count->fetch_add(1);
+            return true;
+        }
+    }
+    merge_window[key] = {now, i.count};
+    return false;
+}
+
 void LiveDanmakuCore::draw(NVGcontext *vg, float x, float y, float width, float height, float alpha) {
     if (!DanmakuCore::DANMAKU_ON) return;
 
+    this->uploadEmoticonAtlas(vg);
+
+    // 回放录制的弹幕时，使用点播弹幕的逻辑按播放进度显示
+    this->updateReplay();
+    if (this->replaying) {
+        DanmakuCore::instance().draw(vg, x, y, width, height, alpha);
+        return;
+    }
+
     int r, g, b;
     float SECOND        = 0.12f * DanmakuCore::DANMAKU_STYLE_SPEED;
     float CENTER_SECOND = 0.04f * DanmakuCore::DANMAKU_STYLE_SPEED;
@@ -87,6 +307,25 @@ void LiveDanmakuCore::draw(NVGcontext *vg, float x, float y, float width, float
 
     auto _now = std::chrono::system_clock::now();
 
+    // 合并后的弹幕放大显示，并在末尾标注重复次数
+    // 表情弹幕直接绘制图集中对应的区域，不绘制描边
+    auto drawText = [this, vg, alpha](const LiveDanmakuItem &j, float tx, float ty, bool border) {
+        auto emoticon = this->getEmoticon(j);
+        if (emoticon && this->emoticon_texture) {
+            if (!border) this->drawEmoticon(vg, *emoticon, tx, ty, this->line_height, alpha);
+            return;
+        }
+        int count = j.count->load();
+        if (count <= 1) {
+            nvgText(vg, tx, ty, j.danmaku->dan, nullptr);
+            return;
+        }
+        nvgFontSize(vg, DanmakuCore::DANMAKU_STYLE_FONTSIZE * j.scale);
+        tx = nvgText(vg, tx, ty, j.danmaku->dan, nullptr);
+        nvgText(vg, tx, ty, fmt::format(" ×{}", count).c_str(), nullptr);
+        nvgFontSize(vg, DanmakuCore::DANMAKU_STYLE_FONTSIZE);
+    };
+
     size_t _time = 0;
     this->next_mutex.lock();
     while (!this->next.empty() && init_danmaku(vg, this->next.front(), width, LINES, SECOND, _now, _time)) {
@@ -124,10 +363,9 @@ void LiveDanmakuCore::draw(NVGcontext *vg, float x, float y, float width, float
             for (const auto &j : v) {
                 float position = j.speed * std::chrono::duration<float>(_now - j.time).count();
                 if (j.danmaku->dan_type == 4 || j.danmaku->dan_type == 5) {
-                    nvgText(vg, x + width / 2 - j.length / 2 + dx, y + j.line * line_height + 5 + dy, j.danmaku->dan,
-                            nullptr);
+                    drawText(j, x + width / 2 - j.length / 2 + dx, y + j.line * line_height + 5 + dy, true);
                 } else if (position > 0) {
-                    nvgText(vg, x + width - position + dx, y + j.line * line_height + 5 + dy, j.danmaku->dan, nullptr);
+                    drawText(j, x + width - position + dx, y + j.line * line_height + 5 + dy, true);
                 }
             }
             nvgFontBlur(vg, 0.0f);
@@ -138,9 +376,9 @@ void LiveDanmakuCore::draw(NVGcontext *vg, float x, float y, float width, float
         for (const auto &j : v) {
             float position = j.speed * std::chrono::duration<float>(_now - j.time).count();
             if (j.danmaku->dan_type == 4 || j.danmaku->dan_type == 5) {
-                nvgText(vg, x + width / 2 - j.length / 2, y + j.line * line_height + 5, j.danmaku->dan, nullptr);
+                drawText(j, x + width / 2 - j.length / 2, y + j.line * line_height + 5, false);
             } else if (position > 0) {
-                nvgText(vg, x + width - position, y + j.line * line_height + 5, j.danmaku->dan, nullptr);
+                drawText(j, x + width - position, y + j.line * line_height + 5, false);
             }
         }
     }
@@ -170,7 +408,21 @@ bool LiveDanmakuCore::init_danmaku(NVGcontext *vg, LiveDanmakuItem &i, float wid
                                    int time) {
     float bounds[4];
     if (!i.length) {
-        nvgTextBounds(vg, 0, 0, i.danmaku->dan, nullptr, bounds);
+        int count     = i.count->load();
+        auto emoticon = this->getEmoticon(i);
+        if (emoticon) {
+            bounds[0] = 0;
+            bounds[2] = emoticon->w * this->line_height / emoticon->h;
+        } else if (count > 1) {
+            // 合并后的弹幕在开始显示时确定字号
+            i.scale = DanmakuCore::getMergedFontScale(count);
+            nvgFontSize(vg, DanmakuCore::DANMAKU_STYLE_FONTSIZE * i.scale);
+            auto text = fmt::format("{} ×{}", i.danmaku->dan, count);
+            nvgTextBounds(vg, 0, 0, text.c_str(), nullptr, bounds);
+            nvgFontSize(vg, DanmakuCore::DANMAKU_STYLE_FONTSIZE);
+        } else {
+            nvgTextBounds(vg, 0, 0, i.danmaku->dan, nullptr, bounds);
+        }
         i.length = bounds[2] - bounds[0];
         if (!i.length) i.length = 1;
     }
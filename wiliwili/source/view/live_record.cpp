@@ -0,0 +1,239 @@
+#include <borealis/core/logger.hpp>
+#include <borealis/core/thread.hpp>
+#include <cpr/filesystem.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <ctime>
+#include <fstream>
+#include <iomanip>
+
+#include "view/live_record.hpp"
+#include "utils/config_helper.hpp"
+
+void LiveDanmakuRecordSegment::close(bool remove) {
+    if (file) {
+        fclose(file);
+        file = nullptr;
+    }
+    if (remove && !path.empty()) std::remove(path.c_str());
+    size  = 0;
+    start = end = 0;
+    count = 0;
+    index.clear();
+}
+
+LiveDanmakuRecorder::~LiveDanmakuRecorder() { this->close(); }
+
+bool LiveDanmakuRecorder::open(int id) {
+    this->close();
+
+    std::lock_guard<std::mutex> lock(mutex);
+    std::string dir = ProgramConfig::instance().getConfigDir() + "/live_danmaku";
+    std::error_code ec;
+    cpr::fs::create_directories(dir, ec);
+
+    this->room_id = id;
+    for (size_t i = 0; i < 2; i++) {
+        segments[i].path = dir + "/" + std::to_string(id) + "_" + std::to_string(i) + ".bin";
+    }
+    this->current         = 0;
+    this->start_time      = std::chrono::steady_clock::now();
+    this->start_timestamp = std::time(nullptr);
+    if (!openSegment(0)) return false;
+
+    brls::Logger::info("LiveDanmakuRecorder: start recording room {}", id);
+    return true;
+}
+
+bool LiveDanmakuRecorder::openSegment(size_t i) {
+    auto &segment = segments[i];
+    segment.close(true);
+    segment.file = fopen(segment.path.c_str(), "w+b");
+    if (!segment.file) {
+        brls::Logger::error("LiveDanmakuRecorder: cannot open {}", segment.path);
+        return false;
+    }
+    return true;
+}
+
+void LiveDanmakuRecorder::close() {
+    std::lock_guard<std::mutex> lock(mutex);
+    for (auto &segment : segments) segment.close(true);
+}
+
+void LiveDanmakuRecorder::closeAndExport(const std::string &path) {
+    static std::atomic<size_t> exportCount{0};
+    std::vector<std::string> files;
+    int id;
+    int64_t timestamp;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        id        = room_id;
+        timestamp = start_timestamp;
+        // 先处理较早的分段；重命名后，同一直播间重新开始录制时不会覆盖待导出的文件
+        for (size_t i : {1 - current, current}) {
+            auto &segment = segments[i];
+            if (segment.file && segment.count > 0) {
+                fclose(segment.file);
+                segment.file    = nullptr;
+                std::string tmp = segment.path + "." + std::to_string(exportCount++) + ".export";
+                if (std::rename(segment.path.c_str(), tmp.c_str()) == 0) files.emplace_back(tmp);
+            }
+            segment.close(true);
+        }
+    }
+    if (files.empty()) return;
+
+    brls::Threading::async([files, path, id, timestamp]() {
+        exportXML(files, path, id, timestamp);
+        for (auto &i : files) std::remove(i.c_str());
+    });
+}
+
+bool LiveDanmakuRecorder::isOpen() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return segments[current].file != nullptr;
+}
+
+uint32_t LiveDanmakuRecorder::now() const {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start_time).count();
+}
+
+void LiveDanmakuRecorder::append(const danmaku_t *dan, uint32_t time) {
+    if (!dan || !dan->dan) return;
+
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!segments[current].file) return;
+
+    // 当前分段写满后切换到另一个分段，较早的弹幕随之删除
+    if (segments[current].size >= SEGMENT_SIZE) {
+        current = 1 - current;
+        if (!openSegment(current)) return;
+    }
+    auto &segment = segments[current];
+
+    size_t length = std::min(strlen(dan->dan), (size_t)UINT16_MAX);
+    LiveDanmakuRecordHeader header{};
+    header.time   = time;
+    header.color  = dan->dan_color;
+    header.length = (uint16_t)length;
+    header.type   = dan->dan_type;
+    header.size   = dan->dan_size;
+    header.level  = dan->user_level;
+    header.flags  = dan->is_emoticon ? LIVE_RECORD_FLAG_EMOTICON : 0;
+
+    // 读取后需要重新定位到文件末尾才能继续写入
+    fseek(segment.file, 0, SEEK_END);
+    if (fwrite(&header, sizeof(header), 1, segment.file) != 1 ||
+        fwrite(dan->dan, 1, length, segment.file) != length) {
+        brls::Logger::error("LiveDanmakuRecorder: failed to write {}", segment.path);
+        return;
+    }
+
+    if (segment.index.empty() || time >= segment.index.back().first + INDEX_INTERVAL) {
+        segment.index.emplace_back(time, segment.size);
+    }
+    if (segment.count == 0) segment.start = time;
+    segment.end = time;
+    segment.size += sizeof(header) + length;
+    segment.count++;
+}
+
+void LiveDanmakuRecorder::readSegment(LiveDanmakuRecordSegment &segment, uint32_t start, uint32_t end,
+                                      const on_record_func_t &func) {
+    if (!segment.file || segment.count == 0) return;
+    if (segment.end < start || segment.start >= end) return;
+
+    // 从 start 之前最近的索引位置开始读取
+    auto it = std::upper_bound(segment.index.begin(), segment.index.end(), start,
+                               [](uint32_t time, const std::pair<uint32_t, uint64_t> &i) { return time < i.first; });
+    uint64_t offset = it == segment.index.begin() ? 0 : std::prev(it)->second;
+
+    fflush(segment.file);
+    fseek(segment.file, (long)offset, SEEK_SET);
+
+    LiveDanmakuRecordHeader header{};
+    std::string text;
+    while (offset < segment.size && fread(&header, sizeof(header), 1, segment.file) == 1) {
+        text.resize(header.length);
+        if (header.length && fread(&text[0], 1, header.length, segment.file) != header.length) break;
+        offset += sizeof(header) + header.length;
+        if (header.time >= end) break;
+        if (header.time >= start) func(header, text);
+    }
+}
+
+void LiveDanmakuRecorder::read(uint32_t start, uint32_t end, const on_record_func_t &func) {
+    std::lock_guard<std::mutex> lock(mutex);
+    // 先读取较早的分段
+    readSegment(segments[1 - current], start, end, func);
+    readSegment(segments[current], start, end, func);
+}
+
+static void escapeXML(std::ostream &out, const std::string &text) {
+    for (char c : text) {
+        switch (c) {
+            case '&':
+                out << "&amp;";
+                break;
+            case '<':
+                out << "&lt;";
+                break;
+            case '>':
+                out << "&gt;";
+                break;
+            case '"':
+                out << "&quot;";
+                break;
+            case '\'':
+                out << "&apos;";
+                break;
+            default:
+                // xml 1.0 不允许出现的控制字符
+                if ((unsigned char)c >= 0x20 || c == '\t' || c == '\n' || c == '\r') out << c;
+        }
+    }
+}
+
+bool LiveDanmakuRecorder::exportXML(const std::vector<std::string> &files, const std::string &path, int room_id,
+                                    int64_t start_timestamp) {
+    std::ofstream file(path);
+    if (!file) {
+        brls::Logger::error("LiveDanmakuRecorder: cannot export to {}", path);
+        return false;
+    }
+
+    file << R"(<?xml version="1.0" encoding="UTF-8"?>)" << "\n";
+    file << "<i><chatserver>chat.bilibili.com</chatserver><chatid>" << room_id
+         << "</chatid><mission>0</mission><maxlimit>0</maxlimit><state>0</state><real_name>0</real_name>"
+            "<source>k-v</source>\n";
+
+    // 格式: 出现时间,类型,字号,颜色,发送时间戳,弹幕池,用户,弹幕id,权重
+    // 权重由用户的直播等级 (0-60) 换算为 1-10
+    size_t count = 0;
+    file << std::fixed << std::setprecision(3);
+    LiveDanmakuRecordHeader header{};
+    std::string text;
+    for (auto &name : files) {
+        FILE *record = fopen(name.c_str(), "rb");
+        if (!record) continue;
+        while (fread(&header, sizeof(header), 1, record) == 1) {
+            text.resize(header.length);
+            if (header.length && fread(&text[0], 1, header.length, record) != header.length) break;
+            file << "<d p=\"" << header.time / 1000.0 << "," << (int)header.type << "," << (int)header.size << ","
+                 << header.color << "," << start_timestamp + header.time / 1000 << ",0,0,0,"
+                 << std::min(10, header.level / 6 + 1) << "\">";
+            escapeXML(file, text);
+            file << "</d>\n";
+            count++;
+        }
+        fclose(record);
+    }
+    file << "</i>\n";
+    file.close();
+
+    brls::Logger::info("LiveDanmakuRecorder: export {} danmaku to {}", count, path);
+    return true;
+}
@@ -2,6 +2,7 @@
 // Created by fang on 2022/8/12.
 //
 
+#include <algorithm>
 #include <cstdlib>
 #include <clocale>
 #include <pystring.h>
@@ -9,6 +10,7 @@
 #include <borealis/core/application.hpp>
 
 #include "utils/config_helper.hpp"
+#include "utils/frame_scheduler.hpp"
 #include "utils/number_helper.hpp"
 #include "utils/crash_helper.hpp"
 #include "view/mpv_core.hpp"
@@ -201,9 +203,7 @@ void MPVCore::on_update(void *self) {
         MPVCore::instance().redraw = flags & MPV_RENDER_UPDATE_FRAME;
         if (MPVCore::instance().redraw) {
 #ifdef MPV_SW_RENDER
-            if (!MPVCore::instance().pixels) return;
-            mpvRenderContextRender(MPVCore::instance().mpv_context, MPVCore::instance().mpv_params);
-            mpvRenderContextReportSwap(MPVCore::instance().mpv_context);
+            MPVCore::instance().renderSoftware();
 #else
             mpvRenderContextRender(MPVCore::instance().mpv_context, MPVCore::instance().mpv_params);
             glBindFramebuffer(GL_FRAMEBUFFER, MPVCore::instance().default_framebuffer);
@@ -273,11 +273,10 @@ MPVCore::MPVCore() {
     brls::Application::getExitDoneEvent()->subscribe([this]() {
         this->clean();
 #ifdef MPV_SW_RENDER
-        if (pixels) {
-            free(pixels);
-            pixels             = nullptr;
-            mpv_params[3].data = nullptr;
-        }
+        free(pixels);
+        pixels             = nullptr;
+        sw_capacity        = 0;
+        mpv_params[3].data = nullptr;
 #endif
     });
 }
@@ -389,7 +388,7 @@ void MPVCore::init() {
     check_error(mpvObserveProperty(mpv, 6, "percent-pos", MPV_FORMAT_DOUBLE));
     check_error(mpvObserveProperty(mpv, 7, "paused-for-cache", MPV_FORMAT_FLAG));
     //    check_error(mpvObserveProperty(mpv, 8, "demuxer-cache-time", MPV_FORMAT_DOUBLE));
-    //    check_error(mpvObserveProperty(mpv, 9, "demuxer-cache-state", MPV_FORMAT_NODE));
+    check_error(mpvObserveProperty(mpv, 9, "demuxer-cache-state", MPV_FORMAT_NODE));
     check_error(mpvObserveProperty(mpv, 10, "speed", MPV_FORMAT_DOUBLE));
     check_error(mpvObserveProperty(mpv, 11, "volume", MPV_FORMAT_INT64));
     check_error(mpvObserveProperty(mpv, 12, "pause", MPV_FORMAT_FLAG));
@@ -635,30 +634,33 @@ void MPVCore::setFrameSize(brls::Rect r) {
     int drawWidth  = rect.getWidth() * brls::Application::windowScale;
     int drawHeight = rect.getHeight() * brls::Application::windowScale;
     if (drawWidth == 0 || drawHeight == 0) return;
-    int frameSize = drawWidth * drawHeight;
+    size_t frameSize = (size_t)drawWidth * drawHeight;
 
-    if (pixels != nullptr && frameSize > sw_size[0] * sw_size[1]) {
-        brls::Logger::debug("Enlarge video surface buffer");
+    // 缓冲区只增不减，并按 1.5 倍扩容，避免调整窗口大小时反复申请内存
+    if (frameSize > sw_capacity) {
+        size_t capacity = std::max(frameSize, sw_capacity + sw_capacity / 2);
+        brls::Logger::debug("Enlarge video surface buffer: {}", capacity);
         free(pixels);
-        pixels = nullptr;
-    }
-
-    if (pixels == nullptr) {
-        pixels             = malloc(frameSize * PIXCEL_SIZE);
+        pixels             = malloc(capacity * PIXCEL_SIZE);
         mpv_params[3].data = pixels;
+        sw_capacity        = capacity;
     }
 
-    if (nvg_image) nvgDeleteImage(brls::Application::getNVGContext(), nvg_image);
-    nvg_image = nvgCreateImageRGBA(brls::Application::getNVGContext(), drawWidth, drawHeight, mpvImageFlags,
-                                   (const unsigned char *)pixels);
+    // 纹理尺寸不变时复用已有的纹理
+    if (!nvg_image || nvg_image_size[0] != drawWidth || nvg_image_size[1] != drawHeight) {
+        if (nvg_image) nvgDeleteImage(brls::Application::getNVGContext(), nvg_image);
+        nvg_image = nvgCreateImageRGBA(brls::Application::getNVGContext(), drawWidth, drawHeight, mpvImageFlags,
+                                       (const unsigned char *)pixels);
+        nvg_image_size[0] = drawWidth;
+        nvg_image_size[1] = drawHeight;
+    }
 
     sw_size[0] = drawWidth;
     sw_size[1] = drawHeight;
     pitch      = PIXCEL_SIZE * drawWidth;
 
     // 在视频暂停时调整纹理尺寸，视频画面会被清空为黑色，强制重新绘制一次，避免这个问题
-    mpvRenderContextRender(mpv_context, mpv_params);
-    mpvRenderContextReportSwap(mpv_context);
+    renderSoftware();
 #elif !defined(MPV_USE_FB)
         // Using default framebuffer
 #ifndef BOREALIS_USE_D3D11
@@ -708,6 +710,16 @@ void MPVCore::setFrameSize(brls::Rect r) {
 #endif
 }
 
+#ifdef MPV_SW_RENDER
+void MPVCore::renderSoftware() {
+    if (!pixels || !mpv_context) return;
+    mpvRenderContextRender(mpv_context, mpv_params);
+    mpvRenderContextReportSwap(mpv_context);
+    sw_dirty = true;
+    sw_frames_rendered++;
+}
+#endif
+
 bool MPVCore::isValid() { return mpv_context != nullptr; }
 
 void MPVCore::draw(brls::Rect area, float alpha) {
@@ -718,7 +730,12 @@ void MPVCore::draw(brls::Rect area, float alpha) {
     if (!pixels) return;
 
     auto *vg = brls::Application::getNVGContext();
-    nvgUpdateImage(vg, nvg_image, (const unsigned char *)pixels);
+    // 只在 mpv 绘制了新的画面时上传纹理
+    if (sw_dirty) {
+        nvgUpdateImage(vg, nvg_image, (const unsigned char *)pixels);
+        sw_dirty = false;
+        sw_frames_uploaded++;
+    }
 
     // draw black background
     nvgBeginPath(vg);
@@ -891,6 +908,7 @@ void MPVCore::eventMainLoop() {
                             bool playing = *(int *)data == 0;
                             if (playing != video_playing) {
                                 video_playing = playing;
+                                restartMediaClock();
                                 mpvCoreEvent.fire(MpvEventEnum::MPV_IDLE);
                             }
                             video_playing = playing;
@@ -919,6 +937,7 @@ void MPVCore::eventMainLoop() {
                         // 播放进度更新
                         if (((mpv_event_property *)event->data)->data) {
                             playback_time = *(double *)((mpv_event_property *)event->data)->data;
+                            updateMediaClock(playback_time);
                             if (video_progress != (int64_t)playback_time) {
                                 video_progress = (int64_t)playback_time;
                                 mpvCoreEvent.fire(MpvEventEnum::UPDATE_PROGRESS);
@@ -951,6 +970,8 @@ void MPVCore::eventMainLoop() {
                         if (*(int *)data) {
                             brls::Logger::info("========> VIDEO PAUSED FOR CACHE");
                             mpvCoreEvent.fire(MpvEventEnum::LOADING_START);
+                            // 跳转进度导致的缓冲不算作卡顿
+                            if (!video_seeking) mpvCoreEvent.fire(MpvEventEnum::CACHE_STALL);
                         } else {
                             brls::Logger::info("========> VIDEO RESUME FROM CACHE");
                             mpvCoreEvent.fire(MpvEventEnum::LOADING_END);
@@ -967,18 +988,24 @@ void MPVCore::eventMainLoop() {
                         // 缓存信息
                         if (((mpv_event_property *)event->data)->data) {
                             auto *node = (mpv_node *)((mpv_event_property *)event->data)->data;
+                            if (node->format != MPV_FORMAT_NODE_MAP) break;
                             std::unordered_map<std::string, mpv_node> node_map;
                             for (int i = 0; i < node->u.list->num; i++) {
                                 node_map.insert(
                                     std::make_pair(std::string(node->u.list->keys[i]), node->u.list->values[i]));
                             }
-                            brls::Logger::debug(
+                            auto it        = node_map.find("cache-duration");
+                            cache_duration = 0;
+                            if (it != node_map.end() && it->second.format == MPV_FORMAT_DOUBLE) {
+                                cache_duration = it->second.u.double_;
+                            }
+                            brls::Logger::verbose(
                                 "total-bytes: {:.2f}MB; cache-duration: "
                                 "{:.2f}; "
                                 "underrun: {}; fw-bytes: {:.2f}MB; bof-cached: "
                                 "{}; eof-cached: {}; file-cache-bytes: {}; "
                                 "raw-input-rate: {:.2f};",
-                                node_map["total-bytes"].u.int64 / 1048576.0, node_map["cache-duration"].u.double_,
+                                node_map["total-bytes"].u.int64 / 1048576.0, cache_duration,
                                 node_map["underrun"].u.flag, node_map["fw-bytes"].u.int64 / 1048576.0,
                                 node_map["bof-cached"].u.flag, node_map["eof-cached"].u.flag,
                                 node_map["file-cache-bytes"].u.int64 / 1048576.0,
@@ -989,6 +1016,7 @@ void MPVCore::eventMainLoop() {
                         // 倍速信息
                         if (data) {
                             video_speed = *(double *)data;
+                            restartMediaClock();
                             mpvCoreEvent.fire(VIDEO_SPEED_CHANGE);
                         }
                         break;
@@ -1063,15 +1091,23 @@ void MPVCore::eventMainLoop() {
 
 void MPVCore::reset() {
     brls::Logger::debug("MPVCore::reset");
+#ifdef MPV_SW_RENDER
+    brls::Logger::debug("MPVCore: frames rendered: {}, uploaded: {}", sw_frames_rendered, sw_frames_uploaded);
+#endif
     mpvCoreEvent.fire(MpvEventEnum::RESET);
     this->percent_pos    = 0;
     this->duration       = 0;  // second
     this->cache_speed    = 0;  // Bps
+    this->cache_duration = 0;
     this->playback_time  = 0;
     this->video_progress = 0;
     this->mpv_error_code = 0;
     this->video_aspect   = aspectConverter(MPVCore::VIDEO_ASPECT);
 
+    // 重置平滑播放进度
+    this->media_clock_valid = false;
+    this->setMediaClock(0, 0);
+
     // 软硬解切换后应该手动设置一次渲染尺寸
     // 切换视频前设置渲染尺寸可以顺便将上一条视频的最后一帧画面清空
     setFrameSize(rect);
@@ -1240,11 +1276,47 @@ std::unordered_map<std::string, mpv_node> MPVCore::getNodeMap(const std::string
 
 double MPVCore::getPlaybackTime() const { return playback_time; }
 
+double MPVCore::getMediaTime() const {
+    const auto &anchor = media_clock[media_clock_index.load(std::memory_order_acquire)];
+    return anchor.media + (double)(brls::getCPUTimeUsec() - anchor.wall) / 1e6 * anchor.rate;
+}
+
+void MPVCore::setMediaClock(double media, double rate) {
+    int next          = 1 - media_clock_index.load(std::memory_order_relaxed);
+    media_clock[next] = {media, brls::getCPUTimeUsec(), rate};
+    media_clock_index.store(next, std::memory_order_release);
+}
+
+void MPVCore::updateMediaClock(double time) {
+    double rate = video_playing ? (video_speed > 0 ? video_speed : 1.0) : 0;
+    if (!media_clock_valid || rate == 0) {
+        media_clock_valid = true;
+        setMediaClock(time, rate);
+        return;
+    }
+
+    double current = getMediaTime();
+    double error   = time - current;
+    if (fabs(error) > MEDIA_CLOCK_JUMP) {
+        // 跳转或者长时间卡顿
+        setMediaClock(time, rate);
+        return;
+    }
+
+    // 通过略微调整时间的增长速度来消除偏差，保证时间单调递增
+    double correction = std::clamp(error / MEDIA_CLOCK_CORRECTION, -0.1 * rate, 0.1 * rate);
+    setMediaClock(current, rate + correction);
+}
+
+void MPVCore::restartMediaClock() {
+    double rate = video_playing ? (video_speed > 0 ? video_speed : 1.0) : 0;
+    setMediaClock(media_clock_valid ? getMediaTime() : playback_time, rate);
+}
+
 void MPVCore::disableDimming(bool disable) {
     brls::Logger::info("disableDimming: {}", disable);
     brls::Application::getPlatform()->disableScreenDimming(disable, "Playing video", APPVersion::getPackageName());
-    static bool deactivationAvailable = ProgramConfig::instance().getSettingItem(SettingItem::DEACTIVATED_TIME, 0) > 0;
-    if (deactivationAvailable) {
+    if (FrameScheduler::instance().isDeactivationEnabled()) {
         brls::Application::setAutomaticDeactivation(!disable);
     }
 }
@@ -2,9 +2,60 @@
 // Created by fang on 2022/6/15.
 //
 
+#include <algorithm>
 #include <utility>
+#include <cpr/cpr.h>
+#include <borealis/core/singleton.hpp>
+#include <borealis/core/thread.hpp>
+
 #include "view/recycling_grid.hpp"
 #include "view/button_refresh.hpp"
+#include "utils/frame_scheduler.hpp"
+
+/// 执行列表项后台布局任务的线程
+class LayoutThreadPool : public cpr::ThreadPool, public brls::Singleton<LayoutThreadPool> {
+public:
+    LayoutThreadPool() : cpr::ThreadPool(1, 1, std::chrono::milliseconds(5000)) { this->Start(); }
+
+    ~LayoutThreadPool() override { this->Stop(); }
+};
+
+/**
+ * 在空闲的帧中预先创建列表项
+ * 注册列表项后等待 DELAY 毫秒（避开启动时的首屏加载），之后交给 FrameScheduler 在空闲的帧中执行：
+ * 每帧最多使用 RecyclingGrid::WARM_BUDGET 毫秒，为每种列表项创建 spanCount * RecyclingGrid::WARM_ROWS 个放入缓存列表
+ */
+class RecyclingGridWarmer : public brls::Singleton<RecyclingGridWarmer> {
+public:
+    void add(RecyclingGrid* grid, const std::string& identifier) {
+        if (RecyclingGrid::WARM_ROWS == 0) return;
+        jobs.emplace_back(grid, identifier);
+        if (scheduled) return;
+        scheduled = true;
+        brls::delay(DELAY, [this]() { FrameScheduler::instance().addIdleTask([this]() { return run(); }); });
+    }
+
+    void remove(RecyclingGrid* grid) {
+        jobs.erase(std::remove_if(jobs.begin(), jobs.end(), [grid](auto& i) { return i.first == grid; }), jobs.end());
+    }
+
+    static inline brls::Time DELAY = 1000;
+
+private:
+    /// 返回 false 时不再执行，直到有新的列表项注册
+    bool run() {
+        brls::Time stop = brls::getCPUTimeUsec() + (brls::Time)(RecyclingGrid::WARM_BUDGET * 1000);
+        while (!jobs.empty() && brls::getCPUTimeUsec() < stop) {
+            auto& job = jobs.front();
+            if (!job.first->warmUpCell(job.second)) jobs.pop_front();
+        }
+        scheduled = !jobs.empty();
+        return scheduled;
+    }
+
+    std::deque<std::pair<RecyclingGrid*, std::string>> jobs;
+    bool scheduled = false;
+};
 
 /// RecyclingGridItem
 
@@ -65,6 +116,93 @@ private:
     unsigned int num;
 };
 
+/// CellHeightIndex
+
+void CellHeightIndex::clear() {
+    heights.clear();
+    estimated.clear();
+    knownTree.assign(1, 0);
+    unknownTree.assign(1, 0);
+    estimatedTree.assign(1, 0);
+}
+
+void CellHeightIndex::push_back(float height) {
+    if (knownTree.empty()) this->clear();
+    heights.push_back(height);
+    estimated.push_back(false);
+
+    // 新节点覆盖 (n - lowbit(n), n]，由新的一项与已有的子节点求和得到
+    size_t n       = heights.size();
+    size_t low     = n - (n & (~n + 1));
+    double known   = height == -1 ? 0 : height;
+    size_t unknown = height == -1 ? 1 : 0;
+    size_t guess   = 0;
+    for (size_t i = n - 1; i > low; i -= i & (~i + 1)) {
+        known += knownTree[i];
+        unknown += unknownTree[i];
+        guess += estimatedTree[i];
+    }
+    knownTree.push_back(known);
+    unknownTree.push_back(unknown);
+    estimatedTree.push_back(guess);
+}
+
+void CellHeightIndex::set(size_t index, float height, bool estimate) {
+    if (index >= heights.size()) return;
+    float old    = heights[index];
+    bool oldFlag = estimated[index];
+    if (height == -1) estimate = false;
+    if (old == height && oldFlag == estimate) return;
+    heights[index]   = height;
+    estimated[index] = estimate;
+
+    double knownDelta  = (height == -1 ? 0 : height) - (old == -1 ? 0 : old);
+    int unknownDelta   = (height == -1 ? 1 : 0) - (old == -1 ? 1 : 0);
+    int estimatedDelta = (estimate ? 1 : 0) - (oldFlag ? 1 : 0);
+    for (size_t i = index + 1; i < knownTree.size(); i += i & (~i + 1)) {
+        knownTree[i] += knownDelta;
+        unknownTree[i] += unknownDelta;
+        estimatedTree[i] += estimatedDelta;
+    }
+}
+
+double CellHeightIndex::getOffset(size_t index, float unknownHeight, float space) const {
+    if (index > heights.size()) index = heights.size();
+    double known   = 0;
+    size_t unknown = 0;
+    for (size_t i = index; i > 0; i -= i & (~i + 1)) {
+        known += knownTree[i];
+        unknown += unknownTree[i];
+    }
+    return known + (double)unknown * unknownHeight + (double)index * space;
+}
+
+size_t CellHeightIndex::getUnknownCount(size_t index) const {
+    if (index > heights.size()) index = heights.size();
+    size_t unknown = 0;
+    for (size_t i = index; i > 0; i -= i & (~i + 1)) unknown += unknownTree[i] + estimatedTree[i];
+    return unknown;
+}
+
+size_t CellHeightIndex::findIndex(double offset, float unknownHeight, float space) const {
+    size_t n    = heights.size();
+    size_t step = 1;
+    while (step * 2 <= n) step *= 2;
+
+    // 从高位到低位逐步确定结果，每一步跳过的节点恰好覆盖 step 项
+    size_t pos = 0;
+    for (; step > 0; step /= 2) {
+        size_t next = pos + step;
+        if (next > n) continue;
+        double height = knownTree[next] + (double)unknownTree[next] * unknownHeight + (double)step * space;
+        if (height <= offset) {
+            pos = next;
+            offset -= height;
+        }
+    }
+    return pos;
+}
+
 /// RecyclingGrid
 
 RecyclingGrid::RecyclingGrid() {
@@ -78,6 +216,8 @@ RecyclingGrid::RecyclingGrid() {
     this->hintLabel->detach();
     this->hintLabel->setFontSize(14);
     this->hintLabel->setHorizontalAlign(brls::HorizontalAlign::CENTER);
+    this->footerSkeleton = new SkeletonCell();
+    this->footerSkeleton->detach();
 
     // Create Refresh button
     this->refreshButton = new ButtonRefresh();
@@ -120,6 +260,8 @@ RecyclingGrid::RecyclingGrid() {
         this->reloadData();
     });
 
+    this->registerFloatXMLAttribute("nextPageRatio", [this](float value) { this->nextPageRatio = value; });
+
     this->registerBoolXMLAttribute("flowMode", [this](bool value) {
         this->spanCount  = 1;
         this->isFlowMode = value;
@@ -138,10 +280,15 @@ RecyclingGrid::RecyclingGrid() {
 
 RecyclingGrid::~RecyclingGrid() {
     brls::Logger::debug("View RecyclingGridActivity: delete");
+    RecyclingGridWarmer::instance().remove(this);
+    // 丢弃还未完成的后台布局任务
+    (*layoutToken)++;
     if (this->hintImage) this->hintImage->freeView();
     this->hintImage = nullptr;
     if (this->hintLabel) this->hintLabel->freeView();
     this->hintLabel = nullptr;
+    if (this->footerSkeleton) this->footerSkeleton->freeView();
+    this->footerSkeleton = nullptr;
     delete this->dataSource;
     for (const auto& it : queueMap) {
         for (auto item : *it.second) {
@@ -178,12 +325,31 @@ void RecyclingGrid::draw(NVGcontext* vg, float x, float y, float width, float he
 void RecyclingGrid::registerCell(std::string identifier, std::function<RecyclingGridItem*()> allocation) {
     queueMap.insert(std::make_pair(identifier, new std::vector<RecyclingGridItem*>()));
     allocationMap.insert(std::make_pair(identifier, allocation));
+    // 骨架屏只在加载时短暂显示，不需要预先创建
+    if (identifier != "Skeleton") RecyclingGridWarmer::instance().add(this, identifier);
+}
+
+RecyclingGridItem* RecyclingGrid::allocateCell(const std::string& identifier) {
+    RecyclingGridItem* cell = allocationMap.at(identifier)();
+    cell->reuseIdentifier   = identifier;
+    cell->detach();
+    cellCount[identifier]++;
+    return cell;
+}
+
+bool RecyclingGrid::warmUpCell(const std::string& identifier) {
+    auto it = queueMap.find(identifier);
+    if (it == queueMap.end()) return false;
+    if (cellCount[identifier] >= (size_t)spanCount * WARM_ROWS) return false;
+    it->second->push_back(allocateCell(identifier));
+    return true;
 }
 
 void RecyclingGrid::addCellAt(size_t index, bool downSide) {
     RecyclingGridItem* cell;
     //获取到一个填充好数据的cell
     cell = dataSource->cellForRow(this, index);
+    cellLayoutCache.erase(index);
 
     float cellHeight = estimatedRowHeight;
     float cellWidth  = (renderedFrame.getWidth() - getPaddingLeft() - getPaddingRight()) / spanCount -
@@ -193,14 +359,14 @@ void RecyclingGrid::addCellAt(size_t index, bool downSide) {
     if (isFlowMode) {
         // 必须在 getHeight 前设置宽度，否则会影响到cell自定义高度的判定
         cell->setWidth(cellWidth);
-        if (cellHeightCache[index] == -1) {
-            // 没有预定义cell的高度，使用cell默认的高度
+        if (cellHeightCache[index] == -1 || cellHeightCache.isEstimated(index)) {
+            // 没有预定义cell的高度或只有后台布局估计的高度，使用cell默认的高度
             cellHeight = cell->getHeight();
 
             if (cellHeight > estimatedRowHeight) {
                 cellHeight = estimatedRowHeight;
             }
-            cellHeightCache[index] = cellHeight;
+            cellHeightCache.set(index, cellHeight);
         } else {
             // dataSource 中指定了cell的高度，使用预定义的值
             cellHeight = cellHeightCache[index];
@@ -218,10 +384,15 @@ void RecyclingGrid::addCellAt(size_t index, bool downSide) {
     cell->setIndex(index);
 
     this->contentBox->getChildren().insert(this->contentBox->getChildren().end(), cell);
+    if (downSide)
+        visibleCells.push_back(cell);
+    else
+        visibleCells.push_front(cell);
 
-    // Allocate and set parent userdata
-    size_t* userdata = (size_t*)malloc(sizeof(size_t));
-    *userdata        = index;
+    // 复用列表项上次分配的 userdata，避免每次添加都重新分配
+    auto* userdata = (size_t*)cell->getParentUserData();
+    if (!userdata) userdata = (size_t*)malloc(sizeof(size_t));
+    *userdata = index;
 
     cell->setParent(this->contentBox, userdata);
 
@@ -241,8 +412,7 @@ void RecyclingGrid::addCellAt(size_t index, bool downSide) {
     }
 
     // 瀑布流模式需要不断修正高度
-    if (isFlowMode)
-        contentBox->setHeight(getHeightByCellIndex(this->dataSource->getItemCount()) + paddingTop + paddingBottom);
+    if (isFlowMode) this->updateContentHeight();
 
     brls::Logger::verbose("Cell #{} - added", index);
 }
@@ -251,23 +421,24 @@ void RecyclingGrid::setDataSource(RecyclingGridDataSource* source) {
     if (this->dataSource) delete this->dataSource;
 
     // 允许自动加载下一页
-    this->requestNextPage = false;
-    this->dataSource      = source;
+    this->requestNextPage     = false;
+    this->pageRequestTime     = 0;
+    this->preFetchPageEnabled = true;
+    this->dataSource          = source;
     if (layouted) reloadData();
 }
 
 void RecyclingGrid::reloadData() {
+    FrameScheduler::instance().markDirty();
     if (!layouted) return;
 
     // 将所有节点从屏幕上移除放入重复利用的列表中
-    auto children = this->contentBox->getChildren();
-    for (auto const& child : children) {
-        queueReusableCell((RecyclingGridItem*)child);
-        this->contentBox->removeView(child, false);
-    }
+    this->recycleAllCells();
 
-    visibleMin = UINT_MAX;
-    visibleMax = 0;
+    // 数据可能已经变化，丢弃所有后台布局结果
+    (*layoutToken)++;
+    cellLayoutCache.clear();
+    cellLayoutRequested.clear();
 
     renderedFrame            = brls::Rect();
     renderedFrame.size.width = getWidth();
@@ -289,8 +460,7 @@ void RecyclingGrid::reloadData() {
     // 设置列表的高度（真实高度，非显示的高度）
     if (!isFlowMode || spanCount != 1) {
         // 设置了固定的高度
-        contentBox->setHeight((estimatedRowHeight + estimatedRowSpace) * (float)getRowCount() + paddingTop +
-                              paddingBottom);
+        this->updateContentHeight();
         // 添加当前焦点 cell 所在行的第一项到屏幕，其余项通过 selectRowAt 内的 itemsRecyclingLoop 自动添加
         // 这里添加首项是因为添加首项时会变更 renderedFrame 的 height 值，包括 itemsRecyclingLoop 内的计算也都是以首项为基准进行的
         // 原则上这里的 addCellAt 任意添加一项即可（比如添加第零项），但最好能添加到 cellFocusIndex 附近，这有助于提升首屏性能
@@ -309,10 +479,12 @@ void RecyclingGrid::reloadData() {
             float height = dataSource->heightForRow(this, section);
             cellHeightCache.push_back(height);
         }
-        contentBox->setHeight(getHeightByCellIndex(dataSource->getItemCount()) + paddingTop + paddingBottom);
-        // 流式布局无法准确确定焦点cell的位置，因此暂时只添加第一项，在 itemsRecyclingLoop 中会逐渐添加到 cellFocusIndex，再按需删除
-        // 当 cellFocusIndex 过于大时，会导致添加的元素过多，因此需要考虑优化
-        this->addCellAt(0, true);
+        this->updateContentHeight();
+        // 焦点cell之前的项高度都已知时，可以准确确定焦点cell的位置，直接从焦点cell开始添加
+        // 否则只添加第一项，在 itemsRecyclingLoop 中会逐渐添加到 cellFocusIndex，再按需删除
+        size_t startIndex      = cellHeightCache.getUnknownCount(cellFocusIndex) == 0 ? cellFocusIndex : 0;
+        renderedFrame.origin.y = getHeightByCellIndex(startIndex);
+        this->addCellAt(startIndex, true);
     }
 
     // 在前面的操作中，列表增加了一项，通过 selectRowAt 再精确地显示出具体选中项
@@ -321,32 +493,34 @@ void RecyclingGrid::reloadData() {
 
 void RecyclingGrid::notifyDataChanged() {
     // todo: 目前仅能处理data在原本的基础上增加的情况，需要考虑data减少或更换时的情况
+    FrameScheduler::instance().markDirty();
     if (!layouted) return;
 
+    if (pageRequestTime != 0) {
+        // 记录下一页请求的平均耗时，用来决定预加载的时机
+        float latency   = (float)(brls::getCPUTimeUsec() - pageRequestTime) / 1000.0f;
+        pageLatency     = pageLatency * 0.7f + latency * 0.3f;
+        pageRequestTime = 0;
+    }
+
     if (dataSource) {
         if (isFlowMode) {
             for (size_t i = cellHeightCache.size(); i < dataSource->getItemCount(); i++) {
                 float height = dataSource->heightForRow(this, i);
                 cellHeightCache.push_back(height);
             }
-            contentBox->setHeight(getHeightByCellIndex(this->dataSource->getItemCount()) + paddingTop + paddingBottom);
-        } else {
-            contentBox->setHeight((estimatedRowHeight + estimatedRowSpace) * this->getRowCount() + paddingTop +
-                                  paddingBottom);
         }
+        this->updateContentHeight();
     }
     // 数据增多后重新允许加载下一页
-    requestNextPage = false;
+    requestNextPage     = false;
+    preFetchPageEnabled = true;
 }
 
 RecyclingGridItem* RecyclingGrid::getGridItemByIndex(size_t index) {
-    for (brls::View* i : contentBox->getChildren()) {
-        RecyclingGridItem* v = dynamic_cast<RecyclingGridItem*>(i);
-        if (!v) continue;
-        if (v->getIndex() == index) return v;
-    }
     // 当前索引数据没有绑定列表项
-    return nullptr;
+    if (visibleCells.empty() || index < visibleMin || index > visibleMax) return nullptr;
+    return visibleCells[index - visibleMin];
 }
 
 std::vector<RecyclingGridItem*>& RecyclingGrid::getGridItems() {
@@ -387,13 +561,20 @@ void RecyclingGrid::itemsRecyclingLoop() {
 
     brls::Rect visibleFrame = getVisibleFrame();
 
+    // 可见区域与已添加的列表项不再重叠时（如快速滑动或跳转），直接定位到可见区域顶部所在的行
+    // 避免逐个添加并回收中间经过的列表项；瀑布流模式下只在 index 之前各项的高度都已知时才能准确定位
+    if (!contentBox->getChildren().empty() && (renderedFrame.getMaxY() < visibleFrame.getMinY() - paddingTop ||
+                                               renderedFrame.getMinY() > visibleFrame.getMaxY() - paddingTop)) {
+        size_t index = getCellIndexByHeight(visibleFrame.getMinY() - paddingTop);
+        if (!isFlowMode || cellHeightCache.getUnknownCount(index) == 0) {
+            brls::Logger::verbose("RecyclingGrid jump to: {}", index);
+            resetCellsAt(index);
+        }
+    }
+
     // 上方元素自动销毁
     while (true) {
-        RecyclingGridItem* minCell = nullptr;
-        for (auto it : contentBox->getChildren())
-
-            // todo: contentBox 循环时加锁？it出现过空指针报错
-            if (*((size_t*)it->getParentUserData()) == visibleMin) minCell = (RecyclingGridItem*)it;
+        RecyclingGridItem* minCell = visibleCells.empty() ? nullptr : visibleCells.front();
 
         // 当第一个cell的顶部 与 组件顶部的距离大于 preFetchLine 行元素的距离时结束
         if (!minCell || (minCell->getDetachedPosition().y +
@@ -407,6 +588,7 @@ void RecyclingGrid::itemsRecyclingLoop() {
         renderedFrame.origin.y += minCell->getIndex() % spanCount == 0 ? cellHeight + estimatedRowSpace : 0;
         renderedFrame.size.height -= minCell->getIndex() % spanCount == 0 ? cellHeight + estimatedRowSpace : 0;
 
+        visibleCells.pop_front();
         queueReusableCell(minCell);
         this->contentBox->removeView(minCell, false);
 
@@ -417,10 +599,7 @@ void RecyclingGrid::itemsRecyclingLoop() {
 
     // 下方元素自动销毁
     while (true) {
-        RecyclingGridItem* maxCell = nullptr;
-        // todo: contentBox 循环时加锁？it出现过空指针报错
-        for (auto it : contentBox->getChildren())
-            if (*((size_t*)it->getParentUserData()) == visibleMax) maxCell = (RecyclingGridItem*)it;
+        RecyclingGridItem* maxCell = visibleCells.empty() ? nullptr : visibleCells.back();
 
         // 当最后一个cell的顶部 与 组件底部间的距离 小于 preFetchLine 行元素的距离时结束
         if (!maxCell || (maxCell->getDetachedPosition().y -
@@ -436,6 +615,7 @@ void RecyclingGrid::itemsRecyclingLoop() {
 
         renderedFrame.size.height -= maxCell->getIndex() % spanCount == 0 ? cellHeight + estimatedRowSpace : 0;
 
+        visibleCells.pop_back();
         queueReusableCell(maxCell);
         this->contentBox->removeView(maxCell, false);
 
@@ -469,17 +649,9 @@ void RecyclingGrid::itemsRecyclingLoop() {
         addCellAt(visibleMax + 1, true);
     }
 
-    if (visibleMax + 1 >= this->getItemCount()) {
-        // 只有当 requestNextPage 为false时，才可以请求下一页，避免多次重复请求
-        if (!requestNextPage && nextPageCallback) {
-            // 有数据、不是骨架屏数据、数据不为空
-            if (dataSource && !dynamic_cast<DataSourceSkeleton*>(dataSource) && dataSource->getItemCount() > 0) {
-                brls::Logger::debug("RecyclingGrid request next page");
-                requestNextPage = true;
-                this->nextPageCallback();
-            }
-        }
-    }
+    checkNextPage(visibleFrame);
+
+    requestCellLayout();
 }
 
 RecyclingGridDataSource* RecyclingGrid::getDataSource() const { return this->dataSource; }
@@ -500,12 +672,8 @@ void RecyclingGrid::selectRowAt(size_t index, bool animated) {
     this->setContentOffsetY(getHeightByCellIndex(index), animated);
     this->itemsRecyclingLoop();
 
-    for (View* view : contentBox->getChildren()) {
-        if (*((size_t*)view->getParentUserData()) == index) {
-            contentBox->setLastFocusedView(view);
-            break;
-        }
-    }
+    RecyclingGridItem* cell = getGridItemByIndex(index);
+    if (cell) contentBox->setLastFocusedView(cell);
 }
 
 float RecyclingGrid::getHeightByCellIndex(size_t index, size_t start) {
@@ -517,20 +685,176 @@ float RecyclingGrid::getHeightByCellIndex(size_t index, size_t start) {
         return 0;
     }
 
-    if (start < 0) start = 0;
     if (index > this->cellHeightCache.size()) index = this->cellHeightCache.size();
+    if (index <= start) return 0;
+
+    return (float)(cellHeightCache.getOffset(index, estimatedRowHeight, estimatedRowSpace) -
+                   cellHeightCache.getOffset(start, estimatedRowHeight, estimatedRowSpace));
+}
 
-    float res = 0;
-    for (size_t i = start; i < index && i < cellHeightCache.size(); i++) {
-        if (cellHeightCache[i] != -1)
-            res += cellHeightCache[i] + estimatedRowSpace;
-        else
-            res += estimatedRowHeight + estimatedRowSpace;
+size_t RecyclingGrid::getCellIndexByHeight(float height) {
+    if (!dataSource || dataSource->getItemCount() == 0 || height <= 0) return 0;
+    size_t count = dataSource->getItemCount();
+
+    size_t index;
+    if (!isFlowMode) {
+        index = (size_t)(height / (estimatedRowHeight + estimatedRowSpace)) * spanCount;
+    } else {
+        index = cellHeightCache.findIndex(height, estimatedRowHeight, estimatedRowSpace);
     }
-    return res;
+    if (index >= count) index = (count - 1) / spanCount * spanCount;
+    return index;
 }
 
-void RecyclingGrid::forceRequestNextPage() { this->requestNextPage = false; }
+void RecyclingGrid::recycleAllCells() {
+    for (auto cell : visibleCells) {
+        queueReusableCell(cell);
+        this->contentBox->removeView(cell, false);
+    }
+    visibleCells.clear();
+
+    visibleMin = UINT_MAX;
+    visibleMax = 0;
+}
+
+void RecyclingGrid::resetCellsAt(size_t index) {
+    this->recycleAllCells();
+
+    // 与 reloadData 相同，伪装成已经移除了 index 之前的列表项
+    index                     = index / spanCount * spanCount;
+    renderedFrame.origin.y    = getHeightByCellIndex(index);
+    renderedFrame.size.height = 0;
+    this->addCellAt(index, true);
+}
+
+std::shared_ptr<RecyclingGridLayout> RecyclingGrid::takeCellLayout(size_t index) {
+    auto it = cellLayoutCache.find(index);
+    if (it == cellLayoutCache.end()) return nullptr;
+    auto layout = it->second;
+    cellLayoutCache.erase(it);
+    return layout;
+}
+
+void RecyclingGrid::requestCellLayout() {
+    if (!isFlowMode || preLayoutLine <= 0 || visibleCells.empty()) return;
+    size_t end = std::min((size_t)visibleMax + 1 + preLayoutLine, cellHeightCache.size());
+
+    // 丢弃已经离开预布局范围的结果
+    while (!cellLayoutCache.empty() && cellLayoutCache.begin()->first < visibleMin)
+        cellLayoutCache.erase(cellLayoutCache.begin());
+    while (!cellLayoutCache.empty() && cellLayoutCache.rbegin()->first >= end)
+        cellLayoutCache.erase(std::prev(cellLayoutCache.end()));
+
+    float width = renderedFrame.getWidth() - getPaddingLeft() - getPaddingRight();
+    for (size_t index = visibleMax + 1; index < end; index++) {
+        if (cellHeightCache[index] != -1 || cellLayoutRequested.count(index)) continue;
+        // 每项只请求一次，失败时添加到屏幕上再测量
+        cellLayoutRequested.insert(index);
+        RecyclingGridLayoutTask task = dataSource->layoutForRow(this, index);
+        if (!task) continue;
+
+        size_t token = *layoutToken;
+        LayoutThreadPool::instance().Submit([this, task, index, width, token, current = layoutToken]() mutable {
+            auto layout = task(width);
+            // 布局任务可能持有只能在主线程中释放的资源（比如图片），交给主线程释放
+            brls::sync([this, task = std::move(task), layout, index, token, current]() {
+                if (*current != token) return;
+                // 只接受屏幕下方的结果，修改屏幕上方的高度会让已添加的列表项错位
+                if (!layout || index <= visibleMax || index >= cellHeightCache.size()) return;
+                if (cellHeightCache[index] != -1) return;
+                cellLayoutCache[index] = layout;
+                if (layout->height < 0) return;
+                cellHeightCache.set(index, std::min(layout->height, estimatedRowHeight), true);
+                this->updateContentHeight();
+            });
+        });
+    }
+}
+
+void RecyclingGrid::forceRequestNextPage() {
+    this->requestNextPage = false;
+    this->pageRequestTime = 0;
+}
+
+void RecyclingGrid::updateContentHeight() {
+    if (!dataSource || dataSource->getItemCount() == 0) {
+        contentBox->setHeight(0);
+        return;
+    }
+    float height;
+    if (!isFlowMode || spanCount != 1) {
+        height = (estimatedRowHeight + estimatedRowSpace) * (float)getRowCount();
+    } else {
+        height = getHeightByCellIndex(dataSource->getItemCount());
+    }
+    // 正在加载下一页时在底部多留出一行显示骨架屏，数据返回后由新的列表项替换
+    if (pageRequestTime != 0) height += estimatedRowHeight + estimatedRowSpace;
+    contentBox->setHeight(height + paddingTop + paddingBottom);
+}
+
+void RecyclingGrid::checkNextPage(const brls::Rect& visibleFrame) {
+    brls::Time now = brls::getCPUTimeUsec();
+
+    // 记录向下滑动的平均速度（行/秒）
+    if (lastScrollTime > 0 && now > lastScrollTime) {
+        float rows  = (visibleFrame.getMinY() - lastScrollY) / (estimatedRowHeight + estimatedRowSpace);
+        float speed = std::max(rows, 0.0f) * 1000000.0f / (float)(now - lastScrollTime);
+        scrollSpeed = scrollSpeed * 0.8f + speed * 0.2f;
+    }
+    lastScrollY    = visibleFrame.getMinY();
+    lastScrollTime = now;
+
+    // 有数据、不是骨架屏数据、数据不为空
+    if (!nextPageCallback || !dataSource || dynamic_cast<DataSourceSkeleton*>(dataSource)) return;
+    size_t count = dataSource->getItemCount();
+    if (count == 0) return;
+
+    if (pageRequestTime != 0) {
+        // 请求失败或没有更多数据时不会调用 notifyDataChanged，超时后视为请求结束，并暂停预加载
+        if (now - pageRequestTime < PAGE_TIMEOUT * 1000) return;
+        pageRequestTime     = 0;
+        preFetchPageEnabled = false;
+        this->updateContentHeight();
+    }
+
+    if (visibleMax + 1 >= count) {
+        // 只有当 requestNextPage 为false时，才可以请求下一页，避免多次重复请求
+        if (requestNextPage) return;
+        brls::Logger::debug("RecyclingGrid request next page");
+    } else {
+        if (!preFetchPageEnabled || nextPageRatio >= 1) return;
+        // 剩余行数少于已加载行数的一定比例，或少于下一页返回前按当前速度会滑过的行数时，提前加载下一页
+        size_t rows      = getRowCount();
+        size_t remaining = rows - (visibleMax / spanCount + 1);
+        float threshold  = std::max((float)rows * (1 - nextPageRatio), scrollSpeed * pageLatency / 1000.0f * 1.5f);
+        if ((float)remaining > threshold) return;
+        brls::Logger::debug("RecyclingGrid prefetch next page: {} rows left, {:.1f} rows/s", remaining, scrollSpeed);
+    }
+
+    requestNextPage = true;
+    pageRequestTime = now;
+    this->updateContentHeight();
+    this->nextPageCallback();
+}
+
+void RecyclingGrid::drawFooterSkeleton(NVGcontext* vg, float x, float y, brls::Style style, brls::FrameContext* ctx) {
+    if (pageRequestTime == 0 || !dataSource) return;
+    size_t count = dataSource->getItemCount();
+    // 列表底部还没有出现在屏幕上
+    if (count == 0 || visibleMax + 1 < count) return;
+
+    float top;
+    if (!isFlowMode || spanCount != 1) {
+        top = (estimatedRowHeight + estimatedRowSpace) * (float)getRowCount();
+    } else {
+        top = getHeightByCellIndex(count);
+    }
+    float cellWidth = (renderedFrame.getWidth() - getPaddingLeft() - getPaddingRight()) / spanCount;
+    for (int i = 0; i < spanCount; i++) {
+        footerSkeleton->draw(vg, x + getPaddingLeft() + cellWidth * i, y + paddingTop + top,
+                             isFlowMode ? cellWidth : cellWidth - estimatedRowSpace, estimatedRowHeight, style, ctx);
+    }
+}
 
 brls::View* RecyclingGrid::getNextCellFocus(brls::FocusDirection direction, brls::View* currentView) {
     void* parentUserData = currentView->getParentUserData();
@@ -549,12 +873,8 @@ brls::View* RecyclingGrid::getNextCellFocus(brls::FocusDirection direction, brls
 
         while (!row_currentFocus && row_currentFocusIndex >= 0 &&
                row_currentFocusIndex < this->dataSource->getItemCount()) {
-            for (auto it : this->contentBox->getChildren()) {
-                if (*((size_t*)it->getParentUserData()) == row_currentFocusIndex) {
-                    row_currentFocus = it->getDefaultFocus();
-                    break;
-                }
-            }
+            RecyclingGridItem* cell = getGridItemByIndex(row_currentFocusIndex);
+            if (cell) row_currentFocus = cell->getDefaultFocus();
             row_currentFocusIndex += row_offset;
         }
         if (row_currentFocus) {
@@ -597,12 +917,8 @@ brls::View* RecyclingGrid::getNextCellFocus(brls::FocusDirection direction, brls
     View* currentFocus       = nullptr;
 
     while (!currentFocus && currentFocusIndex >= 0 && currentFocusIndex < this->dataSource->getItemCount()) {
-        for (auto it : this->contentBox->getChildren()) {
-            if (*((size_t*)it->getParentUserData()) == currentFocusIndex) {
-                currentFocus = it->getDefaultFocus();
-                break;
-            }
-        }
+        RecyclingGridItem* cell = getGridItemByIndex(currentFocusIndex);
+        if (cell) currentFocus = cell->getDefaultFocus();
         currentFocusIndex += offset;
     }
 
@@ -717,9 +1033,7 @@ RecyclingGridItem* RecyclingGrid::dequeueReusableCell(std::string identifier) {
             cell = vector->back();
             vector->pop_back();
         } else {
-            cell                  = allocationMap.at(identifier)();
-            cell->reuseIdentifier = identifier;
-            cell->detach();
+            cell = allocateCell(identifier);
         }
     }
 
@@ -733,6 +1047,12 @@ RecyclingGridItem* RecyclingGrid::dequeueReusableCell(std::string identifier) {
 
 RecyclingGridContentBox::RecyclingGridContentBox(RecyclingGrid* recycler) : Box(brls::Axis::ROW), recycler(recycler) {}
 
+void RecyclingGridContentBox::draw(NVGcontext* vg, float x, float y, float width, float height, brls::Style style,
+                                   brls::FrameContext* ctx) {
+    Box::draw(vg, x, y, width, height, style, ctx);
+    this->recycler->drawFooterSkeleton(vg, x, y, style, ctx);
+}
+
 brls::View* RecyclingGridContentBox::getNextFocus(brls::FocusDirection direction, brls::View* currentView) {
     return this->recycler->getNextCellFocus(direction, currentView);
 }
\ No newline at end of file
@@ -3,11 +3,22 @@
 //
 
 #include <borealis/core/thread.hpp>
+#include <cpr/cpr.h>
+
+#include <algorithm>
 
 #include "bilibili.h"
 #include "view/subtitle_core.hpp"
 #include "view/mpv_core.hpp"
 
+static constexpr float SUBTITLE_FONT_SIZE     = 26;
+static constexpr float SUBTITLE_BORDER_V      = 6;
+static constexpr float SUBTITLE_BORDER_H      = 16;
+static constexpr float SUBTITLE_BOTTOM_SPACE  = 26;
+static constexpr float SUBTITLE_CORNER_RADIUS = 2;
+// 同时显示多条字幕时的间距
+static constexpr float SUBTITLE_SPACING = 4;
+
 static NVGcolor a(NVGcolor color, float alpha) {
     color.a *= alpha;
     return color;
@@ -35,56 +46,128 @@ void SubtitleCore::reset() {
     this->videoPageData.last_play_cid  = 0;
     this->videoPageData.last_play_time = 0;
     this->videoPageData.online_count   = 0;
-    this->subtitleIndex                = 0;
     this->clearSubtitle();
 }
 
 [[nodiscard]] bool SubtitleCore::isAvailable() const { return !videoPageData.subtitles.empty(); }
 
-void SubtitleCore::drawSubtitle(NVGcontext* vg, float x, float y, float width, float height, float alpha) {
-    double playbackTime = MPVCore::instance().playback_time;
-    for (size_t i = subtitleIndex; i < currentSubtitle.data.body.size(); i++) {
-        auto& line = currentSubtitle.data.body[i];
-        // 当前还不能播放字幕
-        if (line.from >= playbackTime) break;
-        // 当前字幕播放结束，应该播放下一条
-        if (line.to < playbackTime) continue;
-
-        float fontSize               = 26;
-        float borderV                = 6;
-        float borderH                = 16;
-        float bottomSpace            = 26;
-        float backgroundCornerRadius = 2;
-
-        // 初始化
-        nvgFontSize(vg, fontSize);
-        nvgTextAlign(vg, NVG_ALIGN_TOP | NVG_ALIGN_LEFT);
-        nvgFontFaceId(vg, this->subtitleFont);
-        nvgTextLineHeight(vg, 1);
-        if (line.length <= 0) {
-            float bounds[4];
-            nvgTextBounds(vg, 0, 0, line.content.c_str(), nullptr, bounds);
-            line.length = bounds[2] - bounds[0];
+void SubtitleCore::seekCue(double time) {
+    auto& cues = subtitleIndex->cues;
+    auto it    = std::lower_bound(cues.begin(), cues.end(), time,
+                                  [](const SubtitleLine& line, double t) { return line.from < t; });
+    cueCursor  = it - cues.begin();
+
+    // 向前查找仍未结束的字幕，直到更早的字幕都已经结束
+    activeCues.clear();
+    for (size_t i = cueCursor; i > 0 && subtitleIndex->endTime[i - 1] >= time; i--) {
+        if (cues[i - 1].to >= time) activeCues.emplace_back(i - 1);
+    }
+    std::reverse(activeCues.begin(), activeCues.end());
+}
+
+void SubtitleCore::updateActiveCues(double time) {
+    auto& cues = subtitleIndex->cues;
+    if (time < cueTime) {
+        seekCue(time);
+    } else {
+        size_t steps = 0;
+        while (cueCursor < cues.size() && cues[cueCursor].from < time) {
+            if (++steps > SUBTITLE_SEEK_STEPS) {
+                seekCue(time);
+                break;
+            }
+            activeCues.emplace_back(cueCursor++);
         }
+    }
+    cueTime = time;
+
+    // 移除已经结束的字幕
+    activeCues.erase(std::remove_if(activeCues.begin(), activeCues.end(),
+                                    [&cues, time](size_t i) { return cues[i].to < time; }),
+                     activeCues.end());
+}
+
+void SubtitleCore::layoutCue(NVGcontext* vg, size_t i) {
+    auto& layout = subtitleIndex->layouts[i];
+    auto& text   = subtitleIndex->cues[i].content;
+    layout.rows.clear();
+    layout.width = 0;
+    layout.ready = true;
+
+    const char* start = text.c_str();
+    const char* end   = start + text.size();
+    NVGtextRow rows[4];
+    int count;
+    while (start < end && (count = nvgTextBreakLines(vg, start, end, subtitleIndex->layoutWidth, rows, 4)) > 0) {
+        for (int r = 0; r < count; r++) {
+            layout.rows.emplace_back(SubtitleRow{std::string(rows[r].start, rows[r].end), rows[r].width});
+            layout.width = std::max(layout.width, rows[r].width);
+        }
+        start = rows[count - 1].next;
+    }
+}
+
+void SubtitleCore::drawSubtitle(NVGcontext* vg, float x, float y, float width, float height, float alpha) {
+    if (!subtitleIndex || subtitleIndex->cues.empty()) return;
+    auto& index = *subtitleIndex;
+
+    // 初始化
+    nvgFontSize(vg, SUBTITLE_FONT_SIZE);
+    nvgTextAlign(vg, NVG_ALIGN_TOP | NVG_ALIGN_LEFT);
+    nvgFontFaceId(vg, this->subtitleFont);
+    nvgTextLineHeight(vg, 1);
+
+    // 显示区域大小改变后重新排版
+    float layoutWidth = std::max(width * 0.8f - SUBTITLE_BORDER_H * 2, SUBTITLE_FONT_SIZE);
+    if (index.layoutWidth != layoutWidth) {
+        index.layoutWidth = layoutWidth;
+        for (auto& layout : index.layouts) layout.ready = false;
+        index.layoutCursor = cueCursor;
+    }
+
+    updateActiveCues(MPVCore::instance().getMediaTime());
+
+    // 每帧预先排版少量即将显示的字幕，避免字幕出现时集中排版
+    index.layoutCursor = std::max(index.layoutCursor, cueCursor);
+    for (size_t n = 0; n < SUBTITLE_LAYOUT_BATCH && index.layoutCursor < index.cues.size(); index.layoutCursor++) {
+        if (index.layouts[index.layoutCursor].ready) continue;
+        layoutCue(vg, index.layoutCursor);
+        n++;
+    }
+
+    // 较晚开始的字幕显示在下方，较早的字幕依次向上排列
+    float bottom = y + height - SUBTITLE_BOTTOM_SPACE;
+    for (auto it = activeCues.rbegin(); it != activeCues.rend(); ++it) {
+        if (!index.layouts[*it].ready) layoutCue(vg, *it);
+        auto& layout = index.layouts[*it];
+        if (layout.rows.empty()) continue;
+        float top = bottom - SUBTITLE_FONT_SIZE * layout.rows.size();
 
         // 绘制字幕背景
         nvgBeginPath(vg);
         nvgFillColor(vg, a(backgroundColor, alpha));
-        nvgRoundedRect(vg, x + (width - line.length) / 2 - borderH, y + height - borderV - fontSize - bottomSpace,
-                       line.length + borderH * 2, fontSize + borderV * 2, backgroundCornerRadius);
+        nvgRoundedRect(vg, x + (width - layout.width) / 2 - SUBTITLE_BORDER_H, top - SUBTITLE_BORDER_V,
+                       layout.width + SUBTITLE_BORDER_H * 2, bottom - top + SUBTITLE_BORDER_V * 2,
+                       SUBTITLE_CORNER_RADIUS);
         nvgFill(vg);
 
         // 绘制字幕
         nvgFillColor(vg, a(fontColor, alpha));
-        nvgText(vg, x + (width - line.length) / 2, y + height - fontSize - bottomSpace, line.content.c_str(), nullptr);
+        float rowY = top;
+        for (auto& row : layout.rows) {
+            nvgText(vg, x + (width - row.width) / 2, rowY, row.text.c_str(), nullptr);
+            rowY += SUBTITLE_FONT_SIZE;
+        }
 
         // 绘制AI标记
-        if (!currentSubtitle.data.genByAI) break;
-        nvgFontSize(vg, 8);
-        nvgFillColor(vg, a(nvgRGBA(255, 255, 255, 127), alpha));
-        nvgText(vg, x + (width + line.length) / 2 + 4, y + height - borderV - fontSize - bottomSpace + 4, "AI",
-                nullptr);
-        break;
+        if (index.genByAI) {
+            nvgFontSize(vg, 8);
+            nvgFillColor(vg, a(nvgRGBA(255, 255, 255, 127), alpha));
+            nvgText(vg, x + (width + layout.width) / 2 + 4, top - SUBTITLE_BORDER_V + 4, "AI", nullptr);
+            nvgFontSize(vg, SUBTITLE_FONT_SIZE);
+        }
+
+        bottom = top - SUBTITLE_BORDER_V * 2 - SUBTITLE_SPACING;
     }
 }
 
@@ -122,10 +205,50 @@ void SubtitleCore::selectSubtitle(size_t index) {
 }
 
 void SubtitleCore::onLoadSubtitle(const bilibili::VideoPageSubtitle& page) {
+    this->clearSubtitle();
     currentSubtitle = page;
+    // 字幕内容保存在索引中
+    currentSubtitle.data.body.clear();
     brls::Logger::info("select subtitle: {}", page.lan_doc);
+
+    // 在网络线程中建立字幕索引，字幕较多时避免阻塞主线程
+    size_t generation = this->subtitleGeneration;
+    auto index        = std::make_shared<SubtitleIndex>();
+    index->cues       = page.data.body;
+    index->genByAI    = page.data.genByAI;
+    ASYNC_RETAIN
+    cpr::async([ASYNC_TOKEN, index, generation]() {
+        auto& cues = index->cues;
+        cues.erase(std::remove_if(cues.begin(), cues.end(),
+                                  [](const SubtitleLine& line) { return line.content.empty() || line.to < line.from; }),
+                   cues.end());
+        std::stable_sort(cues.begin(), cues.end(),
+                         [](const SubtitleLine& lhs, const SubtitleLine& rhs) { return lhs.from < rhs.from; });
+        index->endTime.resize(cues.size());
+        float end = 0;
+        for (size_t i = 0; i < cues.size(); i++) {
+            end               = std::max(end, cues[i].to);
+            index->endTime[i] = end;
+        }
+        index->layouts.resize(cues.size());
+
+        brls::sync([ASYNC_TOKEN, index, generation]() {
+            ASYNC_RELEASE
+            // 等待期间已经切换了字幕
+            if (generation != this->subtitleGeneration) return;
+            this->subtitleIndex = index;
+            brls::Logger::debug("subtitle index: {} cues", index->cues.size());
+        });
+    });
 }
 
-void SubtitleCore::clearSubtitle() { currentSubtitle = bilibili::VideoPageSubtitle{}; }
+void SubtitleCore::clearSubtitle() {
+    currentSubtitle = bilibili::VideoPageSubtitle{};
+    subtitleIndex.reset();
+    subtitleGeneration++;
+    cueCursor = 0;
+    cueTime   = 0;
+    activeCues.clear();
+}
 
 [[nodiscard]] std::string SubtitleCore::getCurrentSubtitleId() const { return currentSubtitle.id_str; }
\ No newline at end of file
@@ -31,11 +31,26 @@ SVGImage::SVGImage() {
             setImageFromSVGFile(filePath);
         }
     });
+
+    // 图集更新后切换到新的纹理，新图集中没有这个图标时重新渲染
+    atlasSubscription = SVGAtlas::instance().getUpdateEvent()->subscribe([this]() {
+        if (resName.empty()) return;
+        bool inAtlas       = atlasTexture > 0;
+        this->atlasTexture = SVGAtlas::instance().get(resName, _width, _height, atlasEntry);
+        if (inAtlas && atlasTexture == 0) setImageFromSVGFile(filePath);
+    });
+}
+
+bool SVGImage::useAtlas(const std::string& name) {
+    this->resName      = name;
+    this->atlasTexture = SVGAtlas::instance().get(name, _width, _height, atlasEntry);
+    return this->atlasTexture > 0;
 }
 
 void SVGImage::setImageFromSVGRes(const std::string& value) {
 #ifdef USE_LIBROMFS
     filePath = "@res/" + value;
+    if (useAtlas(value)) return;
     if (checkCache(filePath) > 0) return;
     auto image     = romfs::get(value);
     this->document = lunasvg::Document::loadFromData((const char*)image.string().data(), image.size());
@@ -60,8 +75,13 @@ void SVGImage::setImageFromSVGRes(const std::string& value) {
 
 void SVGImage::setImageFromSVGFile(const std::string& value) {
     filePath = value;
+    resName.clear();
+    atlasTexture = 0;
 #ifdef USE_LIBROMFS
     if (value.rfind("@res/", 0) == 0) return this->setImageFromSVGRes(value.substr(5));
+#else
+    std::string resources = BRLS_RESOURCES;
+    if (value.rfind(resources, 0) == 0 && useAtlas(value.substr(resources.size()))) return;
 #endif
     if (checkCache(value) > 0) return;
 
@@ -83,6 +103,8 @@ void SVGImage::setImageFromSVGFile(const std::string& value) {
 }
 
 void SVGImage::setImageFromSVGString(const std::string& value) {
+    resName.clear();
+    atlasTexture   = 0;
     this->document = lunasvg::Document::loadFromData(value);
     if (this->document) {
         this->updateBitmap();
@@ -109,28 +131,40 @@ void SVGImage::updateBitmap() {
 
 void SVGImage::rotate(float value) { this->angle = value; }
 
-SVGImage::~SVGImage() { brls::Application::getWindowSizeChangedEvent()->unsubscribe(subscription); }
+SVGImage::~SVGImage() {
+    brls::Application::getWindowSizeChangedEvent()->unsubscribe(subscription);
+    SVGAtlas::instance().getUpdateEvent()->unsubscribe(atlasSubscription);
+}
 
 brls::View* SVGImage::create() { return new SVGImage(); }
 
 void SVGImage::draw(NVGcontext* vg, float x, float y, float width, float height, brls::Style style,
                     brls::FrameContext* ctx) {
-    if (this->texture == 0) return;
+    if (this->texture == 0 && this->atlasTexture == 0) return;
 
     nvgSave(vg);
     float cx = width / 2, cy = height / 2;
     nvgTranslate(vg, x + cx, y + cy);
     nvgRotate(vg, this->angle);
 
-    this->paint.xform[4] = -cx;
-    this->paint.xform[5] = -cy;
+    NVGpaint fill;
+    if (this->atlasTexture > 0) {
+        // 把整张图集缩放到图标的绘制尺寸，只绘制图标所在的区域
+        float sx = width / (float)atlasEntry.width, sy = height / (float)atlasEntry.height;
+        float aw = (float)SVGAtlas::instance().getWidth() * sx, ah = (float)SVGAtlas::instance().getHeight() * sy;
+        fill     = nvgImagePattern(vg, -cx - atlasEntry.x * sx, -cy - atlasEntry.y * sy, aw, ah, 0, atlasTexture, 1.0f);
+    } else {
+        this->paint.xform[4] = -cx;
+        this->paint.xform[5] = -cy;
+        fill                 = this->paint;
+    }
 
     nvgBeginPath(vg);
     if (this->getCornerRadius() > 0.0f)
         nvgRoundedRect(vg, -cx, -cy, width, height, getCornerRadius());
     else
         nvgRect(vg, -cx, -cy, width, height);
-    nvgFillPaint(vg, a(this->paint));
+    nvgFillPaint(vg, a(fill));
     nvgFill(vg);
 
     nvgRestore(vg);
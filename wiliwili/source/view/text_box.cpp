@@ -2,17 +2,64 @@
 // Created by fang on 2022/12/4.
 //
 
-#pragma GCC diagnostic ignored "-Wdeprecated-declarations"
-
+#include <chrono>
+#include <functional>
+#include <future>
+#include <unordered_set>
 #include <utility>
-#include <codecvt>
-#include <locale>
 #include <borealis/core/application.hpp>
+#include <borealis/core/thread.hpp>
 
 #include "view/text_box.hpp"
+#include "utils/frame_scheduler.hpp"
 
 const char* TEXTBOX_MORE = "更多";
 
+/// 一行文字在字符串中的位置，与 NVGtextRow 相同
+class RichTextRow {
+public:
+    size_t start, end, next;
+    float width;
+};
+
+/// 从 begin 开始最多分割 maxRows 行，返回实际的行数
+typedef std::function<size_t(const std::string& text, size_t begin, float breakRowWidth, RichTextRow* rows,
+                             size_t maxRows)>
+    RichTextBreaker;
+
+static size_t decodeUtf8(const std::string& text, size_t pos, uint32_t* codepoint) {
+    auto c     = (unsigned char)text[pos];
+    size_t len = c < 0x80 ? 1 : (c >> 5) == 0x6 ? 2 : (c >> 4) == 0xE ? 3 : (c >> 3) == 0x1E ? 4 : 1;
+    if (len == 1 || pos + len > text.size()) {
+        *codepoint = c;
+        return pos + 1;
+    }
+    uint32_t cp = c & (0xFF >> (len + 1));
+    for (size_t i = 1; i < len; i++) cp = (cp << 6) | ((unsigned char)text[pos + i] & 0x3F);
+    *codepoint = cp;
+    return pos + len;
+}
+
+static std::string encodeUtf8(uint32_t cp) {
+    std::string res;
+    if (cp < 0x80) {
+        res += (char)cp;
+    } else if (cp < 0x800) {
+        res += (char)(0xC0 | (cp >> 6));
+        res += (char)(0x80 | (cp & 0x3F));
+    } else if (cp < 0x10000) {
+        res += (char)(0xE0 | (cp >> 12));
+        res += (char)(0x80 | ((cp >> 6) & 0x3F));
+        res += (char)(0x80 | (cp & 0x3F));
+    } else {
+        res += (char)(0xF0 | (cp >> 18));
+        res += (char)(0x80 | ((cp >> 12) & 0x3F));
+        res += (char)(0x80 | ((cp >> 6) & 0x3F));
+        res += (char)(0x80 | (cp & 0x3F));
+    }
+    return res;
+}
+
 // Modified from https://github.com/memononen/nanovg
 // Do not directly modify nanovg for easy upgrade in the future
 // Great thanks to nanovg!
@@ -20,66 +67,294 @@ const char* TEXTBOX_MORE = "更多";
 inline float minf(float a, float b) { return a < b ? a : b; }
 inline float maxf(float a, float b) { return a > b ? a : b; }
 
-inline static std::shared_ptr<RichTextComponent> genRichTextSpan(const std::string& text, float x, float y,
-                                                                 NVGcolor c) {
-    auto item = std::make_shared<RichTextSpan>(text, c);
-    item->setPosition(x, y);
-    return item;
+/// 与 nvgTextBreakLines 的分行规则相同，字符宽度由 advance 提供
+static size_t textBreakLines(const std::string& text, size_t begin, float breakRowWidth, RichTextRow* rows,
+                             size_t maxRows, const std::function<float(uint32_t)>& advance) {
+    enum { SPACE, NEWLINE, CHAR, CJK_CHAR };
+    size_t nrows        = 0;
+    float x             = 0, rowStartX = 0, rowWidth = 0, wordStartX = 0, breakWidth = 0;
+    size_t rowStart     = 0, rowEnd = 0, wordStart = 0, breakEnd = 0;
+    bool hasRow         = false;
+    int type            = SPACE, ptype = SPACE;
+    uint32_t pcodepoint = 0;
+
+    if (maxRows == 0) return 0;
+    for (size_t pos = begin; pos < text.size();) {
+        uint32_t codepoint;
+        size_t str  = pos;
+        size_t next = decodeUtf8(text, pos, &codepoint);
+        float nextx = x + advance(codepoint);
+        pos         = next;
+
+        switch (codepoint) {
+            case 9:       // \t
+            case 11:      // \v
+            case 12:      // \f
+            case 32:      // space
+            case 0x00a0:  // NBSP
+                type = SPACE;
+                break;
+            case 10:  // \n
+                type = pcodepoint == 13 ? SPACE : NEWLINE;
+                break;
+            case 13:  // \r
+                type = pcodepoint == 10 ? SPACE : NEWLINE;
+                break;
+            case 0x0085:  // NEL
+                type = NEWLINE;
+                break;
+            default:
+                if ((codepoint >= 0x4E00 && codepoint <= 0x9FFF) || (codepoint >= 0x3000 && codepoint <= 0x30FF) ||
+                    (codepoint >= 0xFF00 && codepoint <= 0xFFEF) || (codepoint >= 0x1100 && codepoint <= 0x11FF) ||
+                    (codepoint >= 0x3130 && codepoint <= 0x318F) || (codepoint >= 0xAC00 && codepoint <= 0xD7AF))
+                    type = CJK_CHAR;
+                else
+                    type = CHAR;
+                break;
+        }
+
+        if (type == NEWLINE) {
+            // Always handle new lines.
+            rows[nrows++] = {hasRow ? rowStart : str, hasRow ? rowEnd : str, next, rowWidth};
+            if (nrows >= maxRows) return nrows;
+            // Set null break point
+            breakEnd   = rowStart;
+            breakWidth = 0;
+            // Indicate to skip the white space at the beginning of the row.
+            hasRow   = false;
+            rowWidth = 0;
+        } else if (!hasRow) {
+            // Skip white space until the beginning of the line
+            if (type == CHAR || type == CJK_CHAR) {
+                // The current char is the row so far
+                rowStartX  = x;
+                rowStart   = str;
+                rowEnd     = next;
+                rowWidth   = nextx - rowStartX;
+                wordStart  = str;
+                wordStartX = x;
+                // Set null break point
+                breakEnd   = rowStart;
+                breakWidth = 0;
+                hasRow     = true;
+            }
+        } else {
+            float nextWidth = nextx - rowStartX;
+
+            // track last non-white space character
+            if (type == CHAR || type == CJK_CHAR) {
+                rowEnd   = next;
+                rowWidth = nextx - rowStartX;
+            }
+            // track last end of a word
+            if (((ptype == CHAR || ptype == CJK_CHAR) && type == SPACE) || type == CJK_CHAR) {
+                breakEnd   = str;
+                breakWidth = rowWidth;
+            }
+            // track last beginning of a word
+            if ((ptype == SPACE && (type == CHAR || type == CJK_CHAR)) || type == CJK_CHAR) {
+                wordStart  = str;
+                wordStartX = x;
+            }
+
+            // Break to new line when a character is beyond break width.
+            if ((type == CHAR || type == CJK_CHAR) && nextWidth > breakRowWidth) {
+                // The run length is too long, need to break to new line.
+                if (breakEnd == rowStart) {
+                    // The current word is longer than the row length, just break it from here.
+                    rows[nrows++] = {rowStart, str, str, rowWidth};
+                    if (nrows >= maxRows) return nrows;
+                    rowStartX  = x;
+                    rowStart   = str;
+                    rowEnd     = next;
+                    rowWidth   = nextx - rowStartX;
+                    wordStart  = str;
+                    wordStartX = x;
+                } else {
+                    // Break the line from the end of the last word, and start new line from the beginning of the new.
+                    rows[nrows++] = {rowStart, breakEnd, wordStart, breakWidth};
+                    if (nrows >= maxRows) return nrows;
+                    rowStartX = wordStartX;
+                    rowStart  = wordStart;
+                    rowEnd    = next;
+                    rowWidth  = nextx - rowStartX;
+                }
+                // Set null break point
+                breakEnd   = rowStart;
+                breakWidth = 0;
+            }
+        }
+
+        pcodepoint = codepoint;
+        ptype      = type;
+        x          = nextx;
+    }
+
+    // Break the line from the end of the last word, and start new line from the beginning of the new.
+    if (hasRow) rows[nrows++] = {rowStart, rowEnd, text.size(), rowWidth};
+
+    return nrows;
 }
 
-inline static std::shared_ptr<RichTextComponent> genRichTextImage(const std::string& url, float width, float height,
-                                                                  float x, float y) {
-    auto item = std::make_shared<RichTextImage>(url, width, height, true);
-    item->setPosition(x, y);
+inline static RichTextLayoutItem genRichTextItem(RichTextType type, size_t source, size_t start, size_t length,
+                                                 float x, float y) {
+    RichTextLayoutItem item;
+    item.type   = type;
+    item.source = source;
+    item.start  = start;
+    item.length = length;
+    item.x      = x;
+    item.y      = y;
     return item;
 }
 
-RichTextData richTextBreakLines(NVGcontext* ctx, float x, float y, float breakRowWidth, const std::string& text,
-                                NVGcolor c, float lineHeight, float sx, float* lx, float* ly) {
-    NVGtextRow rows[2];
-    int nrows   = 0, i;
-    float lineh = 0;
-    NVGtextRow* row;
-    RichTextData res;
-    const char* stringStart = text.c_str();
-    const char* string      = stringStart;
-
-    nvgTextMetrics(ctx, nullptr, nullptr, &lineh);
+static std::vector<RichTextLayoutItem> richTextBreakLines(const RichTextBreaker& breakLines, size_t source, float x,
+                                                          float y, float breakRowWidth, const std::string& text,
+                                                          float rowHeight, float sx, float* lx, float* ly) {
+    RichTextRow rows[2];
+    size_t nrows = 0, i;
+    RichTextRow* row;
+    std::vector<RichTextLayoutItem> res;
+    size_t string = 0;
 
     // 第一行
-    nrows = nvgTextBreakLines(ctx, string, nullptr, breakRowWidth - sx, rows, 1);
+    nrows = breakLines(text, string, breakRowWidth - sx, rows, 1);
     if (nrows > 0) {
-        row                     = &rows[0];
-        std::string currentText = text.substr(row->start - stringStart, row->end - row->start);
-        auto firstLine          = std::wstring_convert<std::codecvt_utf8_utf16<wchar_t>>().from_bytes(currentText);
-        if (firstLine.length() == 1 && row->width / 2 + sx > breakRowWidth) {
+        row = &rows[0];
+        // 按 UTF-16 计算字符数
+        size_t length = 0;
+        for (size_t pos = row->start; pos < row->end;) {
+            uint32_t codepoint;
+            pos = decodeUtf8(text, pos, &codepoint);
+            length += codepoint > 0xFFFF ? 2 : 1;
+        }
+        if (length == 1 && row->width / 2 + sx > breakRowWidth) {
             // 只有一个字符且宽度超出了范围
             // 这里使用 row->width / 2 来判断是因为 nanovg在这种情况下会错误的返回前两个字符的宽度
             // 添加空白的一行
-            res.emplace_back(genRichTextSpan("", x + sx, y, c));
+            res.emplace_back(genRichTextItem(RichTextType::Text, source, row->start, 0, x + sx, y));
         } else {
-            res.emplace_back(genRichTextSpan(currentText, x + sx, y, c));
+            res.emplace_back(genRichTextItem(RichTextType::Text, source, row->start, row->end - row->start, x + sx, y));
             if (lx) *lx = sx + row->width;
             if (ly) *ly = y;
             string = row->next;
         }
-        y += lineh * lineHeight;
+        y += rowHeight;
     }
 
     // 之后的若干行
-    while ((nrows = nvgTextBreakLines(ctx, string, nullptr, breakRowWidth, rows, 2))) {
+    while ((nrows = breakLines(text, string, breakRowWidth, rows, 2))) {
         for (i = 0; i < nrows; i++) {
             row = &rows[i];
-            res.emplace_back(genRichTextSpan(text.substr(row->start - stringStart, row->end - row->start), x, y, c));
+            res.emplace_back(genRichTextItem(RichTextType::Text, source, row->start, row->end - row->start, x, y));
             if (lx) *lx = row->width;
             if (ly) *ly = y;
-            y += lineh * lineHeight;
+            y += rowHeight;
         }
         string = rows[nrows - 1].next;
     }
     return res;
 }
 
+/// 按行排版富文本，breakLines 负责按宽度分割文字
+static std::shared_ptr<RichTextLayout> layoutRichText(const RichTextData& data, const RichTextStyle& style, float width,
+                                                      float lineh, const RichTextBreaker& breakLines) {
+    auto res         = std::make_shared<RichTextLayout>();
+    res->style       = style;
+    res->width       = width;
+    auto& items      = res->items;
+    auto& lines      = res->lines;
+    float fontSize   = style.fontSize;
+    float lineHeight = style.lineHeight;
+
+    // 当前行从 items[lineStart] 开始
+    size_t lineStart = 0;
+    auto commitLine  = [&]() {
+        lines.emplace_back(lineStart);
+        lineStart = items.size();
+    };
+
+    float lx = 0, ly = 0;
+    for (size_t index = 0; index < data.size(); index++) {
+        auto& i = data[index];
+        if (i->type == RichTextType::Text) {
+            auto* t = (RichTextSpan*)i.get();
+            if (t->text.empty()) continue;
+            auto rows = richTextBreakLines(breakLines, index, 0, ly, width, t->text, lineh * lineHeight,
+                                           lx + t->l_margin, &lx, &ly);
+            lx += t->r_margin;
+            if (rows.empty()) {
+                // 应该不会出现这种情况
+                brls::Logger::error("TextBox: got empty line: {}", t->text);
+            } else if (rows.size() == 1) {
+                items.emplace_back(rows[0]);
+            } else {
+                if (rows[0].length != 0) {
+                    items.emplace_back(rows[0]);
+                }
+                for (auto it = rows.begin() + 1; it != rows.end(); it++) {
+                    if (items.size() > lineStart) commitLine();
+                    items.emplace_back(*it);
+                }
+            }
+
+        } else if (i->type == RichTextType::Image) {
+            auto* t = (RichTextImage*)i.get();
+
+            if (lx + t->width + 2 + t->l_margin + t->r_margin - 2 > width) {
+                // 当前行长度不够，就换到下一行
+                // 提交之前的行
+                commitLine();
+                // 设置下一行的起始位置
+                lx = 0;
+                ly += fontSize * lineHeight;
+            }
+            items.emplace_back(genRichTextItem(RichTextType::Image, index, 0, 0, lx + t->l_margin,
+                                               ly - t->height + fontSize + t->v_align));
+            lx += t->width + t->l_margin + t->r_margin;
+        } else if (i->type == RichTextType::Break) {
+            // 提交之前的行
+            commitLine();
+            // 设置下一行的起始位置
+            lx = 0;
+            ly += fontSize * lineHeight;
+        }
+    }
+    if (items.size() > lineStart) commitLine();
+
+    // 重新扫描一遍，根据图片高度调整行高
+    float height = fontSize * lineHeight;
+    float bias   = 0;
+    for (size_t line = 0; line < lines.size(); line++) {
+        size_t end = line + 1 < lines.size() ? lines[line + 1] : items.size();
+        // 获取最大行高
+        float maxLineHeight = height;
+        for (size_t j = lines[line]; j < end; j++) {
+            if (items[j].type == RichTextType::Image) {
+                auto* t       = (RichTextImage*)data[items[j].source].get();
+                maxLineHeight = maxf(maxLineHeight, t->height + t->t_margin);
+            }
+        }
+        bias += maxLineHeight - height;
+        for (size_t j = lines[line]; j < end; j++) {
+            items[j].y += bias;
+        }
+    }
+
+    float pxBottomSpace = fontSize * (lineHeight - 1);
+    size_t rows         = style.maxRows;
+    if (style.showMoreText && style.maxRows != SIZE_T_MAX) rows++;
+
+    if (style.maxRows == SIZE_T_MAX || rows >= lines.size()) {
+        // 无限制最大行数 或 最大行数大于等于当前行数
+        res->height = height * (float)lines.size() + bias - pxBottomSpace;
+    } else {
+        // 限制最大行数
+        res->height = res->getLineY(style.maxRows) + fontSize;
+    }
+    return res;
+}
+
 // End of nanovg modification
 
 static YGSize textBoxMeasureFunc(YGNodeRef node, float width, YGMeasureMode widthMode, float height,
@@ -115,32 +390,47 @@ TextBox::TextBox() {
 }
 
 void TextBox::setRichText(const RichTextData& value) {
+    prepareRichText(value);
+    this->setRichText(value, nullptr);
+}
+
+void TextBox::setRichText(const RichTextData& value, const std::shared_ptr<RichTextLayout>& layout) {
+    this->richContent = value;
+    this->richHash    = RichTextLayoutCache::hash(value);
+    this->richLayout  = layout;
+    this->setParsedDone(false);
+    // 设置内容后调用 invalidate 会触发 textBoxMeasureFunc 重排布局
+    this->invalidate();
+    FrameScheduler::instance().markDirty();
+}
+
+void TextBox::prepareRichText(const RichTextData& value) {
 #ifdef OPENCC
     static bool trans =
         brls::Application::getLocale() == brls::LOCALE_ZH_HANT || brls::Application::getLocale() == brls::LOCALE_ZH_TW;
     if (trans && OPENCC_ON) {
-        this->richContent.clear();
         for (auto& i : value) {
             if (i->type == RichTextType::Text) {
                 auto* t = (RichTextSpan*)i.get();
                 t->text = Label::STConverter(t->text);
             }
-            this->richContent.emplace_back(i);
         }
-    } else {
-        this->richContent = value;
     }
-#else
-    this->richContent = value;
 #endif
-    this->lineContent.clear();
-    this->setParsedDone(false);
-    // 设置内容后调用 invalidate 会触发 textBoxMeasureFunc 重排布局
-    this->invalidate();
 }
 
 RichTextData& TextBox::getRichText() { return this->richContent; }
 
+RichTextStyle TextBox::getRichTextStyle() const {
+    RichTextStyle style;
+    style.font         = this->font;
+    style.fontSize     = this->fontSize;
+    style.lineHeight   = this->lineHeight;
+    style.maxRows      = this->maxRows;
+    style.showMoreText = this->showMoreText;
+    return style;
+}
+
 void TextBox::setText(const std::string& value) {
     std::string text;
 #ifdef OPENCC
@@ -155,9 +445,12 @@ void TextBox::setText(const std::string& value) {
     text = value;
 #endif
     this->richContent.clear();
+    this->richLayout = nullptr;
     this->setParsedDone(false);
     this->richContent.emplace_back(std::make_shared<RichTextSpan>(text, this->textColor));
+    this->richHash = RichTextLayoutCache::hash(this->richContent);
     this->invalidate();
+    FrameScheduler::instance().markDirty();
 }
 
 void TextBox::onLayout() {
@@ -168,114 +461,54 @@ void TextBox::onLayout() {
 }
 
 float TextBox::cutRichTextLines(float width) {
-    this->lineContent.clear();
-    if (this->richContent.empty()) return 0;
-
-    auto* vg = brls::Application::getNVGContext();
-
-    nvgFontSize(vg, this->fontSize);
-    nvgTextAlign(vg, NVG_ALIGN_LEFT | NVG_ALIGN_TOP);
-    nvgFontFaceId(vg, this->font);
-    nvgTextLineHeight(vg, this->lineHeight);
-    nvgFillColor(vg, a(this->textColor));
-
-    float lx = 0, ly = 0;
-    RichTextData tempData;
-    for (const auto& i : richContent) {
-        if (i->type == RichTextType::Text) {
-            auto* t = (RichTextSpan*)i.get();
-            if (t->text.empty()) continue;
-            auto rows =
-                richTextBreakLines(vg, 0, ly, width, t->text, t->color, this->lineHeight, lx + t->l_margin, &lx, &ly);
-            lx += t->r_margin;
-            if (rows.empty()) {
-                // 应该不会出现这种情况
-                brls::Logger::error("TextBox: got empty line: {}", t->text);
-            } else if (rows.size() == 1) {
-                tempData.emplace_back(rows[0]);
-            } else {
-                if (!((RichTextSpan*)rows[0].get())->text.empty()) {
-                    tempData.emplace_back(rows[0]);
-                }
-                for (auto it = rows.begin() + 1; it != rows.end(); it++) {
-                    if (!tempData.empty()) this->lineContent.emplace_back(tempData);
-                    tempData.clear();
-                    tempData.emplace_back(*it);
-                }
-            }
-
-        } else if (i->type == RichTextType::Image) {
-            auto* t = (RichTextImage*)i.get();
-
-            if (lx + t->width + 2 + t->l_margin + t->r_margin - 2 > width) {
-                // 当前行长度不够，就换到下一行
-                // 提交之前的行
-                this->lineContent.emplace_back(tempData);
-                tempData.clear();
-                // 设置下一行的起始位置
-                lx = 0;
-                ly += fontSize * lineHeight;
-            }
-            auto item =
-                genRichTextImage(t->url, t->width, t->height, lx + t->l_margin, ly - t->height + fontSize + t->v_align);
-            item->t_margin = t->t_margin;
-            tempData.emplace_back(item);
-            lx += t->width + t->l_margin + t->r_margin;
-        } else if (i->type == RichTextType::Break) {
-            // 提交之前的行
-            this->lineContent.emplace_back(tempData);
-            tempData.clear();
-            // 设置下一行的起始位置
-            lx = 0;
-            ly += fontSize * lineHeight;
-        }
+    if (this->richContent.empty()) {
+        this->richLayout = nullptr;
+        return 0;
     }
-    if (!tempData.empty()) lineContent.emplace_back(tempData);
 
-    // 重新扫描一遍，根据图片高度调整行高
-    float height = fontSize * lineHeight;
-    float bias   = 0;
-    for (auto& i : lineContent) {
-        // 获取最大行高
-        float maxLineHeight = height;
-        for (auto& j : i) {
-            if (j->type == RichTextType::Image) {
-                auto* t       = (RichTextImage*)j.get();
-                maxLineHeight = maxf(maxLineHeight, t->height + t->t_margin);
-            }
-        }
-        bias += maxLineHeight - height;
-        for (auto& j : i) {
-            j->y += bias;
-        }
-    }
-
-    float pxBottomSpace = fontSize * (lineHeight - 1);
-    size_t rows         = maxRows;
-    if (isShowMoreText() && maxRows != SIZE_T_MAX) rows++;
-
-    if (maxRows == SIZE_T_MAX || rows >= lineContent.size()) {
-        // 无限制最大行数 或 最大行数大于等于当前行数
-        return height * (float)lineContent.size() + bias - pxBottomSpace;
+    RichTextStyle style = this->getRichTextStyle();
+    if (this->richLayout && this->richLayout->match(width, style)) return this->richLayout->height;
+
+    auto& cache = RichTextLayoutCache::instance();
+    auto layout = cache.get(richContent, this->richHash, width, style);
+    if (!layout) {
+        auto* vg = brls::Application::getNVGContext();
+
+        nvgFontSize(vg, this->fontSize);
+        nvgTextAlign(vg, NVG_ALIGN_LEFT | NVG_ALIGN_TOP);
+        nvgFontFaceId(vg, this->font);
+        nvgTextLineHeight(vg, this->lineHeight);
+        nvgFillColor(vg, a(this->textColor));
+
+        float lineh = 0;
+        nvgTextMetrics(vg, nullptr, nullptr, &lineh);
+        layout = layoutRichText(
+            richContent, style, width, lineh,
+            [vg](const std::string& text, size_t begin, float breakRowWidth, RichTextRow* rows, size_t maxRows) {
+                NVGtextRow nvgRows[2];
+                const char* string = text.c_str();
+                int nrows = nvgTextBreakLines(vg, string + begin, nullptr, breakRowWidth, nvgRows, (int)maxRows);
+                for (int i = 0; i < nrows; i++) {
+                    auto& row = nvgRows[i];
+                    rows[i]   = {(size_t)(row.start - string), (size_t)(row.end - string),
+                                 (size_t)(row.next - string), row.width};
+                }
+                return (size_t)nrows;
+            });
+        cache.put(richContent, this->richHash, layout);
     }
-
-    // 限制最大行数
-    return getLineY(maxRows) + fontSize;
+    this->richLayout = layout;
+    return layout->height;
 }
 
 float TextBox::getLineY(size_t line) {
-    if (line >= lineContent.size()) return 0;
-    if (lineContent[line].empty()) return 0;
-    float y = lineContent[line][0]->y;
-    for (auto& i : lineContent[line]) {
-        y = minf(y, i->y);
-    }
-    return y;
+    if (!richLayout) return 0;
+    return richLayout->getLineY(line);
 }
 
 void TextBox::draw(NVGcontext* vg, float x, float y, float width, float height, brls::Style style,
                    brls::FrameContext* ctx) {
-    if (width == 0) return;
+    if (width == 0 || !richLayout) return;
 
     nvgFontSize(vg, this->fontSize);
     nvgTextAlign(vg, NVG_ALIGN_LEFT | NVG_ALIGN_TOP);
@@ -289,27 +522,38 @@ void TextBox::draw(NVGcontext* vg, float x, float y, float width, float height,
         drawRow++;
     }
 
-    for (size_t line = 0; line < drawRow && line < lineContent.size(); line++) {
+    auto& items     = richLayout->items;
+    auto& lines     = richLayout->lines;
+    size_t lineSize = lines.size();
+    for (size_t line = 0; line < drawRow && line < lineSize; line++) {
         // 当最后一行给 "更多" 留出空闲区域时，跳出循环
-        if (showMoreText && line == drawRow - 1 && lineContent.size() != drawRow) break;
+        if (showMoreText && line == drawRow - 1 && lineSize != drawRow) break;
 
         // 绘制第 line 行
-        for (auto& i : lineContent[line]) {
-            if (i->type == RichTextType::Text) {
-                auto* t = (RichTextSpan*)i.get();
-                if (t->text.empty()) continue;
+        size_t end = line + 1 < lineSize ? lines[line + 1] : items.size();
+        for (size_t j = lines[line]; j < end; j++) {
+            auto& item = items[j];
+            // 排版结果与内容不一致时跳过，不越界访问
+            if (item.source >= richContent.size() || richContent[item.source]->type != item.type) continue;
+            if (item.type == RichTextType::Text) {
+                if (item.length == 0) continue;
+                auto* t = (RichTextSpan*)richContent[item.source].get();
+                if (item.start + item.length > t->text.size()) continue;
+                const char* string = t->text.c_str() + item.start;
                 nvgFillColor(vg, a(t->color));
-                nvgText(vg, x + t->x, y + t->y, t->text.c_str(), nullptr);
-            } else if (i->type == RichTextType::Image) {
-                auto* t = (RichTextImage*)i.get();
+                nvgText(vg, x + item.x, y + item.y, string, string + item.length);
+            } else if (item.type == RichTextType::Image) {
+                auto* t = (RichTextImage*)richContent[item.source].get();
+                // 只加载需要显示的图片
+                t->load();
                 t->image->setAlpha(this->getAlpha());
-                t->image->draw(vg, x + t->x, y + t->y, t->width, t->height, style, ctx);
+                t->image->draw(vg, x + item.x, y + item.y, t->width, t->height, style, ctx);
             }
         }
     }
 
     // 已经显示了全部文字
-    if (lineContent.size() <= drawRow) {
+    if (lineSize <= drawRow) {
         return;
     }
 
@@ -339,6 +583,221 @@ void TextBox::setShowMoreText(bool value) {
 
 bool TextBox::isShowMoreText() const { return this->showMoreText; }
 
+/// RichTextLayout
+
+bool RichTextLayout::match(float width, const RichTextStyle& style) const {
+    // 布局引擎计算出的宽度会对齐到像素，允许一点误差
+    return this->style == style && fabs(this->width - width) < 0.5f;
+}
+
+float RichTextLayout::getLineY(size_t line) const {
+    if (line >= lines.size()) return 0;
+    size_t end = line + 1 < lines.size() ? lines[line + 1] : items.size();
+    if (lines[line] >= end) return 0;
+    float y = items[lines[line]].y;
+    for (size_t i = lines[line]; i < end; i++) {
+        y = minf(y, items[i].y);
+    }
+    return y;
+}
+
+std::shared_ptr<RichTextLayout> RichTextLayout::create(const RichTextData& data, const RichTextStyle& style,
+                                                       float width) {
+    if (data.empty() || width <= 0) return nullptr;
+
+    // 一次测量所有未知的字符，减少与主线程的同步次数
+    std::string text;
+    for (auto& i : data) {
+        if (i->type == RichTextType::Text) text += ((RichTextSpan*)i.get())->text;
+    }
+    auto& metrics = FontMetrics::instance();
+    if (!metrics.load(style.font, style.fontSize, text)) return nullptr;
+
+    int font       = style.font;
+    float fontSize = style.fontSize;
+
+    std::function<float(uint32_t)> advance = [&metrics, font, fontSize](uint32_t codepoint) {
+        return metrics.getAdvance(font, fontSize, codepoint);
+    };
+    return layoutRichText(
+        data, style, width, metrics.getLineHeight(font, fontSize),
+        [&advance](const std::string& text, size_t begin, float breakRowWidth, RichTextRow* rows, size_t maxRows) {
+            return textBreakLines(text, begin, breakRowWidth, rows, maxRows, advance);
+        });
+}
+
+/// RichTextLayoutCache
+
+std::shared_ptr<RichTextLayout> RichTextLayoutCache::get(const RichTextData& data, size_t hash, float width,
+                                                         const RichTextStyle& style) {
+    Key key;
+    key.hash  = hash;
+    key.width = width;
+    key.style = style;
+    auto it   = index.find(key);
+    if (it == index.end()) return nullptr;
+    // 哈希碰撞，内容与缓存的排版结果不一致
+    if (it->second->second.content != serialize(data)) return nullptr;
+    // 移到队首
+    cache.splice(cache.begin(), cache, it->second);
+    return it->second->second.layout;
+}
+
+void RichTextLayoutCache::put(const RichTextData& data, size_t hash, const std::shared_ptr<RichTextLayout>& layout) {
+    if (!layout || MAX_SIZE == 0) return;
+    Key key;
+    key.hash  = hash;
+    key.width = layout->width;
+    key.style = layout->style;
+    Entry entry;
+    entry.content = serialize(data);
+    entry.layout  = layout;
+    auto it       = index.find(key);
+    if (it != index.end()) {
+        it->second->second = std::move(entry);
+        cache.splice(cache.begin(), cache, it->second);
+        return;
+    }
+    cache.emplace_front(key, std::move(entry));
+    index[key] = cache.begin();
+    while (cache.size() > MAX_SIZE) {
+        index.erase(cache.back().first);
+        cache.pop_back();
+    }
+}
+
+void RichTextLayoutCache::clear() {
+    cache.clear();
+    index.clear();
+}
+
+inline static void hashCombine(size_t& seed, size_t value) { seed ^= value + 0x9e3779b9 + (seed << 6) + (seed >> 2); }
+
+size_t RichTextLayoutCache::hash(const RichTextData& data) {
+    std::hash<float> floatHash;
+    size_t seed = data.size();
+    for (auto& i : data) {
+        hashCombine(seed, (size_t)i->type);
+        hashCombine(seed, floatHash(i->l_margin));
+        hashCombine(seed, floatHash(i->r_margin));
+        if (i->type == RichTextType::Text) {
+            hashCombine(seed, std::hash<std::string>()(((RichTextSpan*)i.get())->text));
+        } else if (i->type == RichTextType::Image) {
+            auto* t = (RichTextImage*)i.get();
+            hashCombine(seed, floatHash(t->width));
+            hashCombine(seed, floatHash(t->height));
+            hashCombine(seed, floatHash(t->v_align));
+            hashCombine(seed, floatHash(t->t_margin));
+        }
+    }
+    return seed;
+}
+
+template <typename T>
+inline static void appendValue(std::string& out, const T& value) {
+    out.append((const char*)&value, sizeof(T));
+}
+
+inline static void appendString(std::string& out, const std::string& value) {
+    appendValue(out, value.size());
+    out.append(value);
+}
+
+std::string RichTextLayoutCache::serialize(const RichTextData& data) {
+    std::string res;
+    for (auto& i : data) {
+        appendValue(res, i->type);
+        appendValue(res, i->l_margin);
+        appendValue(res, i->r_margin);
+        if (i->type == RichTextType::Text) {
+            appendString(res, ((RichTextSpan*)i.get())->text);
+        } else if (i->type == RichTextType::Image) {
+            auto* t = (RichTextImage*)i.get();
+            appendString(res, t->url);
+            appendValue(res, t->width);
+            appendValue(res, t->height);
+            appendValue(res, t->v_align);
+            appendValue(res, t->t_margin);
+        }
+    }
+    return res;
+}
+
+size_t RichTextLayoutCache::KeyHash::operator()(const Key& key) const {
+    size_t seed = key.hash;
+    hashCombine(seed, std::hash<float>()(key.width));
+    hashCombine(seed, std::hash<int>()(key.style.font));
+    hashCombine(seed, std::hash<float>()(key.style.fontSize));
+    hashCombine(seed, std::hash<float>()(key.style.lineHeight));
+    hashCombine(seed, key.style.maxRows);
+    return seed;
+}
+
+/// FontMetrics
+
+bool FontMetrics::load(int font, float fontSize, const std::string& text) {
+    std::vector<uint32_t> missing;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto& entry = fonts[{font, fontSize}];
+        std::unordered_set<uint32_t> found;
+        for (size_t pos = 0; pos < text.size();) {
+            uint32_t codepoint;
+            pos = decodeUtf8(text, pos, &codepoint);
+            if (entry.advances.count(codepoint) == 0 && found.insert(codepoint).second) missing.emplace_back(codepoint);
+        }
+        if (missing.empty() && entry.lineHeight >= 0) return true;
+    }
+
+    auto promise = std::make_shared<std::promise<void>>();
+    auto future  = promise->get_future();
+    brls::sync([this, font, fontSize, missing, promise]() {
+        this->measure(font, fontSize, missing);
+        promise->set_value();
+    });
+    return future.wait_for(std::chrono::milliseconds(TIMEOUT)) == std::future_status::ready;
+}
+
+float FontMetrics::getLineHeight(int font, float fontSize) {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = fonts.find({font, fontSize});
+    if (it == fonts.end()) return 0;
+    return it->second.lineHeight;
+}
+
+float FontMetrics::getAdvance(int font, float fontSize, uint32_t codepoint) {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = fonts.find({font, fontSize});
+    if (it == fonts.end()) return 0;
+    auto advance = it->second.advances.find(codepoint);
+    if (advance == it->second.advances.end()) return 0;
+    return advance->second;
+}
+
+void FontMetrics::measure(int font, float fontSize, const std::vector<uint32_t>& codepoints) {
+    auto* vg = brls::Application::getNVGContext();
+    nvgSave(vg);
+    nvgFontSize(vg, fontSize);
+    nvgFontFaceId(vg, font);
+    nvgTextLetterSpacing(vg, 0);
+    nvgTextAlign(vg, NVG_ALIGN_LEFT | NVG_ALIGN_TOP);
+
+    float lineh = 0;
+    nvgTextMetrics(vg, nullptr, nullptr, &lineh);
+    std::vector<float> advances;
+    advances.reserve(codepoints.size());
+    for (auto& i : codepoints) {
+        std::string glyph = encodeUtf8(i);
+        advances.emplace_back(nvgTextBounds(vg, 0, 0, glyph.c_str(), glyph.c_str() + glyph.size(), nullptr));
+    }
+    nvgRestore(vg);
+
+    std::lock_guard<std::mutex> lock(mutex);
+    auto& entry      = fonts[{font, fontSize}];
+    entry.lineHeight = lineh;
+    for (size_t i = 0; i < codepoints.size(); i++) entry.advances[codepoints[i]] = advances[i];
+}
+
 /// RichTextImage
 
 RichTextImage::RichTextImage(std::string url, float width, float height, bool autoLoad)
@@ -349,7 +808,13 @@ RichTextImage::RichTextImage(std::string url, float width, float height, bool au
     image->setCornerRadius(4);
     image->setScalingType(brls::ImageScalingType::FIT);
 
-    if (autoLoad) ImageHelper::with(image)->load(this->url);
+    if (autoLoad) this->load();
+}
+
+void RichTextImage::load() {
+    if (this->loaded) return;
+    this->loaded = true;
+    ImageHelper::with(image)->load(this->url);
 }
 
 RichTextImage::~RichTextImage() {
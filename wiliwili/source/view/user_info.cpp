@@ -9,9 +9,10 @@
 #include "view/user_info.hpp"
 #include "view/svg_image.hpp"
 #include "utils/image_helper.hpp"
+#include "utils/template_helper.hpp"
 
 UserInfoView::UserInfoView() {
-    this->inflateFromXMLRes("xml/views/user_info.xml");
+    TemplateHelper::inflate(this, "xml/views/user_info.xml");
     this->registerColorXMLAttribute("mainTextColor", [this](NVGcolor value) { this->setMainTextColor(value); });
 }
 
@@ -7,6 +7,7 @@
 #include "view/text_box.hpp"
 #include "utils/number_helper.hpp"
 #include "utils/image_helper.hpp"
+#include "utils/template_helper.hpp"
 #include <pystring.h>
 
 using namespace brls::literals;
@@ -25,7 +26,7 @@ void BaseVideoCard::cacheForReuse() {
 
 /// 普通视频封面
 
-RecyclingGridItemVideoCard::RecyclingGridItemVideoCard() { this->inflateFromXMLRes("xml/views/video_card.xml"); }
+RecyclingGridItemVideoCard::RecyclingGridItemVideoCard() { TemplateHelper::inflate(this, "xml/views/video_card.xml"); }
 
 RecyclingGridItemVideoCard::~RecyclingGridItemVideoCard() {
     // 优先清空正在进行的图片请求
@@ -132,7 +133,7 @@ void RecyclingGridItemVideoCard::setCard(const std::string& pic, const std::stri
 /// 排行榜视频封面
 /// 左上角有角标图案，从1开始自动添加序号
 
-RecyclingGridItemRankVideoCard::RecyclingGridItemRankVideoCard(std::string res) { this->inflateFromXMLRes(res); }
+RecyclingGridItemRankVideoCard::RecyclingGridItemRankVideoCard(std::string res) { TemplateHelper::inflate(this, res); }
 
 RecyclingGridItemRankVideoCard::~RecyclingGridItemRankVideoCard() {
     // 优先清空正在进行的图片请求
@@ -187,7 +188,7 @@ RecyclingGridItemRankVideoCard* RecyclingGridItemRankVideoCard::create(std::stri
 /// 直播视频封面
 
 RecyclingGridItemLiveVideoCard::RecyclingGridItemLiveVideoCard() {
-    this->inflateFromXMLRes("xml/views/video_card_live.xml");
+    TemplateHelper::inflate(this, "xml/views/video_card_live.xml");
 }
 
 RecyclingGridItemLiveVideoCard::~RecyclingGridItemLiveVideoCard() {
@@ -220,7 +221,7 @@ RecyclingGridItemLiveVideoCard* RecyclingGridItemLiveVideoCard::create() {
 /// 支持预览图横竖切换的视频封面
 
 RecyclingGridItemPGCVideoCard::RecyclingGridItemPGCVideoCard(bool vertical_cover) : vertical_cover(vertical_cover) {
-    this->inflateFromXMLRes("xml/views/video_card_pgc.xml");
+    TemplateHelper::inflate(this, "xml/views/video_card_pgc.xml");
     if (!vertical_cover) {
         this->boxPic->setHeightPercentage(70);
         this->boxBadgeBottom->setHeightPercentage(20);
@@ -265,7 +266,7 @@ RecyclingGridItemPGCVideoCard* RecyclingGridItemPGCVideoCard::create(bool vertic
 
 /// 搜索 番剧 和 影视 卡片
 RecyclingGridItemSearchPGCVideoCard::RecyclingGridItemSearchPGCVideoCard() {
-    this->inflateFromXMLRes("xml/views/video_card_search_pgc.xml");
+    TemplateHelper::inflate(this, "xml/views/video_card_search_pgc.xml");
 }
 
 RecyclingGridItemSearchPGCVideoCard::~RecyclingGridItemSearchPGCVideoCard() {
@@ -310,7 +311,7 @@ RecyclingGridItem* RecyclingGridItemSearchPGCVideoCard::create() { return new Re
 /// PGC 查看更多卡片
 
 RecyclingGridItemViewMoreCard::RecyclingGridItemViewMoreCard(bool vertical_cover) : vertical_cover(vertical_cover) {
-    this->inflateFromXMLRes("xml/views/video_card_pgc_more.xml");
+    TemplateHelper::inflate(this, "xml/views/video_card_pgc_more.xml");
 }
 
 RecyclingGridItemViewMoreCard::~RecyclingGridItemViewMoreCard() {}
@@ -328,7 +329,7 @@ RecyclingGridItem* RecyclingGridItemViewMoreCard::create(bool vertical_cover) {
 /// 历史记录 视频卡片
 
 RecyclingGridItemHistoryVideoCard::RecyclingGridItemHistoryVideoCard() {
-    this->inflateFromXMLRes("xml/views/video_card_history.xml");
+    TemplateHelper::inflate(this, "xml/views/video_card_history.xml");
 }
 
 RecyclingGridItemHistoryVideoCard::~RecyclingGridItemHistoryVideoCard() {
@@ -408,7 +409,7 @@ void RecyclingGridItemHistoryVideoCard::setCard(std::string pic, std::string tit
 /// 收藏夹 卡片
 
 RecyclingGridItemCollectionVideoCard::RecyclingGridItemCollectionVideoCard() {
-    this->inflateFromXMLRes("xml/views/video_card_collection.xml");
+    TemplateHelper::inflate(this, "xml/views/video_card_collection.xml");
 }
 
 RecyclingGridItemCollectionVideoCard::~RecyclingGridItemCollectionVideoCard() {
@@ -435,7 +436,7 @@ void RecyclingGridItemCollectionVideoCard::setCard(std::string pic, std::string
 /// 播放页推荐 卡片
 
 RecyclingGridItemRelatedVideoCard::RecyclingGridItemRelatedVideoCard() {
-    this->inflateFromXMLRes("xml/views/video_card_related.xml");
+    TemplateHelper::inflate(this, "xml/views/video_card_related.xml");
 }
 
 RecyclingGridItemRelatedVideoCard::~RecyclingGridItemRelatedVideoCard() {
@@ -466,7 +467,7 @@ void RecyclingGridItemRelatedVideoCard::setCharging(bool value) {
 /// 相关番剧卡片
 
 RecyclingGridItemSeasonSeriesVideoCard::RecyclingGridItemSeasonSeriesVideoCard() {
-    this->inflateFromXMLRes("xml/views/video_card_series.xml");
+    TemplateHelper::inflate(this, "xml/views/video_card_series.xml");
 }
 
 RecyclingGridItemSeasonSeriesVideoCard::~RecyclingGridItemSeasonSeriesVideoCard() {
@@ -4,12 +4,14 @@
 
 #include <borealis/core/touch/tap_gesture.hpp>
 #include <pystring.h>
+#include <yoga/Yoga.h>
 
 #include "view/video_comment.hpp"
 #include "view/text_box.hpp"
 #include "view/svg_image.hpp"
 #include "utils/number_helper.hpp"
 #include "utils/string_helper.hpp"
+#include "utils/template_helper.hpp"
 
 using namespace brls::literals;
 
@@ -92,7 +94,17 @@ typedef std::unordered_map<std::string, std::shared_ptr<CommentElement>> CEMap;
 
 VideoComment::VideoComment() {
     brls::Logger::verbose("View VideoComment: create");
-    this->inflateFromXMLRes("xml/views/video_comment.xml");
+    TemplateHelper::inflate(this, "xml/views/video_comment.xml");
+
+    if (!contentStyleReady) {
+        contentStyle = this->commentContent->getRichTextStyle();
+        // 按 video_comment.xml 计算一次布局，记录评论内容之外的边距、用户信息与按钮栏占用的尺寸
+        const float width = 1000;
+        YGNodeCalculateLayout(this->getYGNode(), width, YGUndefined, YGDirectionLTR);
+        contentPaddingX   = width - this->commentContent->getWidth();
+        contentPaddingY   = this->getHeight() - this->commentContent->getHeight();
+        contentStyleReady = true;
+    }
 
     this->registerColorXMLAttribute("mainTextColor", [this](NVGcolor value) { this->setMainTextColor(value); });
 
@@ -110,14 +122,7 @@ void VideoComment::setMainTextColor(NVGcolor color) {
 
 void VideoComment::setMaxRows(size_t value) { this->commentContent->setMaxRows(value); }
 
-void VideoComment::setData(bilibili::VideoCommentResult data) {
-    this->comment_data = data;
-
-    std::string subtitle = wiliwili::sec2date(data.ctime);
-    if (!data.reply_control.location.empty()) {
-        subtitle += "  " + data.reply_control.location;
-    }
-
+RichTextData VideoComment::parseContent(const bilibili::VideoCommentResult& data) {
     // 结尾加个空格用来正确识别尾部的@
     RichTextData d;
     std::string msg    = data.content.message + " ";
@@ -272,8 +277,41 @@ void VideoComment::setData(bilibili::VideoCommentResult data) {
         }
     }
 
+    return d;
+}
+
+RecyclingGridLayoutTask VideoComment::layoutTask(const bilibili::VideoCommentResult& data) {
+    if (!contentStyleReady) return nullptr;
+
+    // 解析需要读取主题，繁简转换也放在主线程中完成，后台线程只负责排版
+    RichTextData content = parseContent(data);
+    TextBox::prepareRichText(content);
+    RichTextStyle style = contentStyle;
+    float paddingX = contentPaddingX, paddingY = contentPaddingY;
+    return [content, style, paddingX, paddingY](float width) -> std::shared_ptr<RecyclingGridLayout> {
+        auto res     = std::make_shared<VideoCommentLayout>();
+        res->content = content;
+        res->layout  = RichTextLayout::create(content, style, width - paddingX);
+        if (res->layout) res->height = res->layout->height + paddingY;
+        return res;
+    };
+}
+
+void VideoComment::setData(bilibili::VideoCommentResult data, const std::shared_ptr<RecyclingGridLayout>& layout) {
+    this->comment_data = data;
+
+    std::string subtitle = wiliwili::sec2date(data.ctime);
+    if (!data.reply_control.location.empty()) {
+        subtitle += "  " + data.reply_control.location;
+    }
+
     // 设置富文本
-    this->commentContent->setRichText(d);
+    auto* commentLayout = dynamic_cast<VideoCommentLayout*>(layout.get());
+    if (commentLayout) {
+        this->commentContent->setRichText(commentLayout->content, commentLayout->layout);
+    } else {
+        this->commentContent->setRichText(parseContent(data));
+    }
 
     // 设置用户信息
     this->userInfo->setUserInfo(data.member.avatar + ImageHelper::face_ext, data.member.uname, subtitle);
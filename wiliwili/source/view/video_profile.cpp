@@ -7,6 +7,7 @@
 
 #include "view/video_profile.hpp"
 #include "view/mpv_core.hpp"
+#include "utils/frame_scheduler.hpp"
 
 VideoProfile::VideoProfile() {
     this->inflateFromXMLRes("xml/views/video_profile.xml");
@@ -45,6 +46,9 @@ void VideoProfile::update() {
     labelVideoDrop->setText(fmt::format("{} (decoder) {} (output)", mpvCore->getInt("decoder-frame-drop-count"),
                                         mpvCore->getInt("frame-drop-count")));
     labelVideoSync->setText(fmt::format("{:.5f}", mpvCore->getDouble("avsync")));
+    auto& scheduler = FrameScheduler::instance();
+    labelVideoUIFrames->setText(fmt::format("{} fps ({} skipped, target {})", scheduler.getRenderedFrames(),
+                                            scheduler.getSkippedFrames(), FrameScheduler::TARGET_FPS));
 
     // audio
     labelAudioCodec->setText(mpvCore->getString("audio-codec"));
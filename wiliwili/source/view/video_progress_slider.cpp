@@ -92,12 +92,14 @@ VideoProgressSlider::VideoProgressSlider() {
             }
 
             else if (status.state == brls::GestureState::INTERRUPTED || status.state == brls::GestureState::FAILED) {
-                *soundToPlay = brls::SOUND_TOUCH_UNFOCUS;
+                *soundToPlay    = brls::SOUND_TOUCH_UNFOCUS;
+                pointerDragging = false;
                 return;
             }
 
             else if (status.state == brls::GestureState::START) {
-                lastProgress = progress;
+                lastProgress    = progress;
+                pointerDragging = true;
             }
 
             float paddingWidth = getWidth() - pointer->getWidth();
@@ -107,6 +109,7 @@ VideoProgressSlider::VideoProgressSlider() {
             progressEvent.fire(this->progress);
 
             if (status.state == brls::GestureState::END) {
+                pointerDragging = false;
                 brls::Application::getPlatform()->getAudioPlayer()->play(brls::SOUND_SLIDER_RELEASE);
                 progressSetEvent.fire(this->progress);
                 brls::Application::giveFocus(this->getParentActivity()->getContentView());
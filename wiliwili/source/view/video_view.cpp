@@ -17,6 +17,7 @@
 #include "utils/string_helper.hpp"
 #include "utils/gesture_helper.hpp"
 #include "utils/activity_helper.hpp"
+#include "utils/videoshot_helper.hpp"
 #include "activity/player_activity.hpp"
 #include "fragment/player_danmaku_setting.hpp"
 #include "fragment/player_setting.hpp"
@@ -535,7 +536,7 @@ VideoView::VideoView() {
         } else if (event == VideoView::REAL_DURATION) {
             this->real_duration = *(int*)data;
             this->setDuration(wiliwili::sec2Time(real_duration));
-            this->setProgress((float)mpvCore->playback_time / (float)real_duration);
+            this->setProgress((float)mpvCore->getMediaTime() / (float)real_duration);
         } else if (event == VideoView::LAST_TIME) {
             if (*(int64_t*)data == VideoView::POSITION_DISCARD)
                 this->setLastPlayedPosition(VideoView::POSITION_DISCARD);
@@ -660,7 +661,7 @@ void VideoView::draw(NVGcontext* vg, float x, float y, float width, float height
     // draw bottom bar
     if (BOTTOM_BAR && showBottomLineSetting) {
         bottomBarColor.a = alpha;
-        float progress   = mpvCore->playback_time / getRealDuration();
+        float progress   = mpvCore->getMediaTime() / getRealDuration();
         progress         = progress > 1.0f ? 1.0f : progress;
         nvgFillColor(vg, bottomBarColor);
         nvgBeginPath(vg);
@@ -693,6 +694,9 @@ void VideoView::draw(NVGcontext* vg, float x, float y, float width, float height
             osdBottomBox->setVisibility(brls::Visibility::VISIBLE);
             osdBottomBox->frame(ctx);
             osdTopBox->frame(ctx);
+
+            // draw video shot
+            drawVideoShot(vg, alpha);
         }
         // draw osd lock button
         if (!hide_lock_button) {
@@ -796,6 +800,34 @@ void VideoView::drawHighlightProgress(NVGcontext* vg, float x, float y, float wi
     nvgFill(vg);
 }
 
+void VideoView::drawVideoShot(NVGcontext* vg, float alpha) {
+    if (isLiveMode || !(is_seeking || osdSlider->isProgressChanging())) return;
+    float duration = getRealDuration();
+    if (duration <= 0) return;
+    float progress = osdSlider->getProgress();
+    VideoShotFrame frame;
+    if (!VideoShotHelper::instance().getFrame(duration * progress, frame)) return;
+
+    // 预览图跟随进度条指针，但不超出进度条的范围
+    auto sliderRect = osdSlider->getFrame();
+    float height    = 135;
+    float width     = height * frame.width / frame.height;
+    float x         = sliderRect.getMinX() + 30 + (sliderRect.getWidth() - 60) * progress - width / 2;
+    x               = fmax(sliderRect.getMinX(), fmin(x, sliderRect.getMaxX() - width));
+    float y         = sliderRect.getMinY() - height - 10;
+    float scale     = width / frame.width;
+
+    NVGpaint paint = nvgImagePattern(vg, x - frame.x * scale, y - frame.y * scale, frame.imageWidth * scale,
+                                     frame.imageHeight * scale, 0, frame.texture, alpha);
+    nvgBeginPath(vg);
+    nvgRoundedRect(vg, x, y, width, height, 4);
+    nvgFillPaint(vg, paint);
+    nvgFill(vg);
+    nvgStrokeWidth(vg, 1);
+    nvgStrokeColor(vg, nvgRGBAf(1.0f, 1.0f, 1.0f, 0.8f * alpha));
+    nvgStroke(vg);
+}
+
 void VideoView::invalidate() { View::invalidate(); }
 
 void VideoView::onLayout() { brls::View::onLayout(); }
@@ -1415,11 +1447,11 @@ void VideoView::registerMpvEvent() {
                 break;
             case MpvEventEnum::UPDATE_DURATION:
                 this->setDuration(wiliwili::sec2Time(getRealDuration()));
-                this->setProgress((float)mpvCore->playback_time / getRealDuration());
+                this->setProgress((float)mpvCore->getMediaTime() / getRealDuration());
                 break;
             case MpvEventEnum::UPDATE_PROGRESS:
                 this->setPlaybackTime(wiliwili::sec2Time(this->mpvCore->video_progress));
-                this->setProgress((float)mpvCore->playback_time / getRealDuration());
+                this->setProgress((float)mpvCore->getMediaTime() / getRealDuration());
                 break;
             case MpvEventEnum::VIDEO_SPEED_CHANGE:
                 if (fabs(mpvCore->video_speed - 1) < 1e-5) {